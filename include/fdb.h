@@ -5,9 +5,83 @@
 /******************************************************************************
  * FDB : FILTERING DATABASE INTERFACE
  ******************************************************************************
+ *
+ * The Filtering Database holds, for each VLAN, entries for individual
+ * (multicast) MAC addresses, and for each port of the VLAN a default
+ * behaviour for addresses without an entry: forward by default or filter
+ * by default. An entry records for every port whether frames for its
+ * address are forwarded or filtered - there is no per port setting that
+ * means ‘behave as default’ (see gmr.h). An entry is created the first
+ * time an address is filtered or forwarded for any port, with the other
+ * ports set according to their default behaviour at the time.
+ *
+ * There is one Filtering Database, created by fdb_create_fdb() for ports
+ * numbered below number_of_ports. Until it is created, and for ports or
+ * VLAN identifiers out of range, updates are ignored.
+ */
+enum
+{
+    Fdb_number_of_vlans = 4096
+};
+extern Boolean fdb_create_fdb(unsigned number_of_ports,
+                              unsigned number_of_entries);
+/*
+ * Creates the Filtering Database, with space initially for
+ * number_of_entries entries. The space is doubled whenever it fills. All
+ * ports start by filtering by default. Returns False if space cannot be
+ * allocated or the database already exists.
+ */
+extern void fdb_destroy_fdb(void);
+/*
+ * Destroys the Filtering Database, releasing its space.
  */
 extern void fdb_filter(unsigned vlan_id, int port_no, Mac_address address);
 extern void fdb_forward(unsigned vlan_id, int port_no, Mac_address address);
 extern void fdb_filter_by_default(unsigned vlan_id, int port_no);
 extern void fdb_forward_by_default(unsigned vlan_id, int port_no);
-#endif /* fdb_h__ */
\ No newline at end of file
+typedef enum /* Fdb_action */
+{
+    Fdb_filter,
+    Fdb_forward
+} Fdb_action;
+typedef enum /* Fdb_default */
+{
+    Fdb_default_unchanged,
+    Fdb_default_filter,
+    Fdb_default_forward
+} Fdb_default;
+extern void fdb_update(unsigned vlan_id, int port_no, Mac_address *addresses,
+                       unsigned number_of_addresses, Fdb_action action,
+                       Fdb_default default_action);
+/*
+ * Filters or forwards (as action) frames for each of the number_of_addresses
+ * addresses on the port for the VLAN, and changes the port's default
+ * behaviour for addresses without an entry (as default_action), as a single
+ * update. The Filtering Database applies the whole update at once, so that
+ * frames are never forwarded or filtered according to part of it - such as
+ * the new default with only some of the addresses changed - and only one
+ * call is needed however many addresses a change of Legacy mode affects.
+ */
+extern Boolean fdb_remove(unsigned vlan_id, Mac_address address);
+/*
+ * Removes the entry for the address on the VLAN, returning False if there
+ * is none. Frames for the address then follow each port's default.
+ */
+extern Boolean fdb_forwarding(unsigned vlan_id, int port_no,
+                              Mac_address address);
+/*
+ * Returns True if frames for the address on the VLAN are forwarded through
+ * the port, according to its entry if there is one, or else the port's
+ * default behaviour.
+ */
+extern void fdb_forwarding_ports(unsigned vlan_id, Mac_address address,
+                                 Bitword *ports);
+/*
+ * Sets ports, a bit set of number_of_ports bits indexed by port number, to
+ * the ports through which frames for the address on the VLAN are forwarded.
+ */
+extern unsigned fdb_number_of_entries(void);
+/*
+ * Returns the number of entries in the database.
+ */
+#endif /* fdb_h__ */
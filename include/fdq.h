@@ -0,0 +1,107 @@
+/* fdq.h */
+#ifndef fdq_h__
+#define fdq_h__
+#include "sys.h"
+#include "fdb.h"
+/******************************************************************************
+ * FDQ : FILTERING DATABASE QUEUE
+ ******************************************************************************
+ *
+ * Programming the Filtering Database can be slow (a hardware table is
+ * typically written entry by entry over a bus), so GMR does not update it
+ * directly. Instead each change is placed on a bounded queue and returns at
+ * once, and the queue is drained by a separate programming thread supplied
+ * by the system, which calls fdq_program() repeatedly. Changes are applied
+ * in the order they were queued, and each is applied as a whole, as it
+ * would have been by the corresponding fdb.h function.
+ *
+ * The queue is written only by the thread running GARP and read only by the
+ * programming thread, so neither takes a lock, and GARP never waits for the
+ * programming thread: a change for which the queue has no room is refused,
+ * and the caller keeps it to queue again later (GMR keeps it pending, see
+ * gmr.h). Before that, once the queue is more than three quarters full, it
+ * is congested, and GMR delays its transmissions (which invite the Joins,
+ * rejoins after LeaveAlls, and so on of other participants, and so give
+ * rise to further changes) until the programming thread has caught up. The
+ * memory used is fixed when the queue is created.
+ *
+ * Until the queue is created, and after it is destroyed, each change is
+ * made directly by the fdb.h function.
+ */
+enum
+{
+    Fdq_latency_buckets = 32
+};
+#define Fdq_unlimited_room 0xFFFFFFFFu
+typedef struct /* Fdq_latency */
+{ /*
+   * The time, in microseconds, from each change of a single address or
+   * default being queued to its being applied to the Filtering Database:
+   * the number of changes, their total and maximum latency, and a histogram
+   * in which bucket n counts the changes with latency below 2**n (but not
+   * below 2**(n-1)) microseconds.
+   */
+    unsigned long changes;
+    unsigned long total;
+    unsigned long max;
+    unsigned long histogram[Fdq_latency_buckets];
+} Fdq_latency;
+extern Boolean fdq_create_fdq(unsigned number_of_changes,
+                              unsigned program_time);
+/*
+ * Creates the queue, with space for number_of_changes changes of a single
+ * address or default (rounded up to a power of two). A batch from
+ * fdq_update() takes one for each address, or one if there are none.
+ *
+ * program_time simulates a slow table: the programming thread takes at
+ * least program_time microseconds to apply each change to the Filtering
+ * Database, which is then the stand-in for the hardware table. It is zero
+ * for the Filtering Database itself.
+ */
+extern void fdq_destroy_fdq(void);
+/*
+ * Destroys the queue. The programming thread must have stopped; changes
+ * still queued are applied first.
+ */
+extern Boolean fdq_filter(unsigned vlan_id, int port_no,
+                          Mac_address address);
+extern Boolean fdq_forward(unsigned vlan_id, int port_no,
+                           Mac_address address);
+extern Boolean fdq_filter_by_default(unsigned vlan_id, int port_no);
+extern Boolean fdq_forward_by_default(unsigned vlan_id, int port_no);
+extern Boolean fdq_update(unsigned vlan_id, int port_no,
+                          Mac_address *addresses,
+                          unsigned number_of_addresses, Fdb_action action,
+                          Fdb_default default_action);
+/*
+ * Queue the change made by the fdb.h function of the same name, whole,
+ * returning True; or, if the queue does not have room for all of it,
+ * queue nothing and return False. An update with more addresses than the
+ * queue can hold is always refused, so a caller with such an update makes
+ * it in parts of at most fdq_room() addresses.
+ */
+extern Boolean fdq_remove(unsigned vlan_id, Mac_address address);
+/*
+ * Queues the removal of the address's entry (see fdb_remove()), returning
+ * False, and queueing nothing, if the queue has no room for it. The removal
+ * is made in order with the changes queued before and after it.
+ */
+extern unsigned fdq_room(void);
+/*
+ * Returns the number of addresses (or changes of default alone) for which
+ * the queue has room: Fdq_unlimited_room if there is no queue.
+ */
+extern Boolean fdq_congested(void);
+/*
+ * Returns True if the queue is more than three quarters full.
+ */
+extern Boolean fdq_program(void);
+/*
+ * Called by the programming thread: applies the changes queued so far,
+ * returning False if there were none.
+ */
+extern void fdq_read_latency(Fdq_latency *latency);
+/*
+ * Returns the latency of the changes applied so far.
+ */
+#endif /* fdq_h__ */
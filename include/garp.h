@@ -17,12 +17,42 @@ typedef struct /* Garp */
                 * and to GIP (one per application). The signaling functions include the
                 * addition and removal of ports, which the application should use to
                 * initialize port attributes with any management state required.
+                *
+                * The instances of GID are held in a table indexed by port number, with
+                * gid_table_size slots, empty slots being NULL. The port numbers of the
+                * ports that are ‘connected’ for GIP are listed, in ascending order, in
+                * connected_ports. The table and list are allocated and grown by GID as
+                * ports are created, so propagation and action processing walk a compact
+                * array rather than chasing pointers through each port's control block.
+                *
+                * GIP keeps, for each attribute, the set of connected ports registering
+                * it, as gip_port_words Bitwords indexed by port number. GID grows the
+                * sets with the port table.
+                *
+                * GID also keeps state for the application as a whole: for each
+                * attribute, a count of the ports on which its GID machine is active,
+                * and a bitmap of the attributes that are active on any port, and a
+                * bit set, indexed by port number like the port table, of the ports
+                * with actions for gid_do_actions() to carry out, so that
+                * gip_do_actions() need visit only those.
+                *
+                * The control blocks and arrays of GID, GIP, and the application
+                * are allocated from the application's arena, if it has one, so
+                * that they lie together and are released together.
                 */
     int process_id;
-    void *gid;
-    unsigned *gip;
+    void *arena;
+    void **gid;
+    int gid_table_size;
+    int *connected_ports;
+    int number_of_connected_ports;
+    Bitword *ports_with_actions;
+    Bitword *gip;
+    unsigned gip_port_words;
     unsigned max_gid_index;
     unsigned last_gid_used;
+    unsigned *gid_active_ports;
+    Bitword *gid_active;
     void (*join_indication_fn)(void *, void *my_port, unsigned joining_gid_index);
     void (*leave_indication_fn)(void *, void *gid,
                                 unsigned leaving_gid_index);
@@ -46,10 +46,17 @@ typedef struct /* Gid_machine */
      * The GID machine and its internal representation of GID states is not
      * accessed directly: this struct is defined here to allow the GID
      * Control Block (which is accessed externally) to be defined below.
+     *
+     * The 14 Applicant and 18 Registrar states are combined into a single
+     * octet, registrar * 14 + applicant, which indexes the fused transition
+     * tables directly (see gidtt.c).
      */
-    unsigned applicant : 5; /* : Applicant_states */
-    unsigned registrar : 5; /* : Registrar_states */
+    Octet state;
 } Gid_machine;
+enum
+{
+    Number_of_gid_machine_states = 14 * 18
+}; /* for array sizing */
 /******************************************************************************
  * GID : GARP INFORMATION DISTRIBUTION PROTOCOL : MANAGEMENT STATES
  ******************************************************************************
@@ -173,6 +180,14 @@ enum
     Gid_leaveall_count = 4
 };
 enum
+{
+    Gid_initial_table_size = 16
+}; /* port table slots */
+enum
+{
+    Gid_machine_sets = 4
+}; /* bit sets allocated with each port's machines */
+enum
 {
     Gid_default_leaveall_time = 10000
 }; /* miliiseconds */
@@ -184,8 +199,8 @@ typedef struct /* Gid */
 {
     /* Each instance of GID is represented by one of these control blocks.
      * There is a single instance of GID per port for each GARP application.
-     * The control blocks are linked together through the next_in_port_ring
-     * pointer to form a complete ring.
+     * The control blocks are held in the application's port table, indexed
+     * by port number (see Garp).
      *
      * Each control block contains a pointer to the GARP control block
      * representing the application instance that specifies the application’s
@@ -194,14 +209,12 @@ typedef struct /* Gid */
      * including timer functions).
      *
      * The port number associated with this instance of GID is specified.
-     * The GID control blocks for all of the ports of an application instance
-     * are linked together through the next_in_port_ring pointer to form a
-     * complete ring. Ports which are ‘connected,’ e.g., are all in a spanning
-     * tree forwarding state, are linked through the next_in_connected_ring
-     * pointer. The is_connected flag is also set for these ports, and it
-     * handles the case of a single connected port [is_connected is true (set)]
-     * only if is_enabled is also true. The GID control block definition is
-     * shared to allow GIP to traverse these fields.
+     * Ports which are ‘connected,’ e.g., are all in a spanning tree
+     * forwarding state, are listed by port number in the application's
+     * connected_ports. The is_connected flag is also set for these ports,
+     * and it handles the case of a single connected port [is_connected is
+     * true (set)] only if is_enabled is also true. The GID control block
+     * definition is shared to allow GIP to read these fields.
      *
      * GID processing for the port as a whole may be enabled or disabled : the
      * current state is recorded here in case received PDUs or other events
@@ -265,14 +278,34 @@ typedef struct /* Gid */
      * machine is stored in the GID machine indexed by untransmit_machine -
      * space for this is reserved at the very end of the GID machine array,
      * which is one larger than would otherwise be required to store the
-     * maximum number of attributes specified at GID creation. This allows
+     * maximum number of attributes currently supported by the application
+     * (the array is reallocated if the application grows). This allows
      * the implementation of a simple untransmit function, like the C
-     * library function ungetc().
+     * library function ungetc(). The bit set tx_pending_machines, which is
+     * allocated with and follows the machine array, records which machines
+     * have something to do at a transmit opportunity, so that gid_next_tx()
+     * need not examine every machine. Similarly leaving_machines records
+     * which registrars are counting down the leave timer, so that leave
+     * timer expiry visits only those.
+     *
+     * LeaveAll processing is deferred: leaveall_machines records the
+     * machines to which it has yet to be applied, and leaveall_odd_machines
+     * whether an odd number of LeaveAlls are pending. It is applied to each
+     * machine before any other use of it, with transmission and leave timer
+     * expiry visiting these machines too. The counts leaveall_joins and
+     * leaveall_leaves of machines whose state would start the join or leave
+     * timer on a LeaveAll allow its effect on the scratchpad to be
+     * determined when it is received.
+     *
+     * The fields used on every invocation of GID - the application, the
+     * machines, the flags, and the transmit indices - are placed together at
+     * the start of the control block, so that they share a cache line. The
+     * timeouts, which are read only when timers are started, follow on a
+     * cache line of their own.
      */
     Garp *application;
+    Gid_machine *machines;
     int port_no;
-    void *next_in_port_ring;
-    void *next_in_connected_ring;
     unsigned is_enabled : 1;
     unsigned is_connected : 1;
     unsigned is_point_to_point : 1;
@@ -284,25 +317,41 @@ typedef struct /* Gid */
     unsigned leave_timer_running : 1;
     unsigned hold_tx : 1;
     unsigned tx_pending : 1;
-    int join_timeout;
-    int leave_timeout_4;
-    int hold_timeout;
     int leaveall_countdown;
-    int leaveall_timeout_n;
-    Gid_machine *machines;
     unsigned last_transmitted;
     unsigned last_to_transmit;
     unsigned untransmit_machine;
+    Bitword *tx_pending_machines;
+    Bitword *leaving_machines;
+    Bitword *leaveall_machines;
+    Bitword *leaveall_odd_machines;
+    unsigned leaveall_joins;
+    unsigned leaveall_leaves;
+    int join_timeout Sys_cache_aligned;
+    int leave_timeout_4;
+    int hold_timeout;
+    int leaveall_timeout_n;
 } Gid;
 /******************************************************************************
  * GID : GARP INFORMATION DISTRIBUTION PROTOCOL : CREATION, DESTRUCTION, ETC.
  ******************************************************************************
  */
+extern Boolean gid_create_application(Garp *application);
+/*
+ * Allocates the GID state kept for the application as a whole, sized for
+ * attributes up to application->max_gid_index. Called by the application
+ * when it is created, before any port is created.
+ */
+extern void gid_destroy_application(Garp *application);
+/*
+ * Releases the GID state kept for the application as a whole. Called by
+ * the application once all its ports have been destroyed.
+ */
 extern Boolean gid_create_port(Garp *application, int port_no);
 /*
  * Creates a new instance of GID, allocating space for GID machines as
- * required by the application, adding the port to the ring of ports
- * for the application, and signaling the application that the new port
+ * required by the application, adding the port to the table of ports
+ * for the application (growing the table if necessary), and signaling the application that the new port
  * has been created.
  *
  * On creation each GID machine is set to operate as Normal or with
@@ -318,24 +367,36 @@ extern void gid_destroy_port(Garp *application, int port_no);
  * allocated space, signaling the application that the port has been
  * removed.
  */
+extern Boolean gid_resize_ports(Garp *application, unsigned max_gid_index);
+/*
+ * Grows the GID machine arrays of every port of the application to hold
+ * attributes up to max_gid_index, keeping the state of every existing
+ * machine (and of the untransmit machine, which moves to the new end of
+ * each array). New machines are unused. The GID state kept for the
+ * application as a whole is grown to match. Either everything is resized
+ * or, if space cannot be allocated, nothing is and False is returned.
+ * Machine arrays are never shrunk.
+ */
 /******************************************************************************
  * GID : GARP INFORMATION DISTRIBUTION PROTOCOL : USEFUL FUNCTIONS
  ******************************************************************************
  */
-extern Boolean gid_find_port(Gid *first_port, int port_no, void **gid);
+extern Boolean gid_find_port(Garp *application, int port_no, void **gid);
 /*
- * Finds the GID instance for port number port_no.
+ * Finds the GID instance for port number port_no, by indexing the
+ * application's port table.
  */
 extern Gid *gid_next_port(Gid *this_port);
 /*
- * Finds the next port in the ring of ports for this application.
+ * Finds the port with the next higher port number for this application,
+ * wrapping around to the lowest.
  */
 extern Boolean gid_find_unused(Garp *application, unsigned from_index,
                                unsigned *found_index);
 /*
  * Finds an unused GID machine (i.e., one with an Empty registrar and a
- * Very Anxious Observer applicant) starting the search at GID index
- * from_index, and searching to gid_last_used.
+ * Very Anxious Observer applicant on every port) starting the search at
+ * GID index from_index, and searching to gid_last_used.
  */
 /******************************************************************************
  * GID : GARP INFORMATION DISTRIBUTION PROTOCOL : MGT
@@ -388,6 +449,15 @@ extern void gid_leave_request(Gid *my_port, unsigned gid_index);
  * can be called multiple times with no ill effect.
  *
  */
+extern void gid_join_requests(Gid *my_port, unsigned from_index,
+                              Bitword selected);
+extern void gid_leave_requests(Gid *my_port, unsigned from_index,
+                               Bitword selected);
+/*
+ * As gid_join_request() and gid_leave_request() for each GID index
+ * from_index + n for which bit n of selected is set, applying the request
+ * to all of them together. from_index must be a multiple of Bitword_bits.
+ */
 extern void gid_rcv_leaveall(Gid *my_port);
 /*
  */
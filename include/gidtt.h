@@ -6,6 +6,20 @@
  * GIDTT : GARP INFORMATION DISTRIBUTION PROTOCOL : TRANSITION TABLES
  ******************************************************************************
  */
+typedef enum /* Gidtt_property */
+{
+    Gidtt_in = 0x01,            /* gidtt_in() */
+    Gidtt_active = 0x02,        /* gidtt_machine_active() */
+    Gidtt_tx_pending = 0x04,    /* gidtt_tx_pending() */
+    Gidtt_leaving = 0x08,       /* gidtt_leaving() */
+    Gidtt_leaveall_join = 0x10, /* gidtt_starts_join_timer(, Leaveempty) */
+    Gidtt_leaveall_leave = 0x20 /* gidtt_starts_leave_timer(, Leaveempty) */
+} Gidtt_property;
+extern void gidtt_build_tables(void);
+/*
+ * Builds the fused transition tables used by the functions below. Must be
+ * called before any GID machine is used; calls after the first do nothing.
+ */
 extern Gid_event gidtt_event(Gid *my_port,
                              Gid_machine *machine,
                              Gid_event event);
@@ -13,10 +27,39 @@ extern Gid_event gidtt_tx(Gid *my_port,
                           Gid_machine *machine);
 extern Gid_event gidtt_leave_timer_expiry(Gid *my_port,
                                           Gid_machine *machine);
+extern void gidtt_leaveall(Gid_machine *machine, Boolean even);
+/*
+ * Applies the Gid_rcv_leaveempty transitions for one or more LeaveAlls,
+ * twice if the number is even (a further Leaveempty makes no difference
+ * after two), without writing to the GID scratchpad.
+ */
+extern Boolean gidtt_starts_join_timer(Gid_machine *machine, Gid_event event);
+extern Boolean gidtt_starts_leave_timer(Gid_machine *machine, Gid_event event);
+/*
+ * Return True if the receive event or request would cause the Applicant to
+ * start the join timer, or the Registrar to start the leave timer.
+ */
+extern void gidtt_init(Gid_machine *machine);
+/*
+ * Sets the GID machine to the unused state : Normal membership, Very
+ * Anxious Observer applicant, Normal registration, Empty registrar.
+ */
 extern Boolean gidtt_in(Gid_machine *machine);
 /*
  * Returns True if the Registrar is in, or if registration is fixed.
  */
+extern Boolean gidtt_tx_pending(Gid_machine *machine);
+/*
+ * Returns True if a transmit opportunity would cause the Applicant to send
+ * a message or to change state, i.e., unless the Applicant is Quiet or is
+ * an Observer with nothing to leave.
+ */
+extern Boolean gidtt_leaving(Gid_machine *machine);
+/*
+ * Returns True if the Registrar is counting down the leave timer (Lv, L3,
+ * L2, or L1, for any registration management), i.e., if leave timer expiry
+ * would change its state.
+ */
 extern Boolean gidtt_machine_active(Gid_machine *machine);
 /*
  * Returns False iff the Registrar is Normal registration, Empty, and the
@@ -28,4 +71,35 @@ extern void gidtt_states(Gid_machine *machine,
  * Reports the the GID machine state : Gid_applicant_state,
  * Gid_applicant_mgt, Gid_registrar_state, Gid_registrar_mgt.
  */
+/******************************************************************************
+ * GIDTT : GARP INFORMATION DISTRIBUTION PROTOCOL : RANGES OF MACHINES
+ ******************************************************************************
+ */
+extern void gidtt_event_range(Gid *my_port, Gid_machine *machines,
+                              unsigned number_of_machines, Gid_event event,
+                              Bitword *selected, Bitword *joins,
+                              Bitword *leaves);
+/*
+ * Applies the receive event or request to each of the first
+ * number_of_machines machines whose bit is set in selected (or to all of
+ * them if selected is NULL), updating the scratchpad as gidtt_event() would
+ * for each. If joins and leaves are not NULL, sets the bits of the
+ * machines that returned Gid_join or Gid_leave, and clears all others up to
+ * number_of_machines, rounded up to a whole Bitword.
+ */
+extern void gidtt_range_properties(Gid_machine *machines,
+                                   unsigned number_of_machines,
+                                   unsigned properties, Bitword *bits);
+/*
+ * Sets the bit of each of the first number_of_machines machines that has
+ * any of the Gidtt_property properties, and clears the bit of each that has
+ * none. Other bits are unchanged.
+ */
+extern unsigned gidtt_count_properties(Gid_machine *machines,
+                                       unsigned number_of_machines,
+                                       unsigned properties);
+/*
+ * Returns the number of the first number_of_machines machines that have any
+ * of the properties.
+ */
 #endif /* gidtt_h__ */
\ No newline at end of file
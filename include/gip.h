@@ -6,16 +6,22 @@
  * GIP : GARP INFORMATION PROPAGATION : CREATION, DESTRUCTION
  ******************************************************************************
  */
-extern Boolean gip_create_gip(unsigned max_attributes, unsigned **gip);
+extern Boolean gip_create_gip(Garp *application, unsigned max_attributes);
 /*
- * Creates a new instance of GIP, allocating space for propagation counts
- * for up to max_attributes.
+ * Creates a new instance of GIP for the application, allocating space for a
+ * set of registering ports for each of up to max_attributes.
  *
- * Returns True if the creation succeeded together with a pointer to the
- * GIP information. This pointer is passed to gid_create_port() for ports
- * using this instance of GIP and is saved along with GID information.
+ * Returns True if the creation succeeded, the GIP information being saved
+ * in the application's control block.
  */
-extern void gip_destroy_gip(void *gip);
+extern Boolean gip_resize_gip(Garp *application, unsigned new_max_attributes,
+                              unsigned new_port_words);
+/*
+ * Grows the instance of GIP to new_max_attributes, each with a set of
+ * new_port_words Bitwords of ports, keeping the existing sets. Returns
+ * False, leaving the instance unchanged, if space cannot be allocated.
+ */
+extern void gip_destroy_gip(Garp *application);
 /*
  * Destroys the instance of GIP, releasing previously allocated space.
  */
@@ -25,19 +31,29 @@ extern void gip_destroy_gip(void *gip);
  */
 extern void gip_connect_port(Garp *application, int port_no);
 /*
- * Finds the port, checks that it is not already connected, and connects
- * it into the GIP propagation ring that uses GIP field(s) in GID control
- * blocks to link the source port to the ports to which the information is
- * to be propagated.
+ * Finds the port, checks that it is not already connected, and adds it to
+ * the application's list of connected ports, which links the source port
+ * to the ports to which the information is to be propagated.
  *
  * Propagates joins from and to the other already connected ports as
  * necessary.
  */
 extern void gip_disconnect_port(Garp *application, int port_no);
 /*
- * Checks to ensure that the port is connected, and then disconnects it from
- * the GIP propagation ring. Propagates leaves to the other ports that
- * remain in the ring and causes leaves to my_port as necessary.
+ * Checks to ensure that the port is connected, and then removes it from
+ * the list of connected ports. Propagates leaves to the other ports that
+ * remain connected and causes leaves to my_port as necessary.
+ */
+extern void gip_connect_ports(Garp *application, Bitword *ports);
+extern void gip_disconnect_ports(Garp *application, Bitword *ports);
+/*
+ * As gip_connect_port() and gip_disconnect_port() for each port in the set
+ * ports (a bit set of port numbers, with a bit for every slot in the
+ * application's port table), but propagating for all of them in one pass
+ * over the attributes and carrying out the GID actions once. Ports that
+ * are not found, not enabled, or already connected (or, for disconnection,
+ * not connected) are removed from the set, which is left holding the ports
+ * actually connected or disconnected.
  */
 extern void gip_propagate_join(Gid *my_port, unsigned index);
 /*
@@ -45,11 +61,11 @@ extern void gip_propagate_join(Gid *my_port, unsigned index);
  * by a combination of its attribute class and index) from my_port to other
  * ports, causing join requests to those other ports if required.
  *
- * GIP maintains a joined membership count for the connected ports for each
- * attribute (in a given context) so that leaves are not caused when joins
- * from other ports would maintain membership.
+ * GIP maintains the set of connected ports registering each attribute (in
+ * a given context) so that leaves are not caused when joins from other
+ * ports would maintain membership.
  *
- * Because this count is maintained by ‘dead-reckoning’ it is important
+ * Because this set is maintained by ‘dead-reckoning’ it is important
  * that this function only be called when there is a change indication for
  * the source port and index.
  */
@@ -59,7 +75,8 @@ extern void gip_propagate_leave(Gid *my_port, unsigned index);
  * requests to those other ports if required.
  *
  * See the comments for gip_propagate_join() before reading further.
- * This function decrements the ‘dead-reckoning’ membership count.
+ * This function removes the port from the ‘dead-reckoning’ set of
+ * registrants.
  */
 extern Boolean gip_propagates_to(Gid *my_port, unsigned index);
 /*
@@ -70,6 +87,7 @@ extern void gip_do_actions(Gid *my_port);
 /*
  * Calls GID to carry out GID ‘scratchpad’ actions accumulated during this
  * invocation of GARP for all the ports in the GIP propagation list,
- * including the source port.
+ * including the source port. Only the ports that GID has recorded as
+ * having actions are visited.
  */
 #endif /* gip_h__ */
\ No newline at end of file
@@ -6,14 +6,23 @@
  * GMD : GARP MULTICAST REGISTRATION APPLICATION DATABASE
  ******************************************************************************
  */
-extern Boolean gmd_create_gmd(unsigned max_multicasts, void **gmd);
+extern Boolean gmd_create_gmd(unsigned max_multicasts, void *arena,
+                              void **gmd);
 /*
  * Creates a new instance of GMD, allocating space for up to max_multicasts
- * MAC addresses.
+ * MAC addresses, from the arena given (see sysarena_malloc()) both now and
+ * as it grows.
  *
  * Returns True if the creation succeeded together with a pointer to the
  * GMD information.
  */
+extern Boolean gmd_resize_gmd(void *gmd, unsigned max_multicasts);
+/*
+ * Grows the instance of GMD to hold up to max_multicasts MAC addresses,
+ * keeping every existing entry at its current index. Returns False, leaving
+ * the database unchanged, if space cannot be allocated or max_multicasts is
+ * smaller than the current size.
+ */
 extern void gmd_destroy_gmd(void *gmd);
 /*
  * Destroys the instance of gmd, releasing previously allocated database and
@@ -21,9 +30,37 @@ extern void gmd_destroy_gmd(void *gmd);
  */
 extern Boolean gmd_find_entry(void *my_gmd, Mac_address key,
                               unsigned *found_at_index);
+/*
+ * Finds the entry for key, returning True and its index if present.
+ */
+#define Gmd_not_found 0xFFFFFFFFu
+extern unsigned gmd_find_entries(void *my_gmd, Mac_address *keys,
+                                 unsigned number_of_keys,
+                                 unsigned *found_at_indexes);
+/*
+ * Finds the entries for a batch of keys, such as all the multicast keys
+ * read from a received PDU, in a single call. Sets found_at_indexes[i] to
+ * the index of the entry for keys[i], or to Gmd_not_found, and returns the
+ * number of keys that were not found. Hashing is vectorized and bucket
+ * accesses are prefetched across the batch, so the cost per key is well
+ * below that of repeated calls to gmd_find_entry().
+ */
 extern Boolean gmd_create_entry(void *my_gmd, Mac_address key,
                                 unsigned *created_at_index);
+/*
+ * Creates an entry for key (or finds the existing entry), returning True
+ * and its index, or False if the database is full. Indexes of deleted
+ * entries are reused before fresh ones, so the indexes in use stay dense.
+ */
 extern Boolean gmd_delete_entry(void *my_gmd,
                                 unsigned delete_at_index);
+/*
+ * Deletes the entry at delete_at_index. Other entries keep their indexes.
+ */
 extern Boolean gmd_get_key(void *my_gmd, unsigned index, Mac_address *key);
+/*
+ * Returns a pointer to the MAC address held for the entry at index. The
+ * address is stored within the database and remains valid while the entry
+ * exists and the database is not resized.
+ */
 #endif /* gmd_h__ */
\ No newline at end of file
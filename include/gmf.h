@@ -7,14 +7,55 @@
 /******************************************************************************
  * GMF : GARP MULTICAST REGISTRATION APPLICATION PDU FORMATTING
  ******************************************************************************
+ *
+ * A GMRP PDU comprises a two octet Protocol ID, one or more messages, and
+ * an End Mark (a zero octet). Each message is an Attribute Type octet
+ * followed by a list of attributes ending with an End Mark. Each attribute
+ * is an Attribute Length octet (counting itself, the event, and the value),
+ * an Attribute Event octet, and the Attribute Value: a six octet multicast
+ * address for the Group Attribute Type, or a single octet legacy control
+ * for the Service Requirement Attribute Type. A LeaveAll has no value.
  */
+enum
+{
+    Gmf_end_mark = 0,
+    Gmf_group_attribute_type = 1,
+    Gmf_service_requirement_attribute_type = 2,
+    Gmf_group_length = 2 + 6,
+    Gmf_service_requirement_length = 2 + 1,
+    Gmf_leaveall_length = 2
+};
+/*
+ * The largest GMRP PDU sent, by default the payload of a standard Ethernet
+ * frame (or of a jumbo frame) less the LLC header, and the smallest that
+ * can hold a message of every kind.
+ */
+enum
+{
+    Gmf_standard_pdu_size = 1500 - 3,
+    Gmf_jumbo_pdu_size = 9000 - 3,
+    Gmf_min_pdu_size = 2 + 1 + Gmf_group_length + 1 + 1
+};
 typedef struct
 { /*
    * This data structure saves the temporary state required to parse GMR
    * PDUs in particular. Gpdu provides a common basis for GARP application
    * formatters; additional state can be added here as required by GMF.
+   *
+   * A received PDU is parsed in place, through gpdu, a message (an
+   * attribute list, if in_list) at a time. The attribute type of the
+   * current list is All_attributes if it is of a type GMRP does not use.
+   *
+   * A PDU for transmission is built in place: next is where the next
+   * attribute (if in_list, and it is of the same type) or message is to be
+   * written, and end is the last octet available, reserved for the PDU's
+   * End Mark. The End Mark of the current list is reserved too.
    */
     Gpdu gpdu;
+    Octet *next;
+    Octet *end;
+    Boolean in_list;
+    Attribute_type attribute;
 } Gmf;
 typedef struct /* Gmf_msg_data */
 {
@@ -24,8 +65,42 @@ typedef struct /* Gmf_msg_data */
     Mac_address key2;
     Legacy_control legacy_control;
 } Gmf_msg;
-extern void gmf_rdmsg_init(Pdu *pdu, Gmf **gmf);
-extern void gmf_wrmsg_init(Gmf *gmf, Pdu *pdu, int vlan_id);
+extern void gmf_rdmsg_init(Gmf *gmf, Pdu *pdu);
+/*
+ * Prepares to read the messages of a received PDU. The structure of the
+ * whole PDU is checked here, once, by prw_rdrec_init(), and if it is not
+ * well formed no message is read from it.
+ */
+extern void gmf_wrmsg_init(Gmf *gmf, Pdu *pdu, int vlan_id,
+                           unsigned pdu_size);
+/*
+ * Prepares to write messages to a PDU allocated for transmission, using up
+ * to pdu_size octets of it.
+ */
 extern Boolean gmf_rdmsg(Gmf *gmf, Gmf_msg *msg);
+/*
+ * Reads the next message, returning False when there are none left. The
+ * multicast address of a Group attribute, key1, points into the PDU, and
+ * remains valid until the PDU is freed; key2 is not used by GMRP, and is
+ * NULL. Attributes of unknown types, with unknown events, or with values
+ * of the wrong length for their type are skipped.
+ */
+extern Boolean gmf_wrmsg_room(Gmf *gmf);
+/*
+ * Returns True if there is certainly room for another message. Messages
+ * for consecutive attributes of the same type share an attribute list, so
+ * a message costs the attribute alone if it continues the current list
+ * (as multicast attributes, sent in GID index order, do), and the
+ * Attribute Type and End Mark of a new list as well if not. GMR sends a
+ * LeaveAll only first in a PDU, in a Group attribute list.
+ */
 extern Boolean gmf_wrmsg(Gmf *gmf, Gmf_msg *msg);
-#endif /* gmf_h__ */
\ No newline at end of file
+/*
+ * Writes a message, returning False if there is no room for it.
+ */
+extern Boolean gmf_wrmsg_done(Gmf *gmf);
+/*
+ * Ends the PDU, setting its length, and returns True if it holds any
+ * messages.
+ */
+#endif /* gmf_h__ */
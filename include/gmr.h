@@ -23,18 +23,39 @@ typedef enum
 {
     Number_of_legacy_controls = 1
 };
+enum
+{
+    Gmr_default_multicasts = 100
+};
 /******************************************************************************
  * GMR : GARP MULTICAST REGISTRATION APPLICATION : CREATION, DESTRUCTION
  ******************************************************************************
  */
+extern void gmr_set_arena(unsigned arena_size, Boolean huge_pages);
+/*
+ * Sets the initial size of the arena (see sysarena_create()) from which each
+ * instance of GMR created from now on allocates its control blocks and
+ * arrays, and whether the arena is to be backed by huge pages. An
+ * arena_size of zero (the default) sizes the arena from the instance's
+ * initial number of multicasts. Huge pages are only used for arenas, or
+ * regions added as they grow, of at least 2 MiB, which the default size
+ * reaches only for instances of many thousands of multicasts.
+ */
 extern Boolean gmr_create_gmr(int process_id, unsigned vlan_id,
-                              void **gmr);
+                              unsigned number_of_multicasts,
+                              unsigned max_multicasts, void **gmr);
 /*
  * Creates a new instance of GMR, allocating and initializing a control
  * block, returning True and a pointer to this instance if creation succeeds.
  * Also creates instances of MCD (the MultiCast registration Database) and
  * of GIP (which controls information propagation).
  *
+ * Space is initially allocated for number_of_multicasts multicast
+ * attributes (Gmr_default_multicasts is a reasonable choice for a VLAN
+ * without many groups). When the database fills, its size is doubled, up
+ * to max_multicasts, while the instance is running, growing MCD, GIP, and
+ * the GID machines for every port together.
+ *
  * Ports are created by the system and added to GMR separately (see
  * gmr_added_port() and gmr_removed_port() below).
  *
@@ -43,7 +64,9 @@ extern Boolean gmr_create_gmr(int process_id, unsigned vlan_id,
  * scope of process_id, guarding against timers yet to expire for destroyed
  * processes, etc. Although process_id will be implicitly supplied by many
  * if not most systems, it is made explicit in this implementation for
- * clarity.
+ * clarity. Here the instance registers itself with SYSTIME as the context
+ * for the expiry of its timers (see systime_register_process()), and is
+ * unregistered when it is destroyed.
  *
  * The vlan_id provides the context for this instance of GMR.
  * vlan_id 0 is taken to refer to the base LAN, i.e., the LAN as seen by
@@ -53,12 +76,13 @@ extern Boolean gmr_create_gmr(int process_id, unsigned vlan_id,
 extern void gmr_destroy_gmr(void *gmr);
 /*
  * Destroys an instance of GMR, destroying and deallocating the associated
- * instances of MCD and GIP, and any instances of GID remaining.
+ * instances of MCD and GIP, and any instances of GID remaining. All their
+ * memory is released at once, with the instance's arena.
  */
 extern void gmr_added_port(void *gmr, int port_no);
 /*
  * The system has created a new port for this application and added it to
- * the ring of GID ports. This function should provide any management
+ * the table of GID ports. This function should provide any management
  * initilization required for the port for legacy control or multicast
  * filtering attributes, such as might be stored in a permanent database
  * either specifically for the port or as part of a template.
@@ -170,4 +194,59 @@ extern void gmr_tx(void *gmr, Gid *my_port);
 /*
  * Transmit a pdu for this instance of GMR.
  */
+extern Boolean gmr_set_pdu_size(void *gmr, unsigned pdu_size);
+/*
+ * Sets the largest pdu that this instance of GMR sends, initially
+ * Gmf_standard_pdu_size (Gmf_jumbo_pdu_size suits jumbo frames). Returns
+ * False, leaving the size unchanged, if it is below Gmf_min_pdu_size.
+ */
+/******************************************************************************
+ * GMR : GARP MULTICAST REGISTRATION APPLICATION : FILTERING DATABASE WRITES
+ ******************************************************************************
+ *
+ * A single received PDU can filter and then forward (or forward and then
+ * filter) the same address on the same port, or forward an address already
+ * forwarded, as indications and their propagation to other ports follow
+ * one another. The changes that GMR makes to the Filtering Database for
+ * individual addresses while it processes a PDU are therefore collected,
+ * and only the net change for each port and address is made, once the
+ * whole PDU has been processed. GMR also remembers the state that it last
+ * set for each port and address, and does not repeat it - GMR assumes that
+ * it alone changes the entries for the multicast addresses it registers.
+ *
+ * GMR never waits for the Filtering Database. Changes that its queue has
+ * no room for (see fdq.h) are left pending, and are made with the next
+ * change or when the retry timer expires, every 10 ms until
+ * none are left. Only the latest change for each port and address is kept
+ * meanwhile. A change of Legacy mode is kept for the port, and made from
+ * the registrations current when it is made, in order with the changes
+ * that create Filtering Database entries (which take the defaults of the
+ * other ports).
+ *
+ * When the database is full and an unused entry is taken for a new address,
+ * the Filtering Database entry for the old address is removed. If the queue
+ * has no room for the removal, the entry is not taken, and the Join that
+ * needed it is discarded as it would be were the database full, to be made
+ * again when the Join is repeated.
+ */
+typedef struct /* Gmr_fdb_counts */
+{
+    unsigned long requested;
+    unsigned long coalesced;
+    unsigned long suppressed;
+} Gmr_fdb_counts;
+extern void gmr_read_fdb_counts(void *gmr, Gmr_fdb_counts *counts);
+/*
+ * Returns the number of changes for individual addresses requested by this
+ * instance of GMR, the number of those replaced by a later change for the
+ * same port and address while processing the same PDU (or while waiting for
+ * room in the Filtering Database queue), and the number not made because
+ * the Filtering Database had already been set that way. The remainder were
+ * made.
+ */
+extern void gmr_fdb_retry_timer_expired(void *gmr, int instance_id);
+/*
+ * Makes the changes left pending for want of room in the Filtering Database
+ * queue, restarting the timer if some are still left.
+ */
 #endif /* gmr_h__ */
\ No newline at end of file
@@ -5,15 +5,100 @@
 /******************************************************************************
  * PRW : PDU READ WRITE ACCESS
  ******************************************************************************
+ *
+ * Every GARP PDU comprises a two octet Protocol ID and a sequence of
+ * records (GARP messages), ended by a record with the terminating record
+ * identifier (the PDU's End Mark) or by the end of the PDU. Each record is
+ * an identifier octet (the Attribute Type) followed by attributes, each an
+ * Attribute Length octet (counting itself, the event octet, and the value)
+ * and the rest of the attribute, and ends with an End Mark (a zero octet).
+ *
+ * PRW provides the parts of reading that are common to every GARP
+ * application formatter: a cursor over the PDU, held in contiguous memory
+ * (see syspdu_octets()), with a check of the structure of the whole PDU
+ * when reading starts, an iterator over its records, and readers for the
+ * contents of the current record. The readers are inline, and check that
+ * what they read lies within the current record, so reading a PDU costs
+ * no function call for each octet or attribute.
  */
-typedef struct
+enum
 {
+    Garp_protocol_id = 0x0001
+};
+#define Garp_terminating_record_id 0x0000
+typedef struct
+{ /*
+   * The read position is next. The contents of the current record (its
+   * attributes, and not its End Mark) end at end, and the records end at
+   * end_of_records. There is no current record (and nothing for the
+   * readers to read) if record_id is Garp_terminating_record_id.
+   */
     Pdu *pdu;
+    Octet *next;
+    Octet *end;
+    Octet *end_of_records;
     int record_id;
     int record_len;
 } Gpdu;
 extern void prw_rdrec_init(Pdu *pdu, Gpdu *gpdu);
-extern Boolean prw_rdrec(Gpdu gpdu);
-extern Boolean prw_skiprec(Gpdu gpdu);
-#define Garp_terminating_record_id 0x0000
-#endif /* prw_h__ */
\ No newline at end of file
+/*
+ * Prepares to read the records of a received PDU, checking its Protocol
+ * ID and the structure of all its records: every Attribute Length must be
+ * at least two, and every attribute and End Mark must lie within the PDU.
+ * If the PDU is not well formed no record is read from it.
+ */
+extern Boolean prw_rdrec(Gpdu *gpdu);
+/*
+ * Moves to the next record, skipping whatever is left of the current one,
+ * and sets record_id and record_len (the length of its contents). Returns
+ * False if there are no more records.
+ */
+static inline void prw_skiprec(Gpdu *gpdu)
+{ /*
+   * Skips whatever is left of the current record.
+   */
+    gpdu->next = gpdu->end;
+}
+static inline Boolean prw_rdcheck(Gpdu *gpdu, unsigned number_of_octets)
+{ /*
+   * Returns True if at least number_of_octets remain in the current record.
+   */
+    return ((Boolean)((unsigned)(gpdu->end - gpdu->next) >= number_of_octets));
+}
+static inline Boolean prw_rdoctet(Gpdu *gpdu, Octet *val)
+{
+    if (gpdu->next >= gpdu->end)
+        return (False);
+    *val = *gpdu->next++;
+    return (True);
+}
+static inline Boolean prw_rdint16(Gpdu *gpdu, Int16 *val)
+{ /*
+   * Reads a big-endian (network order) 16 bit integer.
+   */
+    if (!prw_rdcheck(gpdu, 2))
+        return (False);
+    *val = (Int16)((gpdu->next[0] << 8) | gpdu->next[1]);
+    gpdu->next += 2;
+    return (True);
+}
+static inline Boolean prw_rdskip(Gpdu *gpdu, unsigned number_to_skip)
+{
+    if (!prw_rdcheck(gpdu, number_to_skip))
+        return (False);
+    gpdu->next += number_to_skip;
+    return (True);
+}
+static inline Boolean prw_rdattr(Gpdu *gpdu, Octet **attribute)
+{ /*
+   * Sets attribute to the next attribute of the current record, starting
+   * with its Attribute Length octet, in place in the PDU, and moves past
+   * it. Returns False at the end of the record.
+   */
+    if (gpdu->next >= gpdu->end)
+        return (False);
+    *attribute = gpdu->next;
+    gpdu->next += gpdu->next[0];
+    return (True);
+}
+#endif /* prw_h__ */
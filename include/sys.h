@@ -7,16 +7,19 @@
  ******************************************************************************
  *
  * This header file represents system supplied routines and primitives grouped
- * into five categories:
+ * into six categories:
  *
  * SYS : System conventions.
  *
+ * SYSBITS : Bit sets, with processor supported bit scanning.
+ *
  * SYSMEM : General memory allocation.
  *
- * SYSPDU : Protocol buffer allocation, access, transmit, and receive.
+ * SYSPDU : Protocol buffer allocation, from a pool of fixed size buffers,
+ * access, transmit, and receive.
  *
  * SYSTIME : Scheduling routines : immediate, in fixed (approximate) time, in
- * random time period.
+ * random time period, on a hierarchical timing wheel.
  *
  * SYSERR : System error routines for gross errors in program logic detected
  * in the course of execution, for which there is no sensible course
@@ -40,12 +43,187 @@ enum
 typedef unsigned char Octet;
 typedef unsigned short Int16;
 typedef unsigned char *Mac_address;
+enum
+{
+    Sys_cache_line = 64
+};
+#if defined(__GNUC__)
+#define sys_prefetch(address) __builtin_prefetch(address)
+#define Sys_cache_aligned __attribute__((aligned(Sys_cache_line)))
+#else
+#define sys_prefetch(address) ((void)(address))
+#define Sys_cache_aligned
+#endif
+/*
+ * Ordered access to memory shared with other threads, for data read without
+ * a lock. A relaxed load or store of an aligned word is indivisible; an
+ * acquire load is ordered before the loads that follow it, and a release
+ * store after the stores that precede it. The fences order all the loads
+ * (or stores) on either side of them. Systems without threads can use plain
+ * accesses.
+ *
+ * sys_fetch_add adds to a word indivisibly, returning its previous value.
+ * sys_compare_exchange stores desired if the word still holds *expected,
+ * and otherwise sets *expected to what it does hold, returning True if it
+ * stored; it orders like an acquire load followed by a release store.
+ * Sys_thread_local gives each thread its own copy of a static variable.
+ */
+#if defined(__GNUC__)
+#define sys_load_relaxed(address) __atomic_load_n(address, __ATOMIC_RELAXED)
+#define sys_store_relaxed(address, value) \
+    __atomic_store_n(address, value, __ATOMIC_RELAXED)
+#define sys_load_acquire(address) __atomic_load_n(address, __ATOMIC_ACQUIRE)
+#define sys_store_release(address, value) \
+    __atomic_store_n(address, value, __ATOMIC_RELEASE)
+#define sys_fence_acquire() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define sys_fence_release() __atomic_thread_fence(__ATOMIC_RELEASE)
+#define sys_fetch_add(address, value) \
+    __atomic_fetch_add(address, value, __ATOMIC_RELAXED)
+#define sys_compare_exchange(address, expected, desired)      \
+    __atomic_compare_exchange_n(address, expected, desired, 0, \
+                                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#define Sys_thread_local __thread
+#else
+#define sys_load_relaxed(address) (*(address))
+#define sys_store_relaxed(address, value) ((void)(*(address) = (value)))
+#define sys_load_acquire(address) (*(address))
+#define sys_store_release(address, value) ((void)(*(address) = (value)))
+#define sys_fence_acquire() ((void)0)
+#define sys_fence_release() ((void)0)
+#define sys_fetch_add(address, value) ((*(address) += (value)) - (value))
+#define sys_compare_exchange(address, expected, desired)       \
+    ((*(address) == *(expected)) ? ((*(address) = (desired)), 1) \
+                                 : ((*(expected) = *(address)), 0))
+#define Sys_thread_local
+#endif
+/******************************************************************************
+ * SYSBITS : BIT SETS
+ ******************************************************************************
+ *
+ * A bit set is an array of Bitwords, bit n being bit (n % Bitword_bits) of
+ * word (n / Bitword_bits). Finding the lowest set bit of a word, and
+ * counting the bits set, are single instructions on most processors.
+ */
+typedef unsigned long long Bitword;
+enum
+{
+    Bitword_bits = 64
+};
+#define sysbits_words(number_of_bits) \
+    (((number_of_bits) + Bitword_bits - 1) / Bitword_bits)
+static inline void sysbits_set(Bitword *bits, unsigned bit)
+{
+    bits[bit / Bitword_bits] |= (Bitword)1 << (bit % Bitword_bits);
+}
+static inline void sysbits_clear(Bitword *bits, unsigned bit)
+{
+    bits[bit / Bitword_bits] &= ~((Bitword)1 << (bit % Bitword_bits));
+}
+static inline Boolean sysbits_test(Bitword *bits, unsigned bit)
+{
+    return ((Boolean)((bits[bit / Bitword_bits] >> (bit % Bitword_bits)) & 1));
+}
+static inline unsigned sysbits_lowest(Bitword word)
+{ /*
+   * Returns the number of the lowest bit set in word, which must not be zero.
+   */
+#if defined(__GNUC__)
+    return ((unsigned)__builtin_ctzll(word));
+#else
+    unsigned bit = 0;
+    while (!(word & 1))
+    {
+        word >>= 1;
+        bit++;
+    }
+    return (bit);
+#endif
+}
+static inline unsigned sysbits_count(Bitword word)
+{
+#if defined(__GNUC__)
+    return ((unsigned)__builtin_popcountll(word));
+#else
+    unsigned count = 0;
+    for (; word != 0; word &= word - 1)
+        count++;
+    return (count);
+#endif
+}
+extern void sysbits_zero(Bitword *bits, unsigned number_of_bits);
+extern void sysbits_copy(Bitword *to, Bitword *from, unsigned number_of_bits);
+/*
+ * Copies the words holding the first number_of_bits bits.
+ */
+extern Boolean sysbits_find_set(Bitword *bits, unsigned from, unsigned to,
+                                unsigned *found);
+/*
+ * Finds the lowest bit set in the range from..to inclusive.
+ */
+extern Boolean sysbits_find_clear(Bitword *bits, unsigned from, unsigned to,
+                                  unsigned *found);
+/*
+ * Finds the lowest bit clear in the range from..to inclusive.
+ */
+extern Boolean sysbits_find_either(Bitword *bits, Bitword *other_bits,
+                                   unsigned from, unsigned to,
+                                   unsigned *found);
+/*
+ * Finds the lowest bit in the range from..to inclusive that is set in
+ * either of two bit sets of the same size.
+ */
+extern void sysbits_set_range(Bitword *bits, unsigned from, unsigned to);
+extern void sysbits_invert_range(Bitword *bits, unsigned from, unsigned to);
+/*
+ * Set, or invert, every bit in the range from..to inclusive.
+ */
 /******************************************************************************
  * SYS : SYSTEM SUPPLIED MEMORY ALLOCATION ROUTINES
  ******************************************************************************
  */
 extern Boolean sysmalloc(int size, void **allocated);
 extern void sysfree(void *allocated);
+extern Boolean sysmalloc_aligned(int size, void **allocated);
+extern void sysfree_aligned(void *allocated);
+/*
+ * Allocate and free a block starting on a cache line, for control blocks
+ * with Sys_cache_aligned members, which sysmalloc() does not promise to
+ * align. A block from sysmalloc_aligned() is freed with sysfree_aligned().
+ */
+/*
+ * An arena is memory set aside for one instance of an application, from
+ * which it allocates its control blocks and arrays, so that the state of
+ * one instance is kept together, thousands of instances do not fragment
+ * the general heap between them, and destroying an instance releases all
+ * of its memory at once, whatever the number of blocks allocated.
+ *
+ * The arena is a region of size octets to begin with, taken from the
+ * system in one piece, and blocks are allocated from it in turn, each
+ * starting on a cache line. A block freed is kept to be allocated again,
+ * which suits the blocks of an instance: control blocks and arrays of a few
+ * sizes, and arrays replaced by larger ones as the instance grows. Freed
+ * blocks are not coalesced, so memory freed at one size is only reused by
+ * blocks no larger. Should the region fill, a further region, at least
+ * twice as large, is added.
+ *
+ * If huge_pages is True, each region of at least a huge page (2 MiB) is
+ * backed by huge pages if the system can provide them, and is rounded up
+ * to whole huge pages. Smaller regions are given ordinary pages, so that
+ * many small instances do not each take a huge page: an arena that starts
+ * small moves to huge pages only as it grows.
+ *
+ * sysarena_malloc() and sysarena_free() allocate and free with sysmalloc()
+ * and sysfree() if arena is NULL, so that code shared by applications can
+ * be used with or without an arena.
+ */
+extern Boolean sysarena_create(unsigned size, Boolean huge_pages,
+                               void **arena);
+extern void sysarena_destroy(void *arena);
+/*
+ * Releases the arena and every block allocated from it, freed or not.
+ */
+extern Boolean sysarena_malloc(void *arena, int size, void **allocated);
+extern void sysarena_free(void *arena, void *allocated);
 /******************************************************************************
  * SYSPDU : SYSTEM SUPPLIED PDU ACCESS PRIMITIVES
  ******************************************************************************
@@ -53,11 +231,74 @@ extern void sysfree(void *allocated);
 typedef void Pdu;
 extern Boolean syspdu_alloc(Pdu **pdu);
 extern void syspdu_free(Pdu *pdu);
-extern Boolean rdcheck(Pdu *pdu, int number_of_octets_remaining);
-extern Boolean rdoctet(Pdu *pdu, Octet *val);
-extern Boolean rdint16(Pdu *pdu, Int16 val);
-extern Boolean rdskip(Pdu *pdu, int number_to_skip);
+extern Octet *syspdu_octets(Pdu *pdu, int *number_of_octets);
+/*
+ * Returns a pointer to the GARP PDU, starting with its Protocol ID, which
+ * the system holds in contiguous memory until the PDU is freed, so that
+ * formatters can parse or build it in place. For a received PDU
+ * number_of_octets is set to its length (which may include padding), and
+ * for one allocated for transmission to the space available.
+ */
+extern void syspdu_set_length(Pdu *pdu, int number_of_octets);
+/*
+ * Sets the length of a PDU built for transmission.
+ */
 extern void syspdu_tx(Pdu *pdu, int port_no);
+/*
+ * Transmits the PDU, which the system frees (from whichever thread completes
+ * the transmission) once it has been sent.
+ */
+/*
+ * PDUs are allocated from a pool of fixed size buffers, created once, each
+ * aligned to a cache line and able to hold pdu_size octets. The memory is
+ * taken and touched when the pool is created, so no allocation or page
+ * fault is incurred as PDUs are allocated and freed.
+ *
+ * Free buffers are held on a list shared by all threads, taken from and
+ * returned to without a lock, and each thread keeps a few buffers it has
+ * freed to allocate again itself, so that most allocations and frees touch
+ * neither the shared list nor any other thread's memory. A buffer can be
+ * freed by a thread other than that which allocated it. Since each thread
+ * keeps up to Syspdu_kept free buffers, an allocation can fail while other
+ * threads keep a few, so the pool should have that many to spare for each
+ * thread; buffers kept by a thread that exits are lost until the pool is
+ * destroyed.
+ *
+ * Until the pool is created, and after it is destroyed, no PDU can be
+ * allocated.
+ */
+enum
+{
+    Syspdu_kept = 16
+};
+typedef struct /* Syspdu_pool_counts */
+{ /*
+   * The number of buffers and the octets each holds, the number of
+   * allocations made, the number of buffers in use now and at most, and the
+   * number of allocations that failed because no buffer was free. The
+   * counts are read without synchronization, so are approximate while PDUs
+   * are being allocated and freed.
+   */
+    unsigned number_of_pdus;
+    unsigned pdu_size;
+    unsigned long allocations;
+    unsigned long in_use;
+    unsigned long high_water;
+    unsigned long exhausted;
+} Syspdu_pool_counts;
+extern Boolean syspdu_create_pool(unsigned number_of_pdus, unsigned pdu_size);
+/*
+ * Creates the pool, which must not already exist.
+ */
+extern void syspdu_destroy_pool(void);
+/*
+ * Destroys the pool. Every PDU must have been freed, and every thread
+ * other than the caller must have stopped using the pool.
+ */
+extern void syspdu_read_pool_counts(Syspdu_pool_counts *counts);
+/*
+ * Returns the counts, which are unchanged if there is no pool.
+ */
 /******************************************************************************
  * SYSTIME : SYSTEM SUPPLIED SCHEDULING FUNCTIONS
  ******************************************************************************
@@ -73,6 +314,73 @@ extern void systime_start_timer(int process_id,
 extern void systime_schedule(int process_id,
                              void (*expiry_fn)(void *, int instance_id),
                              int instance_id);
+extern unsigned long systime_now(void);
+/*
+ * Returns the time in microseconds from an arbitrary origin, for measuring
+ * intervals.
+ */
+/*
+ * Timers are held on a hierarchical timing wheel, so starting a timer, and
+ * its expiry, take constant time however many are running. Timeouts are in
+ * milliseconds: a timer started with timeout t expires t milliseconds after
+ * the time last given to systime_expire_timers() (a random timer after a
+ * random time less than t), and one with a timeout of zero, or scheduled,
+ * at the next call. The wheel is driven by the system's timer thread, which
+ * is the thread that runs GARP, calling systime_expire_timers() with the
+ * time (in milliseconds) every millisecond or so; the expired timers are
+ * then dispatched together, as a batch, in the order they expire.
+ *
+ * A timer is dispatched by calling its expiry_fn with the context that the
+ * process given by process_id registered, and its instance_id. A timer
+ * started for a process that is not registered is discarded at once, and
+ * timers of a process that has since been unregistered (even if process_id
+ * has been registered again) are discarded when they expire, so none
+ * outlives the process that started it or reaches a later one.
+ *
+ * Until the wheel is created, and after it is destroyed, timers are not
+ * started.
+ */
+typedef struct /* Systime_counts */
+{ /*
+   * The number of timers armed now and at most, the numbers started,
+   * dispatched, and of batches dispatched, the number discarded because
+   * their process was not registered when they were started or expired,
+   * and the number that could not be started for want of memory.
+   */
+    unsigned long armed;
+    unsigned long high_water;
+    unsigned long started;
+    unsigned long dispatched;
+    unsigned long batches;
+    unsigned long discarded;
+    unsigned long failed;
+} Systime_counts;
+extern Boolean systime_create_timers(unsigned long now);
+/*
+ * Creates the wheel, with its time set to now (milliseconds).
+ */
+extern void systime_destroy_timers(void);
+/*
+ * Destroys the wheel, discarding any timers still armed.
+ */
+extern Boolean systime_register_process(int process_id, void *context);
+extern void systime_unregister_process(int process_id);
+/*
+ * Register (or unregister) a process with the context to be given to the
+ * expiry functions of its timers: for a GARP application, its control
+ * block. Registration returns False if there is no memory for it, and
+ * True, doing nothing, if there is no wheel.
+ */
+extern unsigned systime_expire_timers(unsigned long now);
+/*
+ * Advances the wheel to now (milliseconds), dispatching every timer that
+ * has expired, and any started to expire at once by those dispatched, and
+ * returns the number dispatched.
+ */
+extern void systime_read_counts(Systime_counts *counts);
+/*
+ * Returns the counts, which are unchanged if there is no wheel.
+ */
 /******************************************************************************
  * SYSERR : FATAL ERROR HANDLING
  ******************************************************************************
@@ -1,21 +1,558 @@
 #include "sys.h"
+#include "fdb.h"
 /******************************************************************************
- * FDB : FILTERING DATABASE INTERFACE
+ * FDB : FILTERING DATABASE : IMPLEMENTATION
  ******************************************************************************
  */
+/* The database comprises a table of entries - an array of keys indexed by
+ * entry number, the port sets of the entries (port_words Bitwords each, one
+ * entry after another, bit n set if frames are forwarded through port n), and
+ * an open addressing hash table that maps keys to entry numbers - and for each
+ * VLAN the set of ports that forward by default.
+ *
+ * Keys are held as 64-bit integers: the MAC address in the low six octets,
+ * the VLAN identifier in the twelve bits above it, and the top bit set to
+ * mark the key in use, so that a probe compares a single value and can never
+ * match an unused entry.
+ *
+ * As in GMD, the hash table has a power of two number of buckets, at least
+ * twice the number of entries, each holding an entry number or Fdb_no_entry.
+ * Collisions are resolved by linear probing, and deletion shifts later
+ * members of the same probe sequence back into the vacated bucket. Entry
+ * numbers of removed entries are reused before fresh ones. When every entry
+ * is in use a table twice the size is built and replaces the old one, so
+ * updates and lookups take constant time on average however large the
+ * database grows.
+ *
+ * The database is updated by one thread (the one running GARP) and may be
+ * read concurrently by any number of others (forwarding frames) without a
+ * lock. VLANs are divided among Fdb_stripes stripes by the low bits of their
+ * identifiers, each with a sequence count on a cache line of its own. Each
+ * update - a single filter or forward, a change of default, or all of
+ * fdb_update() - is bracketed by incrementing the sequence of the VLAN's
+ * stripe, which is odd while an update is in progress. A lookup reads that
+ * sequence, then the data it needs, then the sequence again, and starts
+ * over if an update was in progress or has intervened, so it sees each
+ * update completely or not at all. Readers write nothing, so they share the
+ * database's cache lines without contention, and an update disturbs only
+ * the lookups of VLANs in its stripe. Everything a lookup reads is read and
+ * written with indivisible (relaxed) accesses.
+ *
+ * The entries of a VLAN, its port sets, and its defaults are only changed
+ * by updates to that VLAN, but the buckets are shared: removing an entry can
+ * move entries of other VLANs back along the probe sequence, so a removal
+ * is bracketed by the sequences of every stripe with an entry in the run of
+ * occupied buckets that it closes up.
+ *
+ * A lookup may still be probing a table that has been replaced, so replaced
+ * tables are kept, chained from the current one, until the database is
+ * destroyed. Since each table is twice the size of the one it replaces, this
+ * at most doubles the space used for entries.
+ */
+enum
+{
+    Fdb_mac_bits = 48,
+    Fdb_vlan_bits = 12,
+    Fdb_stripes = Bitword_bits /* stripes, as a Bitword of stripes in use */
+};
+#define Fdb_in_use_key 0x8000000000000000ull
+#define Fdb_no_entry 0xFFFFFFFFu
+#define Fdb_hash_multiplier 0x9E3779B97F4A7C15ull
+typedef struct Fdb_table /* Fdb_table */
+{
+    unsigned max_entries;
+    unsigned bucket_mask;
+    unsigned bucket_shift;
+    unsigned long long *keys;
+    Bitword *ports;
+    unsigned *buckets;
+    struct Fdb_table *replaced;
+} Fdb_table;
+typedef struct /* Fdb_stripe */
+{
+    unsigned sequence Sys_cache_aligned;
+} Fdb_stripe;
+typedef struct /* Fdb */
+{
+    Fdb_stripe stripes[Fdb_stripes];
+    Fdb_table *table Sys_cache_aligned;
+    Bitword *forward_by_default;
+    unsigned number_of_ports;
+    unsigned port_words;
+    unsigned number_of_entries;
+    unsigned next_fresh_entry;
+    unsigned number_of_free;
+    unsigned *free_entries;
+} Fdb;
+static Fdb *fdb = NULL;
+/******************************************************************************
+ * FDB : FILTERING DATABASE : KEYS, HASHING
+ ******************************************************************************
+ */
+static unsigned long long fdb_pack_key(unsigned vlan_id, Mac_address address)
+{
+    unsigned long long packed = Fdb_in_use_key;
+    int i;
+    for (i = 0; i < Fdb_mac_bits / 8; i++)
+        packed |= (unsigned long long)address[i] << (8 * i);
+    return (packed | ((unsigned long long)vlan_id << Fdb_mac_bits));
+}
+static unsigned fdb_key_vlan(unsigned long long packed)
+{
+    return ((unsigned)(packed >> Fdb_mac_bits) & ((1u << Fdb_vlan_bits) - 1));
+}
+static unsigned fdb_hash(Fdb_table *table, unsigned long long packed)
+{
+    return ((unsigned)((packed * Fdb_hash_multiplier) >> table->bucket_shift));
+}
+static Boolean fdb_find_bucket(Fdb_table *table, unsigned long long packed,
+                               unsigned *bucket)
+{ /*
+   * Returns True and the bucket holding the key if it is present, otherwise
+   * returns False and the empty bucket that terminated the probe sequence.
+   * A lookup racing an update may find the table inconsistent (and will
+   * discard the result), so the probe is bounded by the size of the table.
+   */
+    unsigned b;
+    unsigned entry;
+    unsigned probes;
+    b = fdb_hash(table, packed);
+    for (probes = 0; probes <= table->bucket_mask; probes++)
+    {
+        if ((entry = sys_load_relaxed(&table->buckets[b])) == Fdb_no_entry)
+            break;
+        if (sys_load_relaxed(&table->keys[entry]) == packed)
+        {
+            *bucket = b;
+            return (True);
+        }
+        b = (b + 1) & table->bucket_mask;
+    }
+    *bucket = b;
+    return (False);
+}
+static Bitword *fdb_entry_ports(Fdb_table *table, unsigned entry)
+{
+    return (&table->ports[entry * fdb->port_words]);
+}
+static Bitword *fdb_vlan_defaults(unsigned vlan_id)
+{
+    return (&fdb->forward_by_default[vlan_id * fdb->port_words]);
+}
+/******************************************************************************
+ * FDB : FILTERING DATABASE : CREATION, DESTRUCTION
+ ******************************************************************************
+ */
+static unsigned fdb_bucket_bits(unsigned max_entries)
+{ /*
+   * Returns log2 of the number of buckets required for max_entries.
+   */
+    unsigned bucket_bits = 1;
+    while ((1u << bucket_bits) < 2 * max_entries)
+        bucket_bits++;
+    return (bucket_bits);
+}
+static Boolean fdb_create_table(unsigned max_entries, Fdb_table **table)
+{ /*
+   * Creates a table for max_entries entries, holding the entries of the
+   * current table (if any), and a free entry stack of the same size. The
+   * current table and free entry stack are not changed.
+   */
+    Fdb_table *my_table;
+    Fdb_table *old_table = fdb->table;
+    unsigned number_of_buckets;
+    unsigned bucket_bits;
+    unsigned i;
+    unsigned b;
+    bucket_bits = fdb_bucket_bits(max_entries);
+    number_of_buckets = 1u << bucket_bits;
+    if (!sysmalloc(sizeof(Fdb_table), &my_table))
+        goto table_creation_failure;
+    if (!sysmalloc(sizeof(unsigned long long) * max_entries, &my_table->keys))
+        goto keys_creation_failure;
+    if (!sysmalloc(sizeof(Bitword) * max_entries * fdb->port_words,
+                   &my_table->ports))
+        goto ports_creation_failure;
+    if (!sysmalloc(sizeof(unsigned) * number_of_buckets, &my_table->buckets))
+        goto buckets_creation_failure;
+    my_table->max_entries = max_entries;
+    my_table->bucket_mask = number_of_buckets - 1;
+    my_table->bucket_shift = 64 - bucket_bits;
+    my_table->replaced = old_table;
+    for (b = 0; b < number_of_buckets; b++)
+        my_table->buckets[b] = Fdb_no_entry;
+    for (i = 0; i < max_entries; i++)
+        my_table->keys[i] = 0;
+    if (old_table != NULL)
+    {
+        sysbits_copy(my_table->ports, old_table->ports,
+                     old_table->max_entries * fdb->port_words * Bitword_bits);
+        for (i = 0; i < fdb->next_fresh_entry; i++)
+        {
+            if ((my_table->keys[i] = old_table->keys[i]) != 0)
+            {
+                (void)fdb_find_bucket(my_table, my_table->keys[i], &b);
+                my_table->buckets[b] = i;
+            }
+        }
+    }
+    *table = my_table;
+    return (True);
+buckets_creation_failure:
+    sysfree(my_table->ports);
+ports_creation_failure:
+    sysfree(my_table->keys);
+keys_creation_failure:
+    sysfree(my_table);
+table_creation_failure:
+    return (False);
+}
+static Boolean fdb_grow(void)
+{ /*
+   * Replaces the table and free entry stack with ones twice the size. The
+   * new table is published with a release store, so a lookup that finds it
+   * also finds it filled in.
+   */
+    Fdb_table *table;
+    unsigned *free_entries;
+    unsigned max_entries = 2 * fdb->table->max_entries;
+    unsigned i;
+    if (!sysmalloc(sizeof(unsigned) * max_entries, &free_entries))
+        return (False);
+    if (!fdb_create_table(max_entries, &table))
+    {
+        sysfree(free_entries);
+        return (False);
+    }
+    for (i = 0; i < fdb->number_of_free; i++)
+        free_entries[i] = fdb->free_entries[i];
+    sysfree(fdb->free_entries);
+    fdb->free_entries = free_entries;
+    sys_store_release(&fdb->table, table);
+    return (True);
+}
+Boolean fdb_create_fdb(unsigned number_of_ports, unsigned number_of_entries)
+{
+    Fdb *my_fdb;
+    unsigned i;
+    if ((fdb != NULL) || (number_of_ports == 0))
+        goto fdb_creation_failure;
+    if (number_of_entries == 0)
+        number_of_entries = 1;
+    if (!sysmalloc_aligned(sizeof(Fdb), &my_fdb))
+        goto fdb_creation_failure;
+    for (i = 0; i < Fdb_stripes; i++)
+        my_fdb->stripes[i].sequence = 0;
+    my_fdb->table = NULL;
+    my_fdb->number_of_ports = number_of_ports;
+    my_fdb->port_words = sysbits_words(number_of_ports);
+    my_fdb->number_of_entries = 0;
+    my_fdb->next_fresh_entry = 0;
+    my_fdb->number_of_free = 0;
+    if (!sysmalloc(sizeof(Bitword) * Fdb_number_of_vlans * my_fdb->port_words,
+                   &my_fdb->forward_by_default))
+        goto defaults_creation_failure;
+    sysbits_zero(my_fdb->forward_by_default,
+                 Fdb_number_of_vlans * my_fdb->port_words * Bitword_bits);
+    if (!sysmalloc(sizeof(unsigned) * number_of_entries,
+                   &my_fdb->free_entries))
+        goto free_creation_failure;
+    fdb = my_fdb;
+    if (!fdb_create_table(number_of_entries, &my_fdb->table))
+        goto table_creation_failure;
+    return (True);
+table_creation_failure:
+    fdb = NULL;
+    sysfree(my_fdb->free_entries);
+free_creation_failure:
+    sysfree(my_fdb->forward_by_default);
+defaults_creation_failure:
+    sysfree_aligned(my_fdb);
+fdb_creation_failure:
+    return (False);
+}
+void fdb_destroy_fdb(void)
+{ /*
+   * There must be no lookups in progress.
+   */
+    Fdb_table *table;
+    if (fdb == NULL)
+        return;
+    while ((table = fdb->table) != NULL)
+    {
+        fdb->table = table->replaced;
+        sysfree(table->buckets);
+        sysfree(table->ports);
+        sysfree(table->keys);
+        sysfree(table);
+    }
+    sysfree(fdb->free_entries);
+    sysfree(fdb->forward_by_default);
+    sysfree_aligned(fdb);
+    fdb = NULL;
+}
+/******************************************************************************
+ * FDB : FILTERING DATABASE : UPDATES
+ ******************************************************************************
+ */
+static Bitword fdb_stripe(unsigned vlan_id)
+{ /*
+   * Returns the VLAN's stripe, as a set of stripes for the two functions
+   * below.
+   */
+    return ((Bitword)1 << (vlan_id % Fdb_stripes));
+}
+static void fdb_begin_update(Bitword stripes)
+{
+    unsigned *sequence;
+    for (; stripes != 0; stripes &= stripes - 1)
+    {
+        sequence = &fdb->stripes[sysbits_lowest(stripes)].sequence;
+        sys_store_relaxed(sequence, *sequence + 1);
+    }
+    sys_fence_release();
+}
+static void fdb_end_update(Bitword stripes)
+{
+    unsigned *sequence;
+    for (; stripes != 0; stripes &= stripes - 1)
+    {
+        sequence = &fdb->stripes[sysbits_lowest(stripes)].sequence;
+        sys_store_release(sequence, *sequence + 1);
+    }
+}
+static void fdb_set_bit(Bitword *bits, unsigned bit, Boolean set)
+{ /*
+   * Only the updating thread writes, so reading and then storing the word is
+   * safe; the store is indivisible for the benefit of lookups.
+   */
+    Bitword *word = &bits[bit / Bitword_bits];
+    Bitword mask = (Bitword)1 << (bit % Bitword_bits);
+    sys_store_relaxed(word, set ? (*word | mask) : (*word & ~mask));
+}
+static Boolean fdb_in_range(unsigned vlan_id, int port_no)
+{
+    return ((fdb != NULL) && (vlan_id < Fdb_number_of_vlans) &&
+            (port_no >= 0) && ((unsigned)port_no < fdb->number_of_ports));
+}
+static Boolean fdb_find_or_create(unsigned vlan_id, Mac_address address,
+                                  unsigned *found_entry)
+{ /*
+   * Finds the entry for the address, or creates one with the port set of
+   * the VLAN's defaults, first doubling the space for entries if it is full.
+   * The entry's key and ports are filled in before the bucket refers to it.
+   * Returns False if space cannot be allocated.
+   */
+    Fdb_table *table = fdb->table;
+    Bitword *ports;
+    Bitword *defaults;
+    unsigned long long packed;
+    unsigned bucket;
+    unsigned entry;
+    unsigned w;
+    packed = fdb_pack_key(vlan_id, address);
+    if (fdb_find_bucket(table, packed, &bucket))
+    {
+        *found_entry = table->buckets[bucket];
+        return (True);
+    }
+    if ((fdb->number_of_free == 0) &&
+        (fdb->next_fresh_entry == table->max_entries))
+    {
+        if (!fdb_grow())
+            return (False);
+        table = fdb->table;
+        (void)fdb_find_bucket(table, packed, &bucket);
+    }
+    if (fdb->number_of_free > 0)
+        entry = fdb->free_entries[--fdb->number_of_free];
+    else
+        entry = fdb->next_fresh_entry++;
+    sys_store_relaxed(&table->keys[entry], packed);
+    ports = fdb_entry_ports(table, entry);
+    defaults = fdb_vlan_defaults(vlan_id);
+    for (w = 0; w < fdb->port_words; w++)
+        sys_store_relaxed(&ports[w], defaults[w]);
+    sys_store_relaxed(&table->buckets[bucket], entry);
+    fdb->number_of_entries++;
+    *found_entry = entry;
+    return (True);
+}
+static void fdb_set_port(unsigned vlan_id, int port_no, Mac_address address,
+                         Fdb_action action)
+{
+    unsigned entry;
+    if (!fdb_find_or_create(vlan_id, address, &entry))
+        return;
+    fdb_set_bit(fdb_entry_ports(fdb->table, entry), (unsigned)port_no,
+                (Boolean)(action == Fdb_forward));
+}
 void fdb_filter(unsigned vlan_id, int port_no, Mac_address address)
 {
-    return;
+    if (!fdb_in_range(vlan_id, port_no))
+        return;
+    fdb_begin_update(fdb_stripe(vlan_id));
+    fdb_set_port(vlan_id, port_no, address, Fdb_filter);
+    fdb_end_update(fdb_stripe(vlan_id));
 }
 void fdb_forward(unsigned vlan_id, int port_no, Mac_address address)
 {
-    return;
+    if (!fdb_in_range(vlan_id, port_no))
+        return;
+    fdb_begin_update(fdb_stripe(vlan_id));
+    fdb_set_port(vlan_id, port_no, address, Fdb_forward);
+    fdb_end_update(fdb_stripe(vlan_id));
 }
 void fdb_filter_by_default(unsigned vlan_id, int port_no)
 {
-    return;
+    if (!fdb_in_range(vlan_id, port_no))
+        return;
+    fdb_begin_update(fdb_stripe(vlan_id));
+    fdb_set_bit(fdb_vlan_defaults(vlan_id), (unsigned)port_no, False);
+    fdb_end_update(fdb_stripe(vlan_id));
 }
 void fdb_forward_by_default(unsigned vlan_id, int port_no)
 {
-    return;
-}
\ No newline at end of file
+    if (!fdb_in_range(vlan_id, port_no))
+        return;
+    fdb_begin_update(fdb_stripe(vlan_id));
+    fdb_set_bit(fdb_vlan_defaults(vlan_id), (unsigned)port_no, True);
+    fdb_end_update(fdb_stripe(vlan_id));
+}
+void fdb_update(unsigned vlan_id, int port_no, Mac_address *addresses,
+                unsigned number_of_addresses, Fdb_action action,
+                Fdb_default default_action)
+{ /*
+   * The entries are changed before the default, so that any entry created
+   * by the update takes its other ports from the defaults as they were
+   * before it. Lookups see the whole update or none of it.
+   */
+    unsigned i;
+    if (!fdb_in_range(vlan_id, port_no))
+        return;
+    fdb_begin_update(fdb_stripe(vlan_id));
+    for (i = 0; i < number_of_addresses; i++)
+        fdb_set_port(vlan_id, port_no, addresses[i], action);
+    if (default_action != Fdb_default_unchanged)
+        fdb_set_bit(fdb_vlan_defaults(vlan_id), (unsigned)port_no,
+                    (Boolean)(default_action == Fdb_default_forward));
+    fdb_end_update(fdb_stripe(vlan_id));
+}
+Boolean fdb_remove(unsigned vlan_id, Mac_address address)
+{ /*
+   * Removes the entry, closing the gap in its probe sequence by moving back
+   * any later entry that would otherwise become unreachable.
+   */
+    Fdb_table *table;
+    Bitword stripes;
+    unsigned vacant;
+    unsigned next;
+    unsigned home;
+    unsigned entry;
+    if (!fdb_in_range(vlan_id, 0))
+        return (False);
+    table = fdb->table;
+    if (!fdb_find_bucket(table, fdb_pack_key(vlan_id, address), &vacant))
+        return (False);
+    stripes = fdb_stripe(vlan_id);
+    for (next = (vacant + 1) & table->bucket_mask;
+         table->buckets[next] != Fdb_no_entry;
+         next = (next + 1) & table->bucket_mask)
+        stripes |= fdb_stripe(fdb_key_vlan(table->keys[table->buckets[next]]));
+    fdb_begin_update(stripes);
+    entry = table->buckets[vacant];
+    next = vacant;
+    for (;;)
+    {
+        next = (next + 1) & table->bucket_mask;
+        if (table->buckets[next] == Fdb_no_entry)
+            break;
+        home = fdb_hash(table, table->keys[table->buckets[next]]);
+        if (((next - home) & table->bucket_mask) >=
+            ((next - vacant) & table->bucket_mask))
+        {
+            sys_store_relaxed(&table->buckets[vacant], table->buckets[next]);
+            vacant = next;
+        }
+    }
+    sys_store_relaxed(&table->buckets[vacant], Fdb_no_entry);
+    sys_store_relaxed(&table->keys[entry], 0);
+    fdb_end_update(stripes);
+    fdb->free_entries[fdb->number_of_free++] = entry;
+    fdb->number_of_entries--;
+    return (True);
+}
+/******************************************************************************
+ * FDB : FILTERING DATABASE : LOOKUP
+ ******************************************************************************
+ */
+static unsigned fdb_begin_lookup(unsigned vlan_id)
+{ /*
+   * Waits for any update in progress in the VLAN's stripe to finish,
+   * returning the sequence number to be checked by fdb_lookup_valid().
+   */
+    unsigned *stripe_sequence = &fdb->stripes[vlan_id % Fdb_stripes].sequence;
+    unsigned sequence;
+    while ((sequence = sys_load_acquire(stripe_sequence)) & 1)
+        ;
+    return (sequence);
+}
+static Boolean fdb_lookup_valid(unsigned vlan_id, unsigned sequence)
+{
+    sys_fence_acquire();
+    return ((Boolean)(sys_load_relaxed(
+                          &fdb->stripes[vlan_id % Fdb_stripes].sequence) ==
+                      sequence));
+}
+static Bitword *fdb_lookup_ports(unsigned vlan_id, Mac_address address)
+{ /*
+   * Returns the port set of the entry for the address, or the VLAN's
+   * defaults, for reading between fdb_begin_lookup() and fdb_lookup_valid().
+   */
+    Fdb_table *table = sys_load_acquire(&fdb->table);
+    unsigned bucket;
+    unsigned entry;
+    if (fdb_find_bucket(table, fdb_pack_key(vlan_id, address), &bucket))
+    {
+        entry = sys_load_relaxed(&table->buckets[bucket]);
+        if (entry < table->max_entries)
+            return (fdb_entry_ports(table, entry));
+    }
+    return (fdb_vlan_defaults(vlan_id));
+}
+Boolean fdb_forwarding(unsigned vlan_id, int port_no, Mac_address address)
+{
+    unsigned sequence;
+    Bitword word;
+    if (!fdb_in_range(vlan_id, port_no))
+        return (False);
+    do
+    {
+        sequence = fdb_begin_lookup(vlan_id);
+        word = sys_load_relaxed(&fdb_lookup_ports(vlan_id, address)
+                                     [(unsigned)port_no / Bitword_bits]);
+    } while (!fdb_lookup_valid(vlan_id, sequence));
+    return ((Boolean)((word >> ((unsigned)port_no % Bitword_bits)) & 1));
+}
+void fdb_forwarding_ports(unsigned vlan_id, Mac_address address,
+                          Bitword *ports)
+{
+    unsigned sequence;
+    Bitword *found;
+    unsigned w;
+    if (!fdb_in_range(vlan_id, 0))
+        return;
+    do
+    {
+        sequence = fdb_begin_lookup(vlan_id);
+        found = fdb_lookup_ports(vlan_id, address);
+        for (w = 0; w < fdb->port_words; w++)
+            ports[w] = sys_load_relaxed(&found[w]);
+    } while (!fdb_lookup_valid(vlan_id, sequence));
+}
+unsigned fdb_number_of_entries(void)
+{
+    if (fdb == NULL)
+        return (0);
+    return (fdb->number_of_entries);
+}
@@ -0,0 +1,288 @@
+/* fdq.c */
+#include "sys.h"
+#include "fdb.h"
+#include "fdq.h"
+/******************************************************************************
+ * FDQ : FILTERING DATABASE QUEUE : IMPLEMENTATION
+ ******************************************************************************
+ */
+/* The queue is a ring of changes, a power of two in size, with a tail
+ * (advanced by GARP as it queues changes) and a head (advanced by the
+ * programming thread as it applies them), each on a cache line of its own.
+ * Each index is written by one thread alone, and is stored with release and
+ * loaded with acquire ordering, so the changes between them are complete
+ * when seen by the other thread.
+ *
+ * Every change is a batch of one or more consecutive entries of the ring,
+ * each for one address (or, for a change of default alone, a single entry
+ * with no address), the first holding the number of entries in the batch.
+ * A whole batch is queued before the tail is advanced, and is applied with
+ * a single call of fdb_update(), so it takes effect at once. A removal is a
+ * batch of one entry, marked as such, applied with fdb_remove(). Each entry
+ * records when it was queued, for the latency measurement.
+ */
+typedef struct /* Fdq_change */
+{
+    unsigned long queued;
+    unsigned vlan_id;
+    int port_no;
+    unsigned number_in_batch;
+    Octet action;
+    Octet default_action;
+    Octet has_address;
+    Octet removal;
+    Octet address[6];
+} Fdq_change;
+typedef struct /* Fdq */
+{
+    unsigned tail Sys_cache_aligned;
+    unsigned head Sys_cache_aligned;
+    unsigned size Sys_cache_aligned;
+    unsigned mask;
+    unsigned program_time;
+    Fdq_change *changes;
+    Mac_address *addresses;
+    Fdq_latency latency;
+} Fdq;
+static Fdq *fdq = NULL;
+/******************************************************************************
+ * FDQ : FILTERING DATABASE QUEUE : CREATION, DESTRUCTION
+ ******************************************************************************
+ */
+Boolean fdq_create_fdq(unsigned number_of_changes, unsigned program_time)
+{
+    Fdq *my_fdq;
+    unsigned size = 1;
+    unsigned i;
+    if (fdq != NULL)
+        goto fdq_creation_failure;
+    while (size < number_of_changes)
+        size *= 2;
+    if (!sysmalloc_aligned(sizeof(Fdq), &my_fdq))
+        goto fdq_creation_failure;
+    if (!sysmalloc(sizeof(Fdq_change) * size, &my_fdq->changes))
+        goto changes_creation_failure;
+    if (!sysmalloc(sizeof(Mac_address) * size, &my_fdq->addresses))
+        goto addresses_creation_failure;
+    my_fdq->tail = 0;
+    my_fdq->head = 0;
+    my_fdq->size = size;
+    my_fdq->mask = size - 1;
+    my_fdq->program_time = program_time;
+    my_fdq->latency.changes = 0;
+    my_fdq->latency.total = 0;
+    my_fdq->latency.max = 0;
+    for (i = 0; i < Fdq_latency_buckets; i++)
+        my_fdq->latency.histogram[i] = 0;
+    fdq = my_fdq;
+    return (True);
+addresses_creation_failure:
+    sysfree(my_fdq->changes);
+changes_creation_failure:
+    sysfree_aligned(my_fdq);
+fdq_creation_failure:
+    return (False);
+}
+void fdq_destroy_fdq(void)
+{
+    if (fdq == NULL)
+        return;
+    while (fdq_program())
+        ;
+    sysfree(fdq->addresses);
+    sysfree(fdq->changes);
+    sysfree_aligned(fdq);
+    fdq = NULL;
+}
+/******************************************************************************
+ * FDQ : FILTERING DATABASE QUEUE : QUEUEING CHANGES
+ ******************************************************************************
+ */
+unsigned fdq_room(void)
+{
+    if (fdq == NULL)
+        return (Fdq_unlimited_room);
+    return (fdq->size - (fdq->tail - sys_load_acquire(&fdq->head)));
+}
+Boolean fdq_update(unsigned vlan_id, int port_no, Mac_address *addresses,
+                   unsigned number_of_addresses, Fdb_action action,
+                   Fdb_default default_action)
+{ /*
+   * Queues the change as one batch if there is room for it; the programming
+   * thread only ever makes more room, so room found here is still there when
+   * the batch is written.
+   */
+    unsigned number_in_batch = number_of_addresses;
+    unsigned long queued;
+    unsigned tail;
+    unsigned i;
+    Fdq_change *change;
+    if (fdq == NULL)
+    {
+        fdb_update(vlan_id, port_no, addresses, number_of_addresses, action,
+                   default_action);
+        return (True);
+    }
+    if (number_in_batch == 0)
+        number_in_batch = 1;
+    if (number_in_batch > fdq_room())
+        return (False);
+    tail = fdq->tail;
+    queued = systime_now();
+    for (i = 0; i < number_in_batch; i++)
+    {
+        change = &fdq->changes[(tail + i) & fdq->mask];
+        change->queued = queued;
+        change->vlan_id = vlan_id;
+        change->port_no = port_no;
+        change->number_in_batch = number_in_batch;
+        change->action = (Octet)action;
+        change->default_action = (Octet)default_action;
+        change->has_address = (Octet)(number_of_addresses != 0);
+        change->removal = False;
+        if (number_of_addresses != 0)
+        {
+            change->address[0] = addresses[i][0];
+            change->address[1] = addresses[i][1];
+            change->address[2] = addresses[i][2];
+            change->address[3] = addresses[i][3];
+            change->address[4] = addresses[i][4];
+            change->address[5] = addresses[i][5];
+        }
+    }
+    sys_store_release(&fdq->tail, tail + number_in_batch);
+    return (True);
+}
+Boolean fdq_remove(unsigned vlan_id, Mac_address address)
+{
+    Fdq_change *change;
+    if (fdq == NULL)
+    {
+        (void)fdb_remove(vlan_id, address);
+        return (True);
+    }
+    if (fdq_room() == 0)
+        return (False);
+    change = &fdq->changes[fdq->tail & fdq->mask];
+    change->queued = systime_now();
+    change->vlan_id = vlan_id;
+    change->port_no = 0;
+    change->number_in_batch = 1;
+    change->action = (Octet)Fdb_filter;
+    change->default_action = (Octet)Fdb_default_unchanged;
+    change->has_address = True;
+    change->removal = True;
+    change->address[0] = address[0];
+    change->address[1] = address[1];
+    change->address[2] = address[2];
+    change->address[3] = address[3];
+    change->address[4] = address[4];
+    change->address[5] = address[5];
+    sys_store_release(&fdq->tail, fdq->tail + 1);
+    return (True);
+}
+Boolean fdq_filter(unsigned vlan_id, int port_no, Mac_address address)
+{
+    return (fdq_update(vlan_id, port_no, &address, 1, Fdb_filter,
+                       Fdb_default_unchanged));
+}
+Boolean fdq_forward(unsigned vlan_id, int port_no, Mac_address address)
+{
+    return (fdq_update(vlan_id, port_no, &address, 1, Fdb_forward,
+                       Fdb_default_unchanged));
+}
+Boolean fdq_filter_by_default(unsigned vlan_id, int port_no)
+{
+    return (fdq_update(vlan_id, port_no, NULL, 0, Fdb_filter,
+                       Fdb_default_filter));
+}
+Boolean fdq_forward_by_default(unsigned vlan_id, int port_no)
+{
+    return (fdq_update(vlan_id, port_no, NULL, 0, Fdb_forward,
+                       Fdb_default_forward));
+}
+Boolean fdq_congested(void)
+{
+    if (fdq == NULL)
+        return (False);
+    return ((Boolean)(4 * (fdq->tail - sys_load_acquire(&fdq->head)) >
+                      3 * fdq->size));
+}
+/******************************************************************************
+ * FDQ : FILTERING DATABASE QUEUE : PROGRAMMING
+ ******************************************************************************
+ */
+static void fdq_note_latency(unsigned long latency, unsigned number_of_changes)
+{
+    unsigned bucket = 0;
+    while ((bucket < Fdq_latency_buckets - 1) && ((latency >> bucket) != 0))
+        bucket++;
+    sys_store_relaxed(&fdq->latency.changes,
+                      fdq->latency.changes + number_of_changes);
+    sys_store_relaxed(&fdq->latency.total,
+                      fdq->latency.total + latency * number_of_changes);
+    if (latency > fdq->latency.max)
+        sys_store_relaxed(&fdq->latency.max, latency);
+    sys_store_relaxed(&fdq->latency.histogram[bucket],
+                      fdq->latency.histogram[bucket] + number_of_changes);
+}
+Boolean fdq_program(void)
+{ /*
+   * Applies each batch queued so far, first waiting out the simulated
+   * programming time for its changes, then frees its entries.
+   */
+    unsigned head;
+    unsigned tail;
+    unsigned number_in_batch;
+    unsigned long started;
+    unsigned long now;
+    unsigned i;
+    Fdq_change *first;
+    if (fdq == NULL)
+        return (False);
+    head = fdq->head;
+    tail = sys_load_acquire(&fdq->tail);
+    if (head == tail)
+        return (False);
+    while (head != tail)
+    {
+        first = &fdq->changes[head & fdq->mask];
+        number_in_batch = first->number_in_batch;
+        for (i = 0; i < number_in_batch; i++)
+            fdq->addresses[i] = fdq->changes[(head + i) & fdq->mask].address;
+        started = systime_now();
+        if (fdq->program_time != 0)
+        {
+            while (systime_now() - started <
+                   (unsigned long)fdq->program_time * number_in_batch)
+                ;
+        }
+        if (first->removal)
+            (void)fdb_remove(first->vlan_id, first->address);
+        else
+            fdb_update(first->vlan_id, first->port_no, fdq->addresses,
+                       first->has_address ? number_in_batch : 0,
+                       (Fdb_action)first->action,
+                       (Fdb_default)first->default_action);
+        now = systime_now();
+        fdq_note_latency(now - first->queued, number_in_batch);
+        head += number_in_batch;
+        sys_store_release(&fdq->head, head);
+    }
+    return (True);
+}
+void fdq_read_latency(Fdq_latency *latency)
+{ /*
+   * Only the programming thread writes the counts, each indivisibly, so they
+   * can be read at any time; read while changes are being applied, they may
+   * not all include the same changes.
+   */
+    unsigned i;
+    if (fdq == NULL)
+        return;
+    latency->changes = sys_load_relaxed(&fdq->latency.changes);
+    latency->total = sys_load_relaxed(&fdq->latency.total);
+    latency->max = sys_load_relaxed(&fdq->latency.max);
+    for (i = 0; i < Fdq_latency_buckets; i++)
+        latency->histogram[i] = sys_load_relaxed(&fdq->latency.histogram[i]);
+}
@@ -4,21 +4,274 @@
 #include "gidtt.h"
 #include "gip.h"
 #include "garp.h"
+/******************************************************************************
+ * GID : GARP INFORMATION DISTRIBUTION PROTOCOL : MACHINE BOOKKEEPING
+ ******************************************************************************
+ */
+static void gid_note_sets(Gid *my_port, unsigned gid_index, Boolean was_active)
+{ /*
+   * Records any change in whether the GID machine for gid_index on my_port
+   * is active, maintaining the application's count of ports on which the
+   * attribute is active and its bitmap of attributes active on any port,
+   * whether the machine has a message pending transmission, and whether
+   * its registrar is counting down the leave timer.
+   */
+    Garp *application = my_port->application;
+    if (gidtt_tx_pending(&my_port->machines[gid_index]))
+        sysbits_set(my_port->tx_pending_machines, gid_index);
+    else
+        sysbits_clear(my_port->tx_pending_machines, gid_index);
+    if (gidtt_leaving(&my_port->machines[gid_index]))
+        sysbits_set(my_port->leaving_machines, gid_index);
+    else
+        sysbits_clear(my_port->leaving_machines, gid_index);
+    if (gidtt_machine_active(&my_port->machines[gid_index]))
+    {
+        if ((!was_active) && (application->gid_active_ports[gid_index]++ == 0))
+            sysbits_set(application->gid_active, gid_index);
+    }
+    else if (was_active)
+    {
+        if (--application->gid_active_ports[gid_index] == 0)
+            sysbits_clear(application->gid_active, gid_index);
+    }
+}
+static void gid_note_machine(Gid *my_port, unsigned gid_index,
+                             Gid_machine *before)
+{ /*
+   * Called after every transition of a machine in the port's array (other
+   * than the untransmit machine), with the machine's state before the
+   * transition. As well as maintaining the sets above, counts the machines
+   * for which a LeaveAll would start the join or the leave timer.
+   */
+    Gid_machine *after = &my_port->machines[gid_index];
+    my_port->leaveall_joins +=
+        gidtt_starts_join_timer(after, Gid_rcv_leaveempty) -
+        gidtt_starts_join_timer(before, Gid_rcv_leaveempty);
+    my_port->leaveall_leaves +=
+        gidtt_starts_leave_timer(after, Gid_rcv_leaveempty) -
+        gidtt_starts_leave_timer(before, Gid_rcv_leaveempty);
+    gid_note_sets(my_port, gid_index, gidtt_machine_active(before));
+}
+static void gid_note_actions(Gid *my_port)
+{ /*
+   * Adds my_port to the application's set of ports with actions if
+   * gid_do_actions() would do anything for it: if there is anything on the
+   * scratchpad, or if, the hold timer permitting, an immediate transmission
+   * is to be scheduled or the join timer started for pending transmissions.
+   * Called wherever GID changes any of those flags, so that a port not in
+   * the set can be skipped by gip_do_actions().
+   */
+    if (my_port->cstart_join_timer || my_port->cstart_leave_timer ||
+        ((!my_port->hold_tx) &&
+         (my_port->cschedule_tx_now ||
+          ((my_port->tx_pending || (my_port->leaveall_countdown == 0)) &&
+           (!my_port->join_timer_running)))))
+        sysbits_set(my_port->application->ports_with_actions,
+                    (unsigned)my_port->port_no);
+}
+static void gid_sync_machine(Gid *my_port, unsigned gid_index)
+{ /*
+   * Applies any LeaveAll processing still pending for the machine (see
+   * gid_leaveall() below). The port's scratchpad was updated when the
+   * LeaveAll was processed, and the leaveall counts then cleared, so only
+   * the sets need to be maintained here.
+   */
+    Boolean was_active;
+    if (!sysbits_test(my_port->leaveall_machines, gid_index))
+        return;
+    was_active = gidtt_machine_active(&my_port->machines[gid_index]);
+    gidtt_leaveall(&my_port->machines[gid_index],
+                   !sysbits_test(my_port->leaveall_odd_machines, gid_index));
+    sysbits_clear(my_port->leaveall_machines, gid_index);
+    sysbits_clear(my_port->leaveall_odd_machines, gid_index);
+    gid_note_sets(my_port, gid_index, was_active);
+}
+static Gid_event gid_event(Gid *my_port, unsigned gid_index, Gid_event event)
+{
+    Gid_machine before;
+    gid_sync_machine(my_port, gid_index);
+    before = my_port->machines[gid_index];
+    event = gidtt_event(my_port, &my_port->machines[gid_index], event);
+    gid_note_machine(my_port, gid_index, &before);
+    gid_note_actions(my_port);
+    return (event);
+}
+static Gid_event gid_tx(Gid *my_port, unsigned gid_index)
+{
+    Gid_machine before;
+    Gid_event msg;
+    gid_sync_machine(my_port, gid_index);
+    before = my_port->machines[gid_index];
+    msg = gidtt_tx(my_port, &my_port->machines[gid_index]);
+    gid_note_machine(my_port, gid_index, &before);
+    gid_note_actions(my_port);
+    return (msg);
+}
+static Gid_event gid_leave_timer_expiry(Gid *my_port, unsigned gid_index)
+{
+    Gid_machine before;
+    Gid_event event;
+    gid_sync_machine(my_port, gid_index);
+    before = my_port->machines[gid_index];
+    event = gidtt_leave_timer_expiry(my_port, &my_port->machines[gid_index]);
+    gid_note_machine(my_port, gid_index, &before);
+    gid_note_actions(my_port);
+    return (event);
+}
+static void gid_event_range(Gid *my_port, unsigned from_index,
+                            Bitword selected, Gid_event event)
+{ /*
+   * Applies the event to the machines from_index + n for which bit n of
+   * selected is set, using the transition table range kernel, and
+   * maintains the sets and counts as gid_note_machine() would for each.
+   * from_index is a multiple of Bitword_bits, so the machine sets can be
+   * read and written a word at a time. The event must be one that gives
+   * no join or leave indication (a request).
+   */
+    Garp *application = my_port->application;
+    Gid_machine *machines = &my_port->machines[from_index];
+    unsigned word = from_index / Bitword_bits;
+    unsigned number_of_machines;
+    unsigned gid_index;
+    Bitword pending;
+    Bitword was_active = 0;
+    Bitword is_active = 0;
+    number_of_machines = application->last_gid_used + 1 - from_index;
+    if (number_of_machines > Bitword_bits)
+        number_of_machines = Bitword_bits;
+    for (pending = my_port->leaveall_machines[word] & selected; pending != 0;
+         pending &= pending - 1)
+        gid_sync_machine(my_port, from_index + sysbits_lowest(pending));
+    my_port->leaveall_joins -=
+        gidtt_count_properties(machines, number_of_machines,
+                               Gidtt_leaveall_join);
+    my_port->leaveall_leaves -=
+        gidtt_count_properties(machines, number_of_machines,
+                               Gidtt_leaveall_leave);
+    gidtt_range_properties(machines, number_of_machines, Gidtt_active,
+                           &was_active);
+    gidtt_event_range(my_port, machines, number_of_machines, event,
+                      &selected, NULL, NULL);
+    gidtt_range_properties(machines, number_of_machines, Gidtt_active,
+                           &is_active);
+    my_port->leaveall_joins +=
+        gidtt_count_properties(machines, number_of_machines,
+                               Gidtt_leaveall_join);
+    my_port->leaveall_leaves +=
+        gidtt_count_properties(machines, number_of_machines,
+                               Gidtt_leaveall_leave);
+    gidtt_range_properties(machines, number_of_machines, Gidtt_tx_pending,
+                           &my_port->tx_pending_machines[word]);
+    gidtt_range_properties(machines, number_of_machines, Gidtt_leaving,
+                           &my_port->leaving_machines[word]);
+    for (is_active ^= was_active; is_active != 0; is_active &= is_active - 1)
+    {
+        gid_index = from_index + sysbits_lowest(is_active);
+        if (gidtt_machine_active(&my_port->machines[gid_index]))
+        {
+            if (application->gid_active_ports[gid_index]++ == 0)
+                sysbits_set(application->gid_active, gid_index);
+        }
+        else if (--application->gid_active_ports[gid_index] == 0)
+            sysbits_clear(application->gid_active, gid_index);
+    }
+    gid_note_actions(my_port);
+}
 /******************************************************************************
  * GID : GARP INFORMATION DISTRIBUTION PROTOCOL : CREATION, DESTRUCTION
  ******************************************************************************
  */
+static unsigned gid_machines_size(unsigned max_gid_index)
+{ /*
+   * A port's GID machines (for GID indexes up to max_gid_index, plus the
+   * untransmit machine) are allocated together with the port's
+   * Gid_machine_sets bit sets over those machines. The machines come first,
+   * padded to a whole number of Bitwords, followed by the sets in the order
+   * tx_pending_machines, leaving_machines, leaveall_machines, and
+   * leaveall_odd_machines.
+   */
+    return ((sizeof(Gid_machine) * (max_gid_index + 2) + sizeof(Bitword) - 1) /
+            sizeof(Bitword) * sizeof(Bitword));
+}
+static Boolean gid_alloc_machines(Garp *application, unsigned max_gid_index,
+                                  Gid_machine **machines)
+{
+    return (sysarena_malloc(application->arena,
+                            gid_machines_size(max_gid_index) +
+                                sizeof(Bitword) *
+                                    sysbits_words(max_gid_index + 1) *
+                                    Gid_machine_sets,
+                            machines));
+}
+static void gid_install_machines(Gid *my_port, Gid_machine *machines,
+                                 unsigned max_gid_index)
+{ /*
+   * Points my_port at a block allocated by gid_alloc_machines().
+   */
+    my_port->machines = machines;
+    my_port->tx_pending_machines =
+        (Bitword *)((char *)machines + gid_machines_size(max_gid_index));
+    my_port->leaving_machines =
+        my_port->tx_pending_machines + sysbits_words(max_gid_index + 1);
+    my_port->leaveall_machines =
+        my_port->leaving_machines + sysbits_words(max_gid_index + 1);
+    my_port->leaveall_odd_machines =
+        my_port->leaveall_machines + sysbits_words(max_gid_index + 1);
+    my_port->untransmit_machine = max_gid_index + 1;
+}
+Boolean gid_create_application(Garp *application)
+{ /*
+   * The port table is allocated when the first port is created. No
+   * attribute is active until then.
+   */
+    unsigned gid_index;
+    gidtt_build_tables();
+    if (!sysarena_malloc(application->arena,
+                         sizeof(unsigned) * (application->max_gid_index + 1),
+                         &application->gid_active_ports))
+        goto gid_ports_creation_failure;
+    if (!sysarena_malloc(application->arena,
+                         sizeof(Bitword) *
+                             sysbits_words(application->max_gid_index + 1),
+                         &application->gid_active))
+        goto gid_active_creation_failure;
+    for (gid_index = 0; gid_index <= application->max_gid_index; gid_index++)
+        application->gid_active_ports[gid_index] = 0;
+    sysbits_zero(application->gid_active, application->max_gid_index + 1);
+    application->gid = NULL;
+    application->gid_table_size = 0;
+    application->connected_ports = NULL;
+    application->number_of_connected_ports = 0;
+    application->ports_with_actions = NULL;
+    return (True);
+gid_active_creation_failure:
+    sysarena_free(application->arena, application->gid_active_ports);
+gid_ports_creation_failure:
+    return (False);
+}
+void gid_destroy_application(Garp *application)
+{
+    if (application->gid_table_size > 0)
+    {
+        sysarena_free(application->arena, application->gid);
+        sysarena_free(application->arena, application->connected_ports);
+        sysarena_free(application->arena, application->ports_with_actions);
+    }
+    sysarena_free(application->arena, application->gid_active);
+    sysarena_free(application->arena, application->gid_active_ports);
+}
 static Boolean gid_create_gid(Garp *application, int port_no, void **gid)
 { /*
    * Creates a new instance of GID.
    */
     Gid *my_port;
-    if (!sysmalloc(sizeof(Gid), &my_port))
+    Gid_machine *machines;
+    unsigned gid_index;
+    if (!sysarena_malloc(application->arena, sizeof(Gid), &my_port))
         goto gid_creation_failure;
     my_port->application = application;
     my_port->port_no = port_no;
-    my_port->next_in_port_ring = my_port;
-    my_port->next_in_connected_ring = my_port;
     my_port->is_enabled = False;
     my_port->is_connected = False;
     my_port->is_point_to_point = True;
@@ -32,9 +285,17 @@ static Boolean gid_create_gid(Garp *application, int port_no, void **gid)
     my_port->join_timeout = Gid_default_join_time;
     my_port->leave_timeout_4 = Gid_default_leave_time / 4;
     my_port->hold_timeout = Gid_default_hold_time;
-    if (!sysmalloc(sizeof(Gid_machine) * (application->max_gid_index + 2),
-                   &my_port->machines))
+    if (!gid_alloc_machines(application, application->max_gid_index,
+                            &machines))
         goto gid_mcreation_failure;
+    gid_install_machines(my_port, machines, application->max_gid_index);
+    for (gid_index = 0; gid_index <= application->max_gid_index + 1; gid_index++)
+        gidtt_init(&my_port->machines[gid_index]);
+    sysbits_zero(my_port->tx_pending_machines,
+                 Gid_machine_sets * Bitword_bits *
+                     sysbits_words(application->max_gid_index + 1));
+    my_port->leaveall_joins = 0;
+    my_port->leaveall_leaves = 0;
     my_port->leaveall_countdown = Gid_leaveall_count;
     my_port->leaveall_timeout_n = Gid_default_leaveall_time /
                                   Gid_leaveall_count;
@@ -45,11 +306,10 @@ static Boolean gid_create_gid(Garp *application, int port_no, void **gid)
     my_port->tx_pending = False;
     my_port->last_transmitted = application->last_gid_used;
     my_port->last_to_transmit = application->last_gid_used;
-    my_port->untransmit_machine = application->last_gid_used + 1;
     *gid = my_port;
     return (True);
 gid_mcreation_failure:
-    sysfree(my_port);
+    sysarena_free(application->arena, my_port);
 gid_creation_failure:
     return (False);
 }
@@ -58,75 +318,128 @@ static void gid_destroy_gid(Gid *gid)
    * Destroys the instance of GID, releasing previously allocated space.
    * Sends leave indications to the application for previously registered
    * attributes.
+   *
+   * The machines are taken a Bitword at a time, the registered and active
+   * machines in each being found with the transition table range functions.
+   * The machines themselves are not reset, as they are about to be freed,
+   * but the application's counts of ports on which they are active are.
    */
+    Garp *application = gid->application;
+    Gid_machine *machines;
+    unsigned number_of_machines;
+    unsigned from_index;
     unsigned gid_index;
-    for (gid_index = 0; gid_index <= gid->application->last_gid_used;
-         gid_index++)
+    Bitword pending;
+    Bitword found;
+    for (from_index = 0; from_index <= application->last_gid_used;
+         from_index += Bitword_bits)
     {
-        if (gid_registered_here(gid, gid_index))
-            gid->application->leave_indication_fn(gid->application,
-                                                  gid, gid_index);
+        machines = &gid->machines[from_index];
+        number_of_machines = application->last_gid_used + 1 - from_index;
+        if (number_of_machines > Bitword_bits)
+            number_of_machines = Bitword_bits;
+        found = 0;
+        gidtt_range_properties(machines, number_of_machines, Gidtt_in,
+                               &found);
+        for (; found != 0; found &= found - 1)
+            application->leave_indication_fn(application, gid,
+                                             from_index + sysbits_lowest(found));
+        for (pending = gid->leaveall_machines[from_index / Bitword_bits];
+             pending != 0; pending &= pending - 1)
+            gid_sync_machine(gid, from_index + sysbits_lowest(pending));
+        gidtt_range_properties(machines, number_of_machines, Gidtt_active,
+                               &found);
+        for (; found != 0; found &= found - 1)
+        {
+            gid_index = from_index + sysbits_lowest(found);
+            if (--application->gid_active_ports[gid_index] == 0)
+                sysbits_clear(application->gid_active, gid_index);
+        }
     }
-    sysfree(gid->machines);
-    sysfree(gid);
+    sysarena_free(application->arena, gid->machines);
+    sysarena_free(application->arena, gid);
 }
-static Gid *gid_add_port(Gid *existing_ports, Gid *new_port)
+static Boolean gid_add_port(Garp *application, Gid *new_port)
 { /*
-   * Adds new_port to the port ring.
+   * Adds new_port to the application's port table, first growing the table
+   * (and the list of connected ports, which can hold every port in the
+   * table, the set of ports with actions, and GIP's sets of registering
+   * ports) if the port number lies beyond its end.
    */
-    Gid *prior;
-    Gid *next;
-    int new_port_no;
-    if (existing_ports != NULL)
+    void **table;
+    int *connected;
+    Bitword *with_actions;
+    int table_size;
+    int port_no;
+    if (new_port->port_no >= application->gid_table_size)
     {
-        new_port_no = new_port->port_no;
-        next = existing_ports;
-        for (;;)
+        table_size = 2 * application->gid_table_size;
+        if (table_size < Gid_initial_table_size)
+            table_size = Gid_initial_table_size;
+        if (table_size <= new_port->port_no)
+            table_size = new_port->port_no + 1;
+        if (!sysarena_malloc(application->arena, sizeof(void *) * table_size,
+                             &table))
+            goto gid_table_failure;
+        if (!sysarena_malloc(application->arena, sizeof(int) * table_size,
+                             &connected))
+            goto gid_connected_failure;
+        if (!sysarena_malloc(application->arena,
+                             sizeof(Bitword) * sysbits_words(table_size),
+                             &with_actions))
+            goto gid_with_actions_failure;
+        sysbits_zero(with_actions, (unsigned)table_size);
+        if ((sysbits_words((unsigned)table_size) >
+             application->gip_port_words) &&
+            (!gip_resize_gip(application, application->max_gid_index + 1,
+                             sysbits_words((unsigned)table_size))))
+            goto gid_gip_failure;
+        for (port_no = 0; port_no < application->gid_table_size; port_no++)
         {
-            prior = next;
-            next = prior->next_in_port_ring;
-            if (prior->port_no <= new_port_no)
-            {
-                if ((next->port_no <= prior->port_no) || (next->port_no > new_port_no))
-                    break;
-            }
-            else /* if (prior_>port_no > new_port_no) */
-            {
-                if ((next->port_no <= prior->port_no) && (next->port_no > new_port_no))
-                    break;
-            }
+            table[port_no] = application->gid[port_no];
+            connected[port_no] = application->connected_ports[port_no];
+        }
+        for (; port_no < table_size; port_no++)
+            table[port_no] = NULL;
+        if (application->gid_table_size > 0)
+        {
+            sysbits_copy(with_actions, application->ports_with_actions,
+                         (unsigned)application->gid_table_size);
+            sysarena_free(application->arena, application->gid);
+            sysarena_free(application->arena, application->connected_ports);
+            sysarena_free(application->arena, application->ports_with_actions);
         }
-        if (prior->port_no == new_port_no)
-            syserr_panic();
-        prior->next_in_port_ring = new_port;
-        new_port->next_in_port_ring = next;
+        application->gid = table;
+        application->connected_ports = connected;
+        application->ports_with_actions = with_actions;
+        application->gid_table_size = table_size;
     }
+    application->gid[new_port->port_no] = new_port;
     new_port->is_enabled = True;
-    return (new_port);
-}
-static Gid *gid_remove_port(Gid *my_port)
-{
-    Gid *prior;
-    Gid *next;
-    prior = my_port;
-    while ((next = prior->next_in_port_ring) != my_port)
-        prior = next;
-    prior->next_in_port_ring = my_port->next_in_port_ring;
-    if (prior == my_port)
-        return (NULL);
-    else
-        return (prior);
+    return (True);
+gid_gip_failure:
+    sysarena_free(application->arena, with_actions);
+gid_with_actions_failure:
+    sysarena_free(application->arena, connected);
+gid_connected_failure:
+    sysarena_free(application->arena, table);
+gid_table_failure:
+    return (False);
 }
 Boolean gid_create_port(Garp *application, int port_no)
 {
     Gid *my_port;
-    if (!gid_find_port(application->gid, port_no, &my_port))
+    if ((port_no >= 0) && (!gid_find_port(application, port_no, &my_port)))
     {
         if (gid_create_gid(application, port_no, &my_port))
         {
-            application->gid = gid_add_port(application->gid, my_port);
-            application->added_port_fn(application, port_no);
-            return (True);
+            if (gid_add_port(application, my_port))
+            {
+                application->added_port_fn(application, port_no);
+                return (True);
+            }
+            sysarena_free(application->arena, my_port->machines);
+            sysarena_free(application->arena, my_port);
         }
     }
     return (False);
@@ -134,32 +447,135 @@ Boolean gid_create_port(Garp *application, int port_no)
 void gid_destroy_port(Garp *application, int port_no)
 {
     Gid *my_port;
-    if (gid_find_port(application->gid, port_no, &my_port))
+    if (gid_find_port(application, port_no, &my_port))
     {
         gip_disconnect_port(application, port_no);
-        application->gid = gid_remove_port(my_port);
+        application->gid[port_no] = NULL;
+        sysbits_clear(application->ports_with_actions, (unsigned)port_no);
         gid_destroy_gid(my_port);
         application->removed_port_fn(application, port_no);
     }
 }
+Boolean gid_resize_ports(Garp *application, unsigned max_gid_index)
+{ /*
+   * Allocates the new machine arrays for all the ports before installing
+   * any of them, so that a failure part way through leaves every port with
+   * its existing array. The untransmit machine is copied to its new place at
+   * the end of each array.
+   */
+    Gid *my_port;
+    Gid_machine **new_machines;
+    Gid_machine *old_machines;
+    unsigned *active_ports;
+    Bitword *active;
+    Bitword *machine_sets;
+    int port_no;
+    unsigned gid_index;
+    unsigned set;
+    if (max_gid_index <= application->max_gid_index)
+        return (True);
+    if (!sysarena_malloc(application->arena,
+                         sizeof(unsigned) * (max_gid_index + 1), &active_ports))
+        goto gid_aresize_failure;
+    if (!sysarena_malloc(application->arena,
+                         sizeof(Bitword) * sysbits_words(max_gid_index + 1),
+                         &active))
+        goto gid_bresize_failure;
+    if (application->gid_table_size > 0)
+    {
+        if (!sysarena_malloc(application->arena,
+                             sizeof(Gid_machine *) *
+                                 application->gid_table_size,
+                             &new_machines))
+            goto gid_resize_failure;
+        for (port_no = 0; port_no < application->gid_table_size; port_no++)
+        {
+            new_machines[port_no] = NULL;
+            if ((application->gid[port_no] != NULL) &&
+                (!gid_alloc_machines(application, max_gid_index,
+                                     &new_machines[port_no])))
+                goto gid_mresize_failure;
+        }
+        for (port_no = 0; port_no < application->gid_table_size; port_no++)
+        {
+            if ((my_port = application->gid[port_no]) == NULL)
+                continue;
+            for (gid_index = 0; gid_index <= application->max_gid_index;
+                 gid_index++)
+                new_machines[port_no][gid_index] = my_port->machines[gid_index];
+            for (; gid_index <= max_gid_index; gid_index++)
+                gidtt_init(&new_machines[port_no][gid_index]);
+            new_machines[port_no][max_gid_index + 1] =
+                my_port->machines[my_port->untransmit_machine];
+            machine_sets = my_port->tx_pending_machines;
+            old_machines = my_port->machines;
+            gid_install_machines(my_port, new_machines[port_no], max_gid_index);
+            for (set = 0; set < Gid_machine_sets; set++)
+            {
+                sysbits_zero(my_port->tx_pending_machines +
+                                 set * sysbits_words(max_gid_index + 1),
+                             max_gid_index + 1);
+                sysbits_copy(my_port->tx_pending_machines +
+                                 set * sysbits_words(max_gid_index + 1),
+                             machine_sets +
+                                 set * sysbits_words(application->max_gid_index + 1),
+                             application->max_gid_index + 1);
+            }
+            sysarena_free(application->arena, old_machines);
+        }
+        sysarena_free(application->arena, new_machines);
+    }
+    sysbits_zero(active, max_gid_index + 1);
+    for (gid_index = 0; gid_index <= application->max_gid_index; gid_index++)
+    {
+        if ((active_ports[gid_index] =
+                 application->gid_active_ports[gid_index]) != 0)
+            sysbits_set(active, gid_index);
+    }
+    for (; gid_index <= max_gid_index; gid_index++)
+        active_ports[gid_index] = 0;
+    sysarena_free(application->arena, application->gid_active_ports);
+    sysarena_free(application->arena, application->gid_active);
+    application->gid_active_ports = active_ports;
+    application->gid_active = active;
+    application->max_gid_index = max_gid_index;
+    return (True);
+gid_mresize_failure:
+    while (port_no > 0)
+    {
+        if (new_machines[--port_no] != NULL)
+            sysarena_free(application->arena, new_machines[port_no]);
+    }
+    sysarena_free(application->arena, new_machines);
+gid_resize_failure:
+    sysarena_free(application->arena, active);
+gid_bresize_failure:
+    sysarena_free(application->arena, active_ports);
+gid_aresize_failure:
+    return (False);
+}
 /******************************************************************************
  * GID : GARP INFORMATION DISTRIBUTION PROTOCOL : USEFUL FUNCTIONS
  ******************************************************************************
  */
-Boolean gid_find_port(Gid *first_port, int port_no, void **gid)
+Boolean gid_find_port(Garp *application, int port_no, void **gid)
 {
-    Gid *next_port = first_port;
-    while (next_port->port_no != port_no)
-    {
-        if ((next_port = next_port->next_in_port_ring) == first_port)
-            return (False);
-    }
-    *gid = next_port;
+    if ((port_no < 0) || (port_no >= application->gid_table_size) ||
+        (application->gid[port_no] == NULL))
+        return (False);
+    *gid = application->gid[port_no];
     return (True);
 }
 Gid *gid_next_port(Gid *this_port)
 {
-    return (this_port->next_in_port_ring);
+    Garp *application = this_port->application;
+    int port_no = this_port->port_no;
+    do
+    {
+        if (++port_no >= application->gid_table_size)
+            port_no = 0;
+    } while (application->gid[port_no] == NULL);
+    return (application->gid[port_no]);
 }
 /******************************************************************************
  * GID : GARP INFORMATION DISTRIBUTION PROTOCOL : MGT
@@ -168,16 +584,15 @@ Gid *gid_next_port(Gid *this_port)
 void gid_read_attribute_state(Gid *my_port, unsigned index, Gid_states *state)
 { /*
    */
+    gid_sync_machine(my_port, index);
     gidtt_states(&my_port->machines[index], state);
 }
 void gid_manage_attribute(Gid *my_port, unsigned index, Gid_event directive)
 { /*
    *
    */
-    Gid_machine *machine;
     Gid_event event;
-    machine = &my_port->machines[index];
-    event = gidtt_event(my_port, machine, directive);
+    event = gid_event(my_port, index, directive);
     if (event == Gid_join)
     {
         my_port->application->join_indication_fn(my_port->application,
@@ -193,25 +608,47 @@ void gid_manage_attribute(Gid *my_port, unsigned index, Gid_event directive)
 }
 Boolean gid_find_unused(Garp *application, unsigned from_index,
                         unsigned *found_index)
-{
+{ /*
+   * An attribute is unused if its machine is inactive on every port, i.e.,
+   * if its bit is clear in the application's bitmap of active attributes.
+   * Machines with LeaveAll processing pending may become active or inactive
+   * when it is applied, so the candidates also include attributes with
+   * processing pending on any port, and before a candidate is checked any
+   * pending processing is applied on every port.
+   */
+    Gid *my_port;
+    int port_no;
     unsigned gid_index;
-    Gid *check_port;
-    gid_index = from_index;
-    check_port = application->gid;
-    for (;;)
+    unsigned candidate;
+    unsigned pending;
+    for (gid_index = from_index; gid_index <= application->last_gid_used;
+         gid_index = candidate + 1)
     {
-        if (gidtt_machine_active(&check_port->machines[gid_index]))
+        if (!sysbits_find_clear(application->gid_active, gid_index,
+                                application->last_gid_used, &candidate))
+            candidate = application->last_gid_used + 1;
+        for (port_no = 0; port_no < application->gid_table_size; port_no++)
+        {
+            if (((my_port = application->gid[port_no]) != NULL) &&
+                (candidate > gid_index) &&
+                (sysbits_find_set(my_port->leaveall_machines, gid_index,
+                                  candidate - 1, &pending)))
+                candidate = pending;
+        }
+        if (candidate > application->last_gid_used)
+            return (False);
+        for (port_no = 0; port_no < application->gid_table_size; port_no++)
         {
-            if (gid_index++ > application->last_gid_used)
-                return (False);
-            check_port = application->gid;
+            if ((my_port = application->gid[port_no]) != NULL)
+                gid_sync_machine(my_port, candidate);
         }
-        else if ((check_port = check_port->next_in_port_ring) == application->gid)
+        if (!sysbits_test(application->gid_active, candidate))
         {
-            *found_index = gid_index;
+            *found_index = candidate;
             return (True);
         }
     }
+    return (False);
 }
 /******************************************************************************
  * GID : GARP INFORMATION DISTRIBUTION PROTOCOL : EVENT PROCESSSING
@@ -220,12 +657,33 @@ Boolean gid_find_unused(Garp *application, unsigned from_index,
 static void gid_leaveall(Gid *my_port)
 { /*
    * only for shared media at present
+   *
+   * A LeaveAll applies Gid_rcv_leaveempty to every machine, but the machines
+   * are not visited here. Instead each is marked as having LeaveAll
+   * processing pending, which is applied by gid_sync_machine() when the
+   * machine is next used. After the first Leaveempty a further Leaveempty
+   * only toggles a Very Anxious Observer with a Leaving Observer, so it is
+   * enough to record whether an odd or even number are pending.
+   *
+   * The effect on the scratchpad does not depend on the order in which
+   * machines are processed, so is taken from the counts of machines that
+   * would start the join or leave timer. No machine would do either after
+   * the Leaveempty, so the counts are then cleared. There are no join or
+   * leave indications.
    */
-    unsigned i;
     Garp *application;
     application = my_port->application;
-    for (i = 0; i <= application->last_gid_used; i++)
-        (void)gidtt_event(my_port, &my_port->machines[i], Gid_rcv_leaveempty);
+    if (my_port->leaveall_joins != 0)
+        my_port->cstart_join_timer = True;
+    if (my_port->leaveall_leaves != 0)
+        my_port->cstart_leave_timer = True;
+    my_port->leaveall_joins = 0;
+    my_port->leaveall_leaves = 0;
+    sysbits_set_range(my_port->leaveall_machines, 0,
+                      application->last_gid_used);
+    sysbits_invert_range(my_port->leaveall_odd_machines, 0,
+                         application->last_gid_used);
+    gid_note_actions(my_port);
 }
 void gid_rcv_leaveall(Gid *my_port)
 {
@@ -234,10 +692,8 @@ void gid_rcv_leaveall(Gid *my_port)
 }
 void gid_rcv_msg(Gid *my_port, unsigned index, Gid_event msg)
 {
-    Gid_machine *machine;
     Gid_event event;
-    machine = &my_port->machines[index];
-    event = gidtt_event(my_port, machine, msg);
+    event = gid_event(my_port, index, msg);
     if (event == Gid_join)
     {
         my_port->application->join_indication_fn(my_port->application,
@@ -253,11 +709,19 @@ void gid_rcv_msg(Gid *my_port, unsigned index, Gid_event msg)
 }
 void gid_join_request(Gid *my_port, unsigned gid_index)
 {
-    (void)(gidtt_event(my_port, &my_port->machines[gid_index], Gid_join));
+    (void)(gid_event(my_port, gid_index, Gid_join));
 }
 void gid_leave_request(Gid *my_port, unsigned gid_index)
 {
-    (void)(gidtt_event(my_port, &my_port->machines[gid_index], Gid_leave));
+    (void)(gid_event(my_port, gid_index, Gid_leave));
+}
+void gid_join_requests(Gid *my_port, unsigned from_index, Bitword selected)
+{
+    gid_event_range(my_port, from_index, selected, Gid_join);
+}
+void gid_leave_requests(Gid *my_port, unsigned from_index, Bitword selected)
+{
+    gid_event_range(my_port, from_index, selected, Gid_leave);
 }
 Boolean gid_registrar_in(Gid_machine *machine)
 {
@@ -280,7 +744,7 @@ void gid_rcv_pdu(Garp *application, int port_no, void *pdu)
    * Finally release the received pdu.
    */
     Gid *my_port;
-    if (gid_find_port(application->gid, port_no, &my_port))
+    if (gid_find_port(application, port_no, &my_port))
     {
         if (my_port->is_enabled)
         {
@@ -309,6 +773,15 @@ Gid_event gid_next_tx(Gid *my_port, unsigned *index)
    * If tx_pending is True and all machines are yet to be checked, transmission
    * will start from the machine with GID index 0, rather than from immediately
    * following last_transmitted.
+   *
+   * The machine following the last in use is that with GID index 0, so
+   * that when last_transmitted and last_to_transmit are both the last every
+   * machine is checked, rather than none.
+   *
+   * Only the machines in the port's tx_pending_machines set, and those with
+   * LeaveAll processing pending (which is applied first), can send a message
+   * or change state when given a transmit opportunity, so the check skips
+   * directly from one member of those sets to the next.
    */
     unsigned check_index;
     unsigned stop_after;
@@ -327,43 +800,57 @@ Gid_event gid_next_tx(Gid *my_port, unsigned *index)
     if (!my_port->tx_pending)
         return (Gid_null);
     check_index = my_port->last_transmitted + 1;
+    if (check_index > my_port->application->last_gid_used)
+        check_index = 0;
     stop_after = my_port->last_to_transmit;
     if (stop_after < check_index)
         stop_after = my_port->application->last_gid_used;
     for (;; check_index++)
     {
-        if (check_index > stop_after)
+        if (!sysbits_find_either(my_port->tx_pending_machines,
+                                 my_port->leaveall_machines, check_index,
+                                 stop_after, &check_index))
         {
             if (stop_after == my_port->last_to_transmit)
             {
                 my_port->tx_pending = False;
                 return (Gid_null);
             }
-            else if (stop_after == my_port->application->last_gid_used)
+            check_index = 0;
+            stop_after = my_port->last_to_transmit;
+            if (!sysbits_find_either(my_port->tx_pending_machines,
+                                     my_port->leaveall_machines, check_index,
+                                     stop_after, &check_index))
             {
-                check_index = 0;
-                stop_after = my_port->last_to_transmit;
+                my_port->tx_pending = False;
+                return (Gid_null);
             }
         }
-        if ((msg = gidtt_tx(my_port, &my_port->machines[check_index])) != Gid_null)
+        gid_sync_machine(my_port, check_index);
+        my_port->machines[my_port->untransmit_machine] =
+            my_port->machines[check_index];
+        if ((msg = gid_tx(my_port, check_index)) != Gid_null)
         {
             *index = my_port->last_transmitted = check_index;
-            my_port->machines[my_port->untransmit_machine].applicant =
-                my_port->machines[check_index].applicant;
-            my_port->tx_pending = (check_index == stop_after);
+            my_port->tx_pending = (check_index != my_port->last_to_transmit);
+            gid_note_actions(my_port);
             return (msg);
         }
     }
 } /* end for(;;) */
 void gid_untx(Gid *my_port)
 {
-    my_port->machines[my_port->last_transmitted].applicant =
-        my_port->machines[my_port->untransmit_machine].applicant;
+    Gid_machine before;
+    before = my_port->machines[my_port->last_transmitted];
+    my_port->machines[my_port->last_transmitted] =
+        my_port->machines[my_port->untransmit_machine];
+    gid_note_machine(my_port, my_port->last_transmitted, &before);
     if (my_port->last_transmitted == 0)
         my_port->last_transmitted = my_port->application->last_gid_used;
     else
         my_port->last_transmitted--;
     my_port->tx_pending = True;
+    gid_note_actions(my_port);
 }
 /******************************************************************************
  * GID : GARP INFORMATION DISTRIBUTION PROTOCOL : TIMER PROCESSING
@@ -384,8 +871,15 @@ void gid_do_actions(Gid *my_port)
    * The procedure restarts the join timer if there are still transmissions
    * pending (if leaveall_countdown is zero. a Leaveall is to be sent; if
    * tx_pending is true, individual machines may have messages to send.)
+   *
+   * The port is removed from the application's set of ports with actions,
+   * and put back if a further call would still have something to do, as
+   * when an immediate transmission was scheduled in place of starting the
+   * join timer.
    */
     int my_port_no = my_port->port_no;
+    sysbits_clear(my_port->application->ports_with_actions,
+                  (unsigned)my_port_no);
     if (my_port->cstart_join_timer)
     {
         my_port->last_to_transmit = my_port->last_transmitted;
@@ -417,31 +911,44 @@ void gid_do_actions(Gid *my_port)
                             gid_leave_timer_expired,
                             my_port->port_no,
                             my_port->leave_timeout_4);
+        my_port->leave_timer_running = True;
     }
     my_port->cstart_leave_timer = False;
+    gid_note_actions(my_port);
 }
 void gid_leave_timer_expired(Garp *application, int port_no)
-{
+{ /*
+   * Only the machines in the port's leaving_machines set, and those with
+   * LeaveAll processing pending (which is applied first), are affected by
+   * leave timer expiry, so only those are visited. Leave timer expiry
+   * changes the set membership of the expiring machine alone, so the scan
+   * can simply continue from the following GID index.
+   */
     Gid *my_port;
     unsigned gid_index;
-    if (gid_find_port(application->gid, port_no, &my_port))
+    if (gid_find_port(application, port_no, &my_port))
     {
-        for (gid_index = 0; gid_index < my_port->application->last_gid_used;
+        my_port->leave_timer_running = False;
+        for (gid_index = 0;
+             sysbits_find_either(my_port->leaving_machines,
+                                 my_port->leaveall_machines, gid_index,
+                                 application->last_gid_used, &gid_index);
              gid_index++)
         {
-            if (gidtt_leave_timer_expiry(my_port, &my_port->machines[gid_index]) == Gid_leave)
+            if (gid_leave_timer_expiry(my_port, gid_index) == Gid_leave)
             {
                 my_port->application->leave_indication_fn(my_port->application,
                                                           my_port, gid_index);
                 gip_propagate_leave(my_port, gid_index);
             }
         }
+        gip_do_actions(my_port);
     }
 }
 void gid_leaveall_timer_expired(Garp *application, int port_no)
 {
     Gid *my_port;
-    if (gid_find_port(application->gid, port_no, &my_port))
+    if (gid_find_port(application, port_no, &my_port))
     {
         if (my_port->leaveall_countdown > 1)
             my_port->leaveall_countdown--;
@@ -458,13 +965,20 @@ void gid_leaveall_timer_expired(Garp *application, int port_no)
             my_port->cstart_join_timer = False;
             my_port->join_timer_running = True;
         }
+        gid_note_actions(my_port);
     }
 }
 void gid_join_timer_expired(Garp *application, int port_no)
-{
+{ /*
+   * The join timer is no longer running, so that if the application leaves
+   * messages untransmitted (as GMR does while the Filtering Database queue is
+   * congested) the actions taken at hold timer expiry start it again.
+   */
     Gid *my_port;
-    if (gid_find_port(application->gid, port_no, &my_port))
+    if (gid_find_port(application, port_no, &my_port))
     {
+        my_port->join_timer_running = False;
+        gid_note_actions(my_port);
         if (my_port->is_enabled)
         {
             application->transmit_fn(application, my_port);
@@ -478,7 +992,7 @@ void gid_join_timer_expired(Garp *application, int port_no)
 void gid_hold_timer_expired(Garp *application, int port_no)
 {
     Gid *my_port;
-    if (gid_find_port(application->gid, port_no, &my_port))
+    if (gid_find_port(application, port_no, &my_port))
     {
         my_port->hold_tx = False;
         gid_do_actions(my_port);
@@ -1,6 +1,11 @@
 /* gidtt.c */
 #include "gidtt.h"
 #include "gid.h"
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GIDTT_SHUFFLE
+#include <tmmintrin.h>
+#define Gidtt_ssse3 __attribute__((target("ssse3")))
+#endif
 /******************************************************************************
  * GIDTT : GID PROTOCOL TRANSITION TABLES : IMPLEMENTATION OVERVIEW
  ******************************************************************************
@@ -8,8 +13,10 @@
 /* This implementation of GID uses transition tables directly. This makes
  * the implementation appear very bulky, but the net code size impact may be
  * less than the page of code required for an algorithmic-based implementation,
- * depending on the processor. A processing-based implementation is planned as
- * both alternatives may be interesting.
+ * depending on the processor. A processing-based implementation of the
+ * single machine functions is also provided, selected at build time by
+ * defining GIDTT_ALGORITHMIC (see below), as both alternatives may be
+ * interesting.
  *
  * The Applicant and the Registrar use separate transition tables. Both use
  * a general transition table to handle most events, and separate smaller
@@ -78,6 +85,26 @@
  * should be transmitted as a JoinIn or as a JoinEmpty is taken from a
  * Registrar state reporting table. The Registrar state is never modified by
  * transmission.
+ *
+ * The tables above are written for readability, with separate Applicant and
+ * Registrar states. They are not used directly when GID runs. Instead
+ * gidtt_build_tables() combines them into fused tables indexed by the
+ * combined machine state (see Gid_machine), from which a single 16-bit load
+ * yields the new combined state, the timer instructions, and the indication
+ * or message to return. There is a fused table for the main transitions
+ * (indexed by event and state), one for transmit opportunities, and one for
+ * leave timer expiry, together with a table of state properties (registered,
+ * active, message pending, leaving) for the functions that report them.
+ *
+ * When one event is applied to a range of machines (see gidtt_event_range())
+ * the main fused table is also split into two byte-wide tables, one of new
+ * states and one of actions (timer starts and indications), each padded to
+ * 256 entries. When the processor has a byte shuffle (SSSE3) these are
+ * looked up for sixteen machines at a time, each of sixteen shuffles
+ * selecting, by the low nibble of each machine's state, among the sixteen
+ * entries that share a high nibble. The shuffle kernel is compiled for
+ * SSSE3 whatever the target of the rest of the build, and used only if
+ * gidtt_build_tables() finds the processor running it supports SSSE3.
  */
 /******************************************************************************
  * GIDTT : GID PROTOCOL TRANSITION TABLE : TABLE ENTRY DEFINITIONS
@@ -177,6 +204,30 @@ typedef struct /* Registrar_leave_timer_entry */
     unsigned leave_indication : 1;
     unsigned cstart_leave_timer : 1;
 } Registrar_leave_timer_entry;
+typedef unsigned short Fused_tt_entry;
+/*
+ * A fused table entry comprises the new combined state (the low octet), the
+ * Fused_join_timer and Fused_leave_timer instructions, and a Fused_results
+ * code for the Gid_event to be returned.
+ */
+enum
+{
+    Fused_join_timer = 0x100,
+    Fused_leave_timer = 0x200,
+    Fused_result_shift = 10
+};
+enum Fused_results
+{
+    Fr_null,
+    Fr_join,
+    Fr_leave,
+    Fr_tx_joinin,
+    Fr_tx_joinempty,
+    Fr_tx_leavein,
+    Fr_tx_leaveempty,
+    Fr_tx_empty,
+    Number_of_fused_results
+};
 /******************************************************************************
  * GIDTT : GID PROTOCOL: MAIN APPLICANT TRANSITION TABLE
  ******************************************************************************
@@ -190,7 +241,7 @@ static Applicant_tt_entry
                        */
                      {/* Gid_null */
                       /*Va */ {Va, Nt}, /*Aa */ {Aa, Nt}, /*Qa */ {Qa, Nt}, /*La */ {La, Nt},
-                      /*Vp */ {Vp, Nt}, /*Ap */ {Ap, Nt}, /*Vp */ {Vp, Nt},
+                      /*Vp */ {Vp, Nt}, /*Ap */ {Ap, Nt}, /*Qp */ {Qp, Nt},
                       /*Vo */ {Vo, Nt}, /*Ao */ {Ao, Nt}, /*Qo */ {Qo, Nt}, /*Lo */ {Lo, Nt},
                       /*Von*/ {Von, Nt}, /*Aon*/ {Aon, Nt}, /*Qon*/ {Qon, Nt}},
                      {/* Gid_rcv_leaveempty */
@@ -245,17 +296,17 @@ static Applicant_tt_entry
                       /*Von*/ {Von, Nt}, /*Aon*/ {Aon, Nt}, /*Qon*/ {Qon, Nt}},
                      {/* Gid_normal_registration, same as Gid_null for the Applicant */
                       /*Va */ {Va, Nt}, /*Aa */ {Aa, Nt}, /*Qa */ {Qa, Nt}, /*La */ {La, Nt},
-                      /*Vp */ {Vp, Nt}, /*Ap */ {Ap, Nt}, /*Vp */ {Vp, Nt},
+                      /*Vp */ {Vp, Nt}, /*Ap */ {Ap, Nt}, /*Qp */ {Qp, Nt},
                       /*Vo */ {Vo, Nt}, /*Ao */ {Ao, Nt}, /*Qo */ {Qo, Nt}, /*Lo */ {Lo, Nt},
                       /*Von*/ {Von, Nt}, /*Aon*/ {Aon, Nt}, /*Qon*/ {Qon, Nt}},
                      {/* Gid_fix_registration, same as Gid_null for the Applicant */
                       /*Va */ {Va, Nt}, /*Aa */ {Aa, Nt}, /*Qa */ {Qa, Nt}, /*La */ {La, Nt},
-                      /*Vp */ {Vp, Nt}, /*Ap */ {Ap, Nt}, /*Vp */ {Vp, Nt},
+                      /*Vp */ {Vp, Nt}, /*Ap */ {Ap, Nt}, /*Qp */ {Qp, Nt},
                       /*Vo */ {Vo, Nt}, /*Ao */ {Ao, Nt}, /*Qo */ {Qo, Nt}, /*Lo */ {Lo, Nt},
                       /*Von*/ {Von, Nt}, /*Aon*/ {Aon, Nt}, /*Qon*/ {Qon, Nt}},
                      {/* Gid_forbid_registration, same as Gid_null for the Applicant */
                       /*Va */ {Va, Nt}, /*Aa */ {Aa, Nt}, /*Qa */ {Qa, Nt}, /*La */ {La, Nt},
-                      /*Vp */ {Vp, Nt}, /*Ap */ {Ap, Nt}, /*Vp */ {Vp, Nt},
+                      /*Vp */ {Vp, Nt}, /*Ap */ {Ap, Nt}, /*Qp */ {Qp, Nt},
                       /*Vo */ {Vo, Nt}, /*Ao */ {Ao, Nt}, /*Qo */ {Qo, Nt}, /*Lo */ {Lo, Nt},
                       /*Von*/ {Von, Nt}, /*Aon*/ {Aon, Nt}, /*Qon*/ {Qon, Nt}}};
 /******************************************************************************
@@ -280,7 +331,20 @@ static Registrar_tt_entry
                          /*Lvf*/ {Lvf, Ni, Nt},
                          /*L3f*/ {L3f, Ni, Nt}, /*L2f*/ {L2f, Ni, Nt}, /*L1f*/ {L1f, Ni, Nt},
                          /*Mtf*/ {Mtf, Ni, Nt}},
-                        {/* Gid_rcv_leave */
+                        {/* Gid_rcv_leaveempty */
+                         /*Inn*/ {Lv, Ni, Lt},
+                         /*Lv */ {Lv, Ni, Nt},
+                         /*L3 */ {L3, Ni, Nt}, /*L2 */ {L2, Ni, Nt}, /*L1 */ {L1, Ni, Nt},
+                         /*Mt */ {Mt, Ni, Nt},
+                         /*Inr*/ {Lvr, Ni, Lt},
+                         /*Lvr*/ {Lvr, Ni, Nt},
+                         /*L3r*/ {L3r, Ni, Nt}, /*L2r*/ {L2r, Ni, Nt}, /*L1r*/ {L1r, Ni, Nt},
+                         /*Mtr*/ {Mtr, Ni, Nt},
+                         /*Inf*/ {Lvf, Ni, Lt},
+                         /*Lvf*/ {Lvf, Ni, Nt},
+                         /*L3f*/ {L3f, Ni, Nt}, /*L2f*/ {L2f, Ni, Nt}, /*L1f*/ {L1f, Ni, Nt},
+                         /*Mtf*/ {Mtf, Ni, Nt}},
+                        {/* Gid_rcv_leavein */
                          /*Inn*/ {Lv, Ni, Lt},
                          /*Lv */ {Lv, Ni, Nt},
                          /*L3 */ {L3, Ni, Nt}, /*L2 */ {L2, Ni, Nt}, /*L1 */ {L1, Ni, Nt},
@@ -332,6 +396,32 @@ static Registrar_tt_entry
                          /*Lvf*/ {Inf, Ni, Nt},
                          /*L3f*/ {Inf, Ni, Nt}, /*L2f*/ {Inf, Ni, Nt}, /*L1f*/ {Inf, Ni, Nt},
                          /*Mtf*/ {Inf, Ni, Nt}},
+                        {/* Gid_join, same as Gid_null for the Registrar */
+                         /*In */ {Inn, Ni, Nt},
+                         /*Lv */ {Lv, Ni, Nt},
+                         /*L3 */ {L3, Ni, Nt}, /*L2 */ {L2, Ni, Nt}, /*L1 */ {L1, Ni, Nt},
+                         /*Mt */ {Mt, Ni, Nt},
+                         /*Inr*/ {Inr, Ni, Nt},
+                         /*Lvr*/ {Lvr, Ni, Nt},
+                         /*L3r*/ {L3r, Ni, Nt}, /*L2r*/ {L2r, Ni, Nt}, /*L1r*/ {L1r, Ni, Nt},
+                         /*Mtr*/ {Mtr, Ni, Nt},
+                         /*Inf*/ {Inf, Ni, Nt},
+                         /*Lvf*/ {Lvf, Ni, Nt},
+                         /*L3f*/ {L3f, Ni, Nt}, /*L2f*/ {L2f, Ni, Nt}, /*L1f*/ {L1f, Ni, Nt},
+                         /*Mtf*/ {Mtf, Ni, Nt}},
+                        {/* Gid_leave, same as Gid_null for the Registrar */
+                         /*In */ {Inn, Ni, Nt},
+                         /*Lv */ {Lv, Ni, Nt},
+                         /*L3 */ {L3, Ni, Nt}, /*L2 */ {L2, Ni, Nt}, /*L1 */ {L1, Ni, Nt},
+                         /*Mt */ {Mt, Ni, Nt},
+                         /*Inr*/ {Inr, Ni, Nt},
+                         /*Lvr*/ {Lvr, Ni, Nt},
+                         /*L3r*/ {L3r, Ni, Nt}, /*L2r*/ {L2r, Ni, Nt}, /*L1r*/ {L1r, Ni, Nt},
+                         /*Mtr*/ {Mtr, Ni, Nt},
+                         /*Inf*/ {Inf, Ni, Nt},
+                         /*Lvf*/ {Lvf, Ni, Nt},
+                         /*L3f*/ {L3f, Ni, Nt}, /*L2f*/ {L2f, Ni, Nt}, /*L1f*/ {L1f, Ni, Nt},
+                         /*Mtf*/ {Mtf, Ni, Nt}},
                         {/* Gid_normal_operation, same as Gid_null for the Registrar */
                          /*In */ {Inn, Ni, Nt},
                          /*Lv */ {Lv, Ni, Nt},
@@ -389,10 +479,10 @@ static Registrar_tt_entry
                          /*Lv */ {Lvf, Li, Nt},
                          /*L3 */ {L3f, Li, Nt}, /*L2 */ {L2f, Li, Nt}, /*L1 */ {L1f, Li, Nt},
                          /*Mt */ {Mtf, Ni, Nt},
-                         /*Inr*/ {Inr, Li, Nt},
-                         /*Lvr*/ {Lvr, Li, Nt},
-                         /*L3r*/ {L3r, Li, Nt}, /*L2r*/ {L2r, Li, Nt}, /*L1r*/ {L1r, Li, Nt},
-                         /*Mtr*/ {Mtr, Li, Nt},
+                         /*Inr*/ {Inf, Li, Nt},
+                         /*Lvr*/ {Lvf, Li, Nt},
+                         /*L3r*/ {L3f, Li, Nt}, /*L2r*/ {L2f, Li, Nt}, /*L1r*/ {L1f, Li, Nt},
+                         /*Mtr*/ {Mtf, Li, Nt},
                          /*Inf*/ {Inf, Ni, Nt},
                          /*Lvf*/ {Lvf, Ni, Nt},
                          /*L3f*/ {L3f, Ni, Nt}, /*L2f*/ {L2f, Ni, Nt}, /*L1f*/ {L1f, Ni, Nt},
@@ -472,105 +562,667 @@ static Boolean registrar_in_table[Number_of_registrar_states] =
         /*Mtr*/ {True},
         /*Inf*/ {False}, /*Lvf*/ {False}, /*L3f*/ {False}, /*L2f*/ {False}, /*L1f*/ {False},
         /*Mtf*/ {False}};
+/******************************************************************************
+ * GIDTT : GID PROTOCOL : FUSED TABLES
+ ******************************************************************************
+ */
+enum
+{
+    Number_of_gid_tt_events = Number_of_gid_rcv_events + Number_of_gid_req_events +
+                              Number_of_gid_amgt_events + Number_of_gid_rmgt_events
+};
+static Fused_tt_entry fused_tt[Number_of_gid_tt_events][Number_of_gid_machine_states];
+static Fused_tt_entry fused_txtt[Number_of_gid_machine_states];
+static Fused_tt_entry fused_leave_timer_table[Number_of_gid_machine_states];
+enum
+{
+    Range_states = 256, /* combined states, padded for the byte tables */
+    Range_chunk = 16    /* entries selected by one byte shuffle */
+};
+enum Range_actions
+{
+    Range_join_timer = 0x01,
+    Range_leave_timer = 0x02,
+    Range_join = 0x04,
+    Range_leave = 0x08
+};
+static Octet range_state_tt[Number_of_gid_tt_events][Range_states] Sys_cache_aligned;
+static Octet range_action_tt[Number_of_gid_tt_events][Range_states] Sys_cache_aligned;
+static Octet state_properties[Range_states] Sys_cache_aligned;
+static Gid_event fused_results[Number_of_fused_results] =
+    {Gid_null, Gid_join, Gid_leave, Gid_tx_joinin, Gid_tx_joinempty,
+     Gid_tx_leavein, Gid_tx_leaveempty, Gid_tx_empty};
+static Boolean fused_tables_built = False;
+static Boolean range_shuffle = False;
+static Octet gidtt_combine(unsigned applicant, unsigned registrar)
+{
+    return ((Octet)(registrar * Number_of_applicant_states + applicant));
+}
+static Fused_tt_entry gidtt_fuse(unsigned applicant, unsigned registrar,
+                                 unsigned cstart_join_timer,
+                                 unsigned cstart_leave_timer,
+                                 enum Fused_results result)
+{
+    return ((Fused_tt_entry)(gidtt_combine(applicant, registrar) |
+                             (cstart_join_timer ? Fused_join_timer : 0) |
+                             (cstart_leave_timer ? Fused_leave_timer : 0) |
+                             (result << Fused_result_shift)));
+}
+void gidtt_build_tables(void)
+{ /*
+   * Builds the fused tables from the Applicant and Registrar tables. The
+   * tables are the same for all instances of GID, and are built once.
+   */
+    Applicant_tt_entry *atransition;
+    Registrar_tt_entry *rtransition;
+    Applicant_txtt_entry *atxtransition;
+    Registrar_leave_timer_entry *rltransition;
+    Fused_tt_entry transition;
+    enum Fused_results result;
+    unsigned event;
+    unsigned applicant;
+    unsigned registrar;
+    unsigned state;
+    if (fused_tables_built)
+        return;
+#if defined(GIDTT_SHUFFLE)
+    __builtin_cpu_init();
+    range_shuffle = (Boolean)(__builtin_cpu_supports("ssse3") != 0);
+#endif
+    for (registrar = 0; registrar < Number_of_registrar_states; registrar++)
+    {
+        for (applicant = 0; applicant < Number_of_applicant_states; applicant++)
+        {
+            state = gidtt_combine(applicant, registrar);
+            for (event = 0; event < Number_of_gid_tt_events; event++)
+            {
+                atransition = &applicant_tt[event][applicant];
+                rtransition = &registrar_tt[event][registrar];
+                if (rtransition->indications == Ji)
+                    result = Fr_join;
+                else if (rtransition->indications == Li)
+                    result = Fr_leave;
+                else
+                    result = Fr_null;
+                fused_tt[event][state] =
+                    gidtt_fuse(atransition->new_app_state,
+                               rtransition->new_reg_state,
+                               atransition->cstart_join_timer,
+                               rtransition->cstart_leave_timer, result);
+            }
+            atxtransition = &applicant_txtt[applicant];
+            switch (atxtransition->msg_to_transmit)
+            {
+            case Jm:
+                result = (registrar_state_table[registrar] != Empty)
+                             ? Fr_tx_joinin
+                             : Fr_tx_joinempty;
+                break;
+            case Lm:
+                result = (registrar_state_table[registrar] != Empty)
+                             ? Fr_tx_leavein
+                             : Fr_tx_leaveempty;
+                break;
+            case Em:
+                result = Fr_tx_empty;
+                break;
+            case Nm:
+            default:
+                result = Fr_null;
+            }
+            fused_txtt[state] = gidtt_fuse(atxtransition->new_app_state,
+                                           registrar,
+                                           atxtransition->cstart_join_timer,
+                                           Nt, result);
+            rltransition = &registrar_leave_timer_table[registrar];
+            fused_leave_timer_table[state] =
+                gidtt_fuse(applicant, rltransition->new_reg_state, Nt,
+                           rltransition->cstart_leave_timer,
+                           (rltransition->leave_indication == Li) ? Fr_leave
+                                                                  : Fr_null);
+            state_properties[state] = 0;
+            if (registrar_in_table[registrar])
+                state_properties[state] |= Gidtt_in;
+            if ((applicant != Vo) || (registrar != Mt))
+                state_properties[state] |= Gidtt_active;
+            if ((atxtransition->new_app_state != applicant) ||
+                (atxtransition->msg_to_transmit != Nm))
+                state_properties[state] |= Gidtt_tx_pending;
+            if (rltransition->new_reg_state != registrar)
+                state_properties[state] |= Gidtt_leaving;
+            if (fused_tt[Gid_rcv_leaveempty][state] & Fused_join_timer)
+                state_properties[state] |= Gidtt_leaveall_join;
+            if (fused_tt[Gid_rcv_leaveempty][state] & Fused_leave_timer)
+                state_properties[state] |= Gidtt_leaveall_leave;
+        }
+    }
+    for (event = 0; event < Number_of_gid_tt_events; event++)
+    {
+        for (state = 0; state < Range_states; state++)
+        {
+            range_state_tt[event][state] = (Octet)state;
+            range_action_tt[event][state] = 0;
+            if (state >= Number_of_gid_machine_states)
+                continue;
+            transition = fused_tt[event][state];
+            range_state_tt[event][state] = (Octet)transition;
+            if (transition & Fused_join_timer)
+                range_action_tt[event][state] |= Range_join_timer;
+            if (transition & Fused_leave_timer)
+                range_action_tt[event][state] |= Range_leave_timer;
+            if (fused_results[transition >> Fused_result_shift] == Gid_join)
+                range_action_tt[event][state] |= Range_join;
+            else if (fused_results[transition >> Fused_result_shift] == Gid_leave)
+                range_action_tt[event][state] |= Range_leave;
+        }
+    }
+    fused_tables_built = True;
+}
 /******************************************************************************
  * GIDTT : GID PROTOCOL : RECEIVE EVENTS, USER REQUESTS, & MGT PROCESSING
  ******************************************************************************
  */
+#if !defined(GIDTT_ALGORITHMIC)
 Gid_event gidtt_event(Gid *my_port, Gid_machine *machine, Gid_event event)
 { /*
    * Handles receive events and join or leave requests.
    */
-    Applicant_tt_entry *atransition;
-    Registrar_tt_entry *rtransition;
-    atransition = &applicant_tt[event][machine->applicant];
-    rtransition = &registrar_tt[event][machine->registrar];
-    machine->applicant = atransition->new_app_state;
-    machine->registrar = rtransition->new_reg_state;
-    if ((event == Gid_join) && (atransition->cstart_join_timer))
-        my_port->cschedule_tx_now = True;
-    my_port->cstart_join_timer = my_port->cstart_join_timer || atransition->cstart_join_timer;
-    my_port->cstart_leave_timer = my_port->cstart_leave_timer || rtransition->cstart_leave_timer;
-    switch (rtransition->indications)
+    Fused_tt_entry transition;
+    transition = fused_tt[event][machine->state];
+    machine->state = (Octet)transition;
+    if (transition & Fused_join_timer)
     {
-    case Ji:
-        return (Gid_join);
-        break;
-    case Li:
-        return (Gid_leave);
-        break;
-    case Ni:
-    default:
-        return (Gid_null);
+        if (event == Gid_join)
+            my_port->cschedule_tx_now = True;
+        my_port->cstart_join_timer = True;
     }
+    if (transition & Fused_leave_timer)
+        my_port->cstart_leave_timer = True;
+    return (fused_results[transition >> Fused_result_shift]);
+}
+#endif
+void gidtt_init(Gid_machine *machine)
+{ /*
+   *
+   */
+    machine->state = gidtt_combine(Vo, Mt);
 }
+#if !defined(GIDTT_ALGORITHMIC)
 Boolean gidtt_in(Gid_machine *machine)
 { /*
    *
    */
-    return (registrar_in_table[machine->registrar]);
+    return ((Boolean)((state_properties[machine->state] & Gidtt_in) != 0));
 }
+#endif
 /******************************************************************************
  * GIDTT : GID PROTOCOL TRANSITION TABLES : TRANSMIT MESSAGES
  ******************************************************************************
  */
+#if !defined(GIDTT_ALGORITHMIC)
 Gid_event gidtt_tx(Gid *my_port,
                    Gid_machine *machine)
+{ /*
+   * Whether a Join or a Leave is sent as a JoinIn or JoinEmpty, LeaveIn or
+   * LeaveEmpty, depends on the Registrar state, which the fused table has
+   * already taken into account.
+   */
+    Fused_tt_entry transition;
+    transition = fused_txtt[machine->state];
+    machine->state = (Octet)transition;
+    if (transition & Fused_join_timer)
+        my_port->cstart_join_timer = True;
+    return (fused_results[transition >> Fused_result_shift]);
+}
+#endif
+/******************************************************************************
+ * GIDTT : GID PROTOCOL TRANSITION TABLES : LEAVEALL PROCESSING
+ ******************************************************************************
+ */
+void gidtt_leaveall(Gid_machine *machine, Boolean even)
+{ /*
+   * The Registrar transition for Leaveempty is idempotent, so the whole
+   * machine can be transitioned a second time when required.
+   */
+    machine->state = (Octet)fused_tt[Gid_rcv_leaveempty][machine->state];
+    if (even)
+        machine->state = (Octet)fused_tt[Gid_rcv_leaveempty][machine->state];
+}
+Boolean gidtt_starts_join_timer(Gid_machine *machine, Gid_event event)
+{
+    return ((Boolean)((fused_tt[event][machine->state] & Fused_join_timer) != 0));
+}
+Boolean gidtt_starts_leave_timer(Gid_machine *machine, Gid_event event)
+{
+    return ((Boolean)((fused_tt[event][machine->state] & Fused_leave_timer) != 0));
+}
+/******************************************************************************
+ * GIDTT : GID PROTOCOL TRANSITION TABLES : LEAVE TIMER PROCESSING
+ ******************************************************************************
+ */
+#if !defined(GIDTT_ALGORITHMIC)
+Gid_event gidtt_leave_timer_expiry(Gid *my_port,
+                                   Gid_machine *machine)
 { /*
    *
    */
-    unsigned msg;
-    unsigned rin;
-    if ((msg = applicant_txtt[machine->applicant].msg_to_transmit) != Nm)
-        rin = registrar_state_table[machine->registrar];
-    my_port->cstart_join_timer = my_port->cstart_join_timer || applicant_txtt[machine->applicant].cstart_join_timer;
-    switch (msg)
+    Fused_tt_entry transition;
+    transition = fused_leave_timer_table[machine->state];
+    machine->state = (Octet)transition;
+    if (transition & Fused_leave_timer)
+        my_port->cstart_leave_timer = True;
+    return (fused_results[transition >> Fused_result_shift]);
+}
+#endif
+/******************************************************************************
+ * GIDTT : GID PROTOCOL : ALGORITHMIC MACHINE
+ ******************************************************************************
+ *
+ * When built with GIDTT_ALGORITHMIC defined, gidtt_event(), gidtt_tx(),
+ * gidtt_leave_timer_expiry(), and gidtt_in() compute each transition from
+ * the states instead of looking it up. The remaining functions, which are
+ * used in bulk rather than for single events, still use the fused tables.
+ *
+ * The Applicant state is taken as a major state (Very anxious, Anxious,
+ * Quiet, or Leaving) and a participation (active member, passive member,
+ * observer, or non-participant), the Registrar state as a major state (In,
+ * one of the four leave timer states, or Empty) and a registration
+ * management control. A Registrar gives a join indication when it starts to
+ * report In, and a leave indication when it stops.
+ */
+#if defined(GIDTT_ALGORITHMIC)
+enum Participation
+{
+    Pa_active,
+    Pa_passive,
+    Pa_observer,
+    Pa_non_participant
+};
+enum
+{
+    Number_of_registrar_majors = Mt + 1
+}; /* Inn..Mt, repeated for each registration management control */
+static enum Participation gidtt_participation(unsigned applicant)
+{
+    if (applicant <= La)
+        return (Pa_active);
+    if (applicant <= Qp)
+        return (Pa_passive);
+    if (applicant <= Lo)
+        return (Pa_observer);
+    return (Pa_non_participant);
+}
+static unsigned gidtt_applicant(enum Participation participation,
+                                Gid_applicant_state major)
+{ /*
+   * Passive members and non-participants have no Leaving state.
+   */
+    static Octet applicants[][Leaving + 1] = {
+        {Va, Aa, Qa, La}, {Vp, Ap, Qp, Vp}, {Vo, Ao, Qo, Lo}, {Von, Aon, Qon, Von}};
+    return (applicants[participation][major]);
+}
+static Boolean gidtt_registrar_in(unsigned registrar)
+{
+    if (registrar / Number_of_registrar_majors == Registration_fixed)
+        return (True);
+    if (registrar / Number_of_registrar_majors == Registration_forbidden)
+        return (False);
+    return ((Boolean)(registrar != Mt));
+}
+static unsigned gidtt_applicant_event(unsigned applicant, Gid_event event,
+                                      Boolean *cstart_join_timer)
+{
+    enum Participation participation = gidtt_participation(applicant);
+    Gid_applicant_state major = applicant_state_table[applicant];
+    *cstart_join_timer = False;
+    switch (event)
+    {
+    case Gid_rcv_leaveempty:
+    case Gid_rcv_leavein:
+    case Gid_rcv_empty:
+    case Gid_normal_operation:
+        if (participation == Pa_non_participant)
+        {
+            if (event != Gid_normal_operation)
+                return (Von);
+            *cstart_join_timer = (Boolean)(major == Quiet);
+            return (Va);
+        }
+        if (major == Leaving)
+        {
+            if ((event == Gid_normal_operation) ||
+                ((participation == Pa_active) && (event != Gid_rcv_leaveempty)))
+                return (applicant);
+            return (Vo);
+        }
+        if (participation == Pa_observer)
+        {
+            if (event == Gid_rcv_empty)
+                return (Vo);
+            *cstart_join_timer = (Boolean)(major == Quiet);
+            return ((event == Gid_normal_operation) ? Va : Lo);
+        }
+        *cstart_join_timer = (Boolean)(major == Quiet);
+        if ((participation == Pa_active) &&
+            ((event == Gid_rcv_empty) ||
+             ((event == Gid_rcv_leavein) && (major != Quiet))))
+            return (Va);
+        return (Vp);
+    case Gid_rcv_joinempty:
+        *cstart_join_timer = (Boolean)(major == Quiet);
+        if (major == Leaving)
+            return (Vo);
+        return (gidtt_applicant(participation, Very_anxious));
+    case Gid_rcv_joinin:
+        if (major == Leaving)
+            return ((participation == Pa_active) ? La : Ao);
+        return (gidtt_applicant(participation,
+                                (major == Very_anxious) ? Anxious : Quiet));
+    case Gid_join:
+        if (major == Leaving)
+            return ((participation == Pa_active) ? Va : Vp);
+        if (participation != Pa_observer)
+            return (applicant);
+        *cstart_join_timer = (Boolean)(major != Quiet);
+        return (gidtt_applicant(Pa_passive, major));
+    case Gid_leave:
+        if (participation == Pa_active)
+        {
+            *cstart_join_timer = (Boolean)(major == Quiet);
+            return (La);
+        }
+        if (participation == Pa_passive)
+            return (gidtt_applicant(Pa_observer, major));
+        return (applicant);
+    case Gid_no_protocol:
+        return (gidtt_applicant(Pa_non_participant, major));
+    default:
+        return (applicant);
+    }
+}
+static unsigned gidtt_registrar_event(unsigned registrar, Gid_event event,
+                                      Boolean *cstart_leave_timer)
+{
+    unsigned major = registrar % Number_of_registrar_majors;
+    unsigned mgt = registrar - major;
+    *cstart_leave_timer = False;
+    switch (event)
     {
-    case Jm:
-        return (rin != Empty ? Gid_tx_joinin : Gid_tx_joinempty);
-        break;
-    case Lm:
-        return (rin != Empty ? Gid_tx_leavein : Gid_tx_leaveempty);
-        break;
-    case Em:
-        return (Gid_tx_empty);
-        break;
-    case Nm:
+    case Gid_rcv_leaveempty:
+    case Gid_rcv_leavein:
+        if (major != Inn)
+            return (registrar);
+        *cstart_leave_timer = True;
+        return (mgt + Lv);
+    case Gid_rcv_joinempty:
+    case Gid_rcv_joinin:
+        return (mgt + Inn);
+    case Gid_normal_registration:
+        return (Normal_registration * Number_of_registrar_majors + major);
+    case Gid_fix_registration:
+        return (Registration_fixed * Number_of_registrar_majors + major);
+    case Gid_forbid_registration:
+        return (Registration_forbidden * Number_of_registrar_majors + major);
     default:
+        return (registrar);
+    }
+}
+static Gid_event gidtt_indication(unsigned registrar, unsigned new_registrar)
+{
+    if (gidtt_registrar_in(registrar) == gidtt_registrar_in(new_registrar))
         return (Gid_null);
+    return (gidtt_registrar_in(new_registrar) ? Gid_join : Gid_leave);
+}
+Gid_event gidtt_event(Gid *my_port, Gid_machine *machine, Gid_event event)
+{
+    unsigned applicant = machine->state % Number_of_applicant_states;
+    unsigned registrar = machine->state / Number_of_applicant_states;
+    unsigned new_registrar;
+    Boolean cstart_join_timer;
+    Boolean cstart_leave_timer;
+    applicant = gidtt_applicant_event(applicant, event, &cstart_join_timer);
+    new_registrar = gidtt_registrar_event(registrar, event, &cstart_leave_timer);
+    machine->state = gidtt_combine(applicant, new_registrar);
+    if (cstart_join_timer)
+    {
+        if (event == Gid_join)
+            my_port->cschedule_tx_now = True;
+        my_port->cstart_join_timer = True;
     }
+    if (cstart_leave_timer)
+        my_port->cstart_leave_timer = True;
+    return (gidtt_indication(registrar, new_registrar));
 }
+Boolean gidtt_in(Gid_machine *machine)
+{
+    return (gidtt_registrar_in(machine->state / Number_of_applicant_states));
+}
+Gid_event gidtt_tx(Gid *my_port, Gid_machine *machine)
+{ /*
+   * Only members send Joins, and only active members Leaves. A Join or a
+   * Leave is sent as a JoinEmpty or LeaveEmpty if the Registrar is Empty.
+   */
+    unsigned applicant = machine->state % Number_of_applicant_states;
+    unsigned registrar = machine->state / Number_of_applicant_states;
+    Boolean empty = (Boolean)(registrar % Number_of_registrar_majors == Mt);
+    switch (applicant)
+    {
+    case Va:
+    case Vp:
+        my_port->cstart_join_timer = True;
+        machine->state = gidtt_combine(Aa, registrar);
+        return (empty ? Gid_tx_joinempty : Gid_tx_joinin);
+    case Aa:
+    case Ap:
+        machine->state = gidtt_combine(Qa, registrar);
+        return (empty ? Gid_tx_joinempty : Gid_tx_joinin);
+    case La:
+        machine->state = gidtt_combine(Vo, registrar);
+        return (empty ? Gid_tx_leaveempty : Gid_tx_leavein);
+    case Lo:
+        machine->state = gidtt_combine(Vo, registrar);
+        return (Gid_null);
+    default:
+        return (Gid_null);
+    }
+}
+Gid_event gidtt_leave_timer_expiry(Gid *my_port, Gid_machine *machine)
+{ /*
+   * The Registrar counts down Lv, L3, L2, L1, restarting the leave timer
+   * each time, and then becomes Empty.
+   */
+    unsigned registrar = machine->state / Number_of_applicant_states;
+    unsigned major = registrar % Number_of_registrar_majors;
+    if ((major == Inn) || (major == Mt))
+        return (Gid_null);
+    if (major != L1)
+        my_port->cstart_leave_timer = True;
+    machine->state += Number_of_applicant_states;
+    return (gidtt_indication(registrar, registrar + 1));
+}
+#endif
 /******************************************************************************
- * GIDTT : GID PROTOCOL TRANSITION TABLES : LEAVE TIMER PROCESSING
+ * GIDTT : GID PROTOCOL TRANSITION TABLES : RANGES OF MACHINES
  ******************************************************************************
  */
-Gid_event gidtt_leave_timer_expiry(Gid *my_port,
-                                   Gid_machine *machine)
+#if defined(GIDTT_SHUFFLE)
+static Gidtt_ssse3 __m128i gidtt_byte_mask(unsigned selected)
 { /*
-   *
+   * Expands the sixteen bits of selected to sixteen bytes, all ones where
+   * the bit is set and zero where it is clear.
+   */
+    __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+                                 1, 2, 4, 8, 16, 32, 64, -128);
+    __m128i spread = _mm_shuffle_epi8(_mm_cvtsi32_si128((int)selected),
+                                      _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0,
+                                                    1, 1, 1, 1, 1, 1, 1, 1));
+    return (_mm_cmpeq_epi8(_mm_and_si128(spread, bits), bits));
+}
+static Gidtt_ssse3 unsigned gidtt_shuffle_range(Octet *states,
+                                                unsigned number_of_machines,
+                                                Gid_event event,
+                                                Bitword *selected,
+                                                Bitword *joins,
+                                                Bitword *leaves,
+                                                unsigned *actions)
+{ /*
+   * Applies the event to whole chunks of Range_chunk machines, returning
+   * the number of machines covered and ORing the actions of the selected
+   * machines into actions. A chunk never straddles a Bitword.
+   */
+    __m128i low_nibble = _mm_set1_epi8(0x0f);
+    __m128i join = _mm_set1_epi8(Range_join);
+    __m128i leave = _mm_set1_epi8(Range_leave);
+    __m128i all_actions = _mm_setzero_si128();
+    __m128i old_states, index, high, hit, mask, new_states, new_actions;
+    Octet chunk_actions[Range_chunk];
+    unsigned chunk_selected;
+    unsigned machine;
+    unsigned nibble;
+    for (machine = 0; machine + Range_chunk <= number_of_machines;
+         machine += Range_chunk)
+    {
+        chunk_selected = 0xffff;
+        if (selected != NULL)
+            chunk_selected = (unsigned)(selected[machine / Bitword_bits] >>
+                                        (machine % Bitword_bits)) &
+                             0xffff;
+        if (chunk_selected == 0)
+            continue;
+        old_states = _mm_loadu_si128((__m128i *)&states[machine]);
+        index = _mm_and_si128(old_states, low_nibble);
+        high = _mm_and_si128(_mm_srli_epi16(old_states, 4), low_nibble);
+        new_states = _mm_setzero_si128();
+        new_actions = _mm_setzero_si128();
+        for (nibble = 0; nibble < Range_states / Range_chunk; nibble++)
+        {
+            hit = _mm_cmpeq_epi8(high, _mm_set1_epi8((char)nibble));
+            new_states = _mm_or_si128(new_states, _mm_and_si128(hit,
+                _mm_shuffle_epi8(_mm_load_si128((__m128i *)
+                    &range_state_tt[event][nibble * Range_chunk]), index)));
+            new_actions = _mm_or_si128(new_actions, _mm_and_si128(hit,
+                _mm_shuffle_epi8(_mm_load_si128((__m128i *)
+                    &range_action_tt[event][nibble * Range_chunk]), index)));
+        }
+        mask = gidtt_byte_mask(chunk_selected);
+        new_states = _mm_or_si128(_mm_and_si128(mask, new_states),
+                                  _mm_andnot_si128(mask, old_states));
+        new_actions = _mm_and_si128(mask, new_actions);
+        _mm_storeu_si128((__m128i *)&states[machine], new_states);
+        all_actions = _mm_or_si128(all_actions, new_actions);
+        if (joins != NULL)
+        {
+            joins[machine / Bitword_bits] |=
+                (Bitword)_mm_movemask_epi8(_mm_cmpeq_epi8(
+                    _mm_and_si128(new_actions, join), join))
+                << (machine % Bitword_bits);
+            leaves[machine / Bitword_bits] |=
+                (Bitword)_mm_movemask_epi8(_mm_cmpeq_epi8(
+                    _mm_and_si128(new_actions, leave), leave))
+                << (machine % Bitword_bits);
+        }
+    }
+    _mm_storeu_si128((__m128i *)chunk_actions, all_actions);
+    for (nibble = 0; nibble < Range_chunk; nibble++)
+        *actions |= chunk_actions[nibble];
+    return (machine);
+}
+#endif
+void gidtt_event_range(Gid *my_port, Gid_machine *machines,
+                       unsigned number_of_machines, Gid_event event,
+                       Bitword *selected, Bitword *joins, Bitword *leaves)
+{ /*
+   * Each Gid_machine is a single octet, so the array is processed as an
+   * array of states. Machines left over after the last whole chunk, or
+   * all of them without a byte shuffle, are transitioned one at a time
+   * with the same tables.
    */
-    Registrar_leave_timer_entry *rtransition;
-    rtransition = &registrar_leave_timer_table[machine->registrar];
-    machine->registrar = rtransition->new_reg_state;
-    my_port->cstart_leave_timer = my_port->cstart_leave_timer || rtransition->cstart_leave_timer;
-    return ((rtransition->leave_indication == Li) ? Gid_leave : Gid_null);
+    Octet *states = &machines->state;
+    unsigned actions = 0;
+    unsigned action;
+    unsigned machine = 0;
+    if (joins != NULL)
+    {
+        sysbits_zero(joins, number_of_machines);
+        sysbits_zero(leaves, number_of_machines);
+    }
+#if defined(GIDTT_SHUFFLE)
+    if (range_shuffle)
+        machine = gidtt_shuffle_range(states, number_of_machines, event,
+                                      selected, joins, leaves, &actions);
+#endif
+    for (; machine < number_of_machines; machine++)
+    {
+        if ((selected != NULL) && (!sysbits_test(selected, machine)))
+            continue;
+        action = range_action_tt[event][states[machine]];
+        states[machine] = range_state_tt[event][states[machine]];
+        actions |= action;
+        if (joins == NULL)
+            continue;
+        if (action & Range_join)
+            sysbits_set(joins, machine);
+        else if (action & Range_leave)
+            sysbits_set(leaves, machine);
+    }
+    if (actions & Range_join_timer)
+    {
+        if (event == Gid_join)
+            my_port->cschedule_tx_now = True;
+        my_port->cstart_join_timer = True;
+    }
+    if (actions & Range_leave_timer)
+        my_port->cstart_leave_timer = True;
+}
+void gidtt_range_properties(Gid_machine *machines, unsigned number_of_machines,
+                            unsigned properties, Bitword *bits)
+{
+    unsigned machine;
+    for (machine = 0; machine < number_of_machines; machine++)
+    {
+        if (state_properties[machines[machine].state] & properties)
+            sysbits_set(bits, machine);
+        else
+            sysbits_clear(bits, machine);
+    }
+}
+unsigned gidtt_count_properties(Gid_machine *machines,
+                                unsigned number_of_machines,
+                                unsigned properties)
+{
+    unsigned count = 0;
+    unsigned machine;
+    for (machine = 0; machine < number_of_machines; machine++)
+    {
+        if (state_properties[machines[machine].state] & properties)
+            count++;
+    }
+    return (count);
 }
 /******************************************************************************
  * GIDTT : GID PROTOCOL TRANSITION TABLES : STATE REPORTING
  ******************************************************************************
  */
+Boolean gidtt_tx_pending(Gid_machine *machine)
+{
+    return ((Boolean)((state_properties[machine->state] & Gidtt_tx_pending) != 0));
+}
+Boolean gidtt_leaving(Gid_machine *machine)
+{
+    return ((Boolean)((state_properties[machine->state] & Gidtt_leaving) != 0));
+}
 Boolean gidtt_machine_active(Gid_machine *machine)
 {
-    if ((machine->applicant == Vo) && (machine->registrar == Mt))
-        return (False);
-    else
-        return (True);
+    return ((Boolean)((state_properties[machine->state] & Gidtt_active) != 0));
 }
 void gidtt_states(Gid_machine *machine, Gid_states *state)
 { /*
    *
    */
-    state->applicant_state = applicant_state_table[machine->applicant];
-    state->applicant_mgt = applicant_mgt_table[machine->applicant];
-    state->registrar_state = registrar_state_table[machine->registrar];
-    state->registrar_mgt = registrar_mgt_table[machine->registrar];
-}
\ No newline at end of file
+    unsigned applicant = machine->state % Number_of_applicant_states;
+    unsigned registrar = machine->state / Number_of_applicant_states;
+    state->applicant_state = applicant_state_table[applicant];
+    state->applicant_mgt = applicant_mgt_table[applicant];
+    state->registrar_state = registrar_state_table[registrar];
+    state->registrar_mgt = registrar_mgt_table[registrar];
+}
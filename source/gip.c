@@ -1,92 +1,179 @@
 /* gip.c */
 #include "gid.h"
 #include "gip.h"
+static Bitword *gip_registrants(Garp *application, unsigned gid_index)
+{
+    return (&application->gip[gid_index * application->gip_port_words]);
+}
 /******************************************************************************
  * GIP : GARP INFORMATION PROPAGATION : CREATION, DESTRUCTION
  ******************************************************************************
  */
-Boolean gip_create_gip(unsigned max_attributes, unsigned **gip)
+Boolean gip_create_gip(Garp *application, unsigned max_attributes)
 { /*
-   * GIP maintains a set of propagation counts for up to max attributes.
-   * It currently maintains no additional information, so the GIP instance
-   * is represented directly by a pointer to the array of propagation counts.
+   * GIP maintains, for each of up to max attributes, a bit set of the
+   * connected ports (by port number) registering the attribute. It currently
+   * maintains no additional information, so the GIP instance is represented
+   * directly by the bit sets, each gip_port_words long, one after another.
+   * There is room for Bitword_bits ports until the port table grows beyond
+   * that (see gip_resize_gip()).
    */
-    unsigned *my_gip;
-    if (!sysmalloc(sizeof(unsigned) * max_attributes, &my_gip))
+    Bitword *my_gip;
+    if (!sysarena_malloc(application->arena, sizeof(Bitword) * max_attributes,
+                         &my_gip))
         goto gip_creation_failure;
-    *gip = my_gip;
+    sysbits_zero(my_gip, max_attributes * Bitword_bits);
+    application->gip = my_gip;
+    application->gip_port_words = 1;
     return (True);
 gip_creation_failure:
     return (False);
 }
-void gip_destroy_gip(void *gip)
+Boolean gip_resize_gip(Garp *application, unsigned new_max_attributes,
+                       unsigned new_port_words)
 { /*
-   *
+   * Replaces the bit sets with larger ones, for new_max_attributes
+   * attributes of new_port_words each, copying the existing sets for the
+   * application's max_gid_index + 1 attributes.
    */
-    sysfree(gip);
+    Bitword *my_gip;
+    unsigned gid_index;
+    if (!sysarena_malloc(application->arena,
+                         sizeof(Bitword) * new_max_attributes * new_port_words,
+                         &my_gip))
+        goto gip_resize_failure;
+    sysbits_zero(my_gip, new_max_attributes * new_port_words * Bitword_bits);
+    for (gid_index = 0; gid_index <= application->max_gid_index; gid_index++)
+        sysbits_copy(&my_gip[gid_index * new_port_words],
+                     gip_registrants(application, gid_index),
+                     application->gip_port_words * Bitword_bits);
+    sysarena_free(application->arena, application->gip);
+    application->gip = my_gip;
+    application->gip_port_words = new_port_words;
+    return (True);
+gip_resize_failure:
+    return (False);
+}
+void gip_destroy_gip(Garp *application)
+{
+    sysarena_free(application->arena, application->gip);
 }
 /******************************************************************************
  * GIP : GARP INFORMATION PROPAGATION : CONNECT, DISCONNECT PORTS
  ******************************************************************************
  */
-static void gip_connect_into_ring(Gid *my_port)
-{
-    Gid *first_connected, *last_connected;
+static void gip_connect_into_list(Garp *application, Gid *my_port)
+{ /*
+   * Inserts the port number into the application's list of connected ports,
+   * which is kept in port number order. The list has room for every port in
+   * the port table, so never needs to grow here.
+   */
+    int *connected = application->connected_ports;
+    int i = application->number_of_connected_ports;
+    while ((i > 0) && (connected[i - 1] > my_port->port_no))
+    {
+        connected[i] = connected[i - 1];
+        i--;
+    }
+    connected[i] = my_port->port_no;
+    application->number_of_connected_ports++;
     my_port->is_connected = True;
-    my_port->next_in_connected_ring = my_port;
-    first_connected = my_port;
-    do
-        first_connected = first_connected->next_in_port_ring;
-    while (!first_connected->is_connected);
-    my_port->next_in_connected_ring = first_connected;
-    last_connected = first_connected;
-    while (last_connected->next_in_connected_ring != first_connected)
-        last_connected = last_connected->next_in_connected_ring;
-    last_connected->next_in_connected_ring = my_port;
-}
-static void gip_disconnect_from_ring(Gid *my_port)
+}
+static void gip_disconnect_from_list(Garp *application, Gid *my_port)
 {
-    Gid *first_connected, *last_connected;
-    first_connected = my_port->next_in_connected_ring;
-    my_port->next_in_connected_ring = my_port;
+    int *connected = application->connected_ports;
+    int i = 0;
+    while (connected[i] != my_port->port_no)
+        i++;
+    application->number_of_connected_ports--;
+    for (; i < application->number_of_connected_ports; i++)
+        connected[i] = connected[i + 1];
     my_port->is_connected = False;
-    last_connected = first_connected;
-    while (last_connected->next_in_connected_ring != my_port)
-        last_connected = last_connected->next_in_connected_ring;
-    last_connected->next_in_connected_ring = first_connected;
+}
+static Bitword gip_propagates_to_word(Gid *my_port, unsigned from_index)
+{ /*
+   * Returns a Bitword with bit n set if gip_propagates_to() is True for GID
+   * index from_index + n, for the indices up to last_gid_used.
+   */
+    Bitword propagates = 0;
+    unsigned gid_index;
+    for (gid_index = from_index;
+         (gid_index < from_index + Bitword_bits) &&
+         (gid_index <= my_port->application->last_gid_used);
+         gid_index++)
+    {
+        if (gip_propagates_to(my_port, gid_index))
+            propagates |= (Bitword)1 << (gid_index - from_index);
+    }
+    return (propagates);
+}
+static void gip_propagate_word(Gid *my_port, unsigned from_index,
+                               Boolean join)
+{ /*
+   * Propagates a join (or a leave) from my_port for each attribute
+   * registered here with GID index from_index + n, n < Bitword_bits.
+   */
+    unsigned gid_index;
+    for (gid_index = from_index;
+         (gid_index < from_index + Bitword_bits) &&
+         (gid_index <= my_port->application->last_gid_used);
+         gid_index++)
+    {
+        if (!gid_registered_here(my_port, gid_index))
+            continue;
+        if (join)
+            gip_propagate_join(my_port, gid_index);
+        else
+            gip_propagate_leave(my_port, gid_index);
+    }
+}
+static Boolean gip_find_in_set(Garp *application, Bitword *ports,
+                               unsigned from_port_no, unsigned *port_no)
+{ /*
+   * Finds the lowest port number from from_port_no on in the set of ports.
+   */
+    if (application->gid_table_size == 0)
+        return (False);
+    return (sysbits_find_set(ports, from_port_no,
+                             (unsigned)application->gid_table_size - 1,
+                             port_no));
 }
 void gip_connect_port(Garp *application, int port_no)
 { /*
    * If a GID instance for this application and port number is found, is
-   * enabled, and is not already connected, then connect that port into the
-   * GIP propagation ring.
+   * enabled, and is not already connected, then add that port to the list of
+   * connected ports.
    *
    * Propagate every attribute that has been registered (i.e., the Registrar
    * appears not to be Empty) on any other connected port, and that has in
-   * consequence a nonzero propagation count, to this port, generating a join
-   * request.
+   * consequence another port in its set of registrants, to this port,
+   * generating a join request.
    *
    * Propagate every attribute that has been registered on this port and not
-   * on any others (having a propagation count of zero prior to connecting this
-   * port) to all the connected ports, updating propagation counts.
+   * on any others (having no registrants prior to connecting this port) to
+   * all the connected ports, adding this port to the sets of registrants.
    *
    * Action any timers required. Mark the port as connected.
    *
+   * The attributes are taken a Bitword at a time, the join requests for
+   * each being made together (see gid_join_requests()) before the joins
+   * registered here are propagated. The requests do not change what is
+   * registered here, and propagating an attribute changes only its own
+   * set of registrants, so this is the same as taking one at a time.
    */
     Gid *my_port;
-    unsigned gid_index;
-    if (gid_find_port(application->gid, port_no, &my_port))
+    unsigned from_index;
+    if (gid_find_port(application, port_no, &my_port))
     {
         if ((!my_port->is_enabled) || (my_port->is_connected))
             return;
-        gip_connect_into_ring(my_port);
-        for (gid_index = 0; gid_index <= application->last_gid_used;
-             gid_index++)
+        gip_connect_into_list(application, my_port);
+        for (from_index = 0; from_index <= application->last_gid_used;
+             from_index += Bitword_bits)
         {
-            if (gip_propagates_to(my_port, gid_index))
-                gid_join_request(my_port, gid_index);
-            if (gid_registered_here(my_port, gid_index))
-                gip_propagate_join(my_port, gid_index);
+            gid_join_requests(my_port, from_index,
+                              gip_propagates_to_word(my_port, from_index));
+            gip_propagate_word(my_port, from_index, True);
         }
         gip_do_actions(my_port);
         my_port->is_connected = True;
@@ -97,28 +184,142 @@ void gip_disconnect_port(Garp *application, int port_no)
    * Reverses the operations performed by gip_connect_port().
    */
     Gid *my_port;
-    unsigned gid_index;
-    if (gid_find_port(application->gid, port_no, &my_port))
+    unsigned from_index;
+    if (gid_find_port(application, port_no, &my_port))
     {
         if ((!my_port->is_enabled) || (!my_port->is_connected))
             return;
-        for (gid_index = 0; gid_index <= application->last_gid_used;
-             gid_index++)
+        for (from_index = 0; from_index <= application->last_gid_used;
+             from_index += Bitword_bits)
         {
-            if (gip_propagates_to(my_port, gid_index))
-                gid_leave_request(my_port, gid_index);
-            if (gid_registered_here(my_port, gid_index))
-                gip_propagate_leave(my_port, gid_index);
+            gid_leave_requests(my_port, from_index,
+                               gip_propagates_to_word(my_port, from_index));
+            gip_propagate_word(my_port, from_index, False);
         }
         gip_do_actions(my_port);
-        gip_disconnect_from_ring(my_port);
+        gip_disconnect_from_list(application, my_port);
         my_port->is_connected = False;
     }
 }
+void gip_connect_ports(Garp *application, Bitword *ports)
+{ /*
+   * Connects the ports in the set as gip_connect_port() would one after
+   * another, but all the ports are added to the list of connected ports
+   * first, and the attributes are then taken a Bitword at a time for all
+   * the new ports together: first the join requests for the attributes
+   * propagated to each new port from the ports already connected, then the
+   * propagation of the joins registered on each. Each attribute's set of
+   * registrants is examined once for each new port, and the connected ports
+   * are walked only when an attribute gains its first or second registrant.
+   */
+    Gid *my_port;
+    unsigned port_no;
+    unsigned from_index;
+    for (port_no = 0; gip_find_in_set(application, ports, port_no, &port_no);
+         port_no++)
+    {
+        if ((!gid_find_port(application, (int)port_no, &my_port)) ||
+            (!my_port->is_enabled) || (my_port->is_connected))
+            sysbits_clear(ports, port_no);
+        else
+            gip_connect_into_list(application, my_port);
+    }
+    if (!gip_find_in_set(application, ports, 0, &port_no))
+        return;
+    for (from_index = 0; from_index <= application->last_gid_used;
+         from_index += Bitword_bits)
+    {
+        for (port_no = 0;
+             gip_find_in_set(application, ports, port_no, &port_no);
+             port_no++)
+        {
+            my_port = application->gid[port_no];
+            gid_join_requests(my_port, from_index,
+                              gip_propagates_to_word(my_port, from_index));
+        }
+        for (port_no = 0;
+             gip_find_in_set(application, ports, port_no, &port_no);
+             port_no++)
+            gip_propagate_word(application->gid[port_no], from_index, True);
+    }
+    gip_find_in_set(application, ports, 0, &port_no);
+    gip_do_actions(application->gid[port_no]);
+}
+void gip_disconnect_ports(Garp *application, Bitword *ports)
+{ /*
+   * Reverses the operations performed by gip_connect_ports(). Leave requests
+   * are made to each port for the attributes propagated to it before any of
+   * the ports' leaves are propagated, and the ports are removed from the
+   * list of connected ports once the actions for all the connected ports
+   * have been carried out.
+   */
+    Gid *my_port;
+    unsigned port_no;
+    unsigned from_index;
+    for (port_no = 0; gip_find_in_set(application, ports, port_no, &port_no);
+         port_no++)
+    {
+        if ((!gid_find_port(application, (int)port_no, &my_port)) ||
+            (!my_port->is_enabled) || (!my_port->is_connected))
+            sysbits_clear(ports, port_no);
+    }
+    if (!gip_find_in_set(application, ports, 0, &port_no))
+        return;
+    for (from_index = 0; from_index <= application->last_gid_used;
+         from_index += Bitword_bits)
+    {
+        for (port_no = 0;
+             gip_find_in_set(application, ports, port_no, &port_no);
+             port_no++)
+        {
+            my_port = application->gid[port_no];
+            gid_leave_requests(my_port, from_index,
+                               gip_propagates_to_word(my_port, from_index));
+        }
+        for (port_no = 0;
+             gip_find_in_set(application, ports, port_no, &port_no);
+             port_no++)
+            gip_propagate_word(application->gid[port_no], from_index, False);
+    }
+    gip_find_in_set(application, ports, 0, &port_no);
+    gip_do_actions(application->gid[port_no]);
+    for (port_no = 0; gip_find_in_set(application, ports, port_no, &port_no);
+         port_no++)
+        gip_disconnect_from_list(application, application->gid[port_no]);
+}
 /******************************************************************************
  * GIP : GARP INFORMATION PROPAGATION : PROPAGATE SINGLE ATTRIBUTES
  ******************************************************************************
  */
+static unsigned gip_count_registrants(Garp *application, Bitword *registrants)
+{
+    unsigned count = 0;
+    unsigned w;
+    for (w = 0; w < application->gip_port_words; w++)
+        count += sysbits_count(registrants[w]);
+    return (count);
+}
+static Boolean gip_other_registrant(Gid *my_port, Bitword *registrants,
+                                    int *port_no)
+{ /*
+   * Finds the lowest numbered connected port other than my_port registering
+   * the attribute.
+   */
+    unsigned w;
+    Bitword word;
+    for (w = 0; w < my_port->application->gip_port_words; w++)
+    {
+        word = registrants[w];
+        if (w == (unsigned)my_port->port_no / Bitword_bits)
+            word &= ~((Bitword)1 << (my_port->port_no % Bitword_bits));
+        if (word != 0)
+        {
+            *port_no = (int)(w * Bitword_bits + sysbits_lowest(word));
+            return (True);
+        }
+    }
+    return (False);
+}
 void gip_propagate_join(Gid *my_port, unsigned gid_index)
 { /*
    * Propagates a join indication, causing join requests to other ports
@@ -129,26 +330,42 @@ void gip_propagate_join(Gid *my_port, unsigned gid_index)
    * in the group registering membership, but no further port that would cause
    * a join request to that port.
    *
+   * The ports registering membership are found from the attribute's bit set
+   * of registrants, so neither case requires the registrar of every
+   * connected port to be examined.
    */
+    Garp *application = my_port->application;
+    Bitword *registrants;
     unsigned joining_members;
     Gid *to_port;
+    int port_no;
+    int i;
     if (my_port->is_connected)
     {
-        joining_members = (my_port->application->gip[gid_index] += 1);
-        if (joining_members <= 2)
+        registrants = gip_registrants(application, gid_index);
+        sysbits_set(registrants, my_port->port_no);
+        joining_members = gip_count_registrants(application, registrants);
+        if (joining_members == 1)
         {
-            to_port = my_port;
-            while ((to_port = to_port->next_in_connected_ring) != my_port)
+            for (i = 0; i < application->number_of_connected_ports; i++)
             {
-                if ((joining_members == 1) || (gid_registered_here(to_port, gid_index)))
-                {
-                    gid_join_request(to_port, gid_index);
-                    to_port->application->join_propagated_fn(
-                        my_port->application,
-                        my_port, gid_index);
-                }
+                to_port = application->gid[application->connected_ports[i]];
+                if (to_port == my_port)
+                    continue;
+                gid_join_request(to_port, gid_index);
+                to_port->application->join_propagated_fn(
+                    my_port->application,
+                    my_port, gid_index);
             }
         }
+        else if ((joining_members == 2) &&
+                 (gip_other_registrant(my_port, registrants, &port_no)))
+        {
+            to_port = application->gid[port_no];
+            gid_join_request(to_port, gid_index);
+            to_port->application->join_propagated_fn(my_port->application,
+                                                     my_port, gid_index);
+        }
     }
 }
 void gip_propagate_leave(Gid *my_port, unsigned gid_index)
@@ -157,7 +374,8 @@ void gip_propagate_leave(Gid *my_port, unsigned gid_index)
      * requests to those other ports if required.
      *
      * See the comments for gip_propagate_join() before reading further.
-     * This function decrements the ‘dead-reckoning’ membership count.
+     * This function clears the port from the ‘dead-reckoning’ set of
+     * registrants.
      *
      * The first step is to check that this port is connected to any others; if
      * not, the leave indication should not be propagated, nor should the joined
@@ -167,30 +385,50 @@ void gip_propagate_leave(Gid *my_port, unsigned gid_index)
      * membership, in which case the leave request needs to be sent to that
      * port alone.
      */
+    Garp *application = my_port->application;
+    Bitword *registrants;
     unsigned remaining_members;
     Gid *to_port;
+    int port_no;
+    int i;
     if (my_port->is_connected)
     {
-        remaining_members = (my_port->application->gip[gid_index] -= 1);
-        if (remaining_members <= 1)
+        registrants = gip_registrants(application, gid_index);
+        sysbits_clear(registrants, my_port->port_no);
+        remaining_members = gip_count_registrants(application, registrants);
+        if (remaining_members == 0)
         {
-            to_port = my_port;
-            while ((to_port = to_port->next_in_connected_ring) != my_port)
+            for (i = 0; i < application->number_of_connected_ports; i++)
             {
-                if ((remaining_members == 0) || (gid_registered_here(to_port, gid_index)))
-                {
-                    gid_leave_request(to_port, gid_index);
-                    to_port->application->leave_propagated_fn(
-                        my_port->application,
-                        my_port, gid_index);
-                }
+                to_port = application->gid[application->connected_ports[i]];
+                if (to_port == my_port)
+                    continue;
+                gid_leave_request(to_port, gid_index);
+                to_port->application->leave_propagated_fn(
+                    my_port->application,
+                    my_port, gid_index);
             }
         }
+        else if ((remaining_members == 1) &&
+                 (gip_other_registrant(my_port, registrants, &port_no)))
+        {
+            to_port = application->gid[port_no];
+            gid_leave_request(to_port, gid_index);
+            to_port->application->leave_propagated_fn(my_port->application,
+                                                      my_port, gid_index);
+        }
     }
 }
 Boolean gip_propagates_to(Gid *my_port, unsigned gid_index)
-{
-    if ((my_port->is_connected) && ((my_port->application->gip[gid_index] == 2) || ((my_port->application->gip[gid_index] == 1) && (!gid_registered_here(my_port, gid_index)))))
+{ /*
+   * An attribute is propagated to my_port if any other connected port
+   * registers it.
+   */
+    int port_no;
+    if ((my_port->is_connected) &&
+        (gip_other_registrant(my_port,
+                              gip_registrants(my_port->application, gid_index),
+                              &port_no)))
         return (True);
     else
         return (False);
@@ -202,10 +440,28 @@ Boolean gip_propagates_to(Gid *my_port, unsigned gid_index)
 void gip_do_actions(Gid *my_port)
 { /*
    * Calls GID to carry out GID ‘scratchpad’ actions accumulated during this
-   * invocation of GARP for all the ports in the GIP ring, including my port.
+   * invocation of GARP for all the connected ports, including my port. If
+   * my port is not connected, it is the only port with actions to carry out.
+   *
+   * GID records the ports for which gid_do_actions() would do anything in
+   * the application's ports_with_actions set, so only the connected ports
+   * in that set are visited, however many ports are connected.
    */
-    Gid *this_port = my_port;
-    do
-        gid_do_actions(this_port);
-    while ((this_port = this_port->next_in_connected_ring) != my_port);
+    Garp *application = my_port->application;
+    Gid *port;
+    unsigned port_no;
+    if (!my_port->is_connected)
+    {
+        gid_do_actions(my_port);
+        return;
+    }
+    for (port_no = 0;
+         gip_find_in_set(application, application->ports_with_actions,
+                         port_no, &port_no);
+         port_no++)
+    {
+        port = application->gid[port_no];
+        if ((port != NULL) && (port->is_connected))
+            gid_do_actions(port);
+    }
 }
\ No newline at end of file
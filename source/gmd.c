@@ -1,43 +1,396 @@
+/* gmd.c */
 #include "sys.h"
+#include "gmd.h"
 /******************************************************************************
- * GMD : GARP MULTICAST REGISTRATION APPLICATION DATABASE
+ * GMD : GARP MULTICAST REGISTRATION APPLICATION DATABASE : IMPLEMENTATION
  ******************************************************************************
  */
-Boolean gmd_create_gmd(unsigned max_multicasts, void **gmd)
+/* The database comprises an array of keys indexed by GMD index (the GID index
+ * of a multicast attribute less the number of legacy controls), and an
+ * open addressing hash table that maps keys back to GMD indexes.
+ *
+ * Keys are held inline as 64-bit integers. The six octets of the MAC address
+ * occupy the first six octets of the integer, the seventh is always zero, and
+ * the eighth marks the entry as being in use. An unused entry is all zeroes,
+ * so a probe compares a single 64-bit value and can never match an unused
+ * entry. gmd_get_key() returns a pointer to the octets of the stored key, so
+ * callers see an ordinary Mac_address that remains valid while the entry
+ * exists and the database is not resized.
+ *
+ * The hash table has a power of two number of buckets, at least twice the
+ * maximum number of entries, each holding a GMD index or Gmd_no_entry.
+ * Collisions are resolved by linear probing. Deletion shifts later members of
+ * the same probe sequence back into the vacated bucket, so no tombstones
+ * accumulate and the table is only rebuilt when the database is resized.
+ *
+ * GMD indexes are handed out from a stack of previously deleted indexes
+ * before any fresh index is used, so the indexes in use stay dense (which
+ * keeps GID scans short) and each index is stable for the life of its entry.
+ */
+typedef union /* Gmd_key */
+{
+    unsigned long long packed;
+    Octet octets[8];
+} Gmd_key;
+enum
+{
+    Gmd_mac_octets = 6,
+    Gmd_in_use_octet = 7
+};
+#define Gmd_no_entry Gmd_not_found
+#define Gmd_hash_multiplier 0x9E3779B97F4A7C15ull
+enum
+{
+    Gmd_batch_lanes = 4,
+    Gmd_batch_size = 32 /* a multiple of Gmd_batch_lanes */
+};
+#if defined(__GNUC__)
+typedef unsigned long long Gmd_lanes
+    __attribute__((vector_size(Gmd_batch_lanes * sizeof(unsigned long long))));
+#endif
+typedef union /* Gmd_batch */
 {
-    return False;
+#if defined(__GNUC__)
+    Gmd_lanes lanes[Gmd_batch_size / Gmd_batch_lanes];
+#endif
+    unsigned long long packed[Gmd_batch_size];
+} Gmd_batch;
+typedef struct /* Gmd */
+{
+    void *arena;
+    unsigned max_multicasts;
+    unsigned number_of_entries;
+    unsigned next_fresh_index;
+    unsigned number_of_free;
+    unsigned *free_indexes;
+    Gmd_key *keys;
+    unsigned bucket_mask;
+    unsigned bucket_shift;
+    unsigned *buckets;
+} Gmd;
+/******************************************************************************
+ * GMD : GARP MULTICAST REGISTRATION APPLICATION DATABASE : KEYS, HASHING
+ ******************************************************************************
+ */
+static unsigned long long gmd_pack_key(Mac_address key)
+{ /*
+   * Returns the inline representation of the MAC address, marked in use.
+   */
+    Gmd_key packed;
+    int i;
+    packed.packed = 0;
+    for (i = 0; i < Gmd_mac_octets; i++)
+        packed.octets[i] = key[i];
+    packed.octets[Gmd_in_use_octet] = 1;
+    return (packed.packed);
 }
-/*
- * Creates a new instance of GMD, allocating space for up to max_multicasts
- * MAC addresses.
- *
- * Returns True if the creation succeeded together with a pointer to the
- * GMD information.
+static unsigned gmd_hash(Gmd *my_gmd, unsigned long long packed)
+{
+    return ((unsigned)((packed * Gmd_hash_multiplier) >> my_gmd->bucket_shift));
+}
+static Boolean gmd_find_bucket(Gmd *my_gmd, unsigned long long packed,
+                               unsigned *bucket)
+{ /*
+   * Returns True and the bucket holding the key if it is present, otherwise
+   * returns False and the empty bucket that terminated the probe sequence.
+   */
+    unsigned b;
+    unsigned gmd_index;
+    b = gmd_hash(my_gmd, packed);
+    while ((gmd_index = my_gmd->buckets[b]) != Gmd_no_entry)
+    {
+        if (my_gmd->keys[gmd_index].packed == packed)
+        {
+            *bucket = b;
+            return (True);
+        }
+        b = (b + 1) & my_gmd->bucket_mask;
+    }
+    *bucket = b;
+    return (False);
+}
+/******************************************************************************
+ * GMD : GARP MULTICAST REGISTRATION APPLICATION DATABASE : CREATION, DESTRUCTION
+ ******************************************************************************
  */
+static unsigned gmd_bucket_bits(unsigned max_multicasts)
+{ /*
+   * Returns log2 of the number of buckets required for max_multicasts.
+   */
+    unsigned bucket_bits = 1;
+    while ((1u << bucket_bits) < 2 * max_multicasts)
+        bucket_bits++;
+    return (bucket_bits);
+}
+Boolean gmd_create_gmd(unsigned max_multicasts, void *arena, void **gmd)
+{ /*
+   * Creates a new instance of GMD, allocating space for up to max_multicasts
+   * MAC addresses.
+   */
+    Gmd *my_gmd;
+    unsigned number_of_buckets;
+    unsigned bucket_bits;
+    unsigned i;
+    bucket_bits = gmd_bucket_bits(max_multicasts);
+    number_of_buckets = 1u << bucket_bits;
+    if (!sysarena_malloc(arena, sizeof(Gmd), &my_gmd))
+        goto gmd_creation_failure;
+    if (!sysarena_malloc(arena, sizeof(Gmd_key) * max_multicasts,
+                         &my_gmd->keys))
+        goto keys_creation_failure;
+    if (!sysarena_malloc(arena, sizeof(unsigned) * max_multicasts,
+                         &my_gmd->free_indexes))
+        goto free_creation_failure;
+    if (!sysarena_malloc(arena, sizeof(unsigned) * number_of_buckets,
+                         &my_gmd->buckets))
+        goto buckets_creation_failure;
+    my_gmd->arena = arena;
+    my_gmd->max_multicasts = max_multicasts;
+    my_gmd->number_of_entries = 0;
+    my_gmd->next_fresh_index = 0;
+    my_gmd->number_of_free = 0;
+    my_gmd->bucket_mask = number_of_buckets - 1;
+    my_gmd->bucket_shift = 64 - bucket_bits;
+    for (i = 0; i < max_multicasts; i++)
+        my_gmd->keys[i].packed = 0;
+    for (i = 0; i < number_of_buckets; i++)
+        my_gmd->buckets[i] = Gmd_no_entry;
+    *gmd = my_gmd;
+    return (True);
+buckets_creation_failure:
+    sysarena_free(arena, my_gmd->free_indexes);
+free_creation_failure:
+    sysarena_free(arena, my_gmd->keys);
+keys_creation_failure:
+    sysarena_free(arena, my_gmd);
+gmd_creation_failure:
+    return (False);
+}
+Boolean gmd_resize_gmd(void *gmd, unsigned max_multicasts)
+{ /*
+   * Allocates larger key, free index, and bucket arrays, copies the keys and
+   * free indexes across unchanged, and rehashes every entry into the new
+   * buckets. The old arrays are released only once all the new ones have
+   * been allocated.
+   */
+    Gmd *my_gmd = (Gmd *)gmd;
+    Gmd_key *keys;
+    unsigned *free_indexes;
+    unsigned *buckets;
+    unsigned number_of_buckets;
+    unsigned bucket_bits;
+    unsigned i;
+    unsigned b;
+    if (max_multicasts < my_gmd->max_multicasts)
+        return (False);
+    bucket_bits = gmd_bucket_bits(max_multicasts);
+    number_of_buckets = 1u << bucket_bits;
+    if (!sysarena_malloc(my_gmd->arena, sizeof(Gmd_key) * max_multicasts,
+                         &keys))
+        goto keys_resize_failure;
+    if (!sysarena_malloc(my_gmd->arena, sizeof(unsigned) * max_multicasts,
+                         &free_indexes))
+        goto free_resize_failure;
+    if (!sysarena_malloc(my_gmd->arena, sizeof(unsigned) * number_of_buckets,
+                         &buckets))
+        goto buckets_resize_failure;
+    for (i = 0; i < my_gmd->max_multicasts; i++)
+        keys[i] = my_gmd->keys[i];
+    for (; i < max_multicasts; i++)
+        keys[i].packed = 0;
+    for (i = 0; i < my_gmd->number_of_free; i++)
+        free_indexes[i] = my_gmd->free_indexes[i];
+    for (b = 0; b < number_of_buckets; b++)
+        buckets[b] = Gmd_no_entry;
+    sysarena_free(my_gmd->arena, my_gmd->keys);
+    sysarena_free(my_gmd->arena, my_gmd->free_indexes);
+    sysarena_free(my_gmd->arena, my_gmd->buckets);
+    my_gmd->keys = keys;
+    my_gmd->free_indexes = free_indexes;
+    my_gmd->buckets = buckets;
+    my_gmd->max_multicasts = max_multicasts;
+    my_gmd->bucket_mask = number_of_buckets - 1;
+    my_gmd->bucket_shift = 64 - bucket_bits;
+    for (i = 0; i < my_gmd->next_fresh_index; i++)
+    {
+        if (keys[i].packed != 0)
+        {
+            (void)gmd_find_bucket(my_gmd, keys[i].packed, &b);
+            buckets[b] = i;
+        }
+    }
+    return (True);
+buckets_resize_failure:
+    sysarena_free(my_gmd->arena, free_indexes);
+free_resize_failure:
+    sysarena_free(my_gmd->arena, keys);
+keys_resize_failure:
+    return (False);
+}
 void gmd_destroy_gmd(void *gmd)
-{
-    return;
+{ /*
+   * Destroys the instance of gmd, releasing previously allocated database and
+   * control space.
+   */
+    Gmd *my_gmd = (Gmd *)gmd;
+    sysarena_free(my_gmd->arena, my_gmd->buckets);
+    sysarena_free(my_gmd->arena, my_gmd->free_indexes);
+    sysarena_free(my_gmd->arena, my_gmd->keys);
+    sysarena_free(my_gmd->arena, my_gmd);
 }
-/*
- * Destroys the instance of gmd, releasing previously allocated database and
- * control space.
+/******************************************************************************
+ * GMD : GARP MULTICAST REGISTRATION APPLICATION DATABASE : ENTRIES
+ ******************************************************************************
  */
 Boolean gmd_find_entry(void *my_gmd, Mac_address key,
                        unsigned *found_at_index)
 {
-    return False;
+    Gmd *gmd = (Gmd *)my_gmd;
+    unsigned bucket;
+    if (!gmd_find_bucket(gmd, gmd_pack_key(key), &bucket))
+        return (False);
+    *found_at_index = gmd->buckets[bucket];
+    return (True);
+}
+unsigned gmd_find_entries(void *my_gmd, Mac_address *keys,
+                          unsigned number_of_keys,
+                          unsigned *found_at_indexes)
+{ /*
+   * Works through the keys in groups of up to Gmd_batch_size: packs the
+   * group, hashes Gmd_batch_lanes keys at a time with vector arithmetic,
+   * prefetches every home bucket, then the key that each occupied home bucket
+   * refers to, and finally completes each probe. The prefetches let the
+   * cache misses for the whole group overlap instead of being taken one key
+   * at a time.
+   */
+    Gmd *gmd = (Gmd *)my_gmd;
+    Gmd_batch batch;
+    unsigned buckets[Gmd_batch_size];
+    unsigned done;
+    unsigned number_in_group;
+    unsigned number_not_found;
+    unsigned i;
+    unsigned b;
+    unsigned gmd_index;
+#if defined(__GNUC__)
+    Gmd_lanes multiplier;
+    Gmd_lanes hashes;
+    for (i = 0; i < Gmd_batch_lanes; i++)
+        multiplier[i] = Gmd_hash_multiplier;
+#endif
+    number_not_found = 0;
+    for (done = 0; done < number_of_keys; done += number_in_group)
+    {
+        number_in_group = number_of_keys - done;
+        if (number_in_group > Gmd_batch_size)
+            number_in_group = Gmd_batch_size;
+        for (i = 0; i < number_in_group; i++)
+            batch.packed[i] = gmd_pack_key(keys[done + i]);
+#if defined(__GNUC__)
+        for (; (i % Gmd_batch_lanes) != 0; i++)
+            batch.packed[i] = 0;
+        for (i = 0; i < number_in_group; i += Gmd_batch_lanes)
+        {
+            hashes = (batch.lanes[i / Gmd_batch_lanes] * multiplier) >>
+                     gmd->bucket_shift;
+            for (b = 0; b < Gmd_batch_lanes; b++)
+                buckets[i + b] = (unsigned)hashes[b];
+        }
+#else
+        for (i = 0; i < number_in_group; i++)
+            buckets[i] = gmd_hash(gmd, batch.packed[i]);
+#endif
+        for (i = 0; i < number_in_group; i++)
+            sys_prefetch(&gmd->buckets[buckets[i]]);
+        for (i = 0; i < number_in_group; i++)
+        {
+            if ((gmd_index = gmd->buckets[buckets[i]]) != Gmd_no_entry)
+                sys_prefetch(&gmd->keys[gmd_index]);
+        }
+        for (i = 0; i < number_in_group; i++)
+        {
+            b = buckets[i];
+            while (((gmd_index = gmd->buckets[b]) != Gmd_no_entry) &&
+                   (gmd->keys[gmd_index].packed != batch.packed[i]))
+                b = (b + 1) & gmd->bucket_mask;
+            found_at_indexes[done + i] = gmd_index;
+            if (gmd_index == Gmd_no_entry)
+                number_not_found++;
+        }
+    }
+    return (number_not_found);
 }
 Boolean gmd_create_entry(void *my_gmd, Mac_address key,
                          unsigned *created_at_index)
-{
-    return False;
+{ /*
+   * Creates an entry for key, returning its GMD index. If the key is already
+   * present its existing index is returned. Returns False if the database is
+   * full.
+   */
+    Gmd *gmd = (Gmd *)my_gmd;
+    unsigned long long packed;
+    unsigned bucket;
+    unsigned gmd_index;
+    packed = gmd_pack_key(key);
+    if (gmd_find_bucket(gmd, packed, &bucket))
+    {
+        *created_at_index = gmd->buckets[bucket];
+        return (True);
+    }
+    if (gmd->number_of_free > 0)
+        gmd_index = gmd->free_indexes[--gmd->number_of_free];
+    else if (gmd->next_fresh_index < gmd->max_multicasts)
+        gmd_index = gmd->next_fresh_index++;
+    else
+        return (False);
+    gmd->keys[gmd_index].packed = packed;
+    gmd->buckets[bucket] = gmd_index;
+    gmd->number_of_entries++;
+    *created_at_index = gmd_index;
+    return (True);
 }
 Boolean gmd_delete_entry(void *my_gmd,
                          unsigned delete_at_index)
-{
-    return False;
+{ /*
+   * Removes the entry at delete_at_index, closing the gap in its probe
+   * sequence by moving back any later entry that would otherwise become
+   * unreachable.
+   */
+    Gmd *gmd = (Gmd *)my_gmd;
+    unsigned vacant;
+    unsigned next;
+    unsigned home;
+    if ((delete_at_index >= gmd->max_multicasts) ||
+        (gmd->keys[delete_at_index].packed == 0))
+        return (False);
+    vacant = gmd_hash(gmd, gmd->keys[delete_at_index].packed);
+    while (gmd->buckets[vacant] != delete_at_index)
+        vacant = (vacant + 1) & gmd->bucket_mask;
+    next = vacant;
+    for (;;)
+    {
+        next = (next + 1) & gmd->bucket_mask;
+        if (gmd->buckets[next] == Gmd_no_entry)
+            break;
+        home = gmd_hash(gmd, gmd->keys[gmd->buckets[next]].packed);
+        if (((next - home) & gmd->bucket_mask) >=
+            ((next - vacant) & gmd->bucket_mask))
+        {
+            gmd->buckets[vacant] = gmd->buckets[next];
+            vacant = next;
+        }
+    }
+    gmd->buckets[vacant] = Gmd_no_entry;
+    gmd->keys[delete_at_index].packed = 0;
+    gmd->free_indexes[gmd->number_of_free++] = delete_at_index;
+    gmd->number_of_entries--;
+    return (True);
 }
 Boolean gmd_get_key(void *my_gmd, unsigned index, Mac_address *key)
 {
-    return False;
-}
\ No newline at end of file
+    Gmd *gmd = (Gmd *)my_gmd;
+    if ((index >= gmd->max_multicasts) || (gmd->keys[index].packed == 0))
+        return (False);
+    *key = gmd->keys[index].octets;
+    return (True);
+}
@@ -1,35 +1,187 @@
+/* gmf.c */
 #include "sys.h"
 #include "prw.h"
 #include "gmr.h"
+#include "gmf.h"
 /******************************************************************************
  * GMF : GARP MULTICAST REGISTRATION APPLICATION PDU FORMATTING
  ******************************************************************************
  */
-typedef struct
+enum
+{
+    Gmf_number_of_events = 6
+};
+static const Gid_event gmf_rcv_events[Gmf_number_of_events] =
+    {Gid_rcv_leaveall, Gid_rcv_joinempty, Gid_rcv_joinin,
+     Gid_rcv_leaveempty, Gid_rcv_leavein, Gid_rcv_empty};
+/******************************************************************************
+ * GMF : GARP MULTICAST REGISTRATION APPLICATION PDU FORMATTING : RECEIVE
+ ******************************************************************************
+ */
+void gmf_rdmsg_init(Gmf *gmf, Pdu *pdu)
+{
+    prw_rdrec_init(pdu, &gmf->gpdu);
+    gmf->in_list = False;
+    gmf->attribute = All_attributes;
+}
+Boolean gmf_rdmsg(Gmf *gmf, Gmf_msg *msg)
 { /*
-   * This data structure saves the temporary state required to parse GMR
-   * PDUs in particular. Gpdu provides a common basis for GARP application
-   * formatters; additional state can be added here as required by GMF.
+   * PRW has checked the PDU, so each attribute read lies within it, and
+   * is at least long enough for its event.
    */
-    Gpdu gpdu;
-} Gmf;
-typedef struct /* Gmf_msg_data */
+    Gpdu *gpdu = &gmf->gpdu;
+    Octet *attribute;
+    unsigned event;
+    for (;;)
+    {
+        if (!gmf->in_list)
+        {
+            if (!prw_rdrec(gpdu))
+                return (False);
+            if (gpdu->record_id == Gmf_group_attribute_type)
+                gmf->attribute = Multicast_attribute;
+            else if (gpdu->record_id == Gmf_service_requirement_attribute_type)
+                gmf->attribute = Legacy_attribute;
+            else
+            {
+                prw_skiprec(gpdu);
+                gmf->attribute = All_attributes;
+            }
+            gmf->in_list = True;
+        }
+        if (!prw_rdattr(gpdu, &attribute))
+        {
+            gmf->in_list = False;
+            continue;
+        }
+        event = attribute[1];
+        if (event >= Gmf_number_of_events)
+            continue;
+        if (attribute[0] == Gmf_leaveall_length)
+        {
+            if (event != 0)
+                continue;
+            msg->key1 = NULL;
+        }
+        else if (gmf->attribute == Multicast_attribute)
+        {
+            if ((attribute[0] != Gmf_group_length) || (event == 0))
+                continue;
+            msg->key1 = &attribute[2];
+        }
+        else
+        {
+            if ((attribute[0] != Gmf_service_requirement_length) ||
+                (event == 0) || (attribute[2] > Forward_unregistered))
+                continue;
+            msg->legacy_control = (Legacy_control)attribute[2];
+            msg->key1 = NULL;
+        }
+        msg->attribute = gmf->attribute;
+        msg->event = gmf_rcv_events[event];
+        msg->key2 = NULL;
+        return (True);
+    }
+}
+/******************************************************************************
+ * GMF : GARP MULTICAST REGISTRATION APPLICATION PDU FORMATTING : TRANSMIT
+ ******************************************************************************
+ */
+static const Octet gmf_tx_events[Gid_tx_leaveall - Gid_tx_leaveempty + 1] =
+    {3, 4, 5, 1, 2, 0}; /* from Gid_tx_leaveempty to Gid_tx_leaveall */
+void gmf_wrmsg_init(Gmf *gmf, Pdu *pdu, int vlan_id, unsigned pdu_size)
+{
+    Octet *octets;
+    int number_of_octets;
+    octets = syspdu_octets(pdu, &number_of_octets);
+    gmf->gpdu.pdu = pdu;
+    gmf->in_list = False;
+    gmf->attribute = All_attributes;
+    if ((unsigned)number_of_octets > pdu_size)
+        number_of_octets = (int)pdu_size;
+    if ((octets == NULL) || (number_of_octets < Gmf_min_pdu_size))
+    {
+        gmf->next = NULL;
+        gmf->end = NULL;
+        return;
+    }
+    octets[0] = (Octet)(Garp_protocol_id >> 8);
+    octets[1] = (Octet)Garp_protocol_id;
+    gmf->next = octets + 2;
+    gmf->end = octets + number_of_octets - 1;
+}
+static unsigned gmf_msg_length(Gmf *gmf, Attribute_type attribute,
+                               unsigned attribute_length)
 {
-    Attribute_type attribute;
-    Gid_event event;
-    Mac_address key1;
-    Mac_address key2;
-    Legacy_control legacy_control;
-} Gmf_msg;
-void gmf_rdmsg_init(Pdu *pdu, Gmf **gmf){
-    return;
+    if (gmf->in_list && (attribute == gmf->attribute))
+        return (attribute_length);
+    return (1 + attribute_length + 1);
 }
-void gmf_wrmsg_init(Gmf *gmf, Pdu *pdu, int vlan_id){
-    return;
+Boolean gmf_wrmsg_room(Gmf *gmf)
+{
+    unsigned available;
+    if (gmf->next == NULL)
+        return (False);
+    available = (unsigned)(gmf->end - gmf->next) - (gmf->in_list ? 1 : 0);
+    return ((Boolean)(available >= gmf_msg_length(gmf, Multicast_attribute,
+                                                  Gmf_group_length)));
+}
+Boolean gmf_wrmsg(Gmf *gmf, Gmf_msg *msg)
+{
+    Attribute_type attribute = msg->attribute;
+    unsigned attribute_length;
+    unsigned available;
+    Octet *next = gmf->next;
+    if (next == NULL)
+        return (False);
+    if (msg->event == Gid_tx_leaveall)
+    {
+        attribute = Multicast_attribute;
+        attribute_length = Gmf_leaveall_length;
+    }
+    else if (attribute == Legacy_attribute)
+        attribute_length = Gmf_service_requirement_length;
+    else
+        attribute_length = Gmf_group_length;
+    available = (unsigned)(gmf->end - next) - (gmf->in_list ? 1 : 0);
+    if (available < gmf_msg_length(gmf, attribute, attribute_length))
+        return (False);
+    if (!gmf->in_list || (attribute != gmf->attribute))
+    {
+        if (gmf->in_list)
+            *next++ = Gmf_end_mark;
+        *next++ = (attribute == Legacy_attribute) ?
+                      Gmf_service_requirement_attribute_type :
+                      Gmf_group_attribute_type;
+        gmf->in_list = True;
+        gmf->attribute = attribute;
+    }
+    next[0] = (Octet)attribute_length;
+    next[1] = gmf_tx_events[msg->event - Gid_tx_leaveempty];
+    if (attribute_length == Gmf_group_length)
+    {
+        next[2] = msg->key1[0];
+        next[3] = msg->key1[1];
+        next[4] = msg->key1[2];
+        next[5] = msg->key1[3];
+        next[6] = msg->key1[4];
+        next[7] = msg->key1[5];
+    }
+    else if (attribute_length == Gmf_service_requirement_length)
+        next[2] = (Octet)msg->legacy_control;
+    gmf->next = next + attribute_length;
+    return (True);
 }
-Boolean gmf_rdmsg(Gmf *gmf, Gmf_msg *msg){
-    return False;
+Boolean gmf_wrmsg_done(Gmf *gmf)
+{
+    Octet *octets;
+    int number_of_octets;
+    if (!gmf->in_list)
+        return (False);
+    *gmf->next++ = Gmf_end_mark;
+    *gmf->next++ = Gmf_end_mark;
+    octets = syspdu_octets(gmf->gpdu.pdu, &number_of_octets);
+    syspdu_set_length(gmf->gpdu.pdu, (int)(gmf->next - octets));
+    gmf->in_list = False;
+    return (True);
 }
-Boolean gmf_wrmsg(Gmf *gmf, Gmf_msg *msg){
-    return False;
-}
\ No newline at end of file
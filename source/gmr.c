@@ -6,21 +6,84 @@
 #include "gmd.h"
 #include "gmf.h"
 #include "fdb.h"
+#include "fdq.h"
 /******************************************************************************
  * GMR : GARP MULTICAST REGISTRATION APPLICATION : IMPLEMENTATION SIZING
  ******************************************************************************
  */
+/*
+ * The number of multicast attributes that an instance of GMR can hold is
+ * set when the instance is created, and is doubled, up to a maximum also
+ * set at creation, whenever GMD fills. GMD, the GIP sets of registrants,
+ * and the GID machines for every port are grown together, so there is
+ * always one GID machine for each GMD entry (plus one for each legacy
+ * control) and no registration is lost by growing.
+ */
+#define Unused_index 0xFFFFFFFFu
+/*
+ * Received messages are read from a PDU and their multicast keys looked up
+ * in GMD a batch at a time.
+ */
+enum
+{
+    Gmr_rcv_batch = 64
+};
+/*
+ * Unless set by gmr_set_arena(), an instance's arena starts with room for
+ * its control blocks and arrays for the initial number of multicasts and a
+ * few ports; it grows with the instance if it needs more.
+ */
+enum
+{
+    Gmr_arena_base_size = 16384,
+    Gmr_arena_size_per_multicast = 128
+};
+/*
+ * The Filtering Database state last set by GMR, and the changes collected
+ * while a PDU is processed (or not yet taken by the Filtering Database
+ * queue), are held as bit sets over the ports (indexed by port number,
+ * fdb_port_words long, as GIP's sets of registrants), one for each GMD
+ * entry, allocated together: whether the state of the port has been set
+ * for the entry's address, and if so whether it was forwarding; whether a
+ * change is pending, and if so whether it is to forward. These are followed
+ * by the set of GMD entries with changes pending, and the port sets below.
+ *
+ * A change of Legacy mode changes the port's default as well as the entries
+ * for many addresses. It is recorded for the port, and made from the
+ * registrations current when it is made: either every address not
+ * registered on the port is set to the same action as the default (Legacy
+ * modes A and C), or every such address not propagated to the port is
+ * forwarded (Legacy mode B, which leaves those propagated filtered).
+ *
+ * The only changes for single addresses that must not be reordered with a
+ * change of default are those that create Filtering Database entries, which
+ * take the defaults current when they are made. Each change of Legacy mode,
+ * and each GMD entry whose address has not been set on any port when a
+ * change for it is first pending, is therefore stamped from fdb_stamp, and
+ * they are made in the order of their stamps.
+ *
+ * Changes the queue has no room for are retried every Gmr_fdb_retry_time
+ * milliseconds, as well as whenever GMR next makes changes.
+ */
 enum
 {
-    Max_multicasts = 100
+    Gmr_fdb_written,
+    Gmr_fdb_forwarding,
+    Gmr_fdb_pending,
+    Gmr_fdb_pending_forwarding,
+    Gmr_fdb_sets
 };
 enum
 {
-    Number_of_gid_machines = Number_of_legacy_controls + Max_multicasts
+    Gmr_fdb_ports_pending,
+    Gmr_fdb_ports_legacy_all,
+    Gmr_fdb_ports_legacy_forwarding,
+    Gmr_fdb_ports_legacy_unpropagated,
+    Gmr_fdb_port_sets
 };
 enum
 {
-    Unused_index = Number_of_gid_machines
+    Gmr_fdb_retry_time = 10
 };
 /******************************************************************************
  * GMR : GARP MULTICAST REGISTRATION APPLICATION : CREATION, DESTRUCTION
@@ -32,20 +95,135 @@ typedef struct /* Gmr */
     unsigned vlan_id;
     void *gmd;
     unsigned number_of_gmd_entries;
+    unsigned max_gmd_entries;
     unsigned last_gmd_used_plus1;
+    Mac_address *fdb_keys;
+    Bitword *fdb_sets;
+    unsigned *fdb_stamps;
+    unsigned fdb_stamp;
+    unsigned fdb_entries;
+    unsigned fdb_port_words;
+    Boolean fdb_collecting;
+    Boolean fdb_retry_running;
+    Gmr_fdb_counts fdb_counts;
+    unsigned pdu_size;
 } Gmr;
-Boolean gmr_create_gmr(int process_id, unsigned vlan_id, void **gmr)
+static Bitword *gmr_fdb_set(Gmr *my_gmr, unsigned set, unsigned gmd_index)
+{
+    return (&my_gmr->fdb_sets[(set * my_gmr->fdb_entries + gmd_index) *
+                              my_gmr->fdb_port_words]);
+}
+static Bitword *gmr_fdb_pending_entries(Gmr *my_gmr)
+{
+    return (gmr_fdb_set(my_gmr, Gmr_fdb_sets, 0));
+}
+static Bitword *gmr_fdb_ports(Gmr *my_gmr, unsigned set)
+{
+    return (gmr_fdb_pending_entries(my_gmr) +
+            sysbits_words(my_gmr->fdb_entries) +
+            set * my_gmr->fdb_port_words);
+}
+static Boolean gmr_fdb_resize(Gmr *my_gmr, unsigned new_entries,
+                              unsigned new_port_words)
+{ /*
+   * Replaces the Filtering Database sets (if any) with sets for new_entries
+   * GMD entries and new_port_words words of ports, copying the existing
+   * sets, including any pending changes, and their stamps (those of the GMD
+   * entries, followed by those of the ports).
+   */
+    Bitword *new_sets;
+    Bitword *old_sets = my_gmr->fdb_sets;
+    unsigned *new_stamps;
+    unsigned *old_stamps = my_gmr->fdb_stamps;
+    unsigned old_entries = my_gmr->fdb_entries;
+    unsigned old_port_words = my_gmr->fdb_port_words;
+    unsigned number_of_words;
+    unsigned set;
+    unsigned gmd_index;
+    unsigned port_no;
+    number_of_words = Gmr_fdb_sets * new_entries * new_port_words +
+                      sysbits_words(new_entries) +
+                      Gmr_fdb_port_sets * new_port_words;
+    if (!sysarena_malloc(my_gmr->g.arena, sizeof(Bitword) * number_of_words,
+                         &new_sets))
+        goto sets_creation_failure;
+    if (!sysarena_malloc(my_gmr->g.arena,
+                         sizeof(unsigned) *
+                             (new_entries + new_port_words * Bitword_bits),
+                         &new_stamps))
+        goto stamps_creation_failure;
+    sysbits_zero(new_sets, number_of_words * Bitword_bits);
+    my_gmr->fdb_sets = new_sets;
+    my_gmr->fdb_stamps = new_stamps;
+    my_gmr->fdb_entries = new_entries;
+    my_gmr->fdb_port_words = new_port_words;
+    if (old_sets != NULL)
+    {
+        for (set = 0; set < Gmr_fdb_sets; set++)
+            for (gmd_index = 0; gmd_index < old_entries; gmd_index++)
+                sysbits_copy(gmr_fdb_set(my_gmr, set, gmd_index),
+                             &old_sets[(set * old_entries + gmd_index) *
+                                       old_port_words],
+                             old_port_words * Bitword_bits);
+        sysbits_copy(gmr_fdb_pending_entries(my_gmr),
+                     &old_sets[Gmr_fdb_sets * old_entries * old_port_words],
+                     old_entries);
+        for (set = 0; set < Gmr_fdb_port_sets; set++)
+            sysbits_copy(gmr_fdb_ports(my_gmr, set),
+                         &old_sets[Gmr_fdb_sets * old_entries *
+                                       old_port_words +
+                                   sysbits_words(old_entries) +
+                                   set * old_port_words],
+                         old_port_words * Bitword_bits);
+        for (gmd_index = 0; gmd_index < old_entries; gmd_index++)
+            new_stamps[gmd_index] = old_stamps[gmd_index];
+        for (port_no = 0; port_no < old_port_words * Bitword_bits; port_no++)
+            new_stamps[new_entries + port_no] =
+                old_stamps[old_entries + port_no];
+        sysarena_free(my_gmr->g.arena, old_stamps);
+        sysarena_free(my_gmr->g.arena, old_sets);
+    }
+    return (True);
+stamps_creation_failure:
+    sysarena_free(my_gmr->g.arena, new_sets);
+sets_creation_failure:
+    return (False);
+}
+static unsigned gmr_arena_size = 0;
+static Boolean gmr_arena_huge_pages = False;
+void gmr_set_arena(unsigned arena_size, Boolean huge_pages)
+{
+    gmr_arena_size = arena_size;
+    gmr_arena_huge_pages = huge_pages;
+}
+Boolean gmr_create_gmr(int process_id, unsigned vlan_id,
+                       unsigned number_of_multicasts, unsigned max_multicasts,
+                       void **gmr)
 { /*
+   * Everything allocated for the instance comes from its arena, so if
+   * creation fails part way destroying the arena releases it all.
    */
     Gmr *my_gmr;
-    if (!sysmalloc(sizeof(Gmr), &my_gmr))
+    void *arena;
+    unsigned arena_size = gmr_arena_size;
+    if ((number_of_multicasts == 0) || (number_of_multicasts > max_multicasts))
+        goto gmr_creation_failure;
+    if (arena_size == 0)
+        arena_size = Gmr_arena_base_size +
+                     Gmr_arena_size_per_multicast * number_of_multicasts;
+    if (!sysarena_create(arena_size, gmr_arena_huge_pages, &arena))
         goto gmr_creation_failure;
+    if (!sysarena_malloc(arena, sizeof(Gmr), &my_gmr))
+        goto arena_creation_failure;
     my_gmr->g.process_id = process_id;
-    my_gmr->g.gid = NULL;
-    if (!gip_create_gip(Number_of_gid_machines, &my_gmr->g.gip))
-        goto gip_creation_failure;
-    my_gmr->g.max_gid_index = Number_of_gid_machines - 1;
+    my_gmr->g.arena = arena;
+    if (!gip_create_gip(&my_gmr->g,
+                        Number_of_legacy_controls + number_of_multicasts))
+        goto arena_creation_failure;
+    my_gmr->g.max_gid_index = Number_of_legacy_controls + number_of_multicasts - 1;
     my_gmr->g.last_gid_used = Number_of_legacy_controls - 1;
+    if (!gid_create_application(&my_gmr->g))
+        goto arena_creation_failure;
     my_gmr->g.join_indication_fn = gmr_join_indication;
     my_gmr->g.leave_indication_fn = gmr_leave_indication;
     my_gmr->g.join_propagated_fn = gmr_join_propagated;
@@ -54,46 +232,515 @@ Boolean gmr_create_gmr(int process_id, unsigned vlan_id, void **gmr)
     my_gmr->g.added_port_fn = gmr_added_port;
     my_gmr->g.removed_port_fn = gmr_removed_port;
     my_gmr->vlan_id = vlan_id;
-    if (!gmd_create_gmd(Max_multicasts, &my_gmr->gmd))
-        goto gmd_creation_failure;
-    my_gmr->number_of_gmd_entries = Max_multicasts;
+    if (!gmd_create_gmd(number_of_multicasts, arena, &my_gmr->gmd))
+        goto arena_creation_failure;
+    my_gmr->number_of_gmd_entries = number_of_multicasts;
+    my_gmr->max_gmd_entries = max_multicasts;
     my_gmr->last_gmd_used_plus1 = 0;
+    if (!sysarena_malloc(arena, sizeof(Mac_address) * number_of_multicasts,
+                         &my_gmr->fdb_keys))
+        goto arena_creation_failure;
+    my_gmr->fdb_sets = NULL;
+    my_gmr->fdb_stamps = NULL;
+    my_gmr->fdb_stamp = 0;
+    my_gmr->fdb_entries = 0;
+    my_gmr->fdb_port_words = 0;
+    if (!gmr_fdb_resize(my_gmr, number_of_multicasts,
+                        my_gmr->g.gip_port_words))
+        goto arena_creation_failure;
+    my_gmr->fdb_collecting = False;
+    my_gmr->fdb_retry_running = False;
+    my_gmr->fdb_counts.requested = 0;
+    my_gmr->fdb_counts.coalesced = 0;
+    my_gmr->fdb_counts.suppressed = 0;
+    my_gmr->pdu_size = Gmf_standard_pdu_size;
+    if (!systime_register_process(process_id, &my_gmr->g))
+        goto arena_creation_failure;
     *gmr = my_gmr;
     return (True);
-gmd_creation_failure:
-    gip_destroy_gip(my_gmr->g.gip);
-gip_creation_failure:
-    sysfree(my_gmr);
+arena_creation_failure:
+    sysarena_destroy(arena);
 gmr_creation_failure:
     return (False);
 }
 void gmr_destroy_gmr(void *gmr)
-{
-    Gid *my_port;
+{ /*
+   * The ports are destroyed one by one, for the leave indications (and so
+   * the Filtering Database changes) that GID gives for their registrations,
+   * but the memory of the instance is then released with its arena, without
+   * freeing GID, GIP, GMD, and the control block piece by piece. Timers
+   * still armed for the instance are discarded when they expire.
+   */
     Gmr *my_gmr = (Gmr *)gmr;
-    gmd_destroy_gmd(my_gmr->gmd);
-    gip_destroy_gip(my_gmr->g.gip);
-    while ((my_port = my_gmr->g.gid) != NULL)
-        gid_destroy_port(&my_gmr->g, my_port->port_no);
+    int port_no;
+    systime_unregister_process(my_gmr->g.process_id);
+    for (port_no = 0; port_no < my_gmr->g.gid_table_size; port_no++)
+        gid_destroy_port(&my_gmr->g, port_no);
+    sysarena_destroy(my_gmr->g.arena);
 }
 void gmr_added_port(void *gmr, int port_no)
 { /*
    * Provide any management initialization of legacy control or multicast
    * attributes from templates here for the new port.
+   *
+   * The Filtering Database sets are grown with GIP's sets of registrants. If
+   * they cannot be, changes for ports beyond them are made as requested.
    */
   Gmr *my_gmr = (Gmr *)gmr;
+    if (my_gmr->g.gip_port_words > my_gmr->fdb_port_words)
+        (void)gmr_fdb_resize(my_gmr, my_gmr->fdb_entries,
+                             my_gmr->g.gip_port_words);
 }
 void gmr_removed_port(void *gmr, int port_no)
 { /*
    * Provide any GMR specific cleanup or management alert functions for the
    * removed port.
+   *
+   * The Filtering Database state last set for the port is forgotten, so
+   * that it is set again in full if the port is added again.
    */
   Gmr *my_gmr = (Gmr *)gmr;
+    unsigned gmd_index;
+    if ((unsigned)port_no < my_gmr->fdb_port_words * Bitword_bits)
+        for (gmd_index = 0; gmd_index < my_gmr->fdb_entries; gmd_index++)
+            sysbits_clear(gmr_fdb_set(my_gmr, Gmr_fdb_written, gmd_index),
+                          (unsigned)port_no);
+}
+/******************************************************************************
+ * GMR : GARP MULTICAST REGISTRATION APPLICATION : FILTERING DATABASE WRITES
+ ******************************************************************************
+ */
+static Boolean gmr_fdb_tracked(Gmr *my_gmr, int port_no, unsigned gmd_index)
+{
+    return ((Boolean)((port_no >= 0) &&
+                      ((unsigned)port_no <
+                       my_gmr->fdb_port_words * Bitword_bits) &&
+                      (gmd_index < my_gmr->fdb_entries)));
+}
+static Boolean gmr_fdb_needed(Gmr *my_gmr, int port_no, unsigned gmd_index,
+                              Fdb_action action)
+{ /*
+   * Returns False if the port was last set to action for the GMD entry's
+   * address.
+   */
+    if (!gmr_fdb_tracked(my_gmr, port_no, gmd_index))
+        return (True);
+    return ((Boolean)(
+        !sysbits_test(gmr_fdb_set(my_gmr, Gmr_fdb_written, gmd_index),
+                      (unsigned)port_no) ||
+        (sysbits_test(gmr_fdb_set(my_gmr, Gmr_fdb_forwarding, gmd_index),
+                      (unsigned)port_no) != (action == Fdb_forward))));
+}
+static void gmr_fdb_note_written(Gmr *my_gmr, int port_no,
+                                 unsigned gmd_index, Fdb_action action)
+{ /*
+   * Records that the port is now set to action for the GMD entry's address.
+   */
+    Bitword *forwarding;
+    if (!gmr_fdb_tracked(my_gmr, port_no, gmd_index))
+        return;
+    forwarding = gmr_fdb_set(my_gmr, Gmr_fdb_forwarding, gmd_index);
+    sysbits_set(gmr_fdb_set(my_gmr, Gmr_fdb_written, gmd_index),
+                (unsigned)port_no);
+    if (action == Fdb_forward)
+        sysbits_set(forwarding, (unsigned)port_no);
+    else
+        sysbits_clear(forwarding, (unsigned)port_no);
+}
+static Boolean gmr_fdb_pending_to(Gmr *my_gmr, unsigned port_no,
+                                  unsigned gmd_index, Fdb_action action)
+{ /*
+   * Returns True if a change to action is pending for the port and the GMD
+   * entry's address.
+   */
+    return ((Boolean)(
+        sysbits_test(gmr_fdb_set(my_gmr, Gmr_fdb_pending, gmd_index),
+                     port_no) &&
+        (sysbits_test(gmr_fdb_set(my_gmr, Gmr_fdb_pending_forwarding,
+                                  gmd_index),
+                      port_no) == (action == Fdb_forward))));
+}
+static Boolean gmr_fdb_pend(Gmr *my_gmr, int port_no, unsigned gmd_index,
+                            Fdb_action action)
+{ /*
+   * Records a change to action as pending for the port and the GMD entry's
+   * address, replacing any earlier pending change, and stamps the entry if
+   * none was pending. Returns False if the port or entry is beyond the sets
+   * (which could not be grown).
+   */
+    Bitword *pending;
+    Bitword *pending_forwarding;
+    if (!gmr_fdb_tracked(my_gmr, port_no, gmd_index))
+        return (False);
+    pending = gmr_fdb_set(my_gmr, Gmr_fdb_pending, gmd_index);
+    pending_forwarding = gmr_fdb_set(my_gmr, Gmr_fdb_pending_forwarding,
+                                     gmd_index);
+    if (!sysbits_test(gmr_fdb_pending_entries(my_gmr), gmd_index))
+        my_gmr->fdb_stamps[gmd_index] = my_gmr->fdb_stamp;
+    if (sysbits_test(pending, (unsigned)port_no))
+        my_gmr->fdb_counts.coalesced++;
+    sysbits_set(pending, (unsigned)port_no);
+    if (action == Fdb_forward)
+        sysbits_set(pending_forwarding, (unsigned)port_no);
+    else
+        sysbits_clear(pending_forwarding, (unsigned)port_no);
+    sysbits_set(gmr_fdb_pending_entries(my_gmr), gmd_index);
+    sysbits_set(gmr_fdb_ports(my_gmr, Gmr_fdb_ports_pending),
+                (unsigned)port_no);
+    return (True);
+}
+static Boolean gmr_fdb_held(Gmr *my_gmr, unsigned gmd_index,
+                            Boolean holding, unsigned stamp)
+{ /*
+   * Returns True if holding, and the pending changes for the GMD entry's
+   * address would create its Filtering Database entry, and were stamped at
+   * or after stamp.
+   */
+    unsigned port_no;
+    return ((Boolean)(holding &&
+                      ((int)(my_gmr->fdb_stamps[gmd_index] - stamp) >= 0) &&
+                      !sysbits_find_set(gmr_fdb_set(my_gmr, Gmr_fdb_written,
+                                                    gmd_index),
+                                        0,
+                                        my_gmr->fdb_port_words *
+                                                Bitword_bits - 1,
+                                        &port_no)));
+}
+static Boolean gmr_fdb_flush_port(Gmr *my_gmr, unsigned port_no,
+                                  Fdb_action action, Boolean holding,
+                                  unsigned stamp)
+{ /*
+   * Makes the port's pending changes to action that are needed, as one
+   * update - or as many of them as the queue has room for - except those
+   * held (see gmr_fdb_held()). Returns False if any are left pending for
+   * want of room.
+   *
+   * The entries whose keys are collected are noted as written once the
+   * update has been queued, by visiting the same entries again: those not
+   * needed, or whose keys are gone, were cleared on the first visit.
+   */
+    Bitword *pending_entries = gmr_fdb_pending_entries(my_gmr);
+    unsigned last_entry = my_gmr->fdb_entries - 1;
+    unsigned room = fdq_room();
+    unsigned number_of_keys = 0;
+    unsigned gmd_index;
+    unsigned i;
+    Boolean complete = True;
+    for (gmd_index = 0;
+         sysbits_find_set(pending_entries, gmd_index, last_entry, &gmd_index);
+         gmd_index++)
+    {
+        if (!gmr_fdb_pending_to(my_gmr, port_no, gmd_index, action) ||
+            gmr_fdb_held(my_gmr, gmd_index, holding, stamp))
+            continue;
+        if (!gmr_fdb_needed(my_gmr, (int)port_no, gmd_index, action))
+            my_gmr->fdb_counts.suppressed++;
+        else if (number_of_keys == room)
+        {
+            complete = False;
+            break;
+        }
+        else if (gmd_get_key(my_gmr->gmd, gmd_index,
+                             &my_gmr->fdb_keys[number_of_keys]))
+        {
+            number_of_keys++;
+            continue;
+        }
+        sysbits_clear(gmr_fdb_set(my_gmr, Gmr_fdb_pending, gmd_index),
+                      port_no);
+    }
+    if (number_of_keys == 0)
+        return (complete);
+    if (!fdq_update(my_gmr->vlan_id, (int)port_no, my_gmr->fdb_keys,
+                    number_of_keys, action, Fdb_default_unchanged))
+        return (False);
+    for (gmd_index = 0, i = 0;
+         (i < number_of_keys) &&
+         sysbits_find_set(pending_entries, gmd_index, last_entry, &gmd_index);
+         gmd_index++)
+    {
+        if (gmr_fdb_pending_to(my_gmr, port_no, gmd_index, action) &&
+            !gmr_fdb_held(my_gmr, gmd_index, holding, stamp))
+        {
+            gmr_fdb_note_written(my_gmr, (int)port_no, gmd_index, action);
+            sysbits_clear(gmr_fdb_set(my_gmr, Gmr_fdb_pending, gmd_index),
+                          port_no);
+            i++;
+        }
+    }
+    return (complete);
+}
+static Boolean gmr_fdb_legacy_changes(Gid *my_port, unsigned gmd_index,
+                                      Boolean unpropagated)
+{ /*
+   * Returns True if a change of the port's Legacy mode (see the sets above)
+   * sets the GMD entry's address.
+   */
+    unsigned gid_index = gmd_index + Number_of_legacy_controls;
+    return ((Boolean)(!gid_registered_here(my_port, gid_index) &&
+                      (!unpropagated ||
+                       !gip_propagates_to(my_port, gid_index))));
+}
+static Boolean gmr_fdb_legacy(Gmr *my_gmr, Gid *my_port,
+                              Boolean unpropagated, Fdb_action action)
+{ /*
+   * Makes a change of the port's Legacy mode: sets every address not
+   * registered on the port (only those not propagated to it, if
+   * unpropagated) to action, and the port's default to the same, as one
+   * update - or as many of the addresses as the queue has room for, leaving
+   * the default unchanged and returning False. The change can be made again
+   * until it is complete, since addresses already set are omitted.
+   *
+   * The entries whose keys are collected are noted as written once the
+   * update has been queued, by visiting the same entries again.
+   */
+    Mac_address key;
+    unsigned room = fdq_room();
+    unsigned number_of_keys = 0;
+    unsigned gmd_index;
+    unsigned i;
+    Boolean complete = True;
+    if (room == 0)
+        return (False);
+    for (gmd_index = 0; gmd_index < my_gmr->last_gmd_used_plus1; gmd_index++)
+    {
+        if (!gmr_fdb_legacy_changes(my_port, gmd_index, unpropagated))
+            continue;
+        my_gmr->fdb_counts.requested++;
+        if (!gmr_fdb_needed(my_gmr, my_port->port_no, gmd_index, action))
+            my_gmr->fdb_counts.suppressed++;
+        else if (number_of_keys == room)
+        {
+            complete = False;
+            break;
+        }
+        else if (gmd_get_key(my_gmr->gmd, gmd_index,
+                             &my_gmr->fdb_keys[number_of_keys]))
+            number_of_keys++;
+    }
+    if (!fdq_update(my_gmr->vlan_id, my_port->port_no, my_gmr->fdb_keys,
+                    number_of_keys, action,
+                    !complete ? Fdb_default_unchanged
+                    : (action == Fdb_forward) ? Fdb_default_forward
+                                              : Fdb_default_filter))
+        return (False);
+    for (gmd_index = 0, i = 0; i < number_of_keys; gmd_index++)
+    {
+        if (gmr_fdb_legacy_changes(my_port, gmd_index, unpropagated) &&
+            gmr_fdb_needed(my_gmr, my_port->port_no, gmd_index, action) &&
+            gmd_get_key(my_gmr->gmd, gmd_index, &key))
+        {
+            gmr_fdb_note_written(my_gmr, my_port->port_no, gmd_index, action);
+            i++;
+        }
+    }
+    return (complete);
+}
+static Boolean gmr_fdb_flush(Gmr *my_gmr)
+{ /*
+   * Makes the pending changes that are needed, as one update for each port
+   * and action, and clears them, and the pending changes of Legacy mode.
+   * Changes for different addresses are independent, so the order in which
+   * they are made does not matter, except that changes of Legacy mode are
+   * made in the order of their stamps with the changes that create entries
+   * (see the sets above): before each change of Legacy mode, the oldest
+   * first, the changes for single addresses are made, holding those that
+   * create entries and were stamped at or after it.
+   *
+   * If the Filtering Database queue has no room for some of the changes,
+   * they are left pending, False is returned, and the retry timer started.
+   */
+    Bitword *pending_ports = gmr_fdb_ports(my_gmr, Gmr_fdb_ports_pending);
+    Bitword *legacy_all = gmr_fdb_ports(my_gmr, Gmr_fdb_ports_legacy_all);
+    Bitword *legacy_unpropagated =
+        gmr_fdb_ports(my_gmr, Gmr_fdb_ports_legacy_unpropagated);
+    unsigned *port_stamps = &my_gmr->fdb_stamps[my_gmr->fdb_entries];
+    unsigned last_port = my_gmr->fdb_port_words * Bitword_bits - 1;
+    unsigned port_no;
+    unsigned legacy_port_no = 0;
+    unsigned stamp = 0;
+    Boolean holding;
+    Gid *my_port;
+    do
+    {
+        holding = False;
+        for (port_no = 0;
+             sysbits_find_either(legacy_all, legacy_unpropagated, port_no,
+                                 last_port, &port_no);
+             port_no++)
+        {
+            if (!holding || ((int)(port_stamps[port_no] - stamp) < 0))
+            {
+                holding = True;
+                stamp = port_stamps[port_no];
+                legacy_port_no = port_no;
+            }
+        }
+        for (port_no = 0;
+             sysbits_find_set(pending_ports, port_no, last_port, &port_no);
+             port_no++)
+        {
+            if ((!gmr_fdb_flush_port(my_gmr, port_no, Fdb_filter, holding,
+                                     stamp)) ||
+                (!gmr_fdb_flush_port(my_gmr, port_no, Fdb_forward, holding,
+                                     stamp)))
+                goto flush_incomplete;
+            if (!holding)
+                sysbits_clear(pending_ports, port_no);
+        }
+        if (holding)
+        {
+            if (gid_find_port(&my_gmr->g, (int)legacy_port_no,
+                              (void **)&my_port))
+            {
+                if (sysbits_test(legacy_all, legacy_port_no) &&
+                    !gmr_fdb_legacy(
+                        my_gmr, my_port, False,
+                        sysbits_test(gmr_fdb_ports(my_gmr,
+                                         Gmr_fdb_ports_legacy_forwarding),
+                                     legacy_port_no)
+                            ? Fdb_forward
+                            : Fdb_filter))
+                    goto flush_incomplete;
+                if (sysbits_test(legacy_unpropagated, legacy_port_no) &&
+                    !gmr_fdb_legacy(my_gmr, my_port, True, Fdb_forward))
+                    goto flush_incomplete;
+            }
+            sysbits_clear(legacy_all, legacy_port_no);
+            sysbits_clear(legacy_unpropagated, legacy_port_no);
+        }
+    } while (holding);
+    sysbits_zero(gmr_fdb_pending_entries(my_gmr), my_gmr->fdb_entries);
+    return (True);
+flush_incomplete:
+    if (!my_gmr->fdb_retry_running)
+    {
+        my_gmr->fdb_retry_running = True;
+        systime_start_timer(my_gmr->g.process_id,
+                            gmr_fdb_retry_timer_expired, 0,
+                            Gmr_fdb_retry_time);
+    }
+    return (False);
+}
+void gmr_fdb_retry_timer_expired(void *gmr, int instance_id)
+{
+    Gmr *my_gmr = (Gmr *)gmr;
+    (void)instance_id;
+    my_gmr->fdb_retry_running = False;
+    if (!my_gmr->fdb_collecting)
+        (void)gmr_fdb_flush(my_gmr);
+}
+static void gmr_fdb_request(Gmr *my_gmr, int port_no, unsigned gmd_index,
+                            Fdb_action action)
+{ /*
+   * Records a change to filter or forward the GMD entry's address on the
+   * port as pending, replacing any earlier pending change. A change for a
+   * port or entry beyond the sets is made at once.
+   */
+    Mac_address key;
+    my_gmr->fdb_counts.requested++;
+    if ((!gmr_fdb_pend(my_gmr, port_no, gmd_index, action)) &&
+        gmd_get_key(my_gmr->gmd, gmd_index, &key))
+        (void)fdq_update(my_gmr->vlan_id, port_no, &key, 1, action,
+                         Fdb_default_unchanged);
+}
+static void gmr_fdb_write(Gmr *my_gmr, int port_no, unsigned gmd_index,
+                          Fdb_action action)
+{ /*
+   * Filters or forwards the GMD entry's address on the port: unless a PDU
+   * is being processed, at once if it is needed and the queue has room.
+   */
+    gmr_fdb_request(my_gmr, port_no, gmd_index, action);
+    if (!my_gmr->fdb_collecting)
+        (void)gmr_fdb_flush(my_gmr);
+}
+static void gmr_fdb_change_mode(Gmr *my_gmr, Gid *my_port,
+                                Boolean unpropagated, Fdb_action action)
+{ /*
+   * Records a change of the port's Legacy mode (see gmr_fdb_legacy()) as
+   * pending - a change of every address replacing any earlier change still
+   * pending - stamped after any earlier one, and unless a PDU is being
+   * processed, makes it. The change is made at once for a port beyond the
+   * sets.
+   */
+    unsigned port_no = (unsigned)my_port->port_no;
+    if (!gmr_fdb_tracked(my_gmr, my_port->port_no, 0))
+    {
+        (void)gmr_fdb_legacy(my_gmr, my_port, unpropagated, action);
+        return;
+    }
+    my_gmr->fdb_stamps[my_gmr->fdb_entries + port_no] = ++my_gmr->fdb_stamp;
+    if (unpropagated)
+        sysbits_set(gmr_fdb_ports(my_gmr, Gmr_fdb_ports_legacy_unpropagated),
+                    port_no);
+    else
+    {
+        sysbits_set(gmr_fdb_ports(my_gmr, Gmr_fdb_ports_legacy_all), port_no);
+        if (action == Fdb_forward)
+            sysbits_set(gmr_fdb_ports(my_gmr,
+                                      Gmr_fdb_ports_legacy_forwarding),
+                        port_no);
+        else
+            sysbits_clear(gmr_fdb_ports(my_gmr,
+                                        Gmr_fdb_ports_legacy_forwarding),
+                          port_no);
+        sysbits_clear(gmr_fdb_ports(my_gmr,
+                                    Gmr_fdb_ports_legacy_unpropagated),
+                      port_no);
+    }
+    if (!my_gmr->fdb_collecting)
+        (void)gmr_fdb_flush(my_gmr);
+}
+static Boolean gmr_fdb_forget(Gmr *my_gmr, unsigned gmd_index)
+{ /*
+   * Removes the Filtering Database entry for the address of a GMD entry
+   * about to be reused for another address, and forgets the state set for
+   * it and any changes for it still pending, which would otherwise be made
+   * for the new address. Returns False, changing nothing, if the queue has
+   * no room for the removal.
+   *
+   * The GMD entry is unused on every port, so the address is forwarded or
+   * filtered on each as unregistered addresses are, which is what the
+   * port's default gives once the entry is removed.
+   */
+    Mac_address key;
+    if (gmd_get_key(my_gmr->gmd, gmd_index, &key) &&
+        !fdq_remove(my_gmr->vlan_id, key))
+        return (False);
+    if (gmd_index < my_gmr->fdb_entries)
+    {
+        sysbits_zero(gmr_fdb_set(my_gmr, Gmr_fdb_written, gmd_index),
+                     my_gmr->fdb_port_words * Bitword_bits);
+        sysbits_zero(gmr_fdb_set(my_gmr, Gmr_fdb_pending, gmd_index),
+                     my_gmr->fdb_port_words * Bitword_bits);
+        sysbits_clear(gmr_fdb_pending_entries(my_gmr), gmd_index);
+    }
+    return (True);
+}
+void gmr_read_fdb_counts(void *gmr, Gmr_fdb_counts *counts)
+{
+    Gmr *my_gmr = (Gmr *)gmr;
+    *counts = my_gmr->fdb_counts;
 }
 /******************************************************************************
  * GMR : GARP MULTICAST REGISTRATION APPLICATION : JOIN, LEAVE INDICATIONS
  ******************************************************************************
  */
+static Boolean gmr_is_control(unsigned gid_index, Legacy_control control)
+{ /*
+   * Returns True if gid_index is that of the Legacy control. Only the
+   * controls below Number_of_legacy_controls have GID machines: the GID
+   * index of any other is that of a multicast address.
+   */
+    return ((Boolean)(((unsigned)control <
+                       (unsigned)Number_of_legacy_controls) &&
+                      (gid_index == (unsigned)control)));
+}
+static Boolean gmr_control_registered(Gid *my_port, Legacy_control control)
+{
+    return ((Boolean)(gmr_is_control((unsigned)control, control) &&
+                      gid_registered_here(my_port, (unsigned)control)));
+}
 void gmr_join_indication(void *gmr, Gid *my_port, unsigned joining_gid_index)
 { /*
    * This implementation of gmr_join_indication() respects the three cases
@@ -103,43 +750,32 @@ void gmr_join_indication(void *gmr, Gid *my_port, unsigned joining_gid_index)
    * calls to the Filtering Database when one Legacy mode transitions to
    * another.
    *
+   * A change of Legacy mode is recorded for the port, and made once any
+   * pending changes for single addresses have been (see gmr_fdb_flush()).
+   *
+   * The indication is given once the Registrar is in, so Forward All is
+   * registered here when it is the attribute joining. A multicast address
+   * is forwarded in Forward All too, so that it has an entry forwarding on
+   * the port when Forward All is left: the change of mode leaves registered
+   * addresses alone, and the port's default, then filtering, would not
+   * forward them. The write is suppressed if the entry already forwards.
    */
     unsigned gmd_index;
-    unsigned gid_index;
-    Mac_address key;
     Gmr *my_gmr = (Gmr *)gmr;
-    if (!gid_registered_here(my_port, Forward_all))
+    if ((joining_gid_index == Forward_all) ||
+        gmr_is_control(joining_gid_index, Forward_unregistered))
+    { /* Forward_unregistered: only those not propagated */
+        if ((joining_gid_index == Forward_all) ||
+            (!gid_registered_here(my_port, Forward_all)))
+            gmr_fdb_change_mode(my_gmr, my_port,
+                                gmr_is_control(joining_gid_index,
+                                               Forward_unregistered),
+                                Fdb_forward);
+    }
+    else /* Multicast Attribute */
     {
-        if ((joining_gid_index == Forward_all) || (joining_gid_index == Forward_unregistered))
-        {
-            gmd_index = 0;
-            gid_index = gmd_index + Number_of_legacy_controls;
-            while (gmd_index < my_gmr->last_gmd_used_plus1)
-            {
-                if (!gid_registered_here(my_port, gid_index))
-                {
-                    if (joining_gid_index == Forward_all)
-                    {
-                        gmd_get_key(my_gmr->gmd, gmd_index, &key);
-                        fdb_forward(my_gmr->vlan_id, my_port->port_no, key);
-                    }
-                    else if (!gip_propagates_to(my_port, gid_index))
-                    { /*(joining_gid_index == Forward_unregistered) */
-                        gmd_get_key(my_gmr->gmd, gmd_index, &key);
-                        fdb_forward(my_gmr->vlan_id, my_port->port_no, key);
-                    }
-                }
-                gmd_index++;
-                gid_index++;
-            }
-            fdb_forward_by_default(my_gmr->vlan_id, my_port->port_no);
-        }
-        else /* Multicast Attribute */
-        {
-            gmd_index = joining_gid_index - Number_of_legacy_controls;
-            gmd_get_key(my_gmr->gmd, gmd_index, &key);
-            fdb_forward(my_gmr->vlan_id, my_port->port_no, key);
-        }
+        gmd_index = joining_gid_index - Number_of_legacy_controls;
+        gmr_fdb_write(my_gmr, my_port->port_no, gmd_index, Fdb_forward);
     }
 }
 void gmr_join_propagated(void *gmr, Gid *my_port, unsigned joining_gid_index)
@@ -147,15 +783,13 @@ void gmr_join_propagated(void *gmr, Gid *my_port, unsigned joining_gid_index)
    *
    */
     unsigned gmd_index;
-    Mac_address key;
     Gmr *my_gmr = (Gmr *)gmr;
     if (joining_gid_index >= Number_of_legacy_controls)
     { /* Multicast attribute */
-        if ((!gid_registered_here(my_port, Forward_all)) && (gid_registered_here(my_port, Forward_unregistered)) && (!gid_registered_here(my_port, joining_gid_index)))
+        if ((!gid_registered_here(my_port, Forward_all)) && (gmr_control_registered(my_port, Forward_unregistered)) && (!gid_registered_here(my_port, joining_gid_index)))
         {
             gmd_index = joining_gid_index - Number_of_legacy_controls;
-            gmd_get_key(my_gmr->gmd, gmd_index, &key);
-            fdb_filter(my_gmr->vlan_id, my_port->port_no, key);
+            gmr_fdb_write(my_gmr, my_port->port_no, gmd_index, Fdb_filter);
         }
     }
 }
@@ -168,36 +802,37 @@ void gmr_leave_indication(void *gmr, Gid *my_port, unsigned leaving_gid_index)
     unsigned gid_index;
     Boolean mode_a;
     Boolean mode_c;
-    Mac_address key;
     mode_a = gid_registered_here(my_port, Forward_all);
-    mode_c = !gid_registered_here(my_port, Forward_unregistered);
-    if ((leaving_gid_index == Forward_all) || ((!mode_a) && (leaving_gid_index == Forward_unregistered)))
+    mode_c = !gmr_control_registered(my_port, Forward_unregistered);
+    if ((leaving_gid_index == Forward_all) ||
+        ((!mode_a) &&
+         gmr_is_control(leaving_gid_index, Forward_unregistered)))
     {
-        gmd_index = 0;
-        gid_index = gmd_index + Number_of_legacy_controls;
-        while (gmd_index < my_gmr->last_gmd_used_plus1)
-        {
-            if (!gid_registered_here(my_port, gid_index))
+        if (mode_c)
+            gmr_fdb_change_mode(my_gmr, my_port, False, Fdb_filter);
+        else
+        { /* Mode B: filter those propagated, default unchanged */
+            gmd_index = 0;
+            gid_index = gmd_index + Number_of_legacy_controls;
+            while (gmd_index < my_gmr->last_gmd_used_plus1)
             {
-                if (mode_c || gip_propagates_to(my_port, gid_index))
-                {
-                    gmd_get_key(my_gmr->gmd, gmd_index, &key);
-                    fdb_filter(my_gmr->vlan_id, my_port->port_no, key);
-                }
+                if ((!gid_registered_here(my_port, gid_index)) &&
+                    gip_propagates_to(my_port, gid_index))
+                    gmr_fdb_request(my_gmr, my_port->port_no, gmd_index,
+                                    Fdb_filter);
+                gmd_index++;
+                gid_index++;
             }
-            gmd_index++;
-            gid_index++;
+            if (!my_gmr->fdb_collecting)
+                (void)gmr_fdb_flush(my_gmr);
         }
-        if (mode_c)
-            fdb_filter_by_default(my_gmr->vlan_id, my_port->port_no);
     }
     else if (!mode_a)
     {
-        if (mode_c || gip_propagates_to(my_port, gid_index))
+        if (mode_c || gip_propagates_to(my_port, leaving_gid_index))
         { /* Multicast Attribute */
             gmd_index = leaving_gid_index - Number_of_legacy_controls;
-            gmd_get_key(my_gmr->gmd, gmd_index, &key);
-            fdb_filter(my_gmr->vlan_id, my_port->port_no, key);
+            gmr_fdb_write(my_gmr, my_port->port_no, gmd_index, Fdb_filter);
         }
     }
 }
@@ -206,15 +841,13 @@ void gmr_leave_propagated(void *gmr, Gid *my_port, unsigned leaving_gid_index)
    *
    */
     unsigned gmd_index;
-    Mac_address key;
     Gmr *my_gmr = (Gmr *)gmr;
     if (leaving_gid_index >= Number_of_legacy_controls)
     { /* Multicast attribute */
-        if ((!gid_registered_here(my_port, Forward_all)) && (gid_registered_here(my_port, Forward_unregistered)) && (!gid_registered_here(my_port, leaving_gid_index)))
+        if ((!gid_registered_here(my_port, Forward_all)) && (gmr_control_registered(my_port, Forward_unregistered)) && (!gid_registered_here(my_port, leaving_gid_index)))
         {
             gmd_index = leaving_gid_index - Number_of_legacy_controls;
-            gmd_get_key(my_gmr->gmd, gmd_index, &key);
-            fdb_forward(my_gmr->vlan_id, my_port->port_no, key);
+            gmr_fdb_write(my_gmr, my_port->port_no, gmd_index, Fdb_forward);
         }
     }
 }
@@ -222,6 +855,49 @@ void gmr_leave_propagated(void *gmr, Gid *my_port, unsigned leaving_gid_index)
  * GMR : GARP MULTICAST REGISTRATION APPLICATION : RECEIVE MESSAGE PROCESSING
  ******************************************************************************
  */
+static Boolean gmr_db_grow(Gmr *my_gmr)
+{ /*
+   * Doubles the number of GMD entries, up to the maximum set at creation,
+   * growing the GIP sets of registrants and the GID machines for every port
+   * first so that GMD never holds an entry without a GID machine, and the
+   * Filtering Database sets, and replacing the buffer of keys for Filtering
+   * Database updates (which can hold every GMD entry). If any step fails, the database is left at its
+   * current size (GIP and GID may have been grown, which is harmless, and
+   * are simply reused next time).
+   */
+    unsigned new_gmd_entries;
+    unsigned new_max_gid_index;
+    Mac_address *new_fdb_keys;
+    if (my_gmr->number_of_gmd_entries >= my_gmr->max_gmd_entries)
+        return (False);
+    new_gmd_entries = 2 * my_gmr->number_of_gmd_entries;
+    if (new_gmd_entries > my_gmr->max_gmd_entries)
+        new_gmd_entries = my_gmr->max_gmd_entries;
+    new_max_gid_index = Number_of_legacy_controls + new_gmd_entries - 1;
+    if (new_max_gid_index > my_gmr->g.max_gid_index)
+    {
+        if (!gip_resize_gip(&my_gmr->g, new_max_gid_index + 1,
+                            my_gmr->g.gip_port_words))
+            return (False);
+        if (!gid_resize_ports(&my_gmr->g, new_max_gid_index))
+            return (False);
+    }
+    if ((new_gmd_entries > my_gmr->fdb_entries) &&
+        (!gmr_fdb_resize(my_gmr, new_gmd_entries, my_gmr->g.gip_port_words)))
+        return (False);
+    if (!sysarena_malloc(my_gmr->g.arena,
+                         sizeof(Mac_address) * new_gmd_entries, &new_fdb_keys))
+        return (False);
+    if (!gmd_resize_gmd(my_gmr->gmd, new_gmd_entries))
+    {
+        sysarena_free(my_gmr->g.arena, new_fdb_keys);
+        return (False);
+    }
+    sysarena_free(my_gmr->g.arena, my_gmr->fdb_keys);
+    my_gmr->fdb_keys = new_fdb_keys;
+    my_gmr->number_of_gmd_entries = new_gmd_entries;
+    return (True);
+}
 static void gmr_db_full(void *gmr, Gid *my_port)
 { /*
    * If it is desirable to be able to operate correctly with an undersized
@@ -235,9 +911,14 @@ static void gmr_db_full(void *gmr, Gid *my_port)
    */
   Gmr *my_gmr = (Gmr *)gmr;
 }
-static void gmr_rcv_msg(void *gmr, Gid *my_port, Gmf_msg *msg)
+static Boolean gmr_rcv_msg(void *gmr, Gid *my_port, Gmf_msg *msg,
+                           unsigned gmd_index)
 { /*
-   * Process one received message.
+   * Process one received message. The caller has already looked up the key
+   * of a multicast attribute in GMD, supplying its gmd_index, or Unused_index
+   * if no entry was found (or the message has no key). Returns True if GMD
+   * entries were created or deleted, which makes any other lookups done by
+   * the caller for this batch of messages out of date.
    *
    * Dispatch messages by message event, and by attribute type (legacy mode
    * control, or multicast address) except in the case of the LeaveAll
@@ -251,17 +932,19 @@ static void gmr_rcv_msg(void *gmr, Gid *my_port, Gmf_msg *msg)
    * (i.e., the range is ignored).
    *
    * All the remaining messages refer to a single attribute (i.e., a single
-   * registered group address). Try to find a matching entry in the MCD
-   * database. If one is found, dispatch the message to a routine that will
+   * registered group address). If a matching entry was found in the MCD
+   * database, dispatch the message to a routine that will
    * handle both the local GID effects and the GIP propagation to other ports.
    *
    * If no entry is found, Leave and Empty messages can be discarded, but
    * JoinIn and JoinEmpty messages demand further treatment. First, an attempt
    * is made to create a new entry using free space (in the database, which
-   * corresponds to a free GID machine set). If this fails, an attempt may be
+   * corresponds to a free GID machine set), growing the database if it is
+   * full and not yet at its maximum size. If this fails, an attempt may be
    * made to recover space from a machine set that is in an unused or less
-   * significant state. Finally, the database is considered full and the received
-   * message is discarded.
+   * significant state, provided the Filtering Database entry for its old
+   * address can be queued for removal. Finally, the database is considered
+   * full and the received message is discarded.
    *
    * Once (if) an entry is found, Leave, Empty, JoinIn, and JoinEmpty are
    * all submitted to GID (gid_rcv_msg()).
@@ -276,8 +959,8 @@ static void gmr_rcv_msg(void *gmr, Gid *my_port, Gmf_msg *msg)
    *
    */
   Gmr *my_gmr = (Gmr *)gmr;
-    unsigned gmd_index = Unused_index;
     unsigned gid_index = Unused_index;
+    Boolean gmd_changed = False;
     if ((msg->event == Gid_rcv_leaveall) || (msg->event == Gid_rcv_leaveall_range))
     {
         gid_rcv_leaveall(my_port);
@@ -285,17 +968,25 @@ static void gmr_rcv_msg(void *gmr, Gid *my_port, Gmf_msg *msg)
     else
     {
         if (msg->attribute == Legacy_attribute)
-        {
-            gid_index = msg->legacy_control;
+        { /* only the legacy controls with GID machines */
+            if ((unsigned)msg->legacy_control <
+                (unsigned)Number_of_legacy_controls)
+                gid_index = msg->legacy_control;
         }
-        else if (!gmd_find_entry(my_gmr->gmd, msg->key1, &gmd_index))
+        else if (gmd_index == Unused_index)
         { /* && (msg->attribute == Multicast_attribute) */
             if ((msg->event == Gid_rcv_joinin) || (msg->event == Gid_rcv_joinempty))
             {
-                if (!gmd_create_entry(my_gmr->gmd, msg->key1, &gmd_index))
+                gmd_changed = True;
+                if ((!gmd_create_entry(my_gmr->gmd, msg->key1, &gmd_index)) &&
+                    ((!gmr_db_grow(my_gmr)) ||
+                     (!gmd_create_entry(my_gmr->gmd, msg->key1, &gmd_index))))
                 {
                     if (gid_find_unused(&my_gmr->g,
-                                        Number_of_legacy_controls, &gid_index))
+                                        Number_of_legacy_controls,
+                                        &gid_index) &&
+                        gmr_fdb_forget(my_gmr, gid_index -
+                                                   Number_of_legacy_controls))
                     {
                         gmd_index = gid_index - Number_of_legacy_controls;
                         gmd_delete_entry(my_gmr->gmd, gmd_index);
@@ -303,28 +994,95 @@ static void gmr_rcv_msg(void *gmr, Gid *my_port, Gmf_msg *msg)
                                                &gmd_index);
                     }
                     else
+                    {
+                        gid_index = Unused_index;
                         gmr_db_full(my_gmr, my_port);
+                    }
                 }
             }
         }
         if (gmd_index != Unused_index)
+        {
             gid_index = gmd_index + Number_of_legacy_controls;
+            if (gmd_index >= my_gmr->last_gmd_used_plus1)
+            {
+                my_gmr->last_gmd_used_plus1 = gmd_index + 1;
+                my_gmr->g.last_gid_used = gid_index;
+            }
+        }
         if (gid_index != Unused_index)
             gid_rcv_msg(my_port, gid_index, msg->event);
     }
+    return (gmd_changed);
+}
+static Boolean gmr_msg_has_key(Gmf_msg *msg)
+{
+    return ((msg->attribute == Multicast_attribute) &&
+            (msg->event != Gid_rcv_leaveall) &&
+            (msg->event != Gid_rcv_leaveall_range));
 }
 void gmr_rcv(void *gmr, Gid *my_port, Pdu *pdu)
 { /*
    * Process an entire received pdu for this instance of GMR: initialize
-   * the Gmf pdu parsing routine, and, while messages last, read and process
-   * them one at a time.
+   * the Gmf pdu parsing routine, and, while messages last, read a batch of
+   * them, look up all the multicast keys in the batch with a single call
+   * to GMD, then process the messages one at a time in their original order.
+   *
+   * Once processing a message has created or deleted GMD entries, the
+   * remaining batch lookups may be out of date (a later message may carry
+   * the same key, or refer to an entry that was reclaimed), so the keys of
+   * the rest of the batch are looked up again individually.
+   *
+   * Changes to the Filtering Database for single addresses are collected
+   * while the pdu is processed, and made once it has been (see gmr.h).
    */
     Gmf gmf;
-    Gmf_msg msg;
+    Gmf_msg msgs[Gmr_rcv_batch];
+    Mac_address keys[Gmr_rcv_batch];
+    unsigned found_at[Gmr_rcv_batch];
+    unsigned number_of_msgs;
+    unsigned number_of_keys;
+    unsigned i;
+    unsigned k;
+    unsigned gmd_index;
+    Boolean gmd_changed;
     Gmr *my_gmr = (Gmr *)gmr;
+    my_gmr->fdb_collecting = True;
     gmf_rdmsg_init(&gmf, pdu);
-    while (gmf_rdmsg(&gmf, &msg))
-        gmr_rcv_msg(my_gmr, my_port, &msg);
+    do
+    {
+        number_of_msgs = 0;
+        number_of_keys = 0;
+        while ((number_of_msgs < Gmr_rcv_batch) &&
+               (gmf_rdmsg(&gmf, &msgs[number_of_msgs])))
+        {
+            if (gmr_msg_has_key(&msgs[number_of_msgs]))
+                keys[number_of_keys++] = msgs[number_of_msgs].key1;
+            number_of_msgs++;
+        }
+        if (number_of_keys > 0)
+            (void)gmd_find_entries(my_gmr->gmd, keys, number_of_keys, found_at);
+        gmd_changed = False;
+        for (i = 0, k = 0; i < number_of_msgs; i++)
+        {
+            gmd_index = Unused_index;
+            if (gmr_msg_has_key(&msgs[i]))
+            {
+                if (gmd_changed)
+                {
+                    if (!gmd_find_entry(my_gmr->gmd, msgs[i].key1, &gmd_index))
+                        gmd_index = Unused_index;
+                }
+                else if (found_at[k] != Gmd_not_found)
+                    gmd_index = found_at[k];
+                k++;
+            }
+            if (gmr_rcv_msg(my_gmr, my_port, &msgs[i], gmd_index))
+                gmd_changed = True;
+        }
+    } while (number_of_msgs == Gmr_rcv_batch);
+    (void)gmr_fdb_flush(my_gmr);
+    my_gmr->fdb_collecting = False;
 }
 /******************************************************************************
  * GMR : GARP MULTICAST REGISTRATION APPLICATION : TRANSMIT PROCESSING
@@ -357,7 +1115,16 @@ void gmr_tx(void *gmr, Gid *my_port)
    * to this function.
    *
    * Get messages to transmit from GID and pack them into the pdu using Gmf
-   * (MultiCast pdu Formatter).
+   * (MultiCast pdu Formatter). No pdu is allocated unless GID has a first
+   * message, which is taken back with gid_untx() if no pdu is available (or
+   * it has no room) - unless it is a LeaveAll, which GID cannot take back
+   * (its timer is already running again), and which is then not sent this
+   * time, as before. Further messages are only requested from GID while Gmf
+   * is sure that they will fit, so none of them is ever taken back.
+   *
+   * While the Filtering Database queue is congested nothing is transmitted:
+   * the messages remain pending, and are sent once the join timer, restarted
+   * at hold timer expiry, expires with the queue drained.
    */
     Pdu *pdu;
     Gmf gmf;
@@ -365,22 +1132,38 @@ void gmr_tx(void *gmr, Gid *my_port)
     Gid_event tx_event;
     unsigned gid_index;
     Gmr *my_gmr = (Gmr *)gmr;
-    if ((tx_event = gid_next_tx(my_port, &gid_index)) != Gid_null)
+    if (fdq_congested())
+        return;
+    if ((tx_event = gid_next_tx(my_port, &gid_index)) == Gid_null)
+        return;
+    if (!syspdu_alloc(&pdu))
+        goto tx_pdu_failure;
+    gmf_wrmsg_init(&gmf, pdu, my_gmr->vlan_id, my_gmr->pdu_size);
+    if (!gmf_wrmsg_room(&gmf))
+        goto tx_room_failure;
+    do
     {
-        if (syspdu_alloc(&pdu))
-        {
-            gmf_wrmsg_init(&gmf, pdu, my_gmr->vlan_id);
-            do
-            {
-                msg.event = tx_event;
-                gmr_tx_msg(my_gmr, gid_index, &msg);
-                if (!gmf_wrmsg(&gmf, &msg))
-                {
-                    gid_untx(my_port);
-                    break;
-                }
-            } while ((tx_event = gid_next_tx(my_port, &gid_index)) != Gid_null);
-            syspdu_tx(pdu, my_port->port_no);
-        }
-    }
-}
\ No newline at end of file
+        msg.event = tx_event;
+        gmr_tx_msg(my_gmr, gid_index, &msg);
+        (void)gmf_wrmsg(&gmf, &msg);
+    } while (gmf_wrmsg_room(&gmf) &&
+             ((tx_event = gid_next_tx(my_port, &gid_index)) != Gid_null));
+    if (gmf_wrmsg_done(&gmf))
+        syspdu_tx(pdu, my_port->port_no);
+    else
+        syspdu_free(pdu);
+    return;
+tx_room_failure:
+    syspdu_free(pdu);
+tx_pdu_failure:
+    if (tx_event != Gid_tx_leaveall)
+        gid_untx(my_port);
+}
+Boolean gmr_set_pdu_size(void *gmr, unsigned pdu_size)
+{
+    Gmr *my_gmr = (Gmr *)gmr;
+    if (pdu_size < Gmf_min_pdu_size)
+        return (False);
+    my_gmr->pdu_size = pdu_size;
+    return (True);
+}
@@ -1,21 +1,74 @@
+/* prw.c */
 #include "sys.h"
+#include "prw.h"
 /******************************************************************************
  * PRW : PDU READ WRITE ACCESS
  ******************************************************************************
  */
-typedef struct
-{
-    Pdu *pdu;
-    int record_id;
-    int record_len;
-} Gpdu;
-void prw_rdrec_init(Pdu *pdu, Gpdu *gpdu){
-    return;
+static Octet *prw_check_records(Octet *records, Octet *end)
+{ /*
+   * Returns the End Mark of the PDU whose records start at records (or end
+   * if the records run to the end of the PDU), or NULL if an attribute
+   * length is less than the length and event octets, or an attribute or
+   * the End Mark of a record lies beyond the end.
+   */
+    Octet *next = records;
+    while ((next < end) && (*next != Garp_terminating_record_id))
+    {
+        next++;
+        for (;;)
+        {
+            if (next >= end)
+                return (NULL);
+            if (*next == 0)
+                break;
+            if ((*next < 2) || (*next > end - next))
+                return (NULL);
+            next += *next;
+        }
+        next++;
+    }
+    return (next);
 }
-Boolean prw_rdrec(Gpdu gpdu){
-    return False;
+void prw_rdrec_init(Pdu *pdu, Gpdu *gpdu)
+{
+    Octet *octets;
+    int number_of_octets;
+    octets = syspdu_octets(pdu, &number_of_octets);
+    gpdu->pdu = pdu;
+    gpdu->next = NULL;
+    gpdu->end = NULL;
+    gpdu->end_of_records = NULL;
+    gpdu->record_id = Garp_terminating_record_id;
+    gpdu->record_len = 0;
+    if ((octets == NULL) || (number_of_octets < 2) ||
+        (((octets[0] << 8) | octets[1]) != Garp_protocol_id))
+        return;
+    gpdu->end_of_records = prw_check_records(octets + 2,
+                                             octets + number_of_octets);
+    if (gpdu->end_of_records != NULL)
+        gpdu->next = gpdu->end = octets + 2;
 }
-Boolean prw_skiprec(Gpdu gpdu){
-    return False;
+Boolean prw_rdrec(Gpdu *gpdu)
+{ /*
+   * The PDU has been checked, so the end of the record can be found by
+   * stepping through its attributes by their lengths alone.
+   */
+    Octet *next;
+    if (gpdu->record_id != Garp_terminating_record_id)
+        gpdu->next = gpdu->end + 1;
+    if ((gpdu->next == gpdu->end_of_records) ||
+        (*gpdu->next == Garp_terminating_record_id))
+    {
+        gpdu->record_id = Garp_terminating_record_id;
+        gpdu->next = gpdu->end = gpdu->end_of_records;
+        return (False);
+    }
+    gpdu->record_id = *gpdu->next++;
+    next = gpdu->next;
+    while (*next != 0)
+        next += *next;
+    gpdu->end = next;
+    gpdu->record_len = (int)(next - gpdu->next);
+    return (True);
 }
-#define Garp_terminating_record_id 0x0000
\ No newline at end of file
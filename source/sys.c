@@ -1,73 +1,1094 @@
 /*sys.c*/
 #include "sys.h"
+#include <stdlib.h>
+#include <time.h>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+/******************************************************************************
+ * SYSBITS : BIT SETS
+ ******************************************************************************
+ */
+void sysbits_zero(Bitword *bits, unsigned number_of_bits)
+{
+    unsigned w;
+    for (w = 0; w < sysbits_words(number_of_bits); w++)
+        bits[w] = 0;
+}
+void sysbits_copy(Bitword *to, Bitword *from, unsigned number_of_bits)
+{
+    unsigned w;
+    for (w = 0; w < sysbits_words(number_of_bits); w++)
+        to[w] = from[w];
+}
+Boolean sysbits_find_set(Bitword *bits, unsigned from, unsigned to,
+                         unsigned *found)
+{ /*
+   * Scans a word at a time, masking off the bits below from in the first
+   * word; a set bit found beyond to is outside the range.
+   */
+    unsigned w;
+    unsigned last_w;
+    Bitword word;
+    if (from > to)
+        return (False);
+    w = from / Bitword_bits;
+    last_w = to / Bitword_bits;
+    word = bits[w] & (~(Bitword)0 << (from % Bitword_bits));
+    while (word == 0)
+    {
+        if (++w > last_w)
+            return (False);
+        word = bits[w];
+    }
+    if (w * Bitword_bits + sysbits_lowest(word) > to)
+        return (False);
+    *found = w * Bitword_bits + sysbits_lowest(word);
+    return (True);
+}
+Boolean sysbits_find_either(Bitword *bits, Bitword *other_bits,
+                            unsigned from, unsigned to, unsigned *found)
+{
+    unsigned w;
+    unsigned last_w;
+    Bitword word;
+    if (from > to)
+        return (False);
+    w = from / Bitword_bits;
+    last_w = to / Bitword_bits;
+    word = (bits[w] | other_bits[w]) & (~(Bitword)0 << (from % Bitword_bits));
+    while (word == 0)
+    {
+        if (++w > last_w)
+            return (False);
+        word = bits[w] | other_bits[w];
+    }
+    if (w * Bitword_bits + sysbits_lowest(word) > to)
+        return (False);
+    *found = w * Bitword_bits + sysbits_lowest(word);
+    return (True);
+}
+static Bitword sysbits_range_mask(unsigned w, unsigned from, unsigned to)
+{ /*
+   * Returns the bits of word w that lie in the range from..to.
+   */
+    Bitword mask = ~(Bitword)0;
+    if (w == from / Bitword_bits)
+        mask &= ~(Bitword)0 << (from % Bitword_bits);
+    if (w == to / Bitword_bits)
+        mask &= ~(Bitword)0 >> (Bitword_bits - 1 - to % Bitword_bits);
+    return (mask);
+}
+void sysbits_set_range(Bitword *bits, unsigned from, unsigned to)
+{
+    unsigned w;
+    if (from > to)
+        return;
+    for (w = from / Bitword_bits; w <= to / Bitword_bits; w++)
+        bits[w] |= sysbits_range_mask(w, from, to);
+}
+void sysbits_invert_range(Bitword *bits, unsigned from, unsigned to)
+{
+    unsigned w;
+    if (from > to)
+        return;
+    for (w = from / Bitword_bits; w <= to / Bitword_bits; w++)
+        bits[w] ^= sysbits_range_mask(w, from, to);
+}
+Boolean sysbits_find_clear(Bitword *bits, unsigned from, unsigned to,
+                           unsigned *found)
+{
+    unsigned w;
+    unsigned last_w;
+    Bitword word;
+    if (from > to)
+        return (False);
+    w = from / Bitword_bits;
+    last_w = to / Bitword_bits;
+    word = ~bits[w] & (~(Bitword)0 << (from % Bitword_bits));
+    while (word == 0)
+    {
+        if (++w > last_w)
+            return (False);
+        word = ~bits[w];
+    }
+    if (w * Bitword_bits + sysbits_lowest(word) > to)
+        return (False);
+    *found = w * Bitword_bits + sysbits_lowest(word);
+    return (True);
+}
 /******************************************************************************
  * SYS : SYSTEM SUPPLIED MEMORY ALLOCATION ROUTINES
  ******************************************************************************
  */
 Boolean sysmalloc(int size, void **allocated)
-{
-    return False;
+{ /*
+   * Takes the block from the C library heap, which systems with an
+   * allocator of their own replace here.
+   */
+    if ((size < 0) || ((*allocated = malloc((size_t)size + (size == 0))) ==
+                       NULL))
+        return (False);
+    return (True);
 }
 void sysfree(void *allocated)
 {
-    return;
+    free(allocated);
+}
+Boolean sysmalloc_aligned(int size, void **allocated)
+{ /*
+   * Takes a cache line more than asked for from sysmalloc(), and keeps the
+   * block sysmalloc() returned in the word before the aligned block.
+   */
+    void *block;
+    size_t aligned;
+    if ((size < 0) ||
+        (size > 0x7fffffff - Sys_cache_line - (int)sizeof(void *)) ||
+        !sysmalloc(size + Sys_cache_line - 1 + (int)sizeof(void *), &block))
+        return (False);
+    aligned = ((size_t)block + sizeof(void *) + Sys_cache_line - 1) /
+              Sys_cache_line * Sys_cache_line;
+    ((void **)aligned)[-1] = block;
+    *allocated = (void *)aligned;
+    return (True);
+}
+void sysfree_aligned(void *allocated)
+{
+    sysfree(((void **)allocated)[-1]);
+}
+/* An arena is a list of regions, newest first, each taken from the system
+ * whole, the oldest beginning with the arena's control block. Blocks are
+ * allocated from the unused end of the newest region, each after a header
+ * holding its size (header included), in whole cache lines, so that every
+ * block starts on a cache line of its own, as control blocks with cache
+ * aligned members need. When a region fills, what is left of it is kept as
+ * a free block.
+ *
+ * A freed block is pushed onto the free list for the power of two at or
+ * below its size. A request is met by the first large enough of the first
+ * few blocks on the list for the power of two at or below the block it
+ * needs (which finds a block of the same size, freed by an object of the
+ * same type, at once), or else by a block from the first non-empty of the
+ * next Sysarena_split_lists lists, whose blocks are all large enough, the
+ * excess being split off and kept as a free block. Larger blocks are not
+ * broken up, being kept for the large arrays that were freed as they grew.
+ * Only if there is no such block is unused space taken.
+ *
+ * Free blocks are never coalesced with their neighbours. A block split
+ * off stays that size until the arena is destroyed, so an instance whose
+ * allocations keep changing size can hold more of its arena in free
+ * blocks than it uses; the arena suits instances whose blocks are freed
+ * and allocated again at the same few sizes.
+ */
+enum
+{
+    Sysarena_header = Sys_cache_line,
+    Sysarena_lists = 33, /* for blocks of up to 2**32 octets */
+    Sysarena_scan = 4,
+    Sysarena_split_lists = 2,
+    Sysarena_page = 4096,
+    Sysarena_huge_page = 2 * 1024 * 1024
+};
+typedef struct Sysarena_region /* Sysarena_region */
+{
+    struct Sysarena_region *next_region;
+    size_t size;
+    void *allocated;
+} Sysarena_region;
+typedef struct /* Sysarena */
+{
+    Sysarena_region *regions;
+    Octet *next;
+    Octet *end;
+    Boolean huge_pages;
+    Octet *free_blocks[Sysarena_lists];
+} Sysarena;
+static size_t sysarena_round(size_t size, size_t unit)
+{
+    return ((size + unit - 1) / unit * unit);
+}
+static Boolean sysarena_take_region(size_t size, Boolean huge_pages,
+                                    Sysarena_region **region)
+{ /*
+   * Takes a region of at least size octets, rounded up to whole pages, from
+   * the system. Huge pages are mapped explicitly if the system has any set
+   * aside, and otherwise requested for an ordinary mapping, which the
+   * system backs with huge pages where it can. Without mappings, the region
+   * is taken from sysmalloc(), with room to align it to a cache line.
+   *
+   * A region smaller than a huge page is given ordinary pages whatever
+   * huge_pages says, since rounding it up would commit a whole huge page to
+   * an instance that needs a fraction of one.
+   */
+    void *memory;
+    void *allocated;
+    if (size < Sysarena_huge_page)
+        huge_pages = False;
+#if defined(__linux__)
+    memory = MAP_FAILED;
+    if (huge_pages)
+    {
+        size = sysarena_round(size, Sysarena_huge_page);
+#if defined(MAP_HUGETLB)
+        memory = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    }
+    else
+        size = sysarena_round(size, Sysarena_page);
+    if (memory == MAP_FAILED)
+    {
+        memory = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+            return (False);
+#if defined(MADV_HUGEPAGE)
+        if (huge_pages)
+            (void)madvise(memory, size, MADV_HUGEPAGE);
+#endif
+    }
+    allocated = memory;
+#else
+    size = sysarena_round(size, Sysarena_header);
+    if ((size > (size_t)0x7fffffff - Sys_cache_line) ||
+        !sysmalloc((int)(size + Sys_cache_line - 1), &allocated))
+        return (False);
+    memory = (void *)sysarena_round((size_t)allocated, Sys_cache_line);
+#endif
+    *region = (Sysarena_region *)memory;
+    (*region)->next_region = NULL;
+    (*region)->size = size;
+    (*region)->allocated = allocated;
+    return (True);
+}
+static void sysarena_release_region(Sysarena_region *region)
+{
+#if defined(__linux__)
+    (void)munmap(region, region->size);
+#else
+    sysfree(region->allocated);
+#endif
+}
+static unsigned sysarena_list(size_t block_size)
+{ /*
+   * Returns the list for the power of two at or below block_size.
+   */
+    unsigned list = 0;
+    while ((list + 1 < Sysarena_lists) && (((size_t)2 << list) <= block_size))
+        list++;
+    return (list);
+}
+static Octet **sysarena_link(Octet *block)
+{ /*
+   * A free block is linked to the next through the octets after its header.
+   */
+    return ((Octet **)(block + Sysarena_header));
+}
+static void sysarena_push(Sysarena *arena, Octet *block, size_t block_size)
+{
+    unsigned list = sysarena_list(block_size);
+    *(size_t *)block = block_size;
+    *sysarena_link(block) = arena->free_blocks[list];
+    arena->free_blocks[list] = block;
+}
+static Octet *sysarena_take_free(Sysarena *arena, size_t block_size)
+{ /*
+   * Takes a free block of at least block_size octets, splitting off the
+   * excess if that can be a block of its own, or returns NULL.
+   */
+    unsigned list = sysarena_list(block_size);
+    unsigned last_list = list + Sysarena_split_lists;
+    unsigned scanned = 0;
+    Octet **link = &arena->free_blocks[list];
+    Octet *block;
+    size_t size;
+    while (((block = *link) != NULL) && (*(size_t *)block < block_size) &&
+           (++scanned < Sysarena_scan))
+        link = sysarena_link(block);
+    if ((block == NULL) || (*(size_t *)block < block_size))
+    {
+        if (last_list >= Sysarena_lists)
+            last_list = Sysarena_lists - 1;
+        do
+        {
+            if (++list > last_list)
+                return (NULL);
+        } while (arena->free_blocks[list] == NULL);
+        link = &arena->free_blocks[list];
+        block = *link;
+    }
+    *link = *sysarena_link(block);
+    size = *(size_t *)block;
+    if (size - block_size >= 2 * Sysarena_header)
+    {
+        sysarena_push(arena, block + block_size, size - block_size);
+        *(size_t *)block = block_size;
+    }
+    return (block);
+}
+Boolean sysarena_create(unsigned size, Boolean huge_pages, void **arena)
+{
+    Sysarena_region *region;
+    Sysarena *my_arena;
+    size_t overhead = sysarena_round(sizeof(Sysarena_region), Sysarena_header) +
+                      sysarena_round(sizeof(Sysarena), Sysarena_header);
+    unsigned list;
+    if (!sysarena_take_region(overhead + size, huge_pages, &region))
+        return (False);
+    my_arena = (Sysarena *)((Octet *)region +
+                            sysarena_round(sizeof(Sysarena_region),
+                                           Sysarena_header));
+    my_arena->regions = region;
+    my_arena->next = (Octet *)region + overhead;
+    my_arena->end = (Octet *)region + region->size;
+    my_arena->huge_pages = huge_pages;
+    for (list = 0; list < Sysarena_lists; list++)
+        my_arena->free_blocks[list] = NULL;
+    *arena = my_arena;
+    return (True);
+}
+void sysarena_destroy(void *arena)
+{
+    Sysarena_region *region = ((Sysarena *)arena)->regions;
+    Sysarena_region *next_region;
+    for (; region != NULL; region = next_region)
+    {
+        next_region = region->next_region;
+        sysarena_release_region(region);
+    }
+}
+Boolean sysarena_malloc(void *arena, int size, void **allocated)
+{
+    Sysarena *my_arena = (Sysarena *)arena;
+    Sysarena_region *region;
+    size_t block_size;
+    size_t region_size;
+    Octet *block;
+    if (my_arena == NULL)
+        return (sysmalloc(size, allocated));
+    if (size < 0)
+        return (False);
+    block_size = Sysarena_header +
+                 sysarena_round((size_t)size + (size == 0), Sysarena_header);
+    if ((block = sysarena_take_free(my_arena, block_size)) != NULL)
+    {
+        *allocated = block + Sysarena_header;
+        return (True);
+    }
+    if (block_size > (size_t)(my_arena->end - my_arena->next))
+    {
+        region_size = 2 * my_arena->regions->size;
+        if (region_size < sysarena_round(sizeof(Sysarena_region),
+                                         Sysarena_header) + block_size)
+            region_size = sysarena_round(sizeof(Sysarena_region),
+                                         Sysarena_header) + block_size;
+        if (!sysarena_take_region(region_size, my_arena->huge_pages, &region))
+            return (False);
+        if (my_arena->end - my_arena->next >= 2 * Sysarena_header)
+            sysarena_push(my_arena, my_arena->next,
+                          (size_t)(my_arena->end - my_arena->next));
+        region->next_region = my_arena->regions;
+        my_arena->regions = region;
+        my_arena->next = (Octet *)region +
+                         sysarena_round(sizeof(Sysarena_region),
+                                        Sysarena_header);
+        my_arena->end = (Octet *)region + region->size;
+    }
+    block = my_arena->next;
+    my_arena->next += block_size;
+    *(size_t *)block = block_size;
+    *allocated = block + Sysarena_header;
+    return (True);
+}
+void sysarena_free(void *arena, void *allocated)
+{
+    Octet *block;
+    if (arena == NULL)
+    {
+        sysfree(allocated);
+        return;
+    }
+    if (allocated == NULL)
+        return;
+    block = (Octet *)allocated - Sysarena_header;
+    sysarena_push((Sysarena *)arena, block, *(size_t *)block);
 }
 /******************************************************************************
  * SYSPDU : SYSTEM SUPPLIED PDU ACCESS PRIMITIVES
  ******************************************************************************
  */
-typedef void Pdu;
-Boolean syspdu_alloc(Pdu **pdu)
+/* The pool is a single block of buffers, each a header on a cache line of
+ * its own followed by pdu_size octets rounded up to whole cache lines. A
+ * free buffer is linked to the next by its number (plus one, so that zero
+ * ends a list).
+ *
+ * The shared free list is a stack, pushed and popped by compare and
+ * exchange of its head, a buffer number in the low half and a count of
+ * changes in the high half, so that a head that has been popped and pushed
+ * again since it was read is not mistaken for the same head.
+ *
+ * Each thread's own free list is reached through a thread local variable,
+ * and noted with the pool it was taken from, so that buffers kept from a
+ * pool since destroyed are forgotten. A thread allocates from its own list
+ * first, and refills it a batch at a time from the shared list, and frees
+ * to its own list, returning a batch to the shared list once it is full -
+ * the buffers freed longest ago, keeping those most likely to be in cache.
+ */
+enum
+{
+    Syspdu_batch = Syspdu_kept / 2
+};
+typedef struct /* Syspdu_buffer */
+{
+    unsigned next;
+    unsigned number;
+    int length;
+} Syspdu_buffer;
+typedef struct /* Syspdu_pool */
+{
+    unsigned long long free_head Sys_cache_aligned;
+    unsigned long in_use Sys_cache_aligned;
+    unsigned long high_water;
+    unsigned long allocations;
+    unsigned long exhausted;
+    unsigned number_of_pdus Sys_cache_aligned;
+    unsigned pdu_size;
+    unsigned buffer_size;
+    Octet *buffers;
+} Syspdu_pool;
+typedef struct /* Syspdu_kept_list */
 {
-    return False;
+    Syspdu_pool *pool;
+    unsigned first;
+    unsigned number;
+} Syspdu_kept_list;
+static Syspdu_pool *syspdu_pool = NULL;
+static Sys_thread_local Syspdu_kept_list syspdu_kept;
+static Syspdu_buffer *syspdu_buffer(Syspdu_pool *pool, unsigned number)
+{ /*
+   * Returns the buffer with the given number plus one.
+   */
+    return ((Syspdu_buffer *)(pool->buffers +
+                              (size_t)(number - 1) * pool->buffer_size));
 }
-void syspdu_free(Pdu *pdu)
+static Octet *syspdu_buffer_octets(Syspdu_buffer *buffer)
 {
-    return;
+    return ((Octet *)buffer + Sys_cache_line);
 }
-Boolean rdcheck(Pdu *pdu, int number_of_octets_remaining)
+Boolean syspdu_create_pool(unsigned number_of_pdus, unsigned pdu_size)
 {
-    return False;
+    Syspdu_pool *pool;
+    Syspdu_buffer *buffer;
+    unsigned buffer_size;
+    size_t i;
+    if ((syspdu_pool != NULL) || (number_of_pdus == 0) || (pdu_size == 0))
+        goto pool_creation_failure;
+    buffer_size = Sys_cache_line +
+                  (pdu_size + Sys_cache_line - 1) / Sys_cache_line *
+                      Sys_cache_line;
+    if ((size_t)buffer_size * number_of_pdus > 0x7fffffff)
+        goto pool_creation_failure;
+    if (!sysmalloc_aligned(sizeof(Syspdu_pool), &pool))
+        goto pool_creation_failure;
+    if (!sysmalloc_aligned((int)((size_t)buffer_size * number_of_pdus),
+                           &pool->buffers))
+        goto buffers_creation_failure;
+    for (i = 0; i < (size_t)buffer_size * number_of_pdus; i++)
+        pool->buffers[i] = 0;
+    pool->number_of_pdus = number_of_pdus;
+    pool->pdu_size = pdu_size;
+    pool->buffer_size = buffer_size;
+    for (i = 1; i <= number_of_pdus; i++)
+    {
+        buffer = syspdu_buffer(pool, (unsigned)i);
+        buffer->number = (unsigned)i;
+        buffer->next = (i < number_of_pdus) ? (unsigned)i + 1 : 0;
+    }
+    pool->free_head = 1;
+    pool->in_use = 0;
+    pool->high_water = 0;
+    pool->allocations = 0;
+    pool->exhausted = 0;
+    sys_store_release(&syspdu_pool, pool);
+    return (True);
+buffers_creation_failure:
+    sysfree_aligned(pool);
+pool_creation_failure:
+    return (False);
 }
-Boolean rdoctet(Pdu *pdu, Octet *val)
+void syspdu_destroy_pool(void)
 {
-    return False;
+    if (syspdu_pool == NULL)
+        return;
+    sysfree_aligned(syspdu_pool->buffers);
+    sysfree_aligned(syspdu_pool);
+    syspdu_pool = NULL;
+    syspdu_kept.pool = NULL;
+}
+static void syspdu_push(Syspdu_pool *pool, unsigned first, unsigned last)
+{ /*
+   * Pushes the list of buffers from first to last onto the shared list.
+   */
+    unsigned long long head = sys_load_relaxed(&pool->free_head);
+    unsigned long long new_head;
+    do
+    {
+        sys_store_relaxed(&syspdu_buffer(pool, last)->next, (unsigned)head);
+        new_head = ((head >> 32) + 1) << 32 | first;
+    } while (!sys_compare_exchange(&pool->free_head, &head, new_head));
+}
+static unsigned syspdu_pop(Syspdu_pool *pool)
+{ /*
+   * Pops a buffer from the shared list, returning its number plus one, or
+   * zero if the list is empty. The next buffer of one popped by another
+   * thread meanwhile may be read, but the change count then fails the
+   * exchange.
+   */
+    unsigned long long head = sys_load_acquire(&pool->free_head);
+    unsigned long long new_head;
+    unsigned first;
+    do
+    {
+        first = (unsigned)head;
+        if (first == 0)
+            return (0);
+        new_head = ((head >> 32) + 1) << 32 |
+                   sys_load_relaxed(&syspdu_buffer(pool, first)->next);
+    } while (!sys_compare_exchange(&pool->free_head, &head, new_head));
+    return (first);
 }
-Boolean rdint16(Pdu *pdu, Int16 val)
+static void syspdu_note_allocation(Syspdu_pool *pool)
 {
-    return False;
+    unsigned long in_use = sys_fetch_add(&pool->in_use, 1) + 1;
+    unsigned long high_water = sys_load_relaxed(&pool->high_water);
+    sys_fetch_add(&pool->allocations, 1);
+    while ((in_use > high_water) &&
+           !sys_compare_exchange(&pool->high_water, &high_water, in_use))
+        ;
 }
-Boolean rdskip(Pdu *pdu, int number_to_skip)
+Boolean syspdu_alloc(Pdu **pdu)
 {
-    return False;
+    Syspdu_pool *pool = sys_load_acquire(&syspdu_pool);
+    Syspdu_kept_list *kept = &syspdu_kept;
+    Syspdu_buffer *buffer;
+    unsigned number;
+    if (pool == NULL)
+        return (False);
+    if (kept->pool != pool)
+    {
+        kept->pool = pool;
+        kept->first = 0;
+        kept->number = 0;
+    }
+    while ((kept->number < Syspdu_batch) && ((number = syspdu_pop(pool)) != 0))
+    {
+        syspdu_buffer(pool, number)->next = kept->first;
+        kept->first = number;
+        kept->number++;
+    }
+    if (kept->number == 0)
+    {
+        sys_fetch_add(&pool->exhausted, 1);
+        return (False);
+    }
+    buffer = syspdu_buffer(pool, kept->first);
+    kept->first = buffer->next;
+    kept->number--;
+    buffer->length = (int)pool->pdu_size;
+    syspdu_note_allocation(pool);
+    *pdu = (Pdu *)buffer;
+    return (True);
 }
-void syspdu_tx(Pdu *pdu, int port_no)
+void syspdu_free(Pdu *pdu)
+{
+    Syspdu_pool *pool = sys_load_acquire(&syspdu_pool);
+    Syspdu_kept_list *kept = &syspdu_kept;
+    Syspdu_buffer *buffer = (Syspdu_buffer *)pdu;
+    Syspdu_buffer *last;
+    unsigned first;
+    unsigned i;
+    if ((pool == NULL) || (pdu == NULL))
+        return;
+    if (kept->pool != pool)
+    {
+        kept->pool = pool;
+        kept->first = 0;
+        kept->number = 0;
+    }
+    sys_fetch_add(&pool->in_use, (unsigned long)-1);
+    buffer->next = kept->first;
+    kept->first = buffer->number;
+    if (++kept->number < Syspdu_kept)
+        return;
+    buffer = syspdu_buffer(pool, kept->first);
+    for (i = 1; i < Syspdu_kept - Syspdu_batch; i++)
+        buffer = syspdu_buffer(pool, buffer->next);
+    first = buffer->next;
+    buffer->next = 0;
+    last = syspdu_buffer(pool, first);
+    while (last->next != 0)
+        last = syspdu_buffer(pool, last->next);
+    kept->number -= Syspdu_batch;
+    syspdu_push(pool, first, last->number);
+}
+Octet *syspdu_octets(Pdu *pdu, int *number_of_octets)
+{
+    *number_of_octets = ((Syspdu_buffer *)pdu)->length;
+    return (syspdu_buffer_octets((Syspdu_buffer *)pdu));
+}
+void syspdu_set_length(Pdu *pdu, int number_of_octets)
 {
-    return;
+    ((Syspdu_buffer *)pdu)->length = number_of_octets;
+}
+void syspdu_read_pool_counts(Syspdu_pool_counts *counts)
+{
+    Syspdu_pool *pool = syspdu_pool;
+    if (pool == NULL)
+        return;
+    counts->number_of_pdus = pool->number_of_pdus;
+    counts->pdu_size = pool->pdu_size;
+    counts->allocations = sys_load_relaxed(&pool->allocations);
+    counts->in_use = sys_load_relaxed(&pool->in_use);
+    counts->high_water = sys_load_relaxed(&pool->high_water);
+    counts->exhausted = sys_load_relaxed(&pool->exhausted);
+}
+void syspdu_tx(Pdu *pdu, int port_no)
+{ /*
+   * A system would hand the PDU to the port's transmit queue here, freeing it
+   * once sent; this stand-in sends nothing, and frees it at once.
+   */
+    syspdu_free(pdu);
 }
 /******************************************************************************
  * SYSTIME : SYSTEM SUPPLIED SCHEDULING FUNCTIONS
  ******************************************************************************
  */
+enum
+{ /*
+   * The first level of the wheel has a slot for each millisecond, and each
+   * of the upper levels a slot for each turn of the level below. Timers
+   * (starts) are allocated in chunks, and never returned until the wheel
+   * is destroyed.
+   */
+    Systime_first_bits = 8,
+    Systime_first_slots = 1 << Systime_first_bits,
+    Systime_upper_bits = 6,
+    Systime_upper_slots = 1 << Systime_upper_bits,
+    Systime_upper_levels = 3,
+    Systime_timers_per_chunk = 1024,
+    Systime_min_processes = 16
+};
+typedef struct Systime_timer
+{
+    struct Systime_timer *next;
+    unsigned long expires;
+    void (*expiry_fn)(void *, int instance_id);
+    int process_id;
+    unsigned generation;
+    int instance_id;
+} Systime_timer;
+typedef struct /* Systime_list */
+{
+    Systime_timer *first;
+    Systime_timer *last;
+} Systime_list;
+typedef struct Systime_chunk
+{
+    struct Systime_chunk *next;
+    Systime_timer timers[Systime_timers_per_chunk];
+} Systime_chunk;
+typedef struct /* Systime_process */
+{ /*
+   * The generation is advanced each time the process is unregistered, so
+   * timers started by an earlier registration are not dispatched to a
+   * later one.
+   */
+    void *context;
+    unsigned generation;
+    Boolean registered;
+} Systime_process;
+typedef struct /* Systime_wheel */
+{ /*
+   * Every timer due at or before now has been dispatched. The timers in
+   * the slots (and not those to expire at once) number in_slots.
+   */
+    unsigned long now;
+    unsigned long in_slots;
+    Systime_list first_level[Systime_first_slots];
+    Systime_list upper_levels[Systime_upper_levels][Systime_upper_slots];
+    Systime_list immediate;
+    Systime_timer *free;
+    Systime_chunk *chunks;
+    Systime_process *processes;
+    int number_of_processes;
+    unsigned random;
+    Systime_counts counts;
+} Systime_wheel;
+static Systime_wheel *systime_wheel = NULL;
+static void systime_append(Systime_list *list, Systime_timer *timer)
+{
+    timer->next = NULL;
+    if (list->first == NULL)
+        list->first = timer;
+    else
+        list->last->next = timer;
+    list->last = timer;
+}
+static void systime_concatenate(Systime_list *list, Systime_list *other)
+{ /*
+   * Moves the timers of other to the end of list, leaving other empty.
+   */
+    if (other->first == NULL)
+        return;
+    if (list->first == NULL)
+        list->first = other->first;
+    else
+        list->last->next = other->first;
+    list->last = other->last;
+    other->first = other->last = NULL;
+}
+static void systime_file(Systime_wheel *wheel, Systime_timer *timer)
+{ /*
+   * Files the timer in the slot of the lowest level that spans the time to
+   * its expiry (which is not before now). The slot is cascaded, and the
+   * timer refiled lower, no later than the timer expires: a timer due
+   * beyond the span of the wheel is filed in the last slot of the highest
+   * level, and refiled when that is cascaded.
+   */
+    unsigned long delta = timer->expires - wheel->now;
+    unsigned long expires = timer->expires;
+    unsigned level;
+    unsigned shift;
+    if (delta < Systime_first_slots)
+    {
+        systime_append(&wheel->first_level[expires &
+                                           (Systime_first_slots - 1)],
+                       timer);
+        return;
+    }
+    for (level = 0; level < Systime_upper_levels - 1; level++)
+    {
+        shift = Systime_first_bits + level * Systime_upper_bits;
+        if ((delta >> (shift + Systime_upper_bits)) == 0)
+            break;
+    }
+    shift = Systime_first_bits + level * Systime_upper_bits;
+    if ((delta >> (shift + Systime_upper_bits)) != 0)
+        expires = wheel->now + (1UL << (shift + Systime_upper_bits)) - 1;
+    systime_append(&wheel->upper_levels[level][(expires >> shift) &
+                                               (Systime_upper_slots - 1)],
+                   timer);
+}
+static unsigned systime_cascade(Systime_wheel *wheel, unsigned level)
+{ /*
+   * Refiles the timers in the current slot of the given upper level, and
+   * returns the number of that slot: the level above is cascaded too when
+   * this level starts a new turn, that is when the slot number is zero.
+   */
+    unsigned slot;
+    Systime_list list;
+    Systime_timer *timer;
+    slot = (unsigned)(wheel->now >> (Systime_first_bits +
+                                     level * Systime_upper_bits)) &
+           (Systime_upper_slots - 1);
+    list = wheel->upper_levels[level][slot];
+    wheel->upper_levels[level][slot].first = NULL;
+    wheel->upper_levels[level][slot].last = NULL;
+    while ((timer = list.first) != NULL)
+    {
+        list.first = timer->next;
+        systime_file(wheel, timer);
+    }
+    return (slot);
+}
+static void systime_start(int process_id,
+                          void (*expiry_fn)(void *, int instance_id),
+                          int instance_id, int timeout)
+{ /*
+   * Takes a timer from the free list, adding a chunk of timers to it if it
+   * is empty, and files it to expire timeout milliseconds from now. A timer
+   * for a process that is not registered is discarded here: recording the
+   * generation of an unregistered, or not yet known, process_id would let a
+   * later registration at that generation receive it.
+   */
+    Systime_wheel *wheel = systime_wheel;
+    Systime_process *process;
+    Systime_chunk *chunk;
+    Systime_timer *timer;
+    int i;
+    if (wheel == NULL)
+        return;
+    process = ((process_id >= 0) && (process_id < wheel->number_of_processes))
+                  ? &wheel->processes[process_id]
+                  : NULL;
+    if ((process == NULL) || !process->registered)
+    {
+        wheel->counts.discarded++;
+        return;
+    }
+    if (wheel->free == NULL)
+    {
+        if (!sysmalloc(sizeof(Systime_chunk), &chunk))
+        {
+            wheel->counts.failed++;
+            return;
+        }
+        chunk->next = wheel->chunks;
+        wheel->chunks = chunk;
+        for (i = 0; i < Systime_timers_per_chunk; i++)
+        {
+            chunk->timers[i].next = wheel->free;
+            wheel->free = &chunk->timers[i];
+        }
+    }
+    timer = wheel->free;
+    wheel->free = timer->next;
+    timer->expiry_fn = expiry_fn;
+    timer->process_id = process_id;
+    timer->instance_id = instance_id;
+    timer->generation = process->generation;
+    if (++wheel->counts.armed > wheel->counts.high_water)
+        wheel->counts.high_water = wheel->counts.armed;
+    wheel->counts.started++;
+    if (timeout <= 0)
+    {
+        timer->expires = wheel->now;
+        systime_append(&wheel->immediate, timer);
+    }
+    else
+    {
+        timer->expires = wheel->now + (unsigned long)timeout;
+        wheel->in_slots++;
+        systime_file(wheel, timer);
+    }
+}
+Boolean systime_create_timers(unsigned long now)
+{
+    Systime_wheel *wheel;
+    unsigned level;
+    unsigned slot;
+    if (systime_wheel != NULL)
+        return (False);
+    if (!sysmalloc(sizeof(Systime_wheel), &wheel))
+        return (False);
+    wheel->now = now;
+    wheel->in_slots = 0;
+    for (slot = 0; slot < Systime_first_slots; slot++)
+        wheel->first_level[slot].first = wheel->first_level[slot].last = NULL;
+    for (level = 0; level < Systime_upper_levels; level++)
+        for (slot = 0; slot < Systime_upper_slots; slot++)
+            wheel->upper_levels[level][slot].first =
+                wheel->upper_levels[level][slot].last = NULL;
+    wheel->immediate.first = wheel->immediate.last = NULL;
+    wheel->free = NULL;
+    wheel->chunks = NULL;
+    wheel->processes = NULL;
+    wheel->number_of_processes = 0;
+    wheel->random = 0x2545f491;
+    wheel->counts.armed = 0;
+    wheel->counts.high_water = 0;
+    wheel->counts.started = 0;
+    wheel->counts.dispatched = 0;
+    wheel->counts.batches = 0;
+    wheel->counts.discarded = 0;
+    wheel->counts.failed = 0;
+    systime_wheel = wheel;
+    return (True);
+}
+void systime_destroy_timers(void)
+{
+    Systime_wheel *wheel = systime_wheel;
+    Systime_chunk *chunk;
+    if (wheel == NULL)
+        return;
+    systime_wheel = NULL;
+    while ((chunk = wheel->chunks) != NULL)
+    {
+        wheel->chunks = chunk->next;
+        sysfree(chunk);
+    }
+    if (wheel->processes != NULL)
+        sysfree(wheel->processes);
+    sysfree(wheel);
+}
+Boolean systime_register_process(int process_id, void *context)
+{ /*
+   * The table of processes, indexed by process_id, is doubled in size
+   * until it has an entry for the process.
+   */
+    Systime_wheel *wheel = systime_wheel;
+    Systime_process *processes;
+    int number_of_processes;
+    int i;
+    if (wheel == NULL)
+        return (True);
+    if (process_id < 0)
+        return (False);
+    if (process_id >= wheel->number_of_processes)
+    {
+        number_of_processes = (wheel->number_of_processes > 0)
+                                  ? wheel->number_of_processes
+                                  : Systime_min_processes;
+        while (process_id >= number_of_processes)
+            number_of_processes *= 2;
+        if (!sysmalloc((int)(sizeof(Systime_process) * number_of_processes),
+                       &processes))
+            return (False);
+        for (i = 0; i < number_of_processes; i++)
+        {
+            if (i < wheel->number_of_processes)
+                processes[i] = wheel->processes[i];
+            else
+            {
+                processes[i].context = NULL;
+                processes[i].generation = 0;
+                processes[i].registered = False;
+            }
+        }
+        if (wheel->processes != NULL)
+            sysfree(wheel->processes);
+        wheel->processes = processes;
+        wheel->number_of_processes = number_of_processes;
+    }
+    wheel->processes[process_id].context = context;
+    wheel->processes[process_id].registered = True;
+    return (True);
+}
+void systime_unregister_process(int process_id)
+{
+    Systime_wheel *wheel = systime_wheel;
+    if ((wheel == NULL) || (process_id < 0) ||
+        (process_id >= wheel->number_of_processes))
+        return;
+    wheel->processes[process_id].context = NULL;
+    wheel->processes[process_id].registered = False;
+    wheel->processes[process_id].generation++;
+}
+unsigned systime_expire_timers(unsigned long now)
+{ /*
+   * Collects the timers that expire at each millisecond up to now (after
+   * those that were to expire at once) into a batch, then dispatches the
+   * batch, returning each timer to the free list before calling its expiry
+   * function so that the function can start another. Timers started by
+   * the batch to expire at once make up the next batch.
+   */
+    Systime_wheel *wheel = systime_wheel;
+    Systime_list batch;
+    Systime_timer *timer;
+    Systime_process *process;
+    void (*expiry_fn)(void *, int instance_id);
+    int process_id;
+    int instance_id;
+    unsigned generation;
+    unsigned dispatched = 0;
+    unsigned slot;
+    if (wheel == NULL)
+        return (0);
+    batch.first = batch.last = NULL;
+    systime_concatenate(&batch, &wheel->immediate);
+    while ((long)(now - wheel->now) > 0)
+    {
+        if (wheel->in_slots == 0)
+        {
+            wheel->now = now;
+            break;
+        }
+        wheel->now++;
+        slot = (unsigned)wheel->now & (Systime_first_slots - 1);
+        if ((slot == 0) && (systime_cascade(wheel, 0) == 0) &&
+            (systime_cascade(wheel, 1) == 0))
+            systime_cascade(wheel, 2);
+        for (timer = wheel->first_level[slot].first; timer != NULL;
+             timer = timer->next)
+            wheel->in_slots--;
+        systime_concatenate(&batch, &wheel->first_level[slot]);
+    }
+    while (batch.first != NULL)
+    {
+        wheel->counts.batches++;
+        while ((timer = batch.first) != NULL)
+        {
+            batch.first = timer->next;
+            expiry_fn = timer->expiry_fn;
+            process_id = timer->process_id;
+            instance_id = timer->instance_id;
+            generation = timer->generation;
+            timer->next = wheel->free;
+            wheel->free = timer;
+            wheel->counts.armed--;
+            process = ((process_id >= 0) &&
+                       (process_id < wheel->number_of_processes))
+                          ? &wheel->processes[process_id]
+                          : NULL;
+            if ((process == NULL) || !process->registered ||
+                (process->generation != generation))
+            {
+                wheel->counts.discarded++;
+                continue;
+            }
+            wheel->counts.dispatched++;
+            dispatched++;
+            expiry_fn(process->context, instance_id);
+            if (systime_wheel != wheel)
+                return (dispatched);
+        }
+        batch.last = NULL;
+        systime_concatenate(&batch, &wheel->immediate);
+    }
+    return (dispatched);
+}
+void systime_read_counts(Systime_counts *counts)
+{
+    if (systime_wheel != NULL)
+        *counts = systime_wheel->counts;
+}
 void systime_start_random_timer(int process_id,
                                 void (*expiry_fn)(void *, int instance_id),
                                 int instance_id,
                                 int timeout)
-{
-    return;
+{ /*
+   * The timeout is drawn from a xorshift generator, which is plenty random
+   * enough to spread the transmissions of different ports and applications.
+   */
+    Systime_wheel *wheel = systime_wheel;
+    unsigned random;
+    if (wheel == NULL)
+        return;
+    random = wheel->random;
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    wheel->random = random;
+    systime_start(process_id, expiry_fn, instance_id,
+                  (timeout > 0) ? (int)(random % (unsigned)timeout) : 0);
 }
 void systime_start_timer(int process_id,
                          void (*expiry_fn)(void *, int instance_id),
                          int instance_id,
                          int timeout)
 {
-    return;
+    systime_start(process_id, expiry_fn, instance_id, timeout);
 }
 void systime_schedule(int process_id,
                       void (*expiry_fn)(void *, int instance_id),
                       int instance_id)
 {
-    return;
+    systime_start(process_id, expiry_fn, instance_id, 0);
+}
+unsigned long systime_now(void)
+{ /*
+   * Uses the monotonic clock where there is one, so that intervals are not
+   * upset by changes to the time of day, and otherwise the processor time.
+   */
+#if defined(CLOCK_MONOTONIC)
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now) != 0)
+        return (0);
+    return ((unsigned long)now.tv_sec * 1000000UL +
+            (unsigned long)now.tv_nsec / 1000UL);
+#else
+    return ((unsigned long)((double)clock() * 1000000.0 / CLOCKS_PER_SEC));
+#endif
 }
 /******************************************************************************
  * SYSERR : FATAL ERROR HANDLING
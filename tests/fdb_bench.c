@@ -0,0 +1,221 @@
+/* fdb_bench.c */
+#define _POSIX_C_SOURCE 199309L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "sys.h"
+#include "fdb.h"
+/******************************************************************************
+ * FDB BENCHMARK : LOOKUP SCALING UNDER UPDATES
+ ******************************************************************************
+ *
+ * Runs 1, 2, 4, and 8 reader threads, each looking up addresses of a VLAN of
+ * its own, while one writer thread creates and removes entries and changes
+ * defaults as fast as it can, and reports the lookups per second of all
+ * readers together and the updates per second. Each count of readers is run
+ * twice: with the writer updating a VLAN in a stripe none of the readers
+ * use, and with it updating the readers' own VLANs in turn. With lookups
+ * scaling across cores, the first should grow with the number of readers;
+ * the second shows the cost of retrying lookups that race updates to their
+ * own VLANs.
+ *
+ * Each run starts with a full database, holding the readers' entries
+ * created alternately with entries the writer then removes, so that its
+ * removals close up runs of buckets holding the readers' entries, and its
+ * creations then grow the table twice while the readers look up. The
+ * readers' own entries are never updated, and each lookup of one is
+ * checked: the run fails if any gives the wrong result.
+ *
+ * The optional argument is the time of each run in milliseconds.
+ */
+enum
+{
+    Bench_ports = 64,
+    Bench_addresses = 1024,
+    Bench_max_readers = 8,
+    Bench_reader_vlan = 1,     /* readers use VLANs 1 to Bench_max_readers */
+    Bench_writer_vlan = 40,    /* in a stripe no reader uses */
+    Bench_entries = Bench_max_readers * Bench_addresses,
+    Bench_churn_addresses = 7 * Bench_entries /* grows the table twice */
+};
+typedef struct /* Bench_reader */
+{
+    pthread_t thread;
+    unsigned vlan_id;
+    unsigned long lookups Sys_cache_aligned;
+    unsigned long wrong;
+} Bench_reader;
+static Octet bench_addresses[Bench_addresses][6];
+static Octet bench_churn_addresses[Bench_churn_addresses][6];
+static int bench_running;
+static unsigned bench_readers;
+static Boolean bench_same_vlans;
+static void bench_address(unsigned n, Octet *address)
+{
+    address[0] = 0x01;
+    address[1] = 0x00;
+    address[2] = 0x5e;
+    address[3] = (Octet)(n >> 16);
+    address[4] = (Octet)(n >> 8);
+    address[5] = (Octet)n;
+}
+static double bench_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((double)now.tv_sec + (double)now.tv_nsec / 1e9);
+}
+static void *bench_reader(void *context)
+{ /*
+   * Looks up each of the VLAN's own addresses in turn, on the port its
+   * entry forwards through and on the next, which it filters, and between
+   * them an address whose entry the writer may be creating or removing.
+   */
+    Bench_reader *reader = (Bench_reader *)context;
+    unsigned long lookups = 0;
+    unsigned long wrong = 0;
+    unsigned n = 0;
+    unsigned churn = 0;
+    int port_no;
+    while (sys_load_relaxed(&bench_running))
+    {
+        port_no = (int)(n % Bench_ports);
+        if (!fdb_forwarding(reader->vlan_id, port_no, bench_addresses[n]))
+            wrong++;
+        (void)fdb_forwarding(reader->vlan_id, port_no,
+                             bench_churn_addresses[churn]);
+        if (fdb_forwarding(reader->vlan_id, (port_no + 1) % Bench_ports,
+                           bench_addresses[n]))
+            wrong++;
+        n = (n + 1) % Bench_addresses;
+        churn = (churn + 1) % Bench_churn_addresses;
+        lookups += 3;
+    }
+    reader->lookups = lookups;
+    reader->wrong = wrong;
+    return (NULL);
+}
+static unsigned bench_churn_vlan(unsigned n)
+{
+    if (bench_same_vlans)
+        return (Bench_reader_vlan + n % bench_readers);
+    return (Bench_writer_vlan);
+}
+static void *bench_writer(void *context)
+{ /*
+   * Removes the entries of the churn addresses, then creates one for each,
+   * over and over, changing a port's default every so often.
+   */
+    unsigned long *updates = (unsigned long *)context;
+    unsigned n = 0;
+    unsigned churn = 0;
+    Boolean creating = False;
+    while (sys_load_relaxed(&bench_running))
+    {
+        if (n % 32 == 0)
+            fdb_forward_by_default(bench_churn_vlan(n), (int)(n % Bench_ports));
+        else if (n % 16 == 0)
+            fdb_filter_by_default(bench_churn_vlan(n), (int)(n % Bench_ports));
+        else
+        {
+            if (creating)
+                fdb_forward(bench_churn_vlan(churn),
+                            (int)(churn % Bench_ports),
+                            bench_churn_addresses[churn]);
+            else
+                (void)fdb_remove(bench_churn_vlan(churn),
+                                 bench_churn_addresses[churn]);
+            if (++churn == Bench_churn_addresses)
+            {
+                churn = 0;
+                creating = !creating;
+            }
+        }
+        n++;
+        (*updates)++;
+    }
+    return (NULL);
+}
+static int bench_run(unsigned readers, Boolean same_vlans, unsigned run_ms)
+{
+    Bench_reader reader[Bench_max_readers];
+    pthread_t writer;
+    unsigned long updates = 0;
+    unsigned long lookups = 0;
+    unsigned long wrong = 0;
+    struct timespec run_time;
+    double started;
+    double elapsed;
+    unsigned vlan_id;
+    unsigned n;
+    unsigned i;
+    bench_readers = readers;
+    bench_same_vlans = same_vlans;
+    if (!fdb_create_fdb(Bench_ports, 2 * Bench_entries))
+        return (1);
+    for (n = 0; n < Bench_entries; n++)
+    {
+        vlan_id = Bench_reader_vlan + n % Bench_max_readers;
+        fdb_forward(bench_churn_vlan(n), (int)(n % Bench_ports),
+                    bench_churn_addresses[n]);
+        fdb_forward(vlan_id, (int)((n / Bench_max_readers) % Bench_ports),
+                    bench_addresses[n / Bench_max_readers]);
+    }
+    sys_store_relaxed(&bench_running, 1);
+    started = bench_seconds();
+    for (i = 0; i < readers; i++)
+    {
+        reader[i].vlan_id = Bench_reader_vlan + i;
+        reader[i].lookups = 0;
+        reader[i].wrong = 0;
+        if (pthread_create(&reader[i].thread, NULL, bench_reader,
+                           &reader[i]) != 0)
+            return (1);
+    }
+    if (pthread_create(&writer, NULL, bench_writer, &updates) != 0)
+        return (1);
+    run_time.tv_sec = run_ms / 1000;
+    run_time.tv_nsec = (long)(run_ms % 1000) * 1000000L;
+    nanosleep(&run_time, NULL);
+    sys_store_relaxed(&bench_running, 0);
+    pthread_join(writer, NULL);
+    for (i = 0; i < readers; i++)
+    {
+        pthread_join(reader[i].thread, NULL);
+        lookups += reader[i].lookups;
+        wrong += reader[i].wrong;
+    }
+    elapsed = bench_seconds() - started;
+    fdb_destroy_fdb();
+    printf("%u reader%-2s writer on %-13s %7.2f M lookups/s "
+           "%6.2f M updates/s\n",
+           readers, (readers == 1) ? "," : "s,",
+           same_vlans ? "their VLANs:" : "another VLAN:",
+           (double)lookups / elapsed / 1e6, (double)updates / elapsed / 1e6);
+    if (wrong != 0)
+    {
+        printf("FAIL: %lu lookups of unchanged entries were wrong\n", wrong);
+        return (1);
+    }
+    return (0);
+}
+int main(int argc, char **argv)
+{
+    unsigned run_ms = 500;
+    unsigned readers;
+    unsigned n;
+    if (argc > 1)
+        run_ms = (unsigned)strtoul(argv[1], NULL, 0);
+    for (n = 0; n < Bench_addresses; n++)
+        bench_address(n, bench_addresses[n]);
+    for (n = 0; n < Bench_churn_addresses; n++)
+        bench_address(Bench_addresses + n, bench_churn_addresses[n]);
+    for (readers = 1; readers <= Bench_max_readers; readers *= 2)
+    {
+        if ((bench_run(readers, False, run_ms) != 0) ||
+            (bench_run(readers, True, run_ms) != 0))
+            return (1);
+    }
+    return (0);
+}
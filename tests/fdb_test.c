@@ -0,0 +1,250 @@
+/* fdb_test.c */
+#include <stdio.h>
+#include <string.h>
+#include "sys.h"
+#include "fdb.h"
+#include "fdq.h"
+/******************************************************************************
+ * FDB TEST : FILTERING DATABASE AND QUEUE CHECKS
+ ******************************************************************************
+ *
+ * Checks the Filtering Database against a simple model through a long run
+ * of random changes - entries created from the defaults, filtered and
+ * forwarded, removed, and changed by batch, on VLANs that share stripes,
+ * from a table small enough to grow several times - and checks that the
+ * queue makes removals, in order with other changes, only when programmed.
+ * Returns non-zero if any check fails.
+ */
+enum
+{
+    Test_ports = 70, /* more than one Bitword */
+    Test_port_words = (Test_ports + Bitword_bits - 1) / Bitword_bits,
+    Test_vlans = 3,
+    Test_addresses = 300,
+    Test_steps = 20000
+};
+static unsigned test_vlan_ids[Test_vlans] = {1, 1 + 64, 4095};
+typedef struct /* Test_model */
+{
+    Boolean has_entry[Test_vlans][Test_addresses];
+    Bitword ports[Test_vlans][Test_addresses][Test_port_words];
+    Bitword defaults[Test_vlans][Test_port_words];
+    unsigned number_of_entries;
+} Test_model;
+static Test_model model;
+static int failures = 0;
+static unsigned long long test_random = 0x9E3779B97F4A7C15ull;
+static void check(Boolean ok, char *what)
+{
+    if (!ok)
+    {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+static unsigned test_next(unsigned range)
+{
+    test_random = test_random * 6364136223846793005ull +
+                  1442695040888963407ull;
+    return ((unsigned)(test_random >> 33) % range);
+}
+static void test_address(unsigned n, Octet *address)
+{ /*
+   * Addresses differ in their last octets only, so that many share hash
+   * buckets' neighbourhoods and removals move entries of other VLANs.
+   */
+    address[0] = 0x01;
+    address[1] = 0x80;
+    address[2] = 0xc2;
+    address[3] = 0x00;
+    address[4] = (Octet)(n >> 8);
+    address[5] = (Octet)n;
+}
+static void model_set(unsigned v, unsigned a, int port_no, Fdb_action action)
+{
+    if (!model.has_entry[v][a])
+    {
+        model.has_entry[v][a] = True;
+        memcpy(model.ports[v][a], model.defaults[v],
+               sizeof(model.defaults[v]));
+        model.number_of_entries++;
+    }
+    if (action == Fdb_forward)
+        sysbits_set(model.ports[v][a], (unsigned)port_no);
+    else
+        sysbits_clear(model.ports[v][a], (unsigned)port_no);
+}
+static Boolean model_forwarding(unsigned v, unsigned a, int port_no)
+{
+    if (model.has_entry[v][a])
+        return (sysbits_test(model.ports[v][a], (unsigned)port_no));
+    return (sysbits_test(model.defaults[v], (unsigned)port_no));
+}
+static void check_against_model(void)
+{
+    Octet address[6];
+    Bitword ports[Test_port_words];
+    unsigned v;
+    unsigned a;
+    int port_no;
+    Boolean ok = True;
+    for (v = 0; v < Test_vlans; v++)
+    {
+        for (a = 0; a < Test_addresses; a++)
+        {
+            test_address(a, address);
+            fdb_forwarding_ports(test_vlan_ids[v], address, ports);
+            for (port_no = 0; port_no < Test_ports; port_no++)
+            {
+                if (sysbits_test(ports, (unsigned)port_no) !=
+                    model_forwarding(v, a, port_no))
+                    ok = False;
+            }
+            port_no = (int)test_next(Test_ports);
+            if (fdb_forwarding(test_vlan_ids[v], port_no, address) !=
+                model_forwarding(v, a, port_no))
+                ok = False;
+        }
+    }
+    check(ok, "lookups match the model");
+    check((Boolean)(fdb_number_of_entries() == model.number_of_entries),
+          "number of entries matches the model");
+}
+static void test_random_changes(void)
+{ /*
+   * Each step makes one random change to the database and the model alike;
+   * every few hundred steps every address is looked up on every VLAN.
+   */
+    Mac_address batch[8];
+    Octet batch_addresses[8][6];
+    Octet address[6];
+    unsigned step;
+    unsigned v;
+    unsigned a;
+    unsigned i;
+    unsigned number;
+    int port_no;
+    Fdb_action action;
+    Fdb_default default_action;
+    Boolean removed;
+    memset(&model, 0, sizeof(model));
+    check(fdb_create_fdb(Test_ports, 4), "database created");
+    for (step = 0; step < Test_steps; step++)
+    {
+        v = test_next(Test_vlans);
+        a = test_next(Test_addresses);
+        port_no = (int)test_next(Test_ports);
+        action = (Fdb_action)test_next(2);
+        test_address(a, address);
+        switch (test_next(8))
+        {
+        case 0:
+        case 1:
+            fdb_filter(test_vlan_ids[v], port_no, address);
+            model_set(v, a, port_no, Fdb_filter);
+            break;
+        case 2:
+        case 3:
+            fdb_forward(test_vlan_ids[v], port_no, address);
+            model_set(v, a, port_no, Fdb_forward);
+            break;
+        case 4:
+            if (action == Fdb_forward)
+            {
+                fdb_forward_by_default(test_vlan_ids[v], port_no);
+                sysbits_set(model.defaults[v], (unsigned)port_no);
+            }
+            else
+            {
+                fdb_filter_by_default(test_vlan_ids[v], port_no);
+                sysbits_clear(model.defaults[v], (unsigned)port_no);
+            }
+            break;
+        case 5:
+        case 6:
+            removed = fdb_remove(test_vlan_ids[v], address);
+            check((Boolean)(removed == model.has_entry[v][a]),
+                  "fdb_remove() finds exactly the entries present");
+            if (model.has_entry[v][a])
+            {
+                model.has_entry[v][a] = False;
+                model.number_of_entries--;
+            }
+            break;
+        default:
+            number = test_next(8);
+            for (i = 0; i < number; i++)
+            {
+                test_address((a + i * 37) % Test_addresses,
+                             batch_addresses[i]);
+                batch[i] = batch_addresses[i];
+            }
+            default_action = (Fdb_default)test_next(3);
+            fdb_update(test_vlan_ids[v], port_no, batch, number, action,
+                       default_action);
+            for (i = 0; i < number; i++)
+                model_set(v, (a + i * 37) % Test_addresses, port_no, action);
+            if (default_action == Fdb_default_forward)
+                sysbits_set(model.defaults[v], (unsigned)port_no);
+            else if (default_action == Fdb_default_filter)
+                sysbits_clear(model.defaults[v], (unsigned)port_no);
+        }
+        if (step % 500 == 499)
+            check_against_model();
+    }
+    check_against_model();
+    fdb_destroy_fdb();
+}
+static void test_out_of_range(void)
+{
+    Octet address[6];
+    test_address(1, address);
+    check(fdb_create_fdb(4, 1), "database created");
+    fdb_forward(Fdb_number_of_vlans, 0, address);
+    fdb_forward(1, 4, address);
+    fdb_forward(1, -1, address);
+    check((Boolean)(fdb_number_of_entries() == 0),
+          "changes out of range are ignored");
+    check((Boolean)!fdb_remove(1, address),
+          "nothing to remove for an address without an entry");
+    fdb_destroy_fdb();
+}
+static void test_queued_removal(void)
+{ /*
+   * A removal queued after a change for the same address is made after it,
+   * and only when the queue is programmed; a removal the queue has no room
+   * for is refused.
+   */
+    Octet address[6];
+    Octet other[6];
+    test_address(7, address);
+    test_address(8, other);
+    check(fdb_create_fdb(4, 4), "database created");
+    check(fdq_create_fdq(2, 0), "queue created");
+    check(fdq_forward(1, 2, address), "forward queued");
+    check(fdq_remove(1, address), "removal queued");
+    check((Boolean)!fdq_remove(1, other), "removal refused when full");
+    check((Boolean)!fdb_forwarding(1, 2, address),
+          "nothing is changed until the queue is programmed");
+    check(fdq_program(), "queue programmed");
+    check((Boolean)((fdb_number_of_entries() == 0) &&
+                    !fdb_forwarding(1, 2, address)),
+          "the entry is created and then removed");
+    check(fdq_forward(1, 3, other), "forward queued after programming");
+    check(fdq_program(), "queue programmed again");
+    check(fdb_forwarding(1, 3, other), "forward made");
+    check(fdq_remove(1, other), "removal queued again");
+    check(fdq_program(), "queue programmed once more");
+    check((Boolean)(fdb_number_of_entries() == 0), "entry removed");
+    fdq_destroy_fdq();
+    fdb_destroy_fdb();
+}
+int main(void)
+{
+    test_random_changes();
+    test_out_of_range();
+    test_queued_removal();
+    if (failures != 0)
+        printf("%d checks failed\n", failures);
+    return (failures != 0);
+}
@@ -0,0 +1,491 @@
+/* gid_test.c */
+#include <stdio.h>
+#include <string.h>
+#include "gid.h"
+#include "gidtt.h"
+#include "gip.h"
+/******************************************************************************
+ * GID TEST : DEFERRED LEAVEALL CHECKS
+ ******************************************************************************
+ *
+ * Drives the ports of an application through the gid_ functions with random
+ * received messages, requests, management directives, LeaveAlls (received,
+ * and generated when the leaveall timer runs out), transmit opportunities
+ * (some of whose messages are taken back), and leave timer expiries. Each
+ * is also applied to a model of each port whose machines are changed by
+ * gidtt_ functions directly, each LeaveAll being applied to every machine
+ * at once, as GID did before LeaveAll processing was deferred. After each
+ * step the scratchpad flags, transmit indices, indications, and messages
+ * transmitted of the two must agree, and from time to time the states of
+ * every machine and the attributes found to be unused. Returns non-zero if
+ * any check fails.
+ */
+enum
+{
+    Test_ports = 2,
+    Test_attributes = 150,
+    Test_steps = 200000,
+    Test_full_check = 1000, /* steps between checks of every machine */
+    Test_max_indications = Test_ports * Test_attributes
+};
+typedef struct /* Test_model */
+{ /*
+   * A port's machines with every LeaveAll applied eagerly, and the
+   * scratchpad flags, transmit state, and leaveall countdown they give.
+   * Only the scratchpad flags of the Gid are used.
+   */
+    Gid_machine machines[Test_attributes];
+    Gid_machine untransmit;
+    Gid scratchpad;
+    Boolean tx_pending;
+    unsigned last_transmitted;
+    unsigned last_to_transmit;
+    int leaveall_countdown;
+} Test_model;
+typedef struct /* Test_indications */
+{ /*
+   * Join and leave indications, in order: each one's port, GID index, and
+   * whether it is a join.
+   */
+    int port_nos[Test_max_indications];
+    unsigned indices[Test_max_indications];
+    Boolean joins[Test_max_indications];
+    unsigned number;
+} Test_indications;
+static Garp application;
+static Gid *ports[Test_ports];
+static Test_model models[Test_ports];
+static Test_indications given;
+static Test_indications expected;
+static int failures = 0;
+static unsigned long long test_random = 0x9E3779B97F4A7C15ull;
+static void check(Boolean ok, char *what)
+{
+    if (!ok)
+    {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+static unsigned test_next(unsigned range)
+{
+    test_random = test_random * 6364136223846793005ull +
+                  1442695040888963407ull;
+    return ((unsigned)(test_random >> 33) % range);
+}
+static void test_note(Test_indications *indications, int port_no,
+                      unsigned index, Boolean join)
+{
+    if (indications->number < Test_max_indications)
+    {
+        indications->port_nos[indications->number] = port_no;
+        indications->indices[indications->number] = index;
+        indications->joins[indications->number] = join;
+    }
+    indications->number++;
+}
+static void test_join_indication(void *garp, void *gid, unsigned index)
+{
+    test_note(&given, ((Gid *)gid)->port_no, index, True);
+}
+static void test_leave_indication(void *garp, void *gid, unsigned index)
+{
+    test_note(&given, ((Gid *)gid)->port_no, index, False);
+}
+static void test_propagated(void *garp, void *gid, unsigned index)
+{
+}
+static void test_port(void *garp, int port_no)
+{
+}
+static void test_model_create(Test_model *model)
+{ /*
+   * As gid_create_port() leaves a port.
+   */
+    unsigned index;
+    memset(model, 0, sizeof(*model));
+    for (index = 0; index < Test_attributes; index++)
+        gidtt_init(&model->machines[index]);
+    model->last_transmitted = Test_attributes - 1;
+    model->last_to_transmit = Test_attributes - 1;
+    model->leaveall_countdown = Gid_leaveall_count;
+}
+static void test_create(void)
+{ /*
+   * An application without an arena or timers, with unconnected ports, so
+   * that nothing is propagated and no timer expires but when called.
+   */
+    int port_no;
+    memset(&application, 0, sizeof(application));
+    application.max_gid_index = Test_attributes - 1;
+    application.last_gid_used = Test_attributes - 1;
+    check((Boolean)(gip_create_gip(&application, Test_attributes) &&
+                    gid_create_application(&application)),
+          "application created");
+    application.join_indication_fn = test_join_indication;
+    application.leave_indication_fn = test_leave_indication;
+    application.join_propagated_fn = test_propagated;
+    application.leave_propagated_fn = test_propagated;
+    application.added_port_fn = test_port;
+    application.removed_port_fn = test_port;
+    for (port_no = 0; port_no < Test_ports; port_no++)
+    {
+        check((Boolean)(gid_create_port(&application, port_no) &&
+                        gid_find_port(&application, port_no,
+                                      &ports[port_no])),
+              "port created");
+        test_model_create(&models[port_no]);
+    }
+}
+static void test_model_event(int port_no, unsigned index, Gid_event event)
+{
+    Gid_event result;
+    result = gidtt_event(&models[port_no].scratchpad,
+                         &models[port_no].machines[index], event);
+    if (result == Gid_join)
+        test_note(&expected, port_no, index, True);
+    else if (result == Gid_leave)
+        test_note(&expected, port_no, index, False);
+}
+static void test_model_leaveall(int port_no)
+{
+    unsigned index;
+    for (index = 0; index < Test_attributes; index++)
+        test_model_event(port_no, index, Gid_rcv_leaveempty);
+}
+static void test_model_leaveall_timer_expired(int port_no)
+{ /*
+   * As gid_leaveall_timer_expired(), which leaves the join timer running
+   * in place of a request to start it.
+   */
+    Test_model *model = &models[port_no];
+    if (model->leaveall_countdown > 1)
+        model->leaveall_countdown--;
+    else
+    {
+        test_model_leaveall(port_no);
+        model->leaveall_countdown = 0;
+        model->scratchpad.cstart_join_timer = False;
+    }
+}
+static void test_model_do_actions(Test_model *model)
+{ /*
+   * As gid_do_actions() without the hold timer, which is never started
+   * here.
+   */
+    if (model->scratchpad.cstart_join_timer)
+    {
+        model->last_to_transmit = model->last_transmitted;
+        model->tx_pending = True;
+    }
+    model->scratchpad.cschedule_tx_now = False;
+    model->scratchpad.cstart_join_timer = False;
+    model->scratchpad.cstart_leave_timer = False;
+}
+static void test_model_leave_timer_expired(int port_no)
+{
+    Test_model *model = &models[port_no];
+    unsigned index;
+    for (index = 0; index < Test_attributes; index++)
+        if (gidtt_leaving(&model->machines[index]) &&
+            (gidtt_leave_timer_expiry(&model->scratchpad,
+                                      &model->machines[index]) == Gid_leave))
+            test_note(&expected, port_no, index, False);
+    test_model_do_actions(model);
+}
+static Boolean test_model_find_tx(Test_model *model, unsigned from_index,
+                                  unsigned to_index, unsigned *found_index)
+{
+    unsigned index;
+    for (index = from_index; index <= to_index; index++)
+        if (gidtt_tx_pending(&model->machines[index]))
+        {
+            *found_index = index;
+            return (True);
+        }
+    return (False);
+}
+static Gid_event test_model_next_tx(Test_model *model, unsigned *index)
+{ /*
+   * As gid_next_tx(), examining every machine in turn.
+   */
+    unsigned check_index;
+    unsigned stop_after;
+    Gid_event msg;
+    if (model->leaveall_countdown == 0)
+    {
+        model->leaveall_countdown = Gid_leaveall_count;
+        return (Gid_tx_leaveall);
+    }
+    if (!model->tx_pending)
+        return (Gid_null);
+    check_index = model->last_transmitted + 1;
+    if (check_index > Test_attributes - 1)
+        check_index = 0;
+    stop_after = model->last_to_transmit;
+    if (stop_after < check_index)
+        stop_after = Test_attributes - 1;
+    for (;; check_index++)
+    {
+        if (!test_model_find_tx(model, check_index, stop_after, &check_index))
+        {
+            if ((stop_after == model->last_to_transmit) ||
+                !test_model_find_tx(model, 0, model->last_to_transmit,
+                                    &check_index))
+            {
+                model->tx_pending = False;
+                return (Gid_null);
+            }
+            stop_after = model->last_to_transmit;
+        }
+        model->untransmit = model->machines[check_index];
+        msg = gidtt_tx(&model->scratchpad, &model->machines[check_index]);
+        if (msg != Gid_null)
+        {
+            *index = model->last_transmitted = check_index;
+            model->tx_pending = (check_index != model->last_to_transmit);
+            return (msg);
+        }
+    }
+}
+static void test_model_untx(Test_model *model)
+{
+    model->machines[model->last_transmitted] = model->untransmit;
+    if (model->last_transmitted == 0)
+        model->last_transmitted = Test_attributes - 1;
+    else
+        model->last_transmitted--;
+    model->tx_pending = True;
+}
+static Boolean test_model_find_unused(unsigned from_index,
+                                      unsigned *found_index)
+{
+    unsigned index;
+    int port_no;
+    for (index = from_index; index < Test_attributes; index++)
+    {
+        for (port_no = 0; port_no < Test_ports; port_no++)
+            if (gidtt_machine_active(&models[port_no].machines[index]))
+                break;
+        if (port_no == Test_ports)
+        {
+            *found_index = index;
+            return (True);
+        }
+    }
+    return (False);
+}
+static Boolean test_same_states(Gid *my_port, Test_model *model,
+                                unsigned index)
+{ /*
+   * Reads the state of the port's machine, which applies any LeaveAll
+   * processing pending for it.
+   */
+    Gid_states states;
+    Gid_states model_states;
+    gid_read_attribute_state(my_port, index, &states);
+    gidtt_states(&model->machines[index], &model_states);
+    return ((Boolean)((states.applicant_state ==
+                       model_states.applicant_state) &&
+                      (states.applicant_mgt == model_states.applicant_mgt) &&
+                      (states.registrar_state ==
+                       model_states.registrar_state) &&
+                      (states.registrar_mgt == model_states.registrar_mgt)));
+}
+static Boolean test_same_port(Gid *my_port, Test_model *model)
+{
+    return ((Boolean)((my_port->cschedule_tx_now ==
+                       model->scratchpad.cschedule_tx_now) &&
+                      (my_port->cstart_join_timer ==
+                       model->scratchpad.cstart_join_timer) &&
+                      (my_port->cstart_leave_timer ==
+                       model->scratchpad.cstart_leave_timer) &&
+                      (my_port->tx_pending == model->tx_pending) &&
+                      (my_port->last_transmitted ==
+                       model->last_transmitted) &&
+                      (my_port->last_to_transmit ==
+                       model->last_to_transmit) &&
+                      (my_port->leaveall_countdown ==
+                       model->leaveall_countdown)));
+}
+static Boolean test_same_indications(void)
+{
+    unsigned i;
+    Boolean same = (Boolean)(given.number == expected.number);
+    for (i = 0; same && (i < given.number) && (i < Test_max_indications);
+         i++)
+        if ((given.port_nos[i] != expected.port_nos[i]) ||
+            (given.indices[i] != expected.indices[i]) ||
+            (given.joins[i] != expected.joins[i]))
+            same = False;
+    given.number = 0;
+    expected.number = 0;
+    return (same);
+}
+static Bitword test_word(void)
+{
+    Bitword word = 0;
+    unsigned i;
+    for (i = 0; i < Bitword_bits / 16; i++)
+        word = (word << 16) | test_next(1 << 16);
+    return (word);
+}
+static void test_transmit(int port_no, Boolean *tx_ok)
+{ /*
+   * Takes a few messages, as an application filling a PDU would, and
+   * sometimes takes the last back.
+   */
+    Gid_event msg = Gid_null;
+    Gid_event model_msg;
+    unsigned index = 0;
+    unsigned model_index = 0;
+    unsigned number = 1 + test_next(8);
+    for (; number > 0; number--)
+    {
+        msg = gid_next_tx(ports[port_no], &index);
+        model_msg = test_model_next_tx(&models[port_no], &model_index);
+        if ((msg != model_msg) ||
+            ((msg != Gid_null) && (msg != Gid_tx_leaveall) &&
+             (index != model_index)))
+            *tx_ok = False;
+        if ((msg == Gid_null) || (msg != model_msg))
+            return;
+    }
+    if ((msg != Gid_tx_leaveall) && (test_next(4) == 0))
+    {
+        gid_untx(ports[port_no]);
+        test_model_untx(&models[port_no]);
+    }
+}
+static void test_random_operations(void)
+{
+    static Gid_event messages[] = {Gid_rcv_leaveempty, Gid_rcv_leavein,
+                                   Gid_rcv_empty, Gid_rcv_joinempty,
+                                   Gid_rcv_joinin};
+    static Gid_event directives[] = {Gid_normal_operation, Gid_no_protocol,
+                                     Gid_normal_registration,
+                                     Gid_fix_registration,
+                                     Gid_forbid_registration};
+    Gid_event event;
+    Bitword selected;
+    unsigned step;
+    unsigned index;
+    unsigned from_index;
+    unsigned found;
+    unsigned model_found;
+    unsigned n;
+    int port_no;
+    Boolean found_unused;
+    Boolean ports_ok = True;
+    Boolean indications_ok = True;
+    Boolean tx_ok = True;
+    Boolean states_ok = True;
+    Boolean registered_ok = True;
+    Boolean unused_ok = True;
+    for (step = 0; step < Test_steps; step++)
+    {
+        port_no = (int)test_next(Test_ports);
+        index = test_next(Test_attributes);
+        switch (test_next(16))
+        {
+        case 0: case 1: case 2: case 3: case 4:
+            event = messages[test_next(5)];
+            gid_rcv_msg(ports[port_no], index, event);
+            test_model_event(port_no, index, event);
+            break;
+        case 5: case 6:
+            event = (test_next(2) == 0) ? Gid_join : Gid_leave;
+            if (event == Gid_join)
+                gid_join_request(ports[port_no], index);
+            else
+                gid_leave_request(ports[port_no], index);
+            test_model_event(port_no, index, event);
+            break;
+        case 7: case 8:
+            event = (test_next(2) == 0) ? Gid_join : Gid_leave;
+            from_index = index - index % Bitword_bits;
+            selected = test_word();
+            if (event == Gid_join)
+                gid_join_requests(ports[port_no], from_index, selected);
+            else
+                gid_leave_requests(ports[port_no], from_index, selected);
+            for (n = 0; (n < Bitword_bits) &&
+                        (from_index + n < Test_attributes); n++)
+                if ((selected >> n) & 1)
+                    test_model_event(port_no, from_index + n, event);
+            break;
+        case 9:
+            event = directives[test_next(5)];
+            gid_manage_attribute(ports[port_no], index, event);
+            test_model_event(port_no, index, event);
+            break;
+        case 10:
+            gid_rcv_leaveall(ports[port_no]);
+            test_model_leaveall(port_no);
+            models[port_no].leaveall_countdown = Gid_leaveall_count;
+            break;
+        case 11:
+            gid_leaveall_timer_expired(&application, port_no);
+            test_model_leaveall_timer_expired(port_no);
+            break;
+        case 12: case 13:
+            test_transmit(port_no, &tx_ok);
+            break;
+        case 14:
+            gid_leave_timer_expired(&application, port_no);
+            test_model_leave_timer_expired(port_no);
+            break;
+        default:
+            found = model_found = Test_attributes;
+            found_unused = gid_find_unused(&application, index, &found);
+            if ((found_unused !=
+                 test_model_find_unused(index, &model_found)) ||
+                (found != model_found))
+                unused_ok = False;
+            break;
+        }
+        for (port_no = 0; port_no < Test_ports; port_no++)
+            if (!test_same_port(ports[port_no], &models[port_no]))
+                ports_ok = False;
+        if (!test_same_indications())
+            indications_ok = False;
+        port_no = (int)test_next(Test_ports);
+        index = test_next(Test_attributes);
+        if (gid_registered_here(ports[port_no], index) !=
+            gidtt_in(&models[port_no].machines[index]))
+            registered_ok = False;
+        if (!test_same_states(ports[port_no], &models[port_no], index))
+            states_ok = False;
+        if (step % Test_full_check == 0)
+            for (port_no = 0; port_no < Test_ports; port_no++)
+                for (index = 0; index < Test_attributes; index++)
+                    if (!test_same_states(ports[port_no], &models[port_no],
+                                          index))
+                        states_ok = False;
+        if (test_next(2) == 0)
+            for (port_no = 0; port_no < Test_ports; port_no++)
+            {
+                gid_do_actions(ports[port_no]);
+                test_model_do_actions(&models[port_no]);
+            }
+    }
+    check(ports_ok, "scratchpad flags and transmit state agree");
+    check(indications_ok, "join and leave indications agree");
+    check(tx_ok, "messages transmitted agree");
+    check(registered_ok, "registrations agree");
+    check(states_ok, "machine states agree");
+    check(unused_ok, "unused attributes found agree");
+}
+int main(void)
+{
+    int port_no;
+    test_create();
+    test_random_operations();
+    for (port_no = 0; port_no < Test_ports; port_no++)
+        gid_destroy_port(&application, port_no);
+    gid_destroy_application(&application);
+    gip_destroy_gip(&application);
+    if (failures != 0)
+        printf("%d checks failed\n", failures);
+    return (failures != 0);
+}
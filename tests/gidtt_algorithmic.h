@@ -0,0 +1,34 @@
+/* gidtt_algorithmic.h */
+#ifndef gidtt_algorithmic_h__
+#define gidtt_algorithmic_h__
+#include "gid.h"
+/******************************************************************************
+ * GIDTT ALGORITHMIC : SECOND BUILD OF THE GID ENGINE FOR COMPARISON
+ ******************************************************************************
+ *
+ * The gidtt_algorithmic library is gidtt.c built with GIDTT_ALGORITHMIC and
+ * each external function renamed from gidtt_ to gidtt_alg_ (see
+ * CMakeLists.txt), so that it can be linked alongside the table build and
+ * both engines driven from one program. Only the functions that differ
+ * between the builds, and those needed to set them up, are declared here.
+ */
+extern void gidtt_alg_build_tables(void);
+extern Gid_event gidtt_alg_event(Gid *my_port,
+                                 Gid_machine *machine,
+                                 Gid_event event);
+extern Gid_event gidtt_alg_tx(Gid *my_port,
+                              Gid_machine *machine);
+extern Gid_event gidtt_alg_leave_timer_expiry(Gid *my_port,
+                                              Gid_machine *machine);
+extern void gidtt_alg_leaveall(Gid_machine *machine, Boolean even);
+extern Boolean gidtt_alg_starts_join_timer(Gid_machine *machine,
+                                           Gid_event event);
+extern Boolean gidtt_alg_starts_leave_timer(Gid_machine *machine,
+                                            Gid_event event);
+extern Boolean gidtt_alg_in(Gid_machine *machine);
+extern Boolean gidtt_alg_tx_pending(Gid_machine *machine);
+extern Boolean gidtt_alg_leaving(Gid_machine *machine);
+extern Boolean gidtt_alg_machine_active(Gid_machine *machine);
+extern void gidtt_alg_states(Gid_machine *machine,
+                             Gid_states *state);
+#endif /* gidtt_algorithmic_h__ */
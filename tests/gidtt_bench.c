@@ -0,0 +1,146 @@
+/* gidtt_bench.c */
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "gid.h"
+#include "gidtt.h"
+#include "gidtt_algorithmic.h"
+/******************************************************************************
+ * GIDTT BENCHMARK : TABLE AND ALGORITHMIC ENGINES
+ ******************************************************************************
+ *
+ * Times the two engines on the same random mix of receive events, requests,
+ * transmit opportunities, and leave timer expiries applied one machine at a
+ * time across a port's worth of machines, and reports the time taken per
+ * transition. The mix is generated before timing starts, and each pass
+ * shifts it by one machine so that each machine sees a sequence of events.
+ * The optional arguments are the number of machines and the number of
+ * passes over them.
+ */
+enum
+{
+    Bench_tx = Gid_leave + 1,
+    Bench_leave_timer = Gid_leave + 2,
+    Bench_kinds = Gid_leave + 3
+};
+static unsigned long long bench_random = 0x2545F4914F6CDD1Dull;
+static unsigned bench_next(void)
+{
+    bench_random = bench_random * 6364136223846793005ull +
+                   1442695040888963407ull;
+    return ((unsigned)(bench_random >> 33));
+}
+static double bench_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((double)now.tv_sec + (double)now.tv_nsec / 1e9);
+}
+static double bench_table(Gid *my_port, Gid_machine *machines,
+                          Octet *kinds, unsigned number_of_machines,
+                          unsigned passes, unsigned *results)
+{
+    double started = bench_seconds();
+    unsigned pass;
+    unsigned i;
+    Gid_event result;
+    for (pass = 0; pass < passes; pass++)
+    {
+        for (i = 0; i < number_of_machines; i++)
+        {
+            if (kinds[pass + i] == Bench_tx)
+                result = gidtt_tx(my_port, &machines[i]);
+            else if (kinds[pass + i] == Bench_leave_timer)
+                result = gidtt_leave_timer_expiry(my_port, &machines[i]);
+            else
+                result = gidtt_event(my_port, &machines[i],
+                                     (Gid_event)kinds[pass + i]);
+            *results += (unsigned)result;
+        }
+    }
+    return (bench_seconds() - started);
+}
+static double bench_algorithmic(Gid *my_port, Gid_machine *machines,
+                                Octet *kinds, unsigned number_of_machines,
+                                unsigned passes, unsigned *results)
+{
+    double started = bench_seconds();
+    unsigned pass;
+    unsigned i;
+    Gid_event result;
+    for (pass = 0; pass < passes; pass++)
+    {
+        for (i = 0; i < number_of_machines; i++)
+        {
+            if (kinds[pass + i] == Bench_tx)
+                result = gidtt_alg_tx(my_port, &machines[i]);
+            else if (kinds[pass + i] == Bench_leave_timer)
+                result = gidtt_alg_leave_timer_expiry(my_port, &machines[i]);
+            else
+                result = gidtt_alg_event(my_port, &machines[i],
+                                         (Gid_event)kinds[pass + i]);
+            *results += (unsigned)result;
+        }
+    }
+    return (bench_seconds() - started);
+}
+int main(int argc, char **argv)
+{
+    unsigned number_of_machines = 4096;
+    unsigned passes = 2000;
+    unsigned table_results = 0;
+    unsigned alg_results = 0;
+    Gid_machine *table_machines;
+    Gid_machine *alg_machines;
+    Octet *kinds;
+    Gid my_port;
+    double table_time;
+    double alg_time;
+    double transitions;
+    unsigned i;
+    if (argc > 1)
+        number_of_machines = (unsigned)strtoul(argv[1], NULL, 0);
+    if (argc > 2)
+        passes = (unsigned)strtoul(argv[2], NULL, 0);
+    if ((number_of_machines == 0) || (passes == 0))
+        return (1);
+    table_machines = malloc(sizeof(Gid_machine) * number_of_machines);
+    alg_machines = malloc(sizeof(Gid_machine) * number_of_machines);
+    kinds = malloc((size_t)number_of_machines + passes);
+    if ((table_machines == NULL) || (alg_machines == NULL) || (kinds == NULL))
+        return (1);
+    gidtt_build_tables();
+    gidtt_alg_build_tables();
+    for (i = 0; i < number_of_machines; i++)
+    {
+        gidtt_init(&table_machines[i]);
+        alg_machines[i] = table_machines[i];
+    }
+    for (i = 0; i < number_of_machines + passes; i++)
+        kinds[i] = (Octet)(bench_next() % Bench_kinds);
+    memset(&my_port, 0, sizeof(my_port));
+    table_time = bench_table(&my_port, table_machines, kinds,
+                             number_of_machines, passes, &table_results);
+    memset(&my_port, 0, sizeof(my_port));
+    alg_time = bench_algorithmic(&my_port, alg_machines, kinds,
+                                 number_of_machines, passes, &alg_results);
+    transitions = (double)number_of_machines * passes;
+    printf("%u machines, %u passes\n", number_of_machines, passes);
+    printf("tables:      %6.2f ns per transition\n",
+           table_time * 1e9 / transitions);
+    printf("algorithmic: %6.2f ns per transition\n",
+           alg_time * 1e9 / transitions);
+    if ((table_results != alg_results) ||
+        (memcmp(table_machines, alg_machines,
+                sizeof(Gid_machine) * number_of_machines) != 0))
+    {
+        printf("FAIL: the engines finished in different states\n");
+        return (1);
+    }
+    free(kinds);
+    free(alg_machines);
+    free(table_machines);
+    return (0);
+}
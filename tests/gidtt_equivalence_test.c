@@ -0,0 +1,144 @@
+/* gidtt_equivalence_test.c */
+#include <stdio.h>
+#include <string.h>
+#include "gid.h"
+#include "gidtt.h"
+#include "gidtt_algorithmic.h"
+/******************************************************************************
+ * GIDTT EQUIVALENCE TEST : TABLE AND ALGORITHMIC ENGINES
+ ******************************************************************************
+ *
+ * Puts a machine of each engine in each of the combined states in turn and
+ * checks that every receive event, request and management event, transmit
+ * opportunity, leave timer expiry, and LeaveAll gives both the same result,
+ * the same scratchpad flags, and the same new state, and that every state
+ * predicate agrees. Returns non-zero if any case differs.
+ */
+enum
+{
+    Number_of_single_events = Gid_forbid_registration + 1
+};
+static int failures = 0;
+static unsigned cases = 0;
+static void check(Boolean ok, unsigned state, char *what, int event)
+{
+    cases++;
+    if (!ok)
+    {
+        printf("FAIL: state %u (applicant %u, registrar %u): %s %d\n",
+               state, state % 14, state / 14, what, event);
+        failures++;
+    }
+}
+static Boolean same_transition(Gid *table_port, Gid_machine *table_machine,
+                               Gid_event table_result, Gid *alg_port,
+                               Gid_machine *alg_machine, Gid_event alg_result)
+{
+    return ((Boolean)((table_result == alg_result) &&
+                      (table_machine->state == alg_machine->state) &&
+                      (table_port->cschedule_tx_now ==
+                       alg_port->cschedule_tx_now) &&
+                      (table_port->cstart_join_timer ==
+                       alg_port->cstart_join_timer) &&
+                      (table_port->cstart_leave_timer ==
+                       alg_port->cstart_leave_timer)));
+}
+static void start(unsigned state, Gid *table_port, Gid_machine *table_machine,
+                  Gid *alg_port, Gid_machine *alg_machine)
+{
+    memset(table_port, 0, sizeof(*table_port));
+    memset(alg_port, 0, sizeof(*alg_port));
+    table_machine->state = (Octet)state;
+    alg_machine->state = (Octet)state;
+}
+static void test_transitions(unsigned state)
+{
+    Gid table_port, alg_port;
+    Gid_machine table_machine, alg_machine;
+    Gid_event table_result, alg_result;
+    unsigned event;
+    for (event = 0; event < Number_of_single_events; event++)
+    {
+        start(state, &table_port, &table_machine, &alg_port, &alg_machine);
+        table_result = gidtt_event(&table_port, &table_machine,
+                                   (Gid_event)event);
+        alg_result = gidtt_alg_event(&alg_port, &alg_machine,
+                                     (Gid_event)event);
+        check(same_transition(&table_port, &table_machine, table_result,
+                              &alg_port, &alg_machine, alg_result),
+              state, "event", (int)event);
+    }
+    start(state, &table_port, &table_machine, &alg_port, &alg_machine);
+    table_result = gidtt_tx(&table_port, &table_machine);
+    alg_result = gidtt_alg_tx(&alg_port, &alg_machine);
+    check(same_transition(&table_port, &table_machine, table_result,
+                          &alg_port, &alg_machine, alg_result),
+          state, "transmit opportunity", 0);
+    start(state, &table_port, &table_machine, &alg_port, &alg_machine);
+    table_result = gidtt_leave_timer_expiry(&table_port, &table_machine);
+    alg_result = gidtt_alg_leave_timer_expiry(&alg_port, &alg_machine);
+    check(same_transition(&table_port, &table_machine, table_result,
+                          &alg_port, &alg_machine, alg_result),
+          state, "leave timer expiry", 0);
+    for (event = 0; event < 2; event++)
+    {
+        start(state, &table_port, &table_machine, &alg_port, &alg_machine);
+        gidtt_leaveall(&table_machine, (Boolean)event);
+        gidtt_alg_leaveall(&alg_machine, (Boolean)event);
+        check((Boolean)(table_machine.state == alg_machine.state), state,
+              "LeaveAll, even", (int)event);
+    }
+}
+static void test_predicates(unsigned state)
+{
+    Gid_machine machine;
+    Gid_states table_states, alg_states;
+    unsigned event;
+    machine.state = (Octet)state;
+    check((Boolean)(gidtt_in(&machine) == gidtt_alg_in(&machine)), state,
+          "in", 0);
+    check((Boolean)(gidtt_tx_pending(&machine) ==
+                    gidtt_alg_tx_pending(&machine)),
+          state, "tx pending", 0);
+    check((Boolean)(gidtt_leaving(&machine) == gidtt_alg_leaving(&machine)),
+          state, "leaving", 0);
+    check((Boolean)(gidtt_machine_active(&machine) ==
+                    gidtt_alg_machine_active(&machine)),
+          state, "machine active", 0);
+    gidtt_states(&machine, &table_states);
+    gidtt_alg_states(&machine, &alg_states);
+    check((Boolean)((table_states.applicant_state ==
+                     alg_states.applicant_state) &&
+                    (table_states.applicant_mgt == alg_states.applicant_mgt) &&
+                    (table_states.registrar_state ==
+                     alg_states.registrar_state) &&
+                    (table_states.registrar_mgt == alg_states.registrar_mgt)),
+          state, "states", 0);
+    for (event = 0; event < Number_of_single_events; event++)
+    {
+        check((Boolean)(gidtt_starts_join_timer(&machine, (Gid_event)event) ==
+                        gidtt_alg_starts_join_timer(&machine,
+                                                    (Gid_event)event)),
+              state, "starts join timer, event", (int)event);
+        check((Boolean)(gidtt_starts_leave_timer(&machine, (Gid_event)event) ==
+                        gidtt_alg_starts_leave_timer(&machine,
+                                                     (Gid_event)event)),
+              state, "starts leave timer, event", (int)event);
+    }
+}
+int main(void)
+{
+    unsigned state;
+    gidtt_build_tables();
+    gidtt_alg_build_tables();
+    for (state = 0; state < Number_of_gid_machine_states; state++)
+    {
+        test_transitions(state);
+        test_predicates(state);
+    }
+    printf("%u cases compared over %u states\n", cases,
+           (unsigned)Number_of_gid_machine_states);
+    if (failures != 0)
+        printf("%d cases differ\n", failures);
+    return (failures != 0);
+}
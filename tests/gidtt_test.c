@@ -0,0 +1,215 @@
+/* gidtt_test.c */
+#include <stdio.h>
+#include <string.h>
+#include "gid.h"
+#include "gidtt.h"
+/******************************************************************************
+ * GIDTT TEST : TRANSITION TABLE CHECKS
+ ******************************************************************************
+ *
+ * Checks transitions of the GID transition tables against 802.1D, driving a
+ * single machine from the unused state by events alone, and checks, from
+ * every state, the properties of Leaveempty on which deferred LeaveAll
+ * processing relies. Returns non-zero if any check fails.
+ */
+static int failures = 0;
+static void check(Boolean ok, char *what)
+{
+    if (!ok)
+    {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+static void quiet_passive_member(Gid *my_port, Gid_machine *machine)
+{ /*
+   * Vo, then Vp on a Join request, then Ap and Qp on two JoinIns received.
+   */
+    Gid_states states;
+    gidtt_init(machine);
+    (void)gidtt_event(my_port, machine, Gid_join);
+    (void)gidtt_event(my_port, machine, Gid_rcv_joinin);
+    (void)gidtt_event(my_port, machine, Gid_rcv_joinin);
+    gidtt_states(machine, &states);
+    check((Boolean)(states.applicant_state == Quiet), "Qp reached");
+}
+static void test_quiet_passive_member_stays_quiet(Gid *my_port)
+{ /*
+   * Events that leave the Applicant alone must not make a Quiet passive
+   * member Very anxious (the Qp column once held Vp).
+   */
+    static Gid_event events[] = {Gid_null, Gid_normal_registration,
+                                 Gid_fix_registration,
+                                 Gid_forbid_registration};
+    Gid_machine machine;
+    Gid_states states;
+    unsigned i;
+    for (i = 0; i < sizeof(events) / sizeof(events[0]); i++)
+    {
+        quiet_passive_member(my_port, &machine);
+        (void)gidtt_event(my_port, &machine, events[i]);
+        gidtt_states(&machine, &states);
+        check((Boolean)(states.applicant_state == Quiet),
+              "Qp stays Quiet on an event that leaves the Applicant alone");
+        check((Boolean)!gidtt_tx_pending(&machine),
+              "Qp has nothing to transmit after the event");
+    }
+}
+static void test_forbid_fixed_registrar(Gid *my_port)
+{ /*
+   * Forbidding registration on a fixed Registrar, in or leaving, gives a
+   * leave indication and makes the Registrar forbidden, as it does for a
+   * normal one (the fixed rows once stayed fixed).
+   */
+    static Gid_event leave_events[] = {Gid_null, Gid_rcv_leaveempty};
+    Gid_machine machine;
+    Gid_states states;
+    unsigned i;
+    for (i = 0; i < sizeof(leave_events) / sizeof(leave_events[0]); i++)
+    {
+        gidtt_init(&machine);
+        (void)gidtt_event(my_port, &machine, Gid_rcv_joinin);
+        (void)gidtt_event(my_port, &machine, Gid_fix_registration);
+        (void)gidtt_event(my_port, &machine, leave_events[i]);
+        check(gidtt_in(&machine), "fixed Registrar is in");
+        check((Boolean)(gidtt_event(my_port, &machine,
+                                    Gid_forbid_registration) == Gid_leave),
+              "forbidding a fixed Registrar gives a leave indication");
+        gidtt_states(&machine, &states);
+        check((Boolean)(states.registrar_mgt == Registration_forbidden),
+              "forbidding a fixed Registrar makes it forbidden");
+        check((Boolean)!gidtt_in(&machine), "forbidden Registrar is not in");
+        check((Boolean)(gidtt_event(my_port, &machine, Gid_rcv_joinin) ==
+                        Gid_null),
+              "forbidden Registrar gives no join indication");
+    }
+}
+static void test_event_range_matches_single_machines(void)
+{ /*
+   * Applying an event to a range of machines, with every other machine
+   * selected, must change each selected machine as gidtt_event() would,
+   * report its indication, leave the others alone, and set the same
+   * scratchpad flags. The range is long enough for whole chunks of the
+   * byte shuffle kernel, where the processor has one, and a remainder.
+   */
+    enum
+    {
+        Machines = 4 * Bitword_bits + 5
+    };
+    static Gid_event events[] = {Gid_rcv_leaveempty, Gid_rcv_joinin,
+                                 Gid_rcv_empty, Gid_join, Gid_leave,
+                                 Gid_fix_registration,
+                                 Gid_forbid_registration};
+    Gid_machine machines[Machines];
+    Gid_machine expected[Machines];
+    Bitword selected[Machines / Bitword_bits + 1];
+    Bitword joins[Machines / Bitword_bits + 1];
+    Bitword leaves[Machines / Bitword_bits + 1];
+    Gid range_port;
+    Gid single_port;
+    Gid_event result;
+    unsigned i;
+    unsigned m;
+    for (i = 0; i < sizeof(events) / sizeof(events[0]); i++)
+    {
+        memset(&range_port, 0, sizeof(range_port));
+        memset(&single_port, 0, sizeof(single_port));
+        sysbits_zero(selected, Machines);
+        for (m = 0; m < Machines; m++)
+        {
+            machines[m].state = (Octet)((m * 37 + i) %
+                                        Number_of_gid_machine_states);
+            expected[m] = machines[m];
+            if (m % 2 == 0)
+                sysbits_set(selected, m);
+        }
+        gidtt_event_range(&range_port, machines, Machines, events[i],
+                          selected, joins, leaves);
+        for (m = 0; m < Machines; m++)
+        {
+            result = Gid_null;
+            if (m % 2 == 0)
+                result = gidtt_event(&single_port, &expected[m], events[i]);
+            check((Boolean)(machines[m].state == expected[m].state),
+                  "range gives the new state of each machine");
+            check((Boolean)(sysbits_test(joins, m) == (result == Gid_join)),
+                  "range reports each join indication");
+            check((Boolean)(sysbits_test(leaves, m) == (result == Gid_leave)),
+                  "range reports each leave indication");
+        }
+        check((Boolean)((range_port.cschedule_tx_now ==
+                         single_port.cschedule_tx_now) &&
+                        (range_port.cstart_join_timer ==
+                         single_port.cstart_join_timer) &&
+                        (range_port.cstart_leave_timer ==
+                         single_port.cstart_leave_timer)),
+              "range sets the scratchpad flags of its machines");
+    }
+}
+static void test_leaveempty_repeats(void)
+{ /*
+   * LeaveAll processing is deferred on the strength of these: from every
+   * state a third Leaveempty leaves a machine as the first did, so only
+   * whether an odd or even number are pending matters; no Leaveempty gives
+   * an indication; and none after the first starts a timer or schedules a
+   * transmission, so the scratchpad is complete once the first is counted.
+   */
+    Gid_machine once;
+    Gid_machine thrice;
+    Gid_machine twice;
+    Gid_machine deferred;
+    Gid first_port;
+    Gid later_port;
+    unsigned s;
+    Boolean ok = True;
+    Boolean quiet = True;
+    Boolean no_indication = True;
+    Boolean deferred_ok = True;
+    for (s = 0; s < Number_of_gid_machine_states; s++)
+    {
+        memset(&first_port, 0, sizeof(first_port));
+        memset(&later_port, 0, sizeof(later_port));
+        once.state = (Octet)s;
+        if (gidtt_event(&first_port, &once, Gid_rcv_leaveempty) != Gid_null)
+            no_indication = False;
+        thrice = once;
+        if ((gidtt_starts_join_timer(&thrice, Gid_rcv_leaveempty)) ||
+            (gidtt_starts_leave_timer(&thrice, Gid_rcv_leaveempty)))
+            quiet = False;
+        if (gidtt_event(&later_port, &thrice, Gid_rcv_leaveempty) != Gid_null)
+            no_indication = False;
+        twice = thrice;
+        if (gidtt_event(&later_port, &thrice, Gid_rcv_leaveempty) != Gid_null)
+            no_indication = False;
+        if (later_port.cschedule_tx_now || later_port.cstart_join_timer ||
+            later_port.cstart_leave_timer)
+            quiet = False;
+        if (thrice.state != once.state)
+            ok = False;
+        deferred.state = (Octet)s;
+        gidtt_leaveall(&deferred, False);
+        if (deferred.state != once.state)
+            deferred_ok = False;
+        deferred.state = (Octet)s;
+        gidtt_leaveall(&deferred, True);
+        if (deferred.state != twice.state)
+            deferred_ok = False;
+    }
+    check(ok, "a third Leaveempty leaves every state as the first did");
+    check(no_indication, "no Leaveempty gives an indication");
+    check(quiet, "no Leaveempty after the first starts a timer");
+    check(deferred_ok, "deferred LeaveAlls apply one or two Leaveemptys");
+}
+int main(void)
+{
+    Gid my_port;
+    memset(&my_port, 0, sizeof(my_port));
+    gidtt_build_tables();
+    test_quiet_passive_member_stays_quiet(&my_port);
+    test_forbid_fixed_registrar(&my_port);
+    test_event_range_matches_single_machines();
+    test_leaveempty_repeats();
+    if (failures != 0)
+        printf("%d checks failed\n", failures);
+    return (failures != 0);
+}
@@ -0,0 +1,605 @@
+/* gip_test.c */
+#include <stdio.h>
+#include <string.h>
+#include "gid.h"
+#include "gidtt.h"
+#include "gip.h"
+/******************************************************************************
+ * GIP TEST : CONNECTING SETS OF PORTS AND CARRYING OUT ACTIONS
+ ******************************************************************************
+ *
+ * Runs two applications side by side with the same ports - more than fit
+ * in a Bitword, one never created, and one disabled - and the same random
+ * registrations, and connects and disconnects random sets of their ports:
+ * the first with gip_connect_ports() and gip_disconnect_ports(), the second
+ * with gip_connect_port() and gip_disconnect_port() for each port in the set
+ * in turn. The ports connected or disconnected, the join and leave requests
+ * made to each port for each attribute, the sets of registrants of each
+ * attribute, and the states of every machine must be the same for both.
+ *
+ * Then drives both with the same random events, carrying out the actions
+ * of the first with gip_do_actions(), which visits the ports with actions,
+ * and of the second by walking all its connected ports. The timers started
+ * for each port, the ports left with actions, and each port's flags must
+ * be the same for both after every event.
+ *
+ * GIP is built with the GID requests it makes renamed to those below, and
+ * GID with the timers it starts and its call to gip_do_actions(), so that
+ * every request and timer is seen. Returns non-zero if any check fails.
+ */
+enum
+{
+    Test_batched = 0,
+    Test_single = 1,
+    Test_applications = 2,
+    Test_ports = 70,
+    Test_missing_port = 5,  /* never created */
+    Test_disabled_port = 9, /* created, but not enabled */
+    Test_attributes = 150,
+    Test_rounds = 400,
+    Test_messages = 40, /* received on each application between rounds */
+    Test_steps = 20000,
+    Test_tx_messages = 8 /* most taken at a transmit opportunity */
+};
+enum /* Test_timer */
+{
+    Test_join_timer,
+    Test_tx_now,
+    Test_leave_timer,
+    Test_hold_timer,
+    Test_leaveall_timer,
+    Test_timers
+};
+enum /* Test_event */
+{
+    Test_received,
+    Test_requested,
+    Test_join_expired,
+    Test_hold_expired,
+    Test_leave_expired,
+    Test_leaveall_expired,
+    Test_connected,
+    Test_events
+};
+typedef struct /* Test_requests */
+{ /*
+   * The join and leave requests made by GIP to each port for each attribute
+   * since they were last cleared.
+   */
+    unsigned joins[Test_ports][Test_attributes];
+    unsigned leaves[Test_ports][Test_attributes];
+} Test_requests;
+static Garp applications[Test_applications];
+static Test_requests requests[Test_applications];
+static unsigned timers[Test_applications][Test_ports][Test_timers];
+static Boolean walk_all[Test_applications];
+static unsigned tx_messages = 0;
+static Boolean test_untx = False;
+static int failures = 0;
+static unsigned long long test_random = 0x9E3779B97F4A7C15ull;
+static void check(Boolean ok, char *what)
+{
+    if (!ok)
+    {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+static unsigned test_next(unsigned range)
+{
+    test_random = test_random * 6364136223846793005ull +
+                  1442695040888963407ull;
+    return ((unsigned)(test_random >> 33) % range);
+}
+static Test_requests *test_requests(Gid *my_port)
+{
+    return (&requests[my_port->application - applications]);
+}
+void test_gid_join_request(Gid *my_port, unsigned gid_index)
+{ /*
+   * Called by GIP in place of gid_join_request(), and the other three in
+   * place of the GID request functions they are named for.
+   */
+    test_requests(my_port)->joins[my_port->port_no][gid_index]++;
+    gid_join_request(my_port, gid_index);
+}
+void test_gid_leave_request(Gid *my_port, unsigned gid_index)
+{
+    test_requests(my_port)->leaves[my_port->port_no][gid_index]++;
+    gid_leave_request(my_port, gid_index);
+}
+void test_gid_join_requests(Gid *my_port, unsigned from_index,
+                            Bitword selected)
+{
+    unsigned n;
+    for (n = 0; (n < Bitword_bits) && (from_index + n < Test_attributes); n++)
+        if ((selected >> n) & 1)
+            test_requests(my_port)->joins[my_port->port_no][from_index + n]++;
+    gid_join_requests(my_port, from_index, selected);
+}
+void test_gid_leave_requests(Gid *my_port, unsigned from_index,
+                             Bitword selected)
+{
+    unsigned n;
+    for (n = 0; (n < Bitword_bits) && (from_index + n < Test_attributes); n++)
+        if ((selected >> n) & 1)
+            test_requests(my_port)->leaves[my_port->port_no][from_index + n]++;
+    gid_leave_requests(my_port, from_index, selected);
+}
+static void test_timer_started(int process_id, int port_no, unsigned timer)
+{
+    if ((process_id >= 0) && (process_id < Test_applications) &&
+        (port_no >= 0) && (port_no < Test_ports))
+        timers[process_id][port_no][timer]++;
+}
+void test_systime_start_timer(int process_id,
+                              void (*expiry_fn)(void *, int instance_id),
+                              int instance_id, int timeout)
+{ /*
+   * Called by GID in place of systime_start_timer(), and the other two in
+   * place of the timer functions they are named for. The process_id of
+   * each application is its place in the applications array.
+   */
+    unsigned timer = Test_leaveall_timer;
+    if (expiry_fn == (void (*)(void *, int))gid_leave_timer_expired)
+        timer = Test_leave_timer;
+    else if (expiry_fn == (void (*)(void *, int))gid_hold_timer_expired)
+        timer = Test_hold_timer;
+    test_timer_started(process_id, instance_id, timer);
+    systime_start_timer(process_id, expiry_fn, instance_id, timeout);
+}
+void test_systime_start_random_timer(int process_id,
+                                     void (*expiry_fn)(void *,
+                                                       int instance_id),
+                                     int instance_id, int timeout)
+{
+    test_timer_started(process_id, instance_id, Test_join_timer);
+    systime_start_random_timer(process_id, expiry_fn, instance_id, timeout);
+}
+void test_systime_schedule(int process_id,
+                           void (*expiry_fn)(void *, int instance_id),
+                           int instance_id)
+{
+    test_timer_started(process_id, instance_id, Test_tx_now);
+    systime_schedule(process_id, expiry_fn, instance_id);
+}
+void test_gip_do_actions(Gid *my_port)
+{ /*
+   * Called by GID in place of gip_do_actions(). An application marked to
+   * walk all its ports has the actions of every connected port carried out,
+   * as gip_do_actions() did before it visited only the ports with actions.
+   */
+    Garp *application = my_port->application;
+    int i;
+    if (!walk_all[application - applications])
+        gip_do_actions(my_port);
+    else if (!my_port->is_connected)
+        gid_do_actions(my_port);
+    else
+        for (i = 0; i < application->number_of_connected_ports; i++)
+            gid_do_actions(application->gid[application->connected_ports[i]]);
+}
+static void test_transmit(void *garp, void *gid)
+{ /*
+   * Takes the number of messages it is told to at a transmit opportunity,
+   * and when told to puts the last back, as GMR does when the Filtering
+   * Database is busy; at times it takes none, leaving the join timer to be
+   * started again at the next actions carried out for the port.
+   */
+    Gid_event msg = Gid_null;
+    unsigned index;
+    unsigned i;
+    for (i = 0; i < tx_messages; i++)
+        if ((msg = gid_next_tx((Gid *)gid, &index)) == Gid_null)
+            break;
+    if (test_untx && (msg != Gid_null))
+        gid_untx((Gid *)gid);
+}
+static void test_indication(void *garp, void *gid, unsigned index)
+{
+}
+static void test_port(void *garp, int port_no)
+{
+}
+static void test_create(Garp *application)
+{ /*
+   * An application without an arena or timers.
+   */
+    Gid *my_port;
+    int port_no;
+    memset(application, 0, sizeof(*application));
+    application->max_gid_index = Test_attributes - 1;
+    application->last_gid_used = Test_attributes - 1;
+    check((Boolean)(gip_create_gip(application, Test_attributes) &&
+                    gid_create_application(application)),
+          "application created");
+    application->join_indication_fn = test_indication;
+    application->leave_indication_fn = test_indication;
+    application->join_propagated_fn = test_indication;
+    application->leave_propagated_fn = test_indication;
+    application->added_port_fn = test_port;
+    application->removed_port_fn = test_port;
+    application->transmit_fn = test_transmit;
+    for (port_no = 0; port_no < Test_ports; port_no++)
+        if (port_no != Test_missing_port)
+            check(gid_create_port(application, port_no), "port created");
+    if (gid_find_port(application, Test_disabled_port, &my_port))
+        my_port->is_enabled = False;
+}
+static void test_destroy(Garp *application)
+{
+    int port_no;
+    for (port_no = 0; port_no < Test_ports; port_no++)
+        gid_destroy_port(application, port_no);
+    gid_destroy_application(application);
+    gip_destroy_gip(application);
+}
+static void test_receive(void)
+{ /*
+   * Gives both applications the same received messages, and sometimes
+   * expires the leave timer of the port, which completes the leaves.
+   */
+    static Gid_event messages[] = {Gid_rcv_joinin, Gid_rcv_joinin,
+                                   Gid_rcv_joinempty, Gid_rcv_leavein,
+                                   Gid_rcv_leaveempty, Gid_rcv_empty};
+    Gid *my_port;
+    Gid_event msg;
+    unsigned index;
+    unsigned i;
+    unsigned a;
+    int port_no;
+    for (i = 0; i < Test_messages; i++)
+    {
+        port_no = (int)test_next(Test_ports);
+        index = test_next(Test_attributes);
+        msg = messages[test_next(sizeof(messages) / sizeof(messages[0]))];
+        for (a = 0; a < Test_applications; a++)
+        {
+            if (!gid_find_port(&applications[a], port_no, &my_port))
+                continue;
+            gid_rcv_msg(my_port, index, msg);
+            gip_do_actions(my_port);
+        }
+        if (test_next(8) == 0)
+            for (a = 0; a < Test_applications; a++)
+                gid_leave_timer_expired(&applications[a], port_no);
+    }
+}
+static Boolean test_same_ports(Bitword *batched, Bitword *single)
+{ /*
+   * Returns whether the sets of ports connected or disconnected agree, and
+   * the ports are connected in both or in neither.
+   */
+    Gid *batched_port;
+    Gid *single_port;
+    int port_no;
+    if (memcmp(batched, single, sizeof(Bitword) * sysbits_words(Test_ports)))
+        return (False);
+    for (port_no = 0; port_no < Test_ports; port_no++)
+        if (gid_find_port(&applications[Test_batched], port_no,
+                          &batched_port) &&
+            gid_find_port(&applications[Test_single], port_no,
+                          &single_port) &&
+            (batched_port->is_connected != single_port->is_connected))
+            return (False);
+    return ((Boolean)(applications[Test_batched].number_of_connected_ports ==
+                      applications[Test_single].number_of_connected_ports));
+}
+static Boolean test_same_registrants(void)
+{
+    Garp *batched = &applications[Test_batched];
+    Garp *single = &applications[Test_single];
+    return ((Boolean)((batched->gip_port_words == single->gip_port_words) &&
+                      (memcmp(batched->gip, single->gip,
+                              sizeof(Bitword) * batched->gip_port_words *
+                                  Test_attributes) == 0)));
+}
+static void test_settle(Garp *application)
+{ /*
+   * Carries out the GID actions left for every port. gip_do_actions()
+   * carries out those of each port once, and a port for which an immediate
+   * transmission was scheduled in place of starting the join timer is left
+   * with the timer to start. The ports connected one at a time have had
+   * their actions carried out as many times as there were ports, those
+   * connected together once.
+   */
+    unsigned port_no;
+    while (sysbits_find_set(application->ports_with_actions, 0,
+                            (unsigned)application->gid_table_size - 1,
+                            &port_no))
+        gid_do_actions(application->gid[port_no]);
+}
+static Boolean test_any_requests(void)
+{
+    unsigned index;
+    int port_no;
+    for (port_no = 0; port_no < Test_ports; port_no++)
+        for (index = 0; index < Test_attributes; index++)
+            if (requests[Test_batched].joins[port_no][index] +
+                    requests[Test_batched].leaves[port_no][index] !=
+                0)
+                return (True);
+    return (False);
+}
+static Boolean test_same_flags(void)
+{ /*
+   * Compares each port's scratchpad and timers.
+   */
+    Gid *batched_port;
+    Gid *single_port;
+    int port_no;
+    for (port_no = 0; port_no < Test_ports; port_no++)
+    {
+        if (!gid_find_port(&applications[Test_batched], port_no,
+                           &batched_port) ||
+            !gid_find_port(&applications[Test_single], port_no, &single_port))
+            continue;
+        if ((batched_port->cschedule_tx_now != single_port->cschedule_tx_now) ||
+            (batched_port->cstart_join_timer !=
+             single_port->cstart_join_timer) ||
+            (batched_port->cstart_leave_timer !=
+             single_port->cstart_leave_timer) ||
+            (batched_port->tx_pending != single_port->tx_pending) ||
+            (batched_port->join_timer_running !=
+             single_port->join_timer_running) ||
+            (batched_port->leave_timer_running !=
+             single_port->leave_timer_running) ||
+            (batched_port->last_to_transmit != single_port->last_to_transmit))
+            return (False);
+    }
+    return (True);
+}
+static Boolean test_same_machines(void)
+{ /*
+   * Compares the state of every machine, and of each port's scratchpad and
+   * timers once the actions left for it have been carried out.
+   */
+    Gid *batched_port;
+    Gid *single_port;
+    Gid_states batched_states;
+    Gid_states single_states;
+    unsigned index;
+    int port_no;
+    test_settle(&applications[Test_batched]);
+    test_settle(&applications[Test_single]);
+    if (!test_same_flags())
+        return (False);
+    for (port_no = 0; port_no < Test_ports; port_no++)
+    {
+        if (!gid_find_port(&applications[Test_batched], port_no,
+                           &batched_port) ||
+            !gid_find_port(&applications[Test_single], port_no, &single_port))
+            continue;
+        for (index = 0; index < Test_attributes; index++)
+        {
+            gid_read_attribute_state(batched_port, index, &batched_states);
+            gid_read_attribute_state(single_port, index, &single_states);
+            if ((batched_states.applicant_state !=
+                 single_states.applicant_state) ||
+                (batched_states.registrar_state !=
+                 single_states.registrar_state))
+                return (False);
+        }
+    }
+    return (True);
+}
+static Boolean test_same_requests(void)
+{ /*
+   * Returns whether join and leave requests were made to the same ports for
+   * the same attributes. A request made twice has the effect of one, and
+   * the numbers of requests can differ: in a set of ports disconnected
+   * together, one may be asked to leave an attribute both because another
+   * port in the set registers it and because that port's leave is then
+   * propagated to every port still connected.
+   */
+    Test_requests *batched = &requests[Test_batched];
+    Test_requests *single = &requests[Test_single];
+    unsigned index;
+    int port_no;
+    for (port_no = 0; port_no < Test_ports; port_no++)
+        for (index = 0; index < Test_attributes; index++)
+            if (((batched->joins[port_no][index] == 0) !=
+                 (single->joins[port_no][index] == 0)) ||
+                ((batched->leaves[port_no][index] == 0) !=
+                 (single->leaves[port_no][index] == 0)))
+                return (False);
+    return (True);
+}
+static void test_connect_sets(void)
+{ /*
+   * Each round picks a set of ports, including at times ports that are
+   * missing, disabled, or already in the state asked for, and connects or
+   * disconnects them, after the applications have received the same
+   * messages.
+   */
+    Bitword picked[sysbits_words(Test_ports)];
+    Bitword batched[sysbits_words(Test_ports)];
+    Bitword single[sysbits_words(Test_ports)];
+    Gid *my_port;
+    unsigned round;
+    unsigned share;
+    unsigned moved;
+    int port_no;
+    Boolean connect;
+    Boolean was_connected;
+    Boolean ports_ok = True;
+    Boolean requests_ok = True;
+    Boolean registrants_ok = True;
+    Boolean machines_ok = True;
+    unsigned busy_rounds = 0;
+    for (round = 0; round < Test_rounds; round++)
+    {
+        test_receive();
+        connect = (Boolean)(test_next(2) == 0);
+        share = 1 + test_next(4); /* about one port in share + 1 */
+        sysbits_zero(picked, Test_ports);
+        for (port_no = 0; port_no < Test_ports; port_no++)
+            if (test_next(share + 1) == 0)
+                sysbits_set(picked, (unsigned)port_no);
+        memcpy(batched, picked, sizeof(picked));
+        sysbits_zero(single, Test_ports);
+        memset(requests, 0, sizeof(requests));
+        if (connect)
+            gip_connect_ports(&applications[Test_batched], batched);
+        else
+            gip_disconnect_ports(&applications[Test_batched], batched);
+        for (port_no = 0; port_no < Test_ports; port_no++)
+        {
+            if (!sysbits_test(picked, (unsigned)port_no))
+                continue;
+            was_connected = (Boolean)(
+                gid_find_port(&applications[Test_single], port_no,
+                              &my_port) &&
+                my_port->is_connected);
+            if (connect)
+                gip_connect_port(&applications[Test_single], port_no);
+            else
+                gip_disconnect_port(&applications[Test_single], port_no);
+            if (gid_find_port(&applications[Test_single], port_no,
+                              &my_port) &&
+                (my_port->is_connected != was_connected))
+                sysbits_set(single, (unsigned)port_no);
+        }
+        if (!test_same_ports(batched, single))
+            ports_ok = False;
+        if (!test_same_requests())
+            requests_ok = False;
+        if (!test_same_registrants())
+            registrants_ok = False;
+        if (!test_same_machines())
+            machines_ok = False;
+        for (port_no = 0, moved = 0; port_no < Test_ports; port_no++)
+            if (sysbits_test(batched, (unsigned)port_no))
+                moved++;
+        if ((moved > 1) && test_any_requests())
+            busy_rounds++;
+    }
+    check(ports_ok, "the same ports are connected and disconnected");
+    check(requests_ok, "the same requests are made to each port");
+    check(registrants_ok, "the sets of registrants agree");
+    check(machines_ok, "the machines agree");
+    check((Boolean)(busy_rounds > Test_rounds / 4),
+          "many rounds connect or disconnect several ports with requests");
+}
+static void test_event(Garp *application, unsigned event, int port_no,
+                       unsigned index, Gid_event msg, Boolean join)
+{
+    Gid *my_port;
+    switch (event)
+    {
+    case Test_received:
+    case Test_requested:
+        if (!gid_find_port(application, port_no, &my_port))
+            break;
+        if (event == Test_received)
+            gid_rcv_msg(my_port, index, msg);
+        else if (join)
+            gid_join_request(my_port, index);
+        else
+            gid_leave_request(my_port, index);
+        test_gip_do_actions(my_port);
+        break;
+    case Test_join_expired:
+        gid_join_timer_expired(application, port_no);
+        break;
+    case Test_hold_expired:
+        gid_hold_timer_expired(application, port_no);
+        break;
+    case Test_leave_expired:
+        gid_leave_timer_expired(application, port_no);
+        break;
+    case Test_leaveall_expired:
+        gid_leaveall_timer_expired(application, port_no);
+        break;
+    default:
+        if (join)
+            gip_connect_port(application, port_no);
+        else
+            gip_disconnect_port(application, port_no);
+        break;
+    }
+}
+static void test_do_actions(void)
+{ /*
+   * Gives both applications the same events - messages received, join and
+   * leave requests, the expiry of each timer, and ports connected and
+   * disconnected - and compares the timers started for each port, the ports
+   * left with actions, and the ports' flags after each. Connecting and
+   * disconnecting a port carries out the actions with gip_do_actions() for
+   * both, the rest as each application is marked to.
+   */
+    static Gid_event messages[] = {Gid_rcv_joinin, Gid_rcv_joinempty,
+                                   Gid_rcv_leavein, Gid_rcv_leaveempty,
+                                   Gid_rcv_empty};
+    Garp *batched = &applications[Test_batched];
+    Garp *single = &applications[Test_single];
+    unsigned step;
+    unsigned event;
+    unsigned index;
+    unsigned a;
+    int port_no;
+    Gid_event msg;
+    Boolean join;
+    Boolean timers_ok = True;
+    Boolean actions_ok = True;
+    Boolean flags_ok = True;
+    unsigned busy_steps = 0;
+    walk_all[Test_single] = True;
+    for (step = 0; step < Test_steps; step++)
+    {
+        event = test_next(Test_events + 3); /* messages four times as often */
+        if (event >= Test_events)
+            event = Test_received;
+        port_no = (int)test_next(Test_ports);
+        index = test_next(Test_attributes);
+        msg = messages[test_next(sizeof(messages) / sizeof(messages[0]))];
+        join = (Boolean)(test_next(2) == 0);
+        tx_messages = test_next(Test_tx_messages + 1);
+        test_untx = (Boolean)(test_next(4) == 0);
+        memset(timers, 0, sizeof(timers));
+        for (a = 0; a < Test_applications; a++)
+            test_event(&applications[a], event, port_no, index, msg, join);
+        if (memcmp(timers[Test_batched], timers[Test_single],
+                   sizeof(timers[Test_batched])))
+            timers_ok = False;
+        if ((batched->gid_table_size != single->gid_table_size) ||
+            memcmp(batched->ports_with_actions, single->ports_with_actions,
+                   sizeof(Bitword) *
+                       sysbits_words((unsigned)batched->gid_table_size)))
+            actions_ok = False;
+        if (!test_same_flags())
+            flags_ok = False;
+        for (port_no = 0; port_no < Test_ports; port_no++)
+            if (timers[Test_batched][port_no][Test_join_timer] +
+                    timers[Test_batched][port_no][Test_tx_now] +
+                    timers[Test_batched][port_no][Test_leave_timer] !=
+                0)
+            {
+                busy_steps++;
+                break;
+            }
+    }
+    walk_all[Test_single] = False;
+    check(timers_ok, "the same timers are started for each port");
+    check(actions_ok, "the same ports are left with actions");
+    check(flags_ok, "the ports' flags agree");
+    check(test_same_machines(), "the machines agree after the events");
+    check((Boolean)(busy_steps > Test_steps / 8),
+          "many events start join or leave timers");
+}
+int main(void)
+{
+    unsigned a;
+    for (a = 0; a < Test_applications; a++)
+    {
+        test_create(&applications[a]);
+        applications[a].process_id = (int)a;
+    }
+    test_connect_sets();
+    test_do_actions();
+    for (a = 0; a < Test_applications; a++)
+        test_destroy(&applications[a]);
+    if (failures != 0)
+        printf("%d checks failed\n", failures);
+    return (failures != 0);
+}
@@ -0,0 +1,341 @@
+/* gmf_test.c */
+#include <stdio.h>
+#include <string.h>
+#include "sys.h"
+#include "prw.h"
+#include "gmr.h"
+#include "gmf.h"
+/******************************************************************************
+ * GMF TEST : GMRP PDU PARSING CHECKS
+ ******************************************************************************
+ *
+ * Checks the messages read from hand built PDUs: that a PDU with an
+ * Attribute Length below two, or an attribute or End Mark running past its
+ * end, or with the wrong Protocol ID, yields no message at all; and that
+ * from a well formed PDU lists of unknown attribute types, attributes with
+ * unknown events or values of the wrong length (a LeaveAll carrying a
+ * value among them), and bad legacy controls are skipped while the
+ * messages around them are read. Checks too that PDUs written are read back
+ * as written, that gmf_wrmsg_room() promises room only where a Group
+ * attribute fits, and that a PDU is filled to exactly its size and no
+ * further, down to Gmf_min_pdu_size. Returns non-zero if any check fails.
+ */
+enum
+{
+    Test_pdus = 4,
+    Test_max_octets = 64,
+    Test_no_key = -1 /* a LeaveAll */
+};
+typedef struct /* Test_msg */
+{ /*
+   * A message expected: its attribute type, event, and the last octet of
+   * its multicast address, or its legacy control.
+   */
+    Attribute_type attribute;
+    Gid_event event;
+    int key;
+} Test_msg;
+static int failures = 0;
+static void check(Boolean ok, char *what)
+{
+    if (!ok)
+    {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+static void test_parse(Octet *octets, int length, Test_msg *expected,
+                       unsigned number_expected, char *what)
+{ /*
+   * Reads the messages of a PDU holding length octets and compares them
+   * with those expected.
+   */
+    Pdu *pdu;
+    Gmf gmf;
+    Gmf_msg msg;
+    Octet *pdu_octets;
+    int number_of_octets;
+    unsigned number = 0;
+    int key;
+    Boolean ok = True;
+    if (!syspdu_alloc(&pdu))
+    {
+        check(False, "PDU allocated");
+        return;
+    }
+    pdu_octets = syspdu_octets(pdu, &number_of_octets);
+    memcpy(pdu_octets, octets, (size_t)length);
+    syspdu_set_length(pdu, length);
+    gmf_rdmsg_init(&gmf, pdu);
+    while (gmf_rdmsg(&gmf, &msg))
+    {
+        if (msg.event == Gid_rcv_leaveall)
+            key = (msg.key1 == NULL) ? Test_no_key : -2;
+        else if (msg.attribute == Legacy_attribute)
+            key = (int)msg.legacy_control;
+        else
+            key = (msg.key1 == NULL) ? -2 : msg.key1[5];
+        if ((number >= number_expected) ||
+            (msg.attribute != expected[number].attribute) ||
+            (msg.event != expected[number].event) ||
+            (key != expected[number].key) || (msg.key2 != NULL))
+            ok = False;
+        number++;
+    }
+    check((Boolean)(ok && (number == number_expected)), what);
+    syspdu_free(pdu);
+}
+static int test_group(Octet *octets, Octet event, Octet address)
+{ /*
+   * Writes a Group attribute, returning its length.
+   */
+    octets[0] = Gmf_group_length;
+    octets[1] = event;
+    octets[2] = 0x01;
+    octets[3] = 0x00;
+    octets[4] = 0x5e;
+    octets[5] = 0x00;
+    octets[6] = 0x00;
+    octets[7] = address;
+    return (Gmf_group_length);
+}
+static void test_well_formed(void)
+{ /*
+   * One of each message, in a Group list and a Service Requirement list.
+   */
+    static Test_msg expected[] = {
+        {Multicast_attribute, Gid_rcv_leaveall, Test_no_key},
+        {Multicast_attribute, Gid_rcv_joinin, 7},
+        {Multicast_attribute, Gid_rcv_joinempty, 8},
+        {Multicast_attribute, Gid_rcv_leavein, 9},
+        {Multicast_attribute, Gid_rcv_leaveempty, 10},
+        {Multicast_attribute, Gid_rcv_empty, 11},
+        {Legacy_attribute, Gid_rcv_joinin, Forward_unregistered}};
+    Octet octets[Test_max_octets];
+    int n = 0;
+    octets[n++] = 0x00;
+    octets[n++] = 0x01;
+    octets[n++] = Gmf_group_attribute_type;
+    octets[n++] = Gmf_leaveall_length;
+    octets[n++] = 0;
+    n += test_group(&octets[n], 2, 7);
+    n += test_group(&octets[n], 1, 8);
+    n += test_group(&octets[n], 4, 9);
+    n += test_group(&octets[n], 3, 10);
+    n += test_group(&octets[n], 5, 11);
+    octets[n++] = Gmf_end_mark;
+    octets[n++] = Gmf_service_requirement_attribute_type;
+    octets[n++] = Gmf_service_requirement_length;
+    octets[n++] = 2;
+    octets[n++] = Forward_unregistered;
+    octets[n++] = Gmf_end_mark;
+    octets[n++] = Gmf_end_mark;
+    test_parse(octets, n, expected, 7, "a well formed PDU is read");
+    test_parse(octets, n - 1, expected, 7,
+               "a PDU may end with its last list");
+    octets[n] = 0x55; /* padding after the End Mark */
+    octets[n + 1] = 0x01;
+    test_parse(octets, n + 2, expected, 7, "padding is ignored");
+}
+static void test_malformed(void)
+{ /*
+   * Each PDU holds a good message before the fault, which must not be read.
+   */
+    Octet octets[Test_max_octets];
+    int n;
+    n = 0;
+    octets[n++] = 0x00;
+    octets[n++] = 0x01;
+    octets[n++] = Gmf_group_attribute_type;
+    n += test_group(&octets[n], 2, 7);
+    octets[n++] = 1; /* too short for its own length and event */
+    octets[n++] = 2;
+    octets[n++] = Gmf_end_mark;
+    octets[n++] = Gmf_end_mark;
+    test_parse(octets, n, NULL, 0, "an Attribute Length of one is refused");
+    octets[11] = Gmf_end_mark;
+    octets[12] = Gmf_group_attribute_type;
+    octets[13] = 1;
+    octets[14] = 2;
+    octets[15] = Gmf_end_mark;
+    octets[16] = Gmf_end_mark;
+    test_parse(octets, 17, NULL, 0,
+               "an Attribute Length of one in a later list is refused");
+    n = 0;
+    octets[n++] = 0x00;
+    octets[n++] = 0x01;
+    octets[n++] = Gmf_group_attribute_type;
+    n += test_group(&octets[n], 2, 7);
+    n += test_group(&octets[n], 2, 8);
+    test_parse(octets, n - 1, NULL, 0,
+               "an attribute running past the PDU is refused");
+    test_parse(octets, n, NULL, 0,
+               "a list whose End Mark is past the PDU is refused");
+    octets[n++] = Gmf_end_mark;
+    octets[n++] = Gmf_service_requirement_attribute_type;
+    test_parse(octets, n, NULL, 0,
+               "an empty list running past the PDU is refused");
+    octets[0] = 0x00;
+    octets[1] = 0x02;
+    octets[n - 1] = Gmf_end_mark;
+    test_parse(octets, n, NULL, 0, "a wrong Protocol ID is refused");
+    test_parse(octets, 1, NULL, 0, "a PDU too short for its ID is refused");
+}
+static void test_skipped(void)
+{ /*
+   * Messages that cannot be understood are skipped, and those around them
+   * read.
+   */
+    static Test_msg expected[] = {
+        {Multicast_attribute, Gid_rcv_joinin, 7},
+        {Multicast_attribute, Gid_rcv_leavein, 8},
+        {Legacy_attribute, Gid_rcv_joinempty, Forward_all},
+        {Legacy_attribute, Gid_rcv_leaveall, Test_no_key}};
+    Octet octets[Test_max_octets];
+    int n = 0;
+    int i;
+    octets[n++] = 0x00;
+    octets[n++] = 0x01;
+    octets[n++] = 3; /* an attribute type GMRP does not use */
+    n += test_group(&octets[n], 2, 1);
+    octets[n++] = Gmf_end_mark;
+    octets[n++] = Gmf_group_attribute_type;
+    n += test_group(&octets[n], 6, 2); /* an unknown event */
+    n += test_group(&octets[n], 2, 7);
+    n += test_group(&octets[n], 0, 3);  /* a LeaveAll carrying a value */
+    octets[n++] = Gmf_group_length - 1; /* a value a little short */
+    octets[n++] = 2;
+    for (i = 0; i < 5; i++)
+        octets[n++] = 0x01;
+    octets[n++] = Gmf_leaveall_length; /* a JoinIn without a value */
+    octets[n++] = 2;
+    octets[n++] = 3; /* a legacy control in a Group list */
+    octets[n++] = 2;
+    octets[n++] = Forward_all;
+    n += test_group(&octets[n], 4, 8);
+    octets[n++] = Gmf_end_mark;
+    octets[n++] = Gmf_service_requirement_attribute_type;
+    octets[n++] = Gmf_service_requirement_length;
+    octets[n++] = 2;
+    octets[n++] = 2; /* a legacy control that is not defined */
+    octets[n++] = Gmf_service_requirement_length;
+    octets[n++] = 2;
+    octets[n++] = 0xff;
+    octets[n++] = Gmf_service_requirement_length;
+    octets[n++] = 0; /* a LeaveAll carrying a value */
+    octets[n++] = Forward_all;
+    octets[n++] = Gmf_service_requirement_length;
+    octets[n++] = 1;
+    octets[n++] = Forward_all;
+    octets[n++] = Gmf_leaveall_length;
+    octets[n++] = 0;
+    octets[n++] = Gmf_end_mark;
+    octets[n++] = Gmf_end_mark;
+    test_parse(octets, n, expected, 4,
+               "messages not understood are skipped");
+}
+static unsigned test_write(unsigned pdu_size, Boolean mixed, int *length)
+{ /*
+   * Writes messages to a PDU of pdu_size octets, while gmf_wrmsg_room()
+   * says there is room - a LeaveAll and a legacy control, if mixed, and then
+   * Group attributes - and returns the number of Group attributes written,
+   * and the length of the PDU. The PDU must then refuse another, and be read
+   * back as written.
+   */
+    static Test_msg expected[Test_max_octets];
+    Octet address[6] = {0x01, 0x00, 0x5e, 0x00, 0x00, 0x00};
+    Pdu *pdu;
+    Gmf gmf;
+    Gmf_msg msg;
+    Octet *octets;
+    unsigned number = 0;
+    unsigned groups = 0;
+    *length = 0;
+    if (!syspdu_alloc(&pdu))
+    {
+        check(False, "PDU allocated");
+        return (0);
+    }
+    gmf_wrmsg_init(&gmf, pdu, 1, pdu_size);
+    msg.key1 = address;
+    msg.key2 = NULL;
+    if (mixed && gmf_wrmsg_room(&gmf))
+    {
+        msg.attribute = Multicast_attribute;
+        msg.event = Gid_tx_leaveall;
+        check(gmf_wrmsg(&gmf, &msg), "LeaveAll written");
+        expected[number].attribute = Multicast_attribute;
+        expected[number].event = Gid_rcv_leaveall;
+        expected[number++].key = Test_no_key;
+        msg.attribute = Legacy_attribute;
+        msg.event = Gid_tx_joinin;
+        msg.legacy_control = Forward_all;
+        check(gmf_wrmsg(&gmf, &msg), "legacy control written");
+        expected[number].attribute = Legacy_attribute;
+        expected[number].event = Gid_rcv_joinin;
+        expected[number++].key = Forward_all;
+    }
+    msg.attribute = Multicast_attribute;
+    msg.event = Gid_tx_joinempty;
+    while (gmf_wrmsg_room(&gmf))
+    {
+        address[5] = (Octet)groups;
+        check(gmf_wrmsg(&gmf, &msg), "Group attribute written");
+        expected[number].attribute = Multicast_attribute;
+        expected[number].event = Gid_rcv_joinempty;
+        expected[number++].key = (int)groups++;
+    }
+    check((Boolean)!gmf_wrmsg(&gmf, &msg),
+          "no Group attribute is written without room");
+    if (gmf_wrmsg_done(&gmf))
+    {
+        octets = syspdu_octets(pdu, length);
+        test_parse(octets, *length, expected, number,
+                   "a PDU written is read back");
+    }
+    syspdu_free(pdu);
+    return (groups);
+}
+static void test_write_sizes(void)
+{ /*
+   * A PDU of a Group list of three attributes takes 2 + 1 + 3 * 8 + 1 + 1
+   * octets. A LeaveAll, in a Group list, then a legacy control, in a list of
+   * its own, and two Group attributes, in another, take 2 + (1 + 2) + (1 +
+   * 1 + 3) + (1 + 1 + 2 * 8) + 1 + 1.
+   */
+    unsigned groups = 2 + 1 + 3 * 8 + 1 + 1;
+    unsigned mixed = 2 + (1 + 2) + (1 + 1 + 3) + (1 + 1 + 2 * 8) + 1 + 1;
+    int length;
+    check((Boolean)((test_write(groups, False, &length) == 3) &&
+                    (length == (int)groups)),
+          "three Group attributes fill a PDU of their size exactly");
+    check((Boolean)(test_write(groups - 1, False, &length) == 2),
+          "and two fit in one octet less");
+    check((Boolean)((test_write(Gmf_min_pdu_size, False, &length) == 1) &&
+                    (length == Gmf_min_pdu_size)),
+          "one Group attribute fills the smallest PDU");
+    check((Boolean)((test_write(Gmf_min_pdu_size - 1, False, &length) == 0) &&
+                    (length == 0)),
+          "nothing is written to a PDU below the smallest size");
+    check((Boolean)((test_write(mixed, True, &length) == 2) &&
+                    (length == (int)mixed)),
+          "a LeaveAll, a legacy control, and two Group attributes fit");
+    check((Boolean)(test_write(mixed - 1, True, &length) == 1),
+          "and only one Group attribute in one octet less");
+    check((Boolean)((test_write(Gmf_jumbo_pdu_size, False, &length) ==
+                     (Test_max_octets - 5) / 8) &&
+                    (length <= Test_max_octets)),
+          "a PDU size beyond the buffer is limited to the buffer");
+}
+int main(void)
+{
+    check(syspdu_create_pool(Test_pdus, Test_max_octets), "pool created");
+    test_well_formed();
+    test_malformed();
+    test_skipped();
+    test_write_sizes();
+    syspdu_destroy_pool();
+    if (failures != 0)
+        printf("%d checks failed\n", failures);
+    return (failures != 0);
+}
@@ -0,0 +1,694 @@
+/* gmr_test.c */
+#include <stdio.h>
+#include <string.h>
+#include "sys.h"
+#include "gid.h"
+#include "gip.h"
+#include "gmr.h"
+#include "gmf.h"
+#include "fdb.h"
+#include "fdq.h"
+/******************************************************************************
+ * GMR TEST : FILTERING DATABASE WRITE CHECKS
+ ******************************************************************************
+ *
+ * Drives instances of GMR with PDUs built by GMF, on connected ports, and
+ * with the timing wheel, and checks the Filtering Database they leave. A
+ * long run of random PDUs - joins, leaves, and empties of a few dozen
+ * addresses, changes of Legacy mode, and LeaveAlls - is made twice from the
+ * same seed, once straight to the database and once through a queue small
+ * enough that most PDUs' changes are made in parts, by retries, and the
+ * two databases must end up the same. Further checks make the retries, the
+ * hold on transmission while the queue is congested, and the refusal of an
+ * entry whose old address cannot be removed, one step at a time. GMR is
+ * built with the functions it calls to send PDUs, to take messages back
+ * from GID, and to queue updates, renamed to those below, so that the PDUs
+ * sent for a thousand joins can be checked against the PDU size set, and
+ * the updates made for a change of Legacy mode seen. Returns non-zero if
+ * any check fails.
+ */
+enum
+{
+    Test_process = 1,
+    Test_vlan = 5,
+    Test_ports = 6,
+    Test_addresses = 40,
+    Test_multicasts = 4, /* grown while running, up to Test_addresses */
+    Test_pdus = 20000,
+    Test_queue_changes = 8,
+    Test_pool_pdus = 64,
+    Test_retry_time = 10, /* Gmr_fdb_retry_time */
+    Test_tx_multicasts = 1000,
+    Test_batches = 8, /* updates noted */
+    Test_batch_changes = 32,
+    Test_joined = 12, /* on port 0 for the Legacy batch checks */
+    Test_shared = 3   /* of those, also joined on port 1 */
+};
+typedef struct /* Test_snapshot */
+{ /*
+   * The ports forwarding each test address, and the number of entries.
+   */
+    Bitword ports[Test_addresses];
+    unsigned number_of_entries;
+} Test_snapshot;
+typedef struct /* Test_tx */
+{ /*
+   * The PDUs sent, and the messages they held, since the counts were last
+   * cleared, the length of the longest, whether each multicast address was
+   * sent, and the number of messages taken back.
+   */
+    unsigned pdus;
+    unsigned msgs;
+    int longest;
+    Boolean sent[Test_tx_multicasts];
+    unsigned untx;
+} Test_tx;
+typedef struct /* Test_batch */
+{ /*
+   * An update queued by GMR: the port, the action and the default, the
+   * number of addresses, and which test addresses they are.
+   */
+    int port_no;
+    Fdb_action action;
+    Fdb_default default_action;
+    unsigned number_of_keys;
+    Boolean keys[Test_addresses];
+} Test_batch;
+static Octet test_addresses[Test_tx_multicasts][6];
+static Test_tx tx;
+static Test_batch batches[Test_batches];
+static unsigned number_of_batches;
+static void *test_gmr;
+static unsigned long test_now;
+static int failures = 0;
+static unsigned long long test_random;
+static void check(Boolean ok, char *what)
+{
+    if (!ok)
+    {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+static unsigned test_next(unsigned range)
+{
+    test_random = test_random * 6364136223846793005ull +
+                  1442695040888963407ull;
+    return ((unsigned)(test_random >> 33) % range);
+}
+static void test_make_addresses(void)
+{
+    unsigned n;
+    for (n = 0; n < Test_tx_multicasts; n++)
+    {
+        test_addresses[n][0] = 0x01;
+        test_addresses[n][1] = 0x00;
+        test_addresses[n][2] = 0x5e;
+        test_addresses[n][3] = 0x00;
+        test_addresses[n][4] = (Octet)(n >> 8);
+        test_addresses[n][5] = (Octet)n;
+    }
+}
+void test_syspdu_tx(Pdu *pdu, int port_no)
+{ /*
+   * Called by GMR in place of syspdu_tx(): counts the PDU and its messages,
+   * noting the multicast addresses sent, and frees it.
+   */
+    Gmf gmf;
+    Gmf_msg msg;
+    int number_of_octets;
+    unsigned n;
+    (void)syspdu_octets(pdu, &number_of_octets);
+    if (number_of_octets > tx.longest)
+        tx.longest = number_of_octets;
+    tx.pdus++;
+    gmf_rdmsg_init(&gmf, pdu);
+    while (gmf_rdmsg(&gmf, &msg))
+    {
+        tx.msgs++;
+        if (msg.attribute != Multicast_attribute)
+            continue;
+        n = ((unsigned)msg.key1[4] << 8) | msg.key1[5];
+        if (n < Test_tx_multicasts)
+            tx.sent[n] = True;
+    }
+    syspdu_free(pdu);
+    (void)port_no;
+}
+void test_gid_untx(Gid *my_port)
+{ /*
+   * Called by GMR in place of gid_untx().
+   */
+    tx.untx++;
+    gid_untx(my_port);
+}
+Boolean test_fdq_update(unsigned vlan_id, int port_no,
+                        Mac_address *addresses,
+                        unsigned number_of_addresses, Fdb_action action,
+                        Fdb_default default_action)
+{ /*
+   * Called by GMR in place of fdq_update(): notes the update, if it is
+   * queued.
+   */
+    Test_batch *batch = &batches[number_of_batches];
+    unsigned n;
+    unsigned i;
+    if (!fdq_update(vlan_id, port_no, addresses, number_of_addresses, action,
+                    default_action))
+        return (False);
+    if (number_of_batches == Test_batches)
+        return (True);
+    memset(batch, 0, sizeof(*batch));
+    batch->port_no = port_no;
+    batch->action = action;
+    batch->default_action = default_action;
+    batch->number_of_keys = number_of_addresses;
+    for (i = 0; i < number_of_addresses; i++)
+    {
+        n = ((unsigned)addresses[i][4] << 8) | addresses[i][5];
+        if (n < Test_addresses)
+            batch->keys[n] = True;
+    }
+    number_of_batches++;
+    return (True);
+}
+static void test_create(unsigned queue_changes, int number_of_ports)
+{ /*
+   * Creates the database, the queue if queue_changes is not zero, the wheel,
+   * the pool, and an instance of GMR with its ports all connected.
+   */
+    int port_no;
+    test_now = 0;
+    check(fdb_create_fdb(Test_ports, 16), "database created");
+    if (queue_changes != 0)
+        check(fdq_create_fdq(queue_changes, 0), "queue created");
+    check(systime_create_timers(test_now), "wheel created");
+    check(syspdu_create_pool(Test_pool_pdus, Gmf_jumbo_pdu_size),
+          "pool created");
+    check(gmr_create_gmr(Test_process, Test_vlan, Test_multicasts,
+                         Test_addresses, &test_gmr),
+          "GMR created");
+    for (port_no = 0; port_no < number_of_ports; port_no++)
+    {
+        check(gid_create_port((Garp *)test_gmr, port_no), "port created");
+        gip_connect_port((Garp *)test_gmr, port_no);
+    }
+}
+static void test_destroy(Boolean queued)
+{
+    gmr_destroy_gmr(test_gmr);
+    systime_destroy_timers();
+    if (queued)
+        fdq_destroy_fdq();
+    syspdu_destroy_pool();
+    fdb_destroy_fdb();
+}
+static void test_advance(unsigned milliseconds)
+{ /*
+   * Advances the wheel a millisecond at a time, as the timer thread would,
+   * so that timers restarted on expiry (as the leave timer is, until the
+   * Registrar is Empty) expire again within the time.
+   */
+    while (milliseconds-- > 0)
+        (void)systime_expire_timers(++test_now);
+}
+static Gid *test_port(int port_no)
+{
+    Gid *my_port = NULL;
+    check(gid_find_port((Garp *)test_gmr, port_no, (void **)&my_port),
+          "port found");
+    return (my_port);
+}
+static void test_pdu_init(Gmf *gmf, Pdu **pdu)
+{
+    check(syspdu_alloc(pdu), "PDU allocated");
+    gmf_wrmsg_init(gmf, *pdu, Test_vlan, Gmf_jumbo_pdu_size);
+}
+static void test_pdu_msg(Gmf *gmf, Attribute_type attribute,
+                         Gid_event tx_event, unsigned address)
+{ /*
+   * Adds a message to the PDU, as it would be sent: tx_event is the event
+   * that the Applicant of the sender transmits.
+   */
+    Gmf_msg msg;
+    msg.attribute = attribute;
+    msg.event = tx_event;
+    msg.key1 = test_addresses[address];
+    msg.key2 = NULL;
+    msg.legacy_control = Forward_all;
+    check(gmf_wrmsg(gmf, &msg), "message written");
+}
+static void test_rcv(Gmf *gmf, Pdu *pdu, int port_no)
+{ /*
+   * Ends the PDU and receives it on the port, as gid_rcv_pdu() would.
+   */
+    Gid *my_port = test_port(port_no);
+    (void)gmf_wrmsg_done(gmf);
+    gmr_rcv(test_gmr, my_port, pdu);
+    gip_do_actions(my_port);
+    syspdu_free(pdu);
+}
+static void test_snapshot(Test_snapshot *snapshot)
+{
+    unsigned a;
+    for (a = 0; a < Test_addresses; a++)
+        fdb_forwarding_ports(Test_vlan, test_addresses[a],
+                             &snapshot->ports[a]);
+    snapshot->number_of_entries = fdb_number_of_entries();
+}
+static void test_random_pdus(unsigned queue_changes, Test_snapshot *snapshot)
+{ /*
+   * Receives Test_pdus random PDUs on random ports, tens of milliseconds
+   * apart so that many of the leaves complete, programming the queue (if
+   * any) now and then, and then gives the queue and the retries time to
+   * finish. The random choices are the same whether there is a queue or not.
+   */
+    static Gid_event events[] = {Gid_tx_joinin, Gid_tx_joinin,
+                                 Gid_tx_joinempty, Gid_tx_leavein,
+                                 Gid_tx_leaveempty, Gid_tx_empty};
+    Gmf gmf;
+    Pdu *pdu;
+    Gmr_fdb_counts counts;
+    Fdq_latency latency;
+    unsigned long in_histogram;
+    unsigned filled = 0;
+    unsigned retried = 0;
+    unsigned room;
+    unsigned pdu_number;
+    unsigned number_of_msgs;
+    unsigned i;
+    test_random = 0x9E3779B97F4A7C15ull;
+    test_create(queue_changes, Test_ports);
+    for (pdu_number = 0; pdu_number < Test_pdus; pdu_number++)
+    {
+        test_pdu_init(&gmf, &pdu);
+        number_of_msgs = 1 + test_next(12);
+        for (i = 0; i < number_of_msgs; i++)
+        {
+            switch (test_next(32))
+            {
+            case 0:
+                test_pdu_msg(&gmf, Multicast_attribute, Gid_tx_leaveall, 0);
+                break;
+            case 1:
+            case 2:
+            case 3:
+                test_pdu_msg(&gmf, Legacy_attribute,
+                             events[test_next(6)], 0);
+                break;
+            default:
+                test_pdu_msg(&gmf, Multicast_attribute, events[test_next(6)],
+                             test_next(Test_addresses));
+            }
+        }
+        test_rcv(&gmf, pdu, (int)test_next(Test_ports));
+        if (fdq_room() == 0)
+            filled++;
+        if (test_next(4) == 0)
+            (void)fdq_program();
+        room = fdq_room();
+        test_advance(test_next(64));
+        if (fdq_room() < room)
+            retried++;
+    }
+    for (i = 0; i < 200; i++)
+    {
+        (void)fdq_program();
+        test_advance(Test_retry_time);
+    }
+    test_snapshot(snapshot);
+    gmr_read_fdb_counts(test_gmr, &counts);
+    check((Boolean)(counts.requested > counts.coalesced + counts.suppressed),
+          "some of the changes requested are made");
+    if (queue_changes != 0)
+    {
+        check((Boolean)((filled > 0) && (retried > 0)),
+              "the queue fills, and changes left pending are retried");
+        fdq_read_latency(&latency);
+        for (i = 0, in_histogram = 0; i < Fdq_latency_buckets; i++)
+            in_histogram += latency.histogram[i];
+        check((Boolean)((latency.changes > 0) &&
+                        (in_histogram == latency.changes) &&
+                        (latency.total <= latency.max * latency.changes)),
+              "every change applied is counted in the latency histogram");
+    }
+    test_destroy(queue_changes != 0);
+}
+static void test_queue_matches_direct(void)
+{ /*
+   * The queue delays changes, and splits them into parts, but the database
+   * must end up as if each had been made at once.
+   */
+    Test_snapshot direct;
+    Test_snapshot queued;
+    unsigned a;
+    Boolean ok = True;
+    test_random_pdus(0, &direct);
+    test_random_pdus(Test_queue_changes, &queued);
+    for (a = 0; a < Test_addresses; a++)
+        if (direct.ports[a] != queued.ports[a])
+            ok = False;
+    check(ok, "the queued database forwards as the direct one");
+    check((Boolean)(direct.number_of_entries == queued.number_of_entries),
+          "the queued database has as many entries as the direct one");
+}
+static void test_retry(void)
+{ /*
+   * Ten addresses joined on the only port need three batches of a queue of
+   * four changes: the first made with the PDU, the others by the retry
+   * timer, each Test_retry_time milliseconds after the queue last had no
+   * room, and no sooner.
+   */
+    Gmf gmf;
+    Pdu *pdu;
+    Octet *address;
+    unsigned a;
+    Boolean ok = True;
+    test_create(4, 1);
+    test_pdu_init(&gmf, &pdu);
+    for (a = 0; a < 10; a++)
+        test_pdu_msg(&gmf, Multicast_attribute, Gid_tx_joinin, a);
+    test_rcv(&gmf, pdu, 0);
+    check((Boolean)(fdq_room() == 0), "the first batch fills the queue");
+    check(fdq_program(), "queue programmed");
+    test_advance(Test_retry_time - 1);
+    check((Boolean)(fdq_room() == 4), "nothing is retried early");
+    test_advance(1);
+    check((Boolean)(fdq_room() == 0), "the retry fills the queue again");
+    check(fdq_program(), "queue programmed again");
+    test_advance(Test_retry_time);
+    check((Boolean)(fdq_room() == 2), "the last retry makes the rest");
+    check(fdq_program(), "queue programmed once more");
+    test_advance(Test_retry_time);
+    check((Boolean)(fdq_room() == 4), "no retry is left");
+    for (a = 0; a < 10; a++)
+    {
+        address = test_addresses[a];
+        if (!fdb_forwarding(Test_vlan, 0, address))
+            ok = False;
+    }
+    check(ok, "every address joined is forwarded");
+    test_destroy(True);
+}
+static void test_congestion_holds_tx(void)
+{ /*
+   * A join received on one port is propagated to the other, which has a
+   * Join to send; nothing is sent while the queue is congested, and the
+   * Join is sent once it has been programmed.
+   */
+    Gmf gmf;
+    Pdu *pdu;
+    Syspdu_pool_counts before;
+    Syspdu_pool_counts after;
+    unsigned a;
+    test_create(8, 2);
+    test_pdu_init(&gmf, &pdu);
+    test_pdu_msg(&gmf, Multicast_attribute, Gid_tx_joinin, 0);
+    test_rcv(&gmf, pdu, 0);
+    for (a = 1; a < 8; a++)
+        (void)fdq_forward(Test_vlan + 1, 0, test_addresses[a]);
+    check(fdq_congested(), "the queue is congested");
+    syspdu_read_pool_counts(&before);
+    gmr_tx(test_gmr, test_port(1));
+    syspdu_read_pool_counts(&after);
+    check((Boolean)(after.allocations == before.allocations),
+          "nothing is sent while the queue is congested");
+    check(fdq_program(), "queue programmed");
+    check((Boolean)!fdq_congested(), "the queue is no longer congested");
+    gmr_tx(test_gmr, test_port(1));
+    syspdu_read_pool_counts(&after);
+    check((Boolean)(after.allocations == before.allocations + 1),
+          "the Join held back is sent once the queue has drained");
+    test_destroy(True);
+}
+static void test_refused_removal(void)
+{ /*
+   * With the database at its maximum of one address, no longer used (left,
+   * with the Applicant, an Observer, brought back by an Empty), a
+   * join of another address needs the entry of the first removed; while
+   * the queue has no room for the removal the join is discarded, and it is
+   * taken when repeated once the queue has room.
+   */
+    Gmf gmf;
+    Pdu *pdu;
+    unsigned i;
+    check(fdb_create_fdb(Test_ports, 16), "database created");
+    check(fdq_create_fdq(2, 0), "queue created");
+    check(systime_create_timers(test_now = 0), "wheel created");
+    check(syspdu_create_pool(Test_pool_pdus, Gmf_jumbo_pdu_size),
+          "pool created");
+    check(gmr_create_gmr(Test_process, Test_vlan, 1, 1, &test_gmr),
+          "GMR created");
+    check(gid_create_port((Garp *)test_gmr, 0), "port created");
+    gip_connect_port((Garp *)test_gmr, 0);
+    test_pdu_init(&gmf, &pdu);
+    test_pdu_msg(&gmf, Multicast_attribute, Gid_tx_joinin, 0);
+    test_rcv(&gmf, pdu, 0);
+    test_pdu_init(&gmf, &pdu);
+    test_pdu_msg(&gmf, Multicast_attribute, Gid_tx_leavein, 0);
+    test_pdu_msg(&gmf, Multicast_attribute, Gid_tx_empty, 0);
+    test_rcv(&gmf, pdu, 0);
+    for (i = 0; i < 100; i++)
+    {
+        (void)fdq_program();
+        test_advance(Test_retry_time);
+    }
+    check((Boolean)(fdb_number_of_entries() == 1),
+          "the first address has an entry");
+    check((Boolean)!fdb_forwarding(Test_vlan, 0, test_addresses[0]),
+          "the first address is filtered once it has left");
+    (void)fdq_forward(Test_vlan + 1, 0, test_addresses[2]);
+    (void)fdq_forward(Test_vlan + 1, 0, test_addresses[3]);
+    test_pdu_init(&gmf, &pdu);
+    test_pdu_msg(&gmf, Multicast_attribute, Gid_tx_joinin, 1);
+    test_rcv(&gmf, pdu, 0);
+    check(fdq_program(), "queue programmed");
+    check((Boolean)(fdb_number_of_entries() == 3),
+          "the entry is not taken while its removal is refused");
+    test_pdu_init(&gmf, &pdu);
+    test_pdu_msg(&gmf, Multicast_attribute, Gid_tx_joinin, 1);
+    test_rcv(&gmf, pdu, 0);
+    check(fdq_program(), "queue programmed again");
+    check((Boolean)(fdb_number_of_entries() == 3),
+          "the old address's entry is replaced for the repeated join");
+    check(fdb_forwarding(Test_vlan, 0, test_addresses[1]),
+          "the address joined again is forwarded");
+    check((Boolean)!fdb_forwarding(Test_vlan, 0, test_addresses[4]),
+          "the port still filters by default");
+    test_destroy(True);
+}
+static void test_fdb_counts(void)
+{ /*
+   * A PDU that repeats the join of an address gives a single change for it.
+   * A leave and a join of the address that cancel, made while the queue has
+   * no room, leave one change pending, replaced by the next (coalesced),
+   * which is not made because the address is already forwarded
+   * (suppressed). The first address, which takes GMD entry 0, is joined and
+   * left first, so that the others take entries of their own.
+   */
+    Gmf gmf;
+    Pdu *pdu;
+    Gmr_fdb_counts before;
+    Gmr_fdb_counts after;
+    test_create(2, 1);
+    test_pdu_init(&gmf, &pdu);
+    test_pdu_msg(&gmf, Multicast_attribute, Gid_tx_joinin, 0);
+    test_rcv(&gmf, pdu, 0);
+    test_pdu_init(&gmf, &pdu);
+    test_pdu_msg(&gmf, Multicast_attribute, Gid_tx_leavein, 0);
+    test_rcv(&gmf, pdu, 0);
+    (void)fdq_program();
+    test_advance(Gid_default_leave_time + 100);
+    (void)fdq_program();
+    gmr_read_fdb_counts(test_gmr, &before);
+    test_pdu_init(&gmf, &pdu);
+    test_pdu_msg(&gmf, Multicast_attribute, Gid_tx_joinin, 1);
+    test_pdu_msg(&gmf, Multicast_attribute, Gid_tx_joinin, 1);
+    test_pdu_msg(&gmf, Multicast_attribute, Gid_tx_joinempty, 1);
+    test_pdu_msg(&gmf, Multicast_attribute, Gid_tx_joinin, 2);
+    test_rcv(&gmf, pdu, 0);
+    gmr_read_fdb_counts(test_gmr, &after);
+    check((Boolean)((after.requested == before.requested + 2) &&
+                    (after.coalesced == before.coalesced) &&
+                    (after.suppressed == before.suppressed)),
+          "a repeated join gives a single change");
+    check((Boolean)(fdq_room() == 0), "both addresses queued as one batch");
+    check(fdq_program(), "queue programmed");
+    check((Boolean)(fdb_forwarding(Test_vlan, 0, test_addresses[1]) &&
+                    fdb_forwarding(Test_vlan, 0, test_addresses[2])),
+          "both addresses are forwarded");
+    (void)fdq_forward(Test_vlan + 1, 0, test_addresses[3]);
+    (void)fdq_forward(Test_vlan + 1, 0, test_addresses[4]);
+    before = after;
+    test_pdu_init(&gmf, &pdu);
+    test_pdu_msg(&gmf, Multicast_attribute, Gid_tx_leavein, 1);
+    test_rcv(&gmf, pdu, 0);
+    test_advance(Gid_default_leave_time + 100);
+    test_pdu_init(&gmf, &pdu);
+    test_pdu_msg(&gmf, Multicast_attribute, Gid_tx_joinin, 1);
+    test_rcv(&gmf, pdu, 0);
+    check(fdq_program(), "queue programmed again");
+    test_advance(Test_retry_time);
+    gmr_read_fdb_counts(test_gmr, &after);
+    check((Boolean)((after.requested == before.requested + 2) &&
+                    (after.coalesced == before.coalesced + 1) &&
+                    (after.suppressed == before.suppressed + 1)),
+          "a leave and a join that cancel are coalesced, then suppressed");
+    check((Boolean)(fdq_room() == 2), "nothing is queued for them");
+    check(fdb_forwarding(Test_vlan, 0, test_addresses[1]),
+          "the address is still forwarded");
+    test_destroy(True);
+}
+static Boolean test_one_batch(Fdb_action action, Fdb_default default_action)
+{ /*
+   * Returns whether a single update has been queued since the count was
+   * cleared, for port 1, with the action and the default given, and the
+   * addresses joined on port 0 alone.
+   */
+    Test_batch *batch = &batches[0];
+    unsigned a;
+    if ((number_of_batches != 1) || (batch->port_no != 1) ||
+        (batch->action != action) ||
+        (batch->default_action != default_action) ||
+        (batch->number_of_keys != Test_joined - Test_shared))
+        return (False);
+    for (a = 0; a < Test_addresses; a++)
+        if (batch->keys[a] != ((a >= Test_shared) && (a < Test_joined)))
+            return (False);
+    return (True);
+}
+static void test_forward_all_batch(void)
+{ /*
+   * Addresses joined on port 0, a few of them also on port 1, are filtered
+   * on port 1 unless joined there. A Forward All join received on port 1
+   * must forward the others, and make forwarding the port's default, as
+   * one update; its leave, once the leave timer has expired, must filter
+   * them, and the default, as one update.
+   */
+    Gmf gmf;
+    Pdu *pdu;
+    unsigned a;
+    Boolean forwarded = True;
+    Boolean filtered = True;
+    test_create(Test_batch_changes, 2);
+    test_pdu_init(&gmf, &pdu);
+    for (a = 0; a < Test_joined; a++)
+        test_pdu_msg(&gmf, Multicast_attribute, Gid_tx_joinin, a);
+    test_rcv(&gmf, pdu, 0);
+    test_pdu_init(&gmf, &pdu);
+    for (a = 0; a < Test_shared; a++)
+        test_pdu_msg(&gmf, Multicast_attribute, Gid_tx_joinin, a);
+    test_rcv(&gmf, pdu, 1);
+    check(fdq_program(), "queue programmed");
+    number_of_batches = 0;
+    test_pdu_init(&gmf, &pdu);
+    test_pdu_msg(&gmf, Legacy_attribute, Gid_tx_joinin, 0);
+    test_rcv(&gmf, pdu, 1);
+    check(test_one_batch(Fdb_forward, Fdb_default_forward),
+          "a Forward All join is one update, forwarding by default");
+    check(fdq_program(), "queue programmed again");
+    for (a = 0; a < Test_joined; a++)
+        if (!fdb_forwarding(Test_vlan, 1, test_addresses[a]))
+            forwarded = False;
+    check(forwarded, "every address is forwarded in Forward All");
+    number_of_batches = 0;
+    test_pdu_init(&gmf, &pdu);
+    test_pdu_msg(&gmf, Legacy_attribute, Gid_tx_leavein, 0);
+    test_rcv(&gmf, pdu, 1);
+    test_advance(Gid_default_leave_time + 100);
+    check(test_one_batch(Fdb_filter, Fdb_default_filter),
+          "a Forward All leave is one update, filtering by default");
+    check(fdq_program(), "queue programmed once more");
+    for (a = 0; a < Test_joined; a++)
+        if (fdb_forwarding(Test_vlan, 1, test_addresses[a]) != (a < Test_shared))
+            filtered = False;
+    check(filtered, "only the addresses joined are forwarded once it is left");
+    test_destroy(True);
+}
+static unsigned test_tx_round(unsigned pdu_size)
+{ /*
+   * Receives a Join for each of Test_tx_multicasts addresses on one port,
+   * and gives the other, to which they are propagated, transmit
+   * opportunities until it has sent a message for each, returning the
+   * number of PDUs that took. No PDU may be longer than pdu_size, and no
+   * message may be taken back.
+   */
+    Gmf gmf;
+    Pdu *pdu;
+    unsigned a;
+    unsigned calls;
+    unsigned pdus;
+    Boolean ok = True;
+    check(fdb_create_fdb(Test_ports, 16), "database created");
+    check(systime_create_timers(test_now = 0), "wheel created");
+    check(syspdu_create_pool(Test_pool_pdus, Gmf_jumbo_pdu_size),
+          "pool created");
+    check(gmr_create_gmr(Test_process, Test_vlan, Test_multicasts,
+                         Test_tx_multicasts, &test_gmr),
+          "GMR created");
+    check((Boolean)(gid_create_port((Garp *)test_gmr, 0) &&
+                    gid_create_port((Garp *)test_gmr, 1)),
+          "ports created");
+    gip_connect_port((Garp *)test_gmr, 0);
+    gip_connect_port((Garp *)test_gmr, 1);
+    check(gmr_set_pdu_size(test_gmr, pdu_size), "PDU size set");
+    check((Boolean)!gmr_set_pdu_size(test_gmr, Gmf_min_pdu_size - 1),
+          "a PDU size below the smallest is refused");
+    test_pdu_init(&gmf, &pdu);
+    for (a = 0; a < Test_tx_multicasts; a++)
+        test_pdu_msg(&gmf, Multicast_attribute, Gid_tx_joinin, a);
+    test_rcv(&gmf, pdu, 0);
+    memset(&tx, 0, sizeof(tx));
+    for (calls = 0; calls < 2 * Test_tx_multicasts; calls++)
+    {
+        pdus = tx.pdus;
+        gmr_tx(test_gmr, test_port(1));
+        if (tx.pdus == pdus)
+            break;
+    }
+    for (a = 0; a < Test_tx_multicasts; a++)
+        if (!tx.sent[a])
+            ok = False;
+    check((Boolean)(ok && (tx.msgs == Test_tx_multicasts)),
+          "a message is sent for every address joined");
+    check((Boolean)(tx.longest <= (int)pdu_size),
+          "no PDU is longer than the PDU size");
+    check((Boolean)(tx.untx == 0), "no message is taken back");
+    test_destroy(False);
+    return (tx.pdus);
+}
+static void test_pdu_sizes(void)
+{ /*
+   * A PDU holds the Protocol ID, an Attribute Type, attributes of eight
+   * octets, and two End Marks. A PDU size that fits 100 attributes exactly
+   * is filled to the last octet; one octet less, and only 99 fit.
+   */
+    unsigned exact = 2 + 1 + 100 * Gmf_group_length + 1 + 1;
+    check((Boolean)(test_tx_round(Gmf_standard_pdu_size) == 6),
+          "a thousand joins take six standard PDUs");
+    check((Boolean)(test_tx_round(Gmf_jumbo_pdu_size) == 1),
+          "and one jumbo PDU");
+    check((Boolean)((test_tx_round(exact) == 10) &&
+                    (tx.longest == (int)exact)),
+          "PDUs are filled to exactly the PDU size");
+    check((Boolean)(test_tx_round(exact - 1) == 11),
+          "one octet less holds one attribute less");
+    check((Boolean)((test_tx_round(Gmf_min_pdu_size) ==
+                     Test_tx_multicasts) &&
+                    (tx.longest == Gmf_min_pdu_size)),
+          "the smallest PDU size holds one attribute");
+}
+int main(void)
+{
+    test_make_addresses();
+    test_queue_matches_direct();
+    test_retry();
+    test_congestion_holds_tx();
+    test_refused_removal();
+    test_fdb_counts();
+    test_forward_all_batch();
+    test_pdu_sizes();
+    if (failures != 0)
+        printf("%d checks failed\n", failures);
+    return (failures != 0);
+}
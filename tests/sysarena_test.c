@@ -0,0 +1,197 @@
+/* sysarena_test.c */
+#include <stdio.h>
+#include <string.h>
+#include "sys.h"
+/******************************************************************************
+ * SYSARENA TEST : ARENA ALLOCATION CHECKS
+ ******************************************************************************
+ *
+ * Checks that blocks freed to an arena are allocated again - at once at the
+ * same size, and split when a little larger, but not when much larger -
+ * that an arena grows by further regions as it fills, keeping every block
+ * allocated valid and apart from every other, and, on Linux, that only
+ * regions of at least a huge page are given huge pages, so that an arena
+ * that starts small moves to them as it grows. Returns non-zero if any
+ * check fails.
+ */
+enum
+{
+    Test_header = Sys_cache_line, /* before each block */
+    Test_blocks = 600,
+    Test_block_size = 1000,
+    Test_huge_page = 2 * 1024 * 1024
+};
+static int failures = 0;
+static void check(Boolean ok, char *what)
+{
+    if (!ok)
+    {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+static void test_reuse(void)
+{ /*
+   * A block freed is allocated again for a block of the same size, or
+   * split for a smaller one that needs a list or two below; one much
+   * larger is kept whole.
+   */
+    void *arena;
+    void *first;
+    void *second;
+    void *large;
+    void *block;
+    void *rest;
+    check(sysarena_create(64 * 1024, False, &arena), "arena created");
+    check((Boolean)(sysarena_malloc(arena, 100, &first) &&
+                    sysarena_malloc(arena, 100, &second)),
+          "blocks allocated");
+    check((Boolean)(((size_t)first % Sys_cache_line == 0) &&
+                    ((size_t)second % Sys_cache_line == 0)),
+          "blocks start on cache lines");
+    sysarena_free(arena, first);
+    check((Boolean)(sysarena_malloc(arena, 100, &block) && (block == first)),
+          "a block freed is allocated again at the same size");
+    check((Boolean)(sysarena_malloc(arena, 1000, &large) && (large != first) &&
+                    (large != second)),
+          "a larger block is newly allocated");
+    sysarena_free(arena, large);
+    check((Boolean)(sysarena_malloc(arena, 200, &block) && (block == large)),
+          "a block a little larger is split");
+    check((Boolean)(sysarena_malloc(arena, 700, &rest) &&
+                    ((char *)rest ==
+                     (char *)large + Test_header + 256)),
+          "the rest of a split block is allocated in turn");
+    check((Boolean)(sysarena_malloc(arena, 16 * 1024, &large)),
+          "a much larger block allocated");
+    sysarena_free(arena, large);
+    check((Boolean)(sysarena_malloc(arena, 100, &block) && (block != large)),
+          "a block much larger is not split");
+    check((Boolean)(sysarena_malloc(arena, 16 * 1024, &block) &&
+                    (block == large)),
+          "and is kept for a block of its own size");
+    check((Boolean)!sysarena_malloc(arena, -1, &block),
+          "a negative size is refused");
+    sysarena_destroy(arena);
+    check((Boolean)(sysarena_malloc(NULL, 100, &block)),
+          "allocated from the heap without an arena");
+    sysarena_free(NULL, block);
+}
+static void test_growth(void)
+{ /*
+   * Blocks allocated from an arena far too small for them all add regions
+   * to it; each is filled with its own number and checked once all have
+   * been allocated, so that any overlap shows.
+   */
+    static void *blocks[Test_blocks];
+    void *arena;
+    unsigned i;
+    Boolean ok = True;
+    check(sysarena_create(4096, False, &arena), "arena created");
+    for (i = 0; i < Test_blocks; i++)
+    {
+        if (!sysarena_malloc(arena, Test_block_size, &blocks[i]))
+        {
+            ok = False;
+            break;
+        }
+        memset(blocks[i], (int)(i % 251), Test_block_size);
+    }
+    check(ok, "blocks allocated as the arena grows");
+    for (i = 0; ok && (i < Test_blocks); i++)
+        if ((((Octet *)blocks[i])[0] != (Octet)(i % 251)) ||
+            (((Octet *)blocks[i])[Test_block_size - 1] != (Octet)(i % 251)))
+            ok = False;
+    check(ok, "blocks do not overlap");
+    check((Boolean)(sysarena_malloc(arena, 4 * 1024 * 1024, &blocks[0]) &&
+                    (memset(blocks[0], 1, 4 * 1024 * 1024) != NULL)),
+          "a block larger than a new region would be is allocated");
+    sysarena_destroy(arena);
+}
+#if defined(__linux__)
+static Boolean test_huge_mapping(void *address, Boolean *huge)
+{ /*
+   * Finds the mapping holding address in /proc/self/smaps, and whether it
+   * is backed, or advised to be backed, by huge pages.
+   */
+    FILE *smaps = fopen("/proc/self/smaps", "r");
+    char line[512];
+    unsigned long start;
+    unsigned long end;
+    Boolean found = False;
+    Boolean in_mapping = False;
+    if (smaps == NULL)
+        return (False);
+    while (fgets(line, sizeof(line), smaps) != NULL)
+    {
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2)
+            in_mapping = ((unsigned long)address >= start) &&
+                         ((unsigned long)address < end);
+        else if (in_mapping && (strncmp(line, "VmFlags:", 8) == 0))
+        {
+            *huge = (strstr(line, " hg") != NULL) ||
+                    (strstr(line, " ht") != NULL);
+            found = True;
+        }
+    }
+    fclose(smaps);
+    return (found);
+}
+static void test_huge_pages(void)
+{ /*
+   * An arena smaller than a huge page is given ordinary pages, even if
+   * huge pages are asked for, and one of a huge page or more is given huge
+   * pages; one that starts small is given them once a region it adds is
+   * large enough.
+   */
+    FILE *enabled = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    void *arena;
+    void *block;
+    unsigned i;
+    Boolean huge = True;
+    Boolean small_first = False;
+    if (enabled == NULL)
+        return; /* no huge pages to check */
+    fclose(enabled);
+    check((Boolean)(sysarena_create(Test_huge_page / 2, True, &arena) &&
+                    sysarena_malloc(arena, 100, &block) &&
+                    test_huge_mapping(block, &huge) && !huge),
+          "an arena smaller than a huge page has ordinary pages");
+    sysarena_destroy(arena);
+    check((Boolean)(sysarena_create(Test_huge_page, True, &arena) &&
+                    sysarena_malloc(arena, 100, &block) &&
+                    test_huge_mapping(block, &huge) && huge),
+          "an arena of a huge page has huge pages");
+    sysarena_destroy(arena);
+    check((Boolean)(sysarena_create(2 * Test_huge_page, False, &arena) &&
+                    sysarena_malloc(arena, 100, &block) &&
+                    test_huge_mapping(block, &huge) && !huge),
+          "an arena has huge pages only if asked");
+    sysarena_destroy(arena);
+    check(sysarena_create(64 * 1024, True, &arena), "arena created");
+    for (i = 0; i < 64; i++)
+    {
+        if (!sysarena_malloc(arena, 64 * 1024, &block) ||
+            !test_huge_mapping(block, &huge))
+            break;
+        if (i == 0)
+            small_first = !huge;
+        if (huge)
+            break;
+    }
+    check((Boolean)(small_first && huge),
+          "a growing arena moves to huge pages");
+    sysarena_destroy(arena);
+}
+#endif
+int main(void)
+{
+    test_reuse();
+    test_growth();
+#if defined(__linux__)
+    test_huge_pages();
+#endif
+    if (failures != 0)
+        printf("%d checks failed\n", failures);
+    return (failures != 0);
+}
@@ -0,0 +1,360 @@
+/* syspdu_test.c */
+#define _POSIX_C_SOURCE 199309L
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include "sys.h"
+/******************************************************************************
+ * SYSPDU TEST : PDU POOL CHECKS
+ ******************************************************************************
+ *
+ * Checks that the pool gives out each of its buffers once, and no more, until
+ * it is exhausted; that buffers freed by a thread other than that which
+ * allocated them are allocated again; and that, with several threads
+ * allocating from a pool too small for them all, freeing some of their PDUs
+ * themselves and handing the rest to other threads to free, no buffer is
+ * ever held by two threads at once and the counts add up once they have
+ * finished. Each PDU is filled with a tag of its holder's and checked
+ * before it is freed; run under a thread or address sanitizer, the last
+ * check also shows any race or misuse of memory in the pool.
+ * Returns non-zero if any check fails.
+ */
+enum
+{
+    Test_pdus = 256,
+    Test_pdu_size = 100,
+    Test_producers = 4,
+    Test_consumers = 2,
+    Test_ring = 16,      /* PDUs waiting for each consumer */
+    Test_held = 6,       /* PDUs held by each producer at once */
+    Test_steps = 100000, /* for each producer */
+    Test_stress_pdus = 64
+};
+typedef struct /* Test_consumer */
+{ /*
+   * PDUs handed to a consumer thread to check and free.
+   */
+    pthread_t thread;
+    pthread_mutex_t lock;
+    Pdu *ring[Test_ring];
+    Octet tags[Test_ring];
+    unsigned first;
+    unsigned number;
+    unsigned long freed;
+    unsigned long bad;
+} Test_consumer;
+typedef struct /* Test_producer */
+{
+    pthread_t thread;
+    unsigned number;
+    unsigned long long random;
+    unsigned long allocated;
+    unsigned long failed;
+    unsigned long handed;
+    unsigned long bad;
+} Test_producer;
+static Test_consumer consumers[Test_consumers];
+static Test_producer producers[Test_producers];
+static int producing;
+static int failures = 0;
+static void check(Boolean ok, char *what)
+{
+    if (!ok)
+    {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+static unsigned test_next(unsigned long long *random, unsigned range)
+{
+    *random = *random * 6364136223846793005ull + 1442695040888963407ull;
+    return ((unsigned)(*random >> 33) % range);
+}
+static void test_tag(Pdu *pdu, Octet tag)
+{
+    Octet *octets;
+    int number_of_octets;
+    int i;
+    octets = syspdu_octets(pdu, &number_of_octets);
+    for (i = 0; i < number_of_octets; i++)
+        octets[i] = tag;
+}
+static Boolean test_tagged(Pdu *pdu, Octet tag)
+{ /*
+   * Returns whether the PDU still holds the tag throughout.
+   */
+    Octet *octets;
+    int number_of_octets;
+    int i;
+    octets = syspdu_octets(pdu, &number_of_octets);
+    if (number_of_octets != Test_pdu_size)
+        return (False);
+    for (i = 0; i < number_of_octets; i++)
+        if (octets[i] != tag)
+            return (False);
+    return (True);
+}
+static void test_exhaustion(void)
+{ /*
+   * One thread can allocate every buffer, each once, and no more; once
+   * all are freed it can allocate them all again.
+   */
+    static Pdu *pdus[Test_pdus + 1];
+    Syspdu_pool_counts counts;
+    unsigned number;
+    unsigned i;
+    int number_of_octets;
+    Boolean ok = True;
+    check(syspdu_create_pool(Test_pdus, Test_pdu_size), "pool created");
+    check((Boolean)!syspdu_create_pool(Test_pdus, Test_pdu_size),
+          "only one pool can be created");
+    for (number = 0; number <= Test_pdus; number++)
+    {
+        if (!syspdu_alloc(&pdus[number]))
+            break;
+        if (((size_t)syspdu_octets(pdus[number], &number_of_octets) %
+             Sys_cache_line) != 0)
+            ok = False;
+        test_tag(pdus[number], (Octet)number);
+    }
+    check((Boolean)(number == Test_pdus), "every buffer is allocated");
+    check(ok, "buffers are aligned to cache lines");
+    for (i = 0; i < number; i++)
+        if (!test_tagged(pdus[i], (Octet)i))
+            ok = False;
+    check(ok, "no buffer is allocated twice");
+    syspdu_read_pool_counts(&counts);
+    check((Boolean)((counts.in_use == Test_pdus) &&
+                    (counts.high_water == Test_pdus) &&
+                    (counts.allocations == Test_pdus) &&
+                    (counts.exhausted == 1)),
+          "counts of the exhausted pool");
+    for (i = 0; i < number; i++)
+        syspdu_free(pdus[i]);
+    for (number = 0; number < Test_pdus; number++)
+        if (!syspdu_alloc(&pdus[number]))
+            break;
+    check((Boolean)(number == Test_pdus), "every buffer is allocated again");
+    for (i = 0; i < number; i++)
+        syspdu_free(pdus[i]);
+    syspdu_read_pool_counts(&counts);
+    check((Boolean)((counts.in_use == 0) &&
+                    (counts.allocations == 2 * Test_pdus)),
+          "every buffer is freed");
+    syspdu_destroy_pool();
+}
+static void *test_free_all(void *context)
+{
+    Pdu **pdus = (Pdu **)context;
+    unsigned i;
+    for (i = 0; i < Test_pdus; i++)
+        syspdu_free(pdus[i]);
+    return (NULL);
+}
+static void test_free_elsewhere(void)
+{ /*
+   * Buffers allocated by one thread and freed by another can be allocated
+   * again, except those the other thread keeps for itself.
+   */
+    static Pdu *pdus[Test_pdus];
+    pthread_t thread;
+    Syspdu_pool_counts counts;
+    unsigned number;
+    check(syspdu_create_pool(Test_pdus, Test_pdu_size), "pool created");
+    for (number = 0; number < Test_pdus; number++)
+        if (!syspdu_alloc(&pdus[number]))
+            break;
+    check((Boolean)((number == Test_pdus) &&
+                    (pthread_create(&thread, NULL, test_free_all, pdus) == 0)),
+          "freeing thread started");
+    pthread_join(thread, NULL);
+    syspdu_read_pool_counts(&counts);
+    check((Boolean)(counts.in_use == 0), "freed by another thread");
+    for (number = 0; number < Test_pdus; number++)
+        if (!syspdu_alloc(&pdus[number]))
+            break;
+    check((Boolean)(number > Test_pdus - Syspdu_kept),
+          "buffers freed by another thread are allocated again");
+    while (number > 0)
+        syspdu_free(pdus[--number]);
+    syspdu_destroy_pool();
+}
+static Boolean test_hand(Test_consumer *consumer, Pdu *pdu, Octet tag)
+{ /*
+   * Hands the PDU to the consumer, returning False if its ring is full.
+   */
+    Boolean handed = False;
+    pthread_mutex_lock(&consumer->lock);
+    if (consumer->number < Test_ring)
+    {
+        consumer->ring[(consumer->first + consumer->number) % Test_ring] = pdu;
+        consumer->tags[(consumer->first + consumer->number) % Test_ring] = tag;
+        consumer->number++;
+        handed = True;
+    }
+    pthread_mutex_unlock(&consumer->lock);
+    return (handed);
+}
+static void *test_producer(void *context)
+{ /*
+   * Allocates PDUs, holding a few at a time, and frees each itself or hands
+   * it to a consumer; waits a little when the pool is exhausted.
+   */
+    Test_producer *producer = (Test_producer *)context;
+    Pdu *held[Test_held];
+    Octet tags[Test_held];
+    unsigned number_held = 0;
+    unsigned step;
+    unsigned i;
+    for (step = 0; step < Test_steps; step++)
+    {
+        if ((number_held < Test_held) && (test_next(&producer->random, 2) == 0))
+        {
+            if (syspdu_alloc(&held[number_held]))
+            {
+                tags[number_held] = (Octet)(producer->number * 64 + step % 64);
+                test_tag(held[number_held], tags[number_held]);
+                number_held++;
+                producer->allocated++;
+            }
+            else
+            {
+                producer->failed++;
+                sched_yield();
+            }
+            continue;
+        }
+        if (number_held == 0)
+            continue;
+        i = test_next(&producer->random, number_held);
+        if (!test_tagged(held[i], tags[i]))
+            producer->bad++;
+        if (test_next(&producer->random, 4) == 0)
+            syspdu_free(held[i]);
+        else if (test_hand(&consumers[test_next(&producer->random,
+                                                Test_consumers)],
+                           held[i], tags[i]))
+            producer->handed++;
+        else
+            syspdu_free(held[i]);
+        held[i] = held[--number_held];
+        tags[i] = tags[number_held];
+    }
+    while (number_held > 0)
+        syspdu_free(held[--number_held]);
+    return (NULL);
+}
+static void *test_consumer(void *context)
+{ /*
+   * Checks and frees the PDUs handed to it until the producers have
+   * finished and none are left.
+   */
+    Test_consumer *consumer = (Test_consumer *)context;
+    Pdu *pdu;
+    Octet tag;
+    Boolean finished;
+    for (;;)
+    {
+        finished = !sys_load_acquire(&producing);
+        pthread_mutex_lock(&consumer->lock);
+        pdu = NULL;
+        tag = 0;
+        if (consumer->number > 0)
+        {
+            pdu = consumer->ring[consumer->first];
+            tag = consumer->tags[consumer->first];
+            consumer->first = (consumer->first + 1) % Test_ring;
+            consumer->number--;
+        }
+        pthread_mutex_unlock(&consumer->lock);
+        if (pdu != NULL)
+        {
+            if (!test_tagged(pdu, tag))
+                consumer->bad++;
+            syspdu_free(pdu);
+            consumer->freed++;
+        }
+        else if (finished)
+            break;
+        else
+            sched_yield();
+    }
+    return (NULL);
+}
+static void test_stress(void)
+{ /*
+   * Producers allocate from a pool smaller than all threads may keep
+   * between them, so allocations fail from time to time.
+   */
+    Syspdu_pool_counts counts;
+    unsigned long allocated = 0;
+    unsigned long failed = 0;
+    unsigned long handed = 0;
+    unsigned long freed = 0;
+    unsigned long bad = 0;
+    unsigned i;
+    Boolean started = True;
+    check(syspdu_create_pool(Test_stress_pdus, Test_pdu_size),
+          "pool created");
+    sys_store_release(&producing, 1);
+    for (i = 0; i < Test_consumers; i++)
+    {
+        pthread_mutex_init(&consumers[i].lock, NULL);
+        consumers[i].first = 0;
+        consumers[i].number = 0;
+        consumers[i].freed = 0;
+        consumers[i].bad = 0;
+        if (pthread_create(&consumers[i].thread, NULL, test_consumer,
+                           &consumers[i]) != 0)
+            started = False;
+    }
+    for (i = 0; i < Test_producers; i++)
+    {
+        producers[i].number = i;
+        producers[i].random = 0x9E3779B97F4A7C15ull + i;
+        producers[i].allocated = 0;
+        producers[i].failed = 0;
+        producers[i].handed = 0;
+        producers[i].bad = 0;
+        if (pthread_create(&producers[i].thread, NULL, test_producer,
+                           &producers[i]) != 0)
+            started = False;
+    }
+    check(started, "threads started");
+    if (!started)
+        return;
+    for (i = 0; i < Test_producers; i++)
+    {
+        pthread_join(producers[i].thread, NULL);
+        allocated += producers[i].allocated;
+        failed += producers[i].failed;
+        handed += producers[i].handed;
+        bad += producers[i].bad;
+    }
+    sys_store_release(&producing, 0);
+    for (i = 0; i < Test_consumers; i++)
+    {
+        pthread_join(consumers[i].thread, NULL);
+        freed += consumers[i].freed;
+        bad += consumers[i].bad;
+        pthread_mutex_destroy(&consumers[i].lock);
+    }
+    check((Boolean)(bad == 0), "no buffer is held by two threads at once");
+    check((Boolean)(freed == handed), "every PDU handed over is freed");
+    check((Boolean)(failed > 0), "the pool is exhausted at times");
+    syspdu_read_pool_counts(&counts);
+    check((Boolean)((counts.in_use == 0) && (counts.allocations == allocated) &&
+                    (counts.exhausted == failed) &&
+                    (counts.high_water <= Test_stress_pdus)),
+          "counts add up once every PDU is freed");
+    syspdu_destroy_pool();
+}
+int main(void)
+{
+    test_exhaustion();
+    test_free_elsewhere();
+    test_stress();
+    if (failures != 0)
+        printf("%d checks failed\n", failures);
+    return (failures != 0);
+}
@@ -0,0 +1,246 @@
+/* systime_test.c */
+#include <stdio.h>
+#include <string.h>
+#include "sys.h"
+/******************************************************************************
+ * SYSTIME TEST : TIMING WHEEL CHECKS
+ ******************************************************************************
+ *
+ * Checks that timers expire when they are due, to the millisecond, whichever
+ * level of the wheel they are filed in (or parked beyond its span), and
+ * from whatever time the wheel has reached; that each batch dispatches its
+ * timers in the order they expire, and in the order they were started when
+ * they expire together; and that timers of a process that is not
+ * registered, or has been registered again since they were started, are
+ * discarded rather than dispatched. Returns non-zero if any check fails.
+ */
+enum
+{
+    Test_process = 3,
+    Test_timers = 400,
+    Test_max_fired = Test_timers + 16,
+    Test_span = 1 << 26 /* 8 bits at the first level, 6 at each of three */
+};
+typedef struct /* Test_fired */
+{ /*
+   * The timers dispatched, in order: each one's context and instance_id.
+   */
+    void *contexts[Test_max_fired];
+    int instance_ids[Test_max_fired];
+    unsigned number;
+} Test_fired;
+static Test_fired fired;
+static int test_context = 0;
+static int test_other_context = 0;
+static int failures = 0;
+static unsigned long long test_random = 0x9E3779B97F4A7C15ull;
+static void check(Boolean ok, char *what)
+{
+    if (!ok)
+    {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+static unsigned test_next(unsigned range)
+{
+    test_random = test_random * 6364136223846793005ull +
+                  1442695040888963407ull;
+    return ((unsigned)(test_random >> 33) % range);
+}
+static void test_expiry(void *context, int instance_id)
+{
+    if (fired.number < Test_max_fired)
+    {
+        fired.contexts[fired.number] = context;
+        fired.instance_ids[fired.number] = instance_id;
+    }
+    fired.number++;
+}
+static void test_expiry_starts_more(void *context, int instance_id)
+{ /*
+   * Starts a timer to expire at once, and one a millisecond later.
+   */
+    test_expiry(context, instance_id);
+    systime_schedule(Test_process, test_expiry, instance_id + 100);
+    systime_start_timer(Test_process, test_expiry, instance_id + 200, 1);
+}
+static void test_create(unsigned long now)
+{
+    memset(&fired, 0, sizeof(fired));
+    check(systime_create_timers(now), "wheel created");
+    check(systime_register_process(Test_process, &test_context),
+          "process registered");
+}
+static void test_accuracy(unsigned long start, unsigned long phase)
+{ /*
+   * Starts Test_timers timers with delays spread over every level, and
+   * beyond the span of the wheel, once the wheel has advanced from start by
+   * phase milliseconds. The wheel is then advanced to a millisecond before
+   * each expiry and to the expiry itself: no timer may expire early, and
+   * each must have expired once its time has come.
+   */
+    static int delays[Test_timers];
+    Systime_counts counts;
+    unsigned long now;
+    unsigned long next;
+    unsigned due;
+    unsigned i;
+    int delay;
+    Boolean early = False;
+    Boolean late = False;
+    test_create(start);
+    now = start + phase;
+    (void)systime_expire_timers(now);
+    delays[0] = 1;
+    delays[1] = 255;
+    delays[2] = 256;
+    delays[3] = 1 << 14;
+    delays[4] = (1 << 14) + 1;
+    delays[5] = 1 << 20;
+    delays[6] = (1 << 20) - 1;
+    delays[7] = Test_span - 1;
+    delays[8] = Test_span;
+    delays[9] = Test_span + 12345;
+    for (i = 10; i < Test_timers; i++)
+    { /* a level at random, and a delay at random within it */
+        delay = 1 << (8 + 6 * test_next(4));
+        delays[i] = 1 + (int)test_next((unsigned)delay);
+    }
+    for (i = 0; i < Test_timers; i++)
+        systime_start_timer(Test_process, test_expiry, (int)i, delays[i]);
+    for (;;)
+    {
+        next = 0;
+        for (i = 0; i < Test_timers; i++)
+            if ((start + phase + delays[i] > now) &&
+                ((next == 0) || (start + phase + delays[i] < next)))
+                next = start + phase + delays[i];
+        if (next == 0)
+            break;
+        (void)systime_expire_timers(next - 1);
+        for (i = 0, due = 0; i < Test_timers; i++)
+            if (start + phase + delays[i] < next)
+                due++;
+        if (fired.number != due)
+            early = True;
+        (void)systime_expire_timers(now = next);
+        for (i = 0, due = 0; i < Test_timers; i++)
+            if (start + phase + delays[i] <= next)
+                due++;
+        if (fired.number != due)
+            late = True;
+    }
+    check((Boolean)!early, "no timer expires before it is due");
+    check((Boolean)!late, "every timer expires when it is due");
+    systime_read_counts(&counts);
+    check((Boolean)((counts.started == Test_timers) &&
+                    (counts.dispatched == Test_timers) &&
+                    (counts.armed == 0) &&
+                    (counts.high_water == Test_timers)),
+          "every timer started is dispatched");
+    systime_destroy_timers();
+}
+static void test_order(void)
+{ /*
+   * One batch dispatches the timers to expire at once first, then the
+   * others in the order they expire, and those that expire together in the
+   * order they were started. Timers started by the batch to expire at once
+   * follow it, in a batch of their own, and those started to expire later
+   * expire later.
+   */
+    static int expected[] = {6, 1, 4, 7, 0, 2, 5, 3, 103};
+    Systime_counts counts;
+    unsigned i;
+    Boolean ok = True;
+    test_create(1000);
+    systime_start_timer(Test_process, test_expiry, 0, 5);
+    systime_start_timer(Test_process, test_expiry, 1, 3);
+    systime_start_timer(Test_process, test_expiry, 2, 5);
+    systime_start_timer(Test_process, test_expiry_starts_more, 3, 300);
+    systime_start_timer(Test_process, test_expiry, 4, 3);
+    systime_start_timer(Test_process, test_expiry, 5, 5);
+    systime_schedule(Test_process, test_expiry, 6);
+    systime_start_timer(Test_process, test_expiry, 7, 4);
+    check((Boolean)(systime_expire_timers(1000) == 1),
+          "a scheduled timer expires at the next call");
+    check((Boolean)(systime_expire_timers(2000) == 8),
+          "the batch and the timer it scheduled are dispatched");
+    check((Boolean)(fired.number == 9), "nine timers dispatched");
+    for (i = 0; i < 9; i++)
+        if (fired.instance_ids[i] != expected[i])
+            ok = False;
+    check(ok, "timers are dispatched in the order they expire");
+    systime_read_counts(&counts);
+    check((Boolean)(counts.batches == 3), "each batch is counted");
+    check((Boolean)(systime_expire_timers(2000) == 0),
+          "nothing expires without time passing");
+    check((Boolean)((systime_expire_timers(2001) == 1) &&
+                    (fired.instance_ids[9] == 203)),
+          "a timer started by a batch expires after its timeout");
+    systime_destroy_timers();
+}
+static void test_random_timer(void)
+{ /*
+   * A random timer expires within its timeout.
+   */
+    unsigned i;
+    test_create(0);
+    for (i = 0; i < 100; i++)
+        systime_start_random_timer(Test_process, test_expiry, (int)i, 200);
+    (void)systime_expire_timers(199);
+    check((Boolean)(fired.number == 100),
+          "every random timer expires within its timeout");
+    systime_destroy_timers();
+}
+static void test_discard(void)
+{ /*
+   * A timer started for a process that is not registered is discarded at
+   * once, and one started for a process that is unregistered, even if the
+   * process is registered again, is discarded when it expires; the timers
+   * of the new registration are dispatched with its context.
+   */
+    Systime_counts counts;
+    test_create(0);
+    systime_start_timer(Test_process + 1, test_expiry, 1, 10);
+    systime_start_timer(-1, test_expiry, 2, 10);
+    systime_start_timer(1000, test_expiry, 3, 10);
+    systime_read_counts(&counts);
+    check((Boolean)((counts.discarded == 3) && (counts.armed == 0)),
+          "timers of processes not registered are discarded at once");
+    systime_start_timer(Test_process, test_expiry, 4, 10);
+    systime_schedule(Test_process, test_expiry, 5);
+    systime_unregister_process(Test_process);
+    check((Boolean)(systime_expire_timers(100) == 0),
+          "timers of an unregistered process are not dispatched");
+    check(systime_register_process(Test_process, &test_other_context),
+          "process registered again");
+    systime_start_timer(Test_process, test_expiry, 6, 10);
+    systime_start_timer(Test_process, test_expiry, 7, 20);
+    systime_unregister_process(Test_process);
+    check(systime_register_process(Test_process, &test_other_context),
+          "process registered once more");
+    systime_start_timer(Test_process, test_expiry, 8, 10);
+    check((Boolean)((systime_expire_timers(200) == 1) &&
+                    (fired.number == 1) && (fired.instance_ids[0] == 8) &&
+                    (fired.contexts[0] == &test_other_context)),
+          "only the new registration's timer is dispatched, to it");
+    systime_read_counts(&counts);
+    check((Boolean)((counts.discarded == 7) && (counts.armed == 0) &&
+                    (counts.dispatched == 1)),
+          "the timers of earlier registrations are counted as discarded");
+    systime_destroy_timers();
+}
+int main(void)
+{
+    test_accuracy(0, 0);
+    test_accuracy(0, 1);
+    test_accuracy(123456789, 255);
+    test_accuracy(4000000000UL, 16383);
+    test_order();
+    test_random_timer();
+    test_discard();
+    if (failures != 0)
+        printf("%d checks failed\n", failures);
+    return (failures != 0);
+}